@@ -0,0 +1,154 @@
+/***************************************************************/
+/*                                                             */
+/*  ARENA.C                                                    */
+/*                                                             */
+/*  Implementation of functions for allocating from an arena.  */
+/*                                                             */
+/*  This file is part of REMIND.                               */
+/*  Copyright (C) 1992-2022 by Dianne Skoll                    */
+/*                                                             */
+/***************************************************************/
+
+#include "config.h"
+#include "arena.h"
+#include <string.h>
+#include <stdlib.h>
+
+/* Every allocation is aligned suitably for any of these */
+typedef union {
+    long l;
+    double d;
+    void *p;
+} ArenaAlign;
+
+#define ARENA_ROUND(n) \
+    (((n) + sizeof(ArenaAlign) - 1) / sizeof(ArenaAlign) * sizeof(ArenaAlign))
+
+typedef struct arena_block {
+    struct arena_block *next;
+    size_t used;
+    size_t size;
+    ArenaAlign data[1];
+} ArenaBlock;
+
+/**********************************************************************
+%FUNCTION: ArenaInit
+%ARGUMENTS:
+ arena -- pointer to an arena
+%RETURNS:
+ Nothing
+%DESCRIPTION:
+ Initializes an empty arena
+**********************************************************************/
+void ArenaInit(Arena *arena)
+{
+    arena->head = NULL;
+}
+
+/**********************************************************************
+%FUNCTION: ArenaAlloc
+%ARGUMENTS:
+ arena -- pointer to an arena
+ n -- number of bytes wanted
+%RETURNS:
+ Pointer to n bytes of suitably-aligned memory, or NULL if out of
+ memory
+%DESCRIPTION:
+ Allocates memory from an arena.  Memory is carved out of blocks of
+ ARENA_BLOCK_SIZE bytes; larger requests get a block of their own.
+**********************************************************************/
+void *ArenaAlloc(Arena *arena, size_t n)
+{
+    ArenaBlock *b = arena->head;
+    size_t size;
+    void *ans;
+
+    n = ARENA_ROUND(n ? n : 1);
+    if (!b || b->size - b->used < n) {
+	size = (n > ARENA_BLOCK_SIZE) ? n : ARENA_BLOCK_SIZE;
+	b = malloc(offsetof(ArenaBlock, data) + size);
+	if (!b) return NULL;
+	b->used = 0;
+	b->size = size;
+
+	/* Don't abandon a partly-used block for the sake of
+	   one large allocation */
+	if (arena->head && n > ARENA_BLOCK_SIZE / 4) {
+	    b->next = arena->head->next;
+	    arena->head->next = b;
+	} else {
+	    b->next = arena->head;
+	    arena->head = b;
+	}
+    }
+    ans = ((char *) b->data) + b->used;
+    b->used += n;
+    return ans;
+}
+
+/**********************************************************************
+%FUNCTION: ArenaStrDup
+%ARGUMENTS:
+ arena -- pointer to an arena
+ s -- string to copy
+%RETURNS:
+ Copy of s allocated from the arena, or NULL if out of memory
+**********************************************************************/
+char *ArenaStrDup(Arena *arena, char const *s)
+{
+    size_t l = strlen(s) + 1;
+    char *ans = ArenaAlloc(arena, l);
+    if (ans) memcpy(ans, s, l);
+    return ans;
+}
+
+/**********************************************************************
+%FUNCTION: ArenaReset
+%ARGUMENTS:
+ arena -- pointer to an arena
+%RETURNS:
+ Nothing
+%DESCRIPTION:
+ Frees everything allocated from an arena, but keeps one ordinary
+ block for reuse so that an arena emptied over and over again
+ doesn't go back to malloc each time.
+**********************************************************************/
+void ArenaReset(Arena *arena)
+{
+    ArenaBlock *keep = NULL;
+    ArenaBlock *b;
+
+    while (arena->head) {
+	b = arena->head->next;
+	if (!keep && arena->head->size == ARENA_BLOCK_SIZE) {
+	    keep = arena->head;
+	} else {
+	    free(arena->head);
+	}
+	arena->head = b;
+    }
+    if (keep) {
+	keep->next = NULL;
+	keep->used = 0;
+	arena->head = keep;
+    }
+}
+
+/**********************************************************************
+%FUNCTION: ArenaFree
+%ARGUMENTS:
+ arena -- pointer to an arena
+%RETURNS:
+ Nothing
+%DESCRIPTION:
+ Frees everything allocated from an arena and reinitializes it
+**********************************************************************/
+void ArenaFree(Arena *arena)
+{
+    ArenaBlock *b;
+    while (arena->head) {
+	b = arena->head->next;
+	free(arena->head);
+	arena->head = b;
+    }
+}
@@ -0,0 +1,31 @@
+/***************************************************************/
+/*                                                             */
+/*  ARENA.H                                                    */
+/*                                                             */
+/*  Declaration of functions for allocating from an arena:     */
+/*  many small allocations that are all freed together.        */
+/*                                                             */
+/*  This file is part of REMIND.                               */
+/*  Copyright (C) 1992-2022 by Dianne Skoll                    */
+/*                                                             */
+/***************************************************************/
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>  /* For size_t */
+
+#define ARENA_BLOCK_SIZE 16384
+
+struct arena_block;
+typedef struct {
+    struct arena_block *head;
+} Arena;
+
+void ArenaInit(Arena *arena);
+void *ArenaAlloc(Arena *arena, size_t n);
+char *ArenaStrDup(Arena *arena, char const *s);
+void ArenaReset(Arena *arena);
+void ArenaFree(Arena *arena);
+
+#endif /* ARENA_H */
@@ -0,0 +1,379 @@
+/***************************************************************/
+/*                                                             */
+/*  BATCH.C                                                    */
+/*                                                             */
+/*  Batch mode (--batch=manifest):  run many jobs, each with   */
+/*  its own command line and output file, in one process.      */
+/*  Every job gets a fresh interpreter context, so variables,  */
+/*  functions, OMITs and so on don't leak from one job to the  */
+/*  next, but they all share the file cache, so files that     */
+/*  many jobs INCLUDE are read only once.                      */
+/*                                                             */
+/*  With --prelude=file, the prelude is run once and each job  */
+/*  runs in a child process forked from the state it leaves,   */
+/*  so its cost is not paid again for every job.               */
+/*                                                             */
+/*  This file is part of REMIND.                               */
+/*  Copyright (C) 1992-2022 by Dianne Skoll                    */
+/*                                                             */
+/***************************************************************/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "types.h"
+#include "protos.h"
+#include "globals.h"
+#include "err.h"
+
+/* Batch mode is part of the program, not the library */
+#ifndef LIBREMIND
+
+/* The most words a job's line may have */
+#define MAX_JOB_ARGS 64
+
+/* Where the job being started comes from */
+static char const *JobManifest;
+static int JobLine;
+static int JobRejected;
+
+/* The stream the manifest is read from */
+static FILE *ManifestFp;
+
+/* The state the prelude leaves, which every job starts from */
+static RemContext *Prelude;
+
+/***************************************************************/
+/*                                                             */
+/*  RejectBatchJob                                             */
+/*                                                             */
+/*  Called by InitRemind for a job whose command line it can't */
+/*  use.  The job is reported against its manifest line and    */
+/*  not run.                                                   */
+/*                                                             */
+/***************************************************************/
+void RejectBatchJob(char const *why)
+{
+    fprintf(ErrFp, "%s(%d): %s\n", JobManifest, JobLine, why);
+    JobRejected = 1;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  RejectBatchOption                                          */
+/*                                                             */
+/*  Called by InitRemind for an option a batch job may not     */
+/*  use.  The job is not run.                                  */
+/*                                                             */
+/***************************************************************/
+void RejectBatchOption(char const *opt)
+{
+    fprintf(ErrFp, "%s(%d): %s is not allowed in a batch job\n",
+	    JobManifest, JobLine, opt);
+    JobRejected = 1;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  SplitJob                                                   */
+/*                                                             */
+/*  Split a manifest line into words in place.  Words are      */
+/*  separated by white space; a word in double quotes may      */
+/*  contain it.  Returns the number of words, or -1 if there   */
+/*  are too many or a quote is not closed.                     */
+/*                                                             */
+/***************************************************************/
+static int SplitJob(char *line, char const **words, int max)
+{
+    char *s = line, *t;
+    int n = 0;
+
+    while (1) {
+	while (isspace((unsigned char) *s)) s++;
+	if (!*s) return n;
+	if (n == max) return -1;
+	if (*s == '"') {
+	    t = strchr(++s, '"');
+	    if (!t) return -1;
+	} else {
+	    t = s;
+	    while (*t && !isspace((unsigned char) *t)) t++;
+	}
+	words[n++] = s;
+	if (!*t) return n;
+	*t = 0;
+	s = t+1;
+    }
+}
+
+/***************************************************************/
+/*                                                             */
+/*  LoadPrelude                                                */
+/*                                                             */
+/*  Run the prelude once, for today's date, and keep what it   */
+/*  defines:  its variables and OMITs become the base ones, so */
+/*  calendar jobs get them back when they start each day       */
+/*  afresh.  Returns 0 or 1 on error.                          */
+/*                                                             */
+/***************************************************************/
+static int LoadPrelude(char const *file)
+{
+    RemContext *old;
+    int r;
+
+    Prelude = NewContext();
+    if (!Prelude) {
+	fprintf(ErrFp, "%s: %s\n", ArgV[0], ErrMsg[E_NO_MEM]);
+	return 1;
+    }
+    old = SwitchContext(Prelude);
+    Ctx->RealToday = SystemDate(&Ctx->CurYear, &Ctx->CurMon, &Ctx->CurDay);
+    set_components_from_lat_and_long();
+    if (Ctx->CalculateUTC) {
+	(void) CalcMinsFromUTC(Ctx->RealToday, SystemTime(0)/60,
+			       &Ctx->MinsFromUTC, NULL);
+    }
+    Ctx->InitialFile = file;
+    Ctx->ShouldCache = 1;
+    Ctx->DontQueue = 1;
+    /* EXIT just ends the prelude early */
+    Ctx->TrapExit = 1;
+    r = RunCalendarFile(Ctx->RealToday);
+    if (r == E_EXIT) r = OK;
+    ClearIncludeStack();
+    if (DestroyOmitContexts()) {
+	fprintf(ErrFp, "%s: %s\n", file, ErrMsg[E_PUSH_NOPOP]);
+    }
+    if (!r) {
+	r = SetBaseVars();
+	if (!r) r = SetBaseOmits();
+	if (r) fprintf(ErrFp, "%s: %s\n", ArgV[0], ErrMsg[r]);
+    }
+    SwitchContext(old);
+    return r ? 1 : 0;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  DoJob                                                      */
+/*                                                             */
+/*  Run one job in ctx:  words[0] is the output file ("-" for  */
+/*  our standard output) and the rest are remind's arguments.  */
+/*  The job's file name goes in *file, to be freed by the      */
+/*  caller.  Returns the job's exit status.                    */
+/*                                                             */
+/***************************************************************/
+static int DoJob(RemContext *ctx, char const *manifest, int lineno,
+		 char const **words, int nwords, char **file)
+{
+    FILE *errfp = ErrFp;
+    RemContext *old;
+    char const *output = words[0];
+    int fd, saved = -1;
+    int status;
+
+    if (strcmp(output, "-")) {
+	fd = open(output, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	if (fd < 0) {
+	    fprintf(errfp, "%s(%d): Cannot open `%s': %s\n", manifest, lineno,
+		    output, strerror(errno));
+	    return 1;
+	}
+	fflush(stdout);
+	saved = dup(STDOUT_FILENO);
+	dup2(fd, STDOUT_FILENO);
+	close(fd);
+    }
+
+    /* The job's arguments follow its output file, so the output
+       file's slot can take the program name */
+    words[0] = ArgV[0];
+    old = SwitchContext(ctx);
+    JobManifest = manifest;
+    JobLine = lineno;
+    JobRejected = 0;
+    InBatchJob = 1;
+    InitRemind(nwords, words);
+    InBatchJob = 0;
+    if (!JobRejected && (Ctx->Daemon || Ctx->PurgeMode)) {
+	RejectBatchOption(Ctx->Daemon ? "-z" : "-j");
+    }
+    /* Remind exits if it can't read its file, which would end
+       the batch, so make sure it can first */
+    if (!JobRejected && !Ctx->UseStdin && access(Ctx->InitialFile, R_OK)) {
+	char why[512];
+	snprintf(why, sizeof(why), "%s: `%s': %s", ErrMsg[E_CANTACCESS],
+		 Ctx->InitialFile, strerror(errno));
+	RejectBatchJob(why);
+    }
+    if (JobRejected) {
+	status = 1;
+    } else {
+	/* Timed reminders can't be queued, since we carry on to the
+	   next job, and EXIT must end only this one; and keep every
+	   file read for the jobs to come */
+	Ctx->DontQueue = 1;
+	Ctx->TrapExit = 1;
+	Ctx->Exited = 0;
+	Ctx->ShouldCache = 1;
+	status = RunRemind();
+    }
+    /* A rejected job may not have got as far as its file name */
+    *file = Ctx->InitialFile ? StrDup(Ctx->InitialFile) : NULL;
+
+    fflush(stdout);
+    if (saved >= 0) {
+	dup2(saved, STDOUT_FILENO);
+	close(saved);
+    }
+    /* -e may have pointed ErrFp at the job's output */
+    ErrFp = errfp;
+    SwitchContext(old);
+    return status;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  RunJob                                                     */
+/*                                                             */
+/*  Run one job in a fresh context, or, if there is a prelude, */
+/*  in a child process starting from the prelude's state.      */
+/*  The job's file name goes in *file, to be freed by the      */
+/*  caller; it is left NULL for a child, whose reading of      */
+/*  files doesn't touch our cache.                             */
+/*                                                             */
+/***************************************************************/
+static int RunJob(char const *manifest, int lineno, char const **words,
+		  int nwords, char **file)
+{
+    RemContext *ctx;
+    pid_t pid;
+    int status;
+
+    if (Prelude) {
+	/* Anything still buffered would be written by the child too */
+	fflush(stdout);
+	fflush(ErrFp);
+	pid = fork();
+	if (pid == -1) {
+	    fprintf(ErrFp, "%s(%d): %s\n", manifest, lineno, ErrMsg[E_CANTFORK]);
+	    return 1;
+	}
+	if (pid == 0) {
+	    /* We share the manifest's file offset with our parent, and
+	       anything that flushes or closes our copy of its stream,
+	       such as exit() from an EXIT command, would move it back
+	       to the line we were started for.  So the stream's
+	       descriptor is pointed at /dev/null instead, and we leave
+	       with _exit() */
+	    int fd = open("/dev/null", O_RDONLY);
+	    if (fd < 0 || dup2(fd, fileno(ManifestFp)) < 0) _exit(1);
+	    if (fd != fileno(ManifestFp)) close(fd);
+	    status = DoJob(Prelude, manifest, lineno, words, nwords, file);
+	    fflush(stdout);
+	    _exit(status);
+	}
+	if (waitpid(pid, &status, 0) < 0) return 1;
+	return !WIFEXITED(status) || WEXITSTATUS(status);
+    }
+
+    ctx = NewContext();
+    if (!ctx) {
+	fprintf(ErrFp, "%s(%d): %s\n", manifest, lineno, ErrMsg[E_NO_MEM]);
+	return 1;
+    }
+    status = DoJob(ctx, manifest, lineno, words, nwords, file);
+    FreeContext(ctx);
+    return status;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  RunBatch                                                   */
+/*                                                             */
+/*  Run every job in the manifest (standard input if it is     */
+/*  "-").  Each line is an output file followed by the         */
+/*  arguments remind would be given for the job; blank lines   */
+/*  and lines starting with # are ignored.  If prelude isn't   */
+/*  NULL, it is run first and each job starts from the state   */
+/*  it leaves.  Returns 0 if all the jobs succeeded, 1         */
+/*  otherwise.                                                 */
+/*                                                             */
+/***************************************************************/
+int RunBatch(char const *manifest, char const *prelude)
+{
+    DynamicBuffer line;
+    FILE *fp;
+    char const *words[MAX_JOB_ARGS];
+    char *file, *lastfile = NULL;
+    int lineno = 0;
+    int n, status = 0;
+
+    if (!strcmp(manifest, "-")) {
+	fp = stdin;
+    } else {
+	fp = fopen(manifest, "r");
+	if (!fp) {
+	    fprintf(ErrFp, "%s: Cannot open `%s': %s\n", ArgV[0], manifest,
+		    strerror(errno));
+	    return 1;
+	}
+    }
+    if (prelude && LoadPrelude(prelude)) {
+	FreeContext(Prelude);
+	Prelude = NULL;
+	if (fp != stdin) fclose(fp);
+	return 1;
+    }
+    ManifestFp = fp;
+
+    DBufInit(&line);
+    while (DBufGets(&line, fp) == OK) {
+	if (!*DBufValue(&line) && feof(fp)) break;
+	lineno++;
+	n = SplitJob(DBufValue(&line), words, MAX_JOB_ARGS);
+	if (n < 0) {
+	    fprintf(ErrFp, "%s(%d): Too many words or unmatched quote\n",
+		    manifest, lineno);
+	    status = 1;
+	    continue;
+	}
+	if (!n || *words[0] == '#') continue;
+	if (n < 2) {
+	    fprintf(ErrFp, "%s(%d): Expecting an output file and a reminder file\n",
+		    manifest, lineno);
+	    status = 1;
+	    continue;
+	}
+
+	file = NULL;
+	if (RunJob(manifest, lineno, words, n, &file)) status = 1;
+
+	/* The files named in the manifest usually belong to one job
+	   each; only the files they INCLUDE are worth keeping */
+	if (lastfile && (!file || strcmp(file, lastfile))) {
+	    UncacheFile(lastfile);
+	}
+	free(lastfile);
+	lastfile = file;
+    }
+    free(lastfile);
+    DBufFree(&line);
+    if (fp != stdin) fclose(fp);
+    ManifestFp = NULL;
+    FreeContext(Prelude);
+    Prelude = NULL;
+    return status;
+}
+
+#endif /* LIBREMIND */
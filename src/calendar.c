@@ -10,10 +10,12 @@
 /***************************************************************/
 
 #define _XOPEN_SOURCE 600
+#include "version.h"
 #include "config.h"
 #include "custom.h"
 
 #include <stdio.h>
+#include <stdarg.h>
 #include <string.h>
 #include <strings.h>
 #include <ctype.h>
@@ -21,6 +23,11 @@
 #include <stdlib.h>
 #include <sys/ioctl.h>
 #include <unistd.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/select.h>
+#include <sys/wait.h>
 
 #ifdef REM_USE_WCHAR
 #include <wctype.h>
@@ -29,6 +36,7 @@
 
 #ifdef HAVE_LANGINFO_H
 #include <langinfo.h>
+#include <time.h>
 #endif
 
 #include "lang.h"
@@ -38,10 +46,15 @@
 #include "globals.h"
 #include "err.h"
 #include "md5.h"
+#include "arena.h"
+#include "libremind.h"
+
+#ifdef USE_THREADS
+#include <pthread.h>
+#endif
 
 /* Data structures used by the calendar */
 typedef struct cal_entry {
-    struct cal_entry *next;
     char *text;
     char *raw_text;
     char const *pos;
@@ -53,7 +66,7 @@ typedef struct cal_entry {
     int r, g, b;
     int time;
     int priority;
-    DynamicBuffer tags;
+    char const *tags;
     char passthru[PASSTHRU_LEN+1];
     int duration;
     char *filename;
@@ -81,7 +94,7 @@ static struct line_drawing VT100Drawing = {
   "\x6c", "\x74", "\x6a", "\x71"
 };
 
-static int encoding_is_utf8 = 0;
+static THREAD_LOCAL int encoding_is_utf8 = 0;
 
 static struct line_drawing UTF8Drawing = {
     "", "",
@@ -180,16 +193,36 @@ static char const *moonphase_emojis[] = {
 
 /* Moon phases for each day 1-31, up to 32 chars per moon-phase string
    including termination \0 */
-static char moons[32][32];
+static THREAD_LOCAL char moons[32][32];
 
 /* Week indicators */
-static char weeks[32][32];
+static THREAD_LOCAL char weeks[32][32];
 
 /* Background colors of each day 1-31, rgb */
-static int bgcolor[32][3];
+static THREAD_LOCAL int bgcolor[32][3];
+
+static THREAD_LOCAL struct line_drawing *linestruct;
+
+/* Rules and the column separator for the current linestruct and
+   ColSpaces; see BuildCalLines() */
+static THREAD_LOCAL DynamicBuffer ColSep, TopLine, BottomLine, PostHeaderLine;
+static THREAD_LOCAL DynamicBuffer WeekHeaderLine, IntermediateLine;
 
-static struct line_drawing *linestruct;
-#define DRAW(x) fputs(linestruct->x, stdout)
+/* Buffered calendar output */
+#define CAL_OUT_SIZE 8192
+static THREAD_LOCAL char CalOut[CAL_OUT_SIZE];
+static THREAD_LOCAL size_t CalOutLen = 0;
+
+/* Where the output goes: stdout, or a worker thread's own file */
+static THREAD_LOCAL FILE *CalOutFp = NULL;
+#define CAL_OUT_FP (CalOutFp ? CalOutFp : stdout)
+
+#define OutPutc(c) do { \
+    if (CalOutLen == CAL_OUT_SIZE) OutFlush(); \
+    CalOut[CalOutLen++] = (c); \
+} while(0)
+
+#define OutDBuf(dbuf) OutWrite(DBufValue(dbuf), DBufLen(dbuf))
 
 struct xterm256_colors {
     int r;
@@ -268,27 +301,57 @@ static struct xterm256_colors XTerm256Colors[] =
     {208, 208, 208}, {218, 218, 218}, {228, 228, 228}, {238, 238, 238}
 };
 
+/* The entries for one column (day) of the row being produced.
+   They are appended in file order, sorted once when the column is
+   complete, and all freed together when the row has been written. */
+typedef struct {
+    CalEntry **entries;
+    int num;     /* Number of entries */
+    int size;    /* Allocated size of entries */
+    int cur;     /* Entry being written by WriteOneColLine */
+} CalCell;
+
 /* Global variables */
-static CalEntry *CalColumn[7];
-static int ColToDay[7];
+static THREAD_LOCAL CalCell CalColumn[7];
+static THREAD_LOCAL Arena CalArena;     /* Entries and their text for the current row */
+static THREAD_LOCAL int ColToDay[7];
 
-static int ColSpaces;
+static THREAD_LOCAL int ColSpaces;
 
-static int DidAMonth;
-static int DidADay;
+static THREAD_LOCAL int DidAMonth;
+static THREAD_LOCAL int DidADay;
 
 static void ColorizeEntry(CalEntry const *e, int clamp);
-static void SortCol (CalEntry **col);
+static void OutFlush (void);
+static void OutWrite (char const *s, size_t n);
+static void OutPuts (char const *s);
+static void BuildCalLines (void);
+#ifdef USE_THREADS
+static void FreeCalState (void);
+#endif
+static void WriteBinStart (void);
+static void WriteBinMonth (int y, int m);
+static void WriteBinEntry (CalEntry const *e, int d);
+static void OutBinRecord (int type, size_t len);
+static void WriteColSep (void);
+static void SortCol (CalCell *col);
+static int AddToCol (CalCell *col, CalEntry *e);
+static void ClearCalColumns (void);
 static void DoCalendarOneWeek (int nleft);
 static void DoCalendarOneMonth (void);
+static void DoHTMLOneMonth (void);
+static char const *SkipWords (char const *s, int n);
+static void WriteHTMLStart (void);
+static void WriteHTMLEnd (void);
 static int WriteCalendarRow (void);
 static void WriteWeekHeaderLine (void);
 static void WritePostHeaderLine (void);
 static void PrintLeft (char const *s, int width, char pad);
-static void PrintCentered (char const *s, int width, char *pad);
+static void PrintCentered (char const *s, int width, char pad);
 static int WriteOneCalLine (int jul, int wd);
 static int WriteOneColLine (int col);
 static void GenerateCalEntries (int col);
+static int CollectCalEntries (int col);
 static void WriteCalHeader (void);
 static void WriteCalTrailer (void);
 static int DoCalRem (ParsePtr p, int col);
@@ -313,13 +376,13 @@ Backgroundize(int d)
         return;
     }
 
-    if (!UseBGVTColors) {
+    if (!Ctx->UseBGVTColors) {
         return;
     }
     if (bgcolor[d][0] < 0) {
         return;
     }
-    printf("%s", Colorize(bgcolor[d][0], bgcolor[d][1], bgcolor[d][2], 1, 0));
+    OutPuts(Colorize(bgcolor[d][0], bgcolor[d][1], bgcolor[d][2], 1, 0));
 }
 
 static void
@@ -329,34 +392,34 @@ UnBackgroundize(int d)
         return;
     }
 
-    if (!UseBGVTColors) {
+    if (!Ctx->UseBGVTColors) {
         return;
     }
     if (bgcolor[d][0] < 0) {
         return;
     }
-    printf("%s", Decolorize());
+    OutPuts(Decolorize());
 }
 
 static void
 send_lrm(void)
 {
     /* Don't send LRM if SuppressLRM is set */
-    if (SuppressLRM) {
+    if (Ctx->SuppressLRM) {
         return;
     }
     /* Send a lrm control sequence if UseUTF8Chars is enabled
        or char encoding is UTF-8
     */
-    if (UseUTF8Chars || encoding_is_utf8) {
-        printf("\xE2\x80\x8E");
+    if (Ctx->UseUTF8Chars || encoding_is_utf8) {
+        OutPuts("\xE2\x80\x8E");
     }
 }
 
 static char const *
 despace(char const *s)
 {
-    static char buf[256];
+    static THREAD_LOCAL char buf[256];
 
     char *t = buf;
     if (strlen(s) > sizeof(buf)-1) {
@@ -375,58 +438,133 @@ despace(char const *s)
     return buf;
 }
 
-void PrintJSONChar(char c) {
+/***************************************************************/
+/*                                                             */
+/*  Output buffering                                           */
+/*                                                             */
+/*  The calendar is produced a few bytes at a time.  Rather    */
+/*  than make a stdio call for each piece, collect the output  */
+/*  in CalOut and hand it to stdout (or, in a worker thread,   */
+/*  CalOutFp) in large chunks.                                 */
+/*  OutFlush() must be called before anything else may write   */
+/*  to stdout.                                                 */
+/*                                                             */
+/***************************************************************/
+static void OutFlush(void)
+{
+    if (CalOutLen) {
+	fwrite(CalOut, 1, CalOutLen, CAL_OUT_FP);
+	CalOutLen = 0;
+    }
+}
+
+static void OutWrite(char const *s, size_t n)
+{
+    if (CalOutLen + n > CAL_OUT_SIZE) {
+	OutFlush();
+	if (n > CAL_OUT_SIZE) {
+	    fwrite(s, 1, n, CAL_OUT_FP);
+	    return;
+	}
+    }
+    memcpy(CalOut + CalOutLen, s, n);
+    CalOutLen += n;
+}
+
+static void OutPuts(char const *s)
+{
+    OutWrite(s, strlen(s));
+}
+
+/* Write n copies of c */
+static void OutPad(char c, int n)
+{
+    size_t k;
+
+    while (n > 0) {
+	if (CalOutLen == CAL_OUT_SIZE) OutFlush();
+	k = CAL_OUT_SIZE - CalOutLen;
+	if (k > (size_t) n) k = n;
+	memset(CalOut + CalOutLen, c, k);
+	CalOutLen += k;
+	n -= k;
+    }
+}
+
+static void OutPrintf(char const *fmt, ...)
+{
+    va_list argptr;
+    int n;
+
+    if (CAL_OUT_SIZE - CalOutLen < 256) OutFlush();
+    va_start(argptr, fmt);
+    n = vsnprintf(CalOut + CalOutLen, CAL_OUT_SIZE - CalOutLen, fmt, argptr);
+    va_end(argptr);
+    if (n < 0) return;
+    if ((size_t) n < CAL_OUT_SIZE - CalOutLen) {
+	CalOutLen += n;
+	return;
+    }
+
+    /* Didn't fit; send it straight out */
+    OutFlush();
+    va_start(argptr, fmt);
+    vfprintf(CAL_OUT_FP, fmt, argptr);
+    va_end(argptr);
+}
+
+static void OutJSONChar(char c)
+{
     switch(c) {
-    case '\b': printf("\\b"); break;
-    case '\f': printf("\\f"); break;
-    case '\n': printf("\\n"); break;
-    case '\r': printf("\\r"); break;
-    case '\t': printf("\\t"); break;
-    case '"':  printf("\\\""); break;
-    case '\\': printf("\\\\"); break;
-    default: printf("%c", c);
+    case '\b': OutWrite("\\b", 2); break;
+    case '\f': OutWrite("\\f", 2); break;
+    case '\n': OutWrite("\\n", 2); break;
+    case '\r': OutWrite("\\r", 2); break;
+    case '\t': OutWrite("\\t", 2); break;
+    case '"':  OutWrite("\\\"", 2); break;
+    case '\\': OutWrite("\\\\", 2); break;
+    default: OutPutc(c);
     }
 }
 
-void PrintJSONString(char const *s)
+static void OutJSONString(char const *s)
 {
+    size_t n;
+
     while (*s) {
-	switch(*s) {
-	case '\b': printf("\\b"); break;
-	case '\f': printf("\\f"); break;
-	case '\n': printf("\\n"); break;
-	case '\r': printf("\\r"); break;
-	case '\t': printf("\\t"); break;
-	case '"':  printf("\\\""); break;
-	case '\\': printf("\\\\"); break;
-	default: printf("%c", *s);
+	/* Copy a run of characters that need no escaping in one go */
+	n = JSONPlainSpan(s);
+	if (n) {
+	    OutWrite(s, n);
+	    s += n;
+	    if (!*s) break;
 	}
-	s++;
+	OutJSONChar(*s++);
     }
 }
 
-void PrintJSONKeyPairInt(char const *name, int val)
+static void OutJSONKeyPairInt(char const *name, int val)
 {
-    printf("\"");
-    PrintJSONString(name);
-    printf("\":%d,", val);
+    OutPutc('"');
+    OutJSONString(name);
+    OutPrintf("\":%d,", val);
 }
 
-void PrintJSONKeyPairString(char const *name, char const *val)
+static void OutJSONKeyPairString(char const *name, char const *val)
 {
     /* If value is blank, skip it! */
     if (!val || !*val) {
 	return;
     }
 
-    printf("\"");
-    PrintJSONString(name);
-    printf("\":\"");
-    PrintJSONString(val);
-    printf("\",");
+    OutPutc('"');
+    OutJSONString(name);
+    OutWrite("\":\"", 3);
+    OutJSONString(val);
+    OutWrite("\",", 2);
 }
 
-void PrintJSONKeyPairDate(char const *name, int jul)
+static void OutJSONKeyPairDate(char const *name, int jul)
 {
     int y, m, d;
     if (jul == NO_DATE) {
@@ -434,13 +572,13 @@ void PrintJSONKeyPairDate(char const *name, int jul)
 	return;
     }
     FromJulian(jul, &y, &m, &d);
-    printf("\"");
-    PrintJSONString(name);
-    printf("\":\"%04d-%02d-%02d\",", y, m+1, d);
+    OutPutc('"');
+    OutJSONString(name);
+    OutPrintf("\":\"%04d-%02d-%02d\",", y, m+1, d);
 
 }
 
-void PrintJSONKeyPairDateTime(char const *name, int dt)
+static void OutJSONKeyPairDateTime(char const *name, int dt)
 {
     int y, m, d, h, i, k;
     if (dt == NO_TIME) {
@@ -452,13 +590,13 @@ void PrintJSONKeyPairDateTime(char const *name, int dt)
     k = dt % MINUTES_PER_DAY;
     h = k / 60;
     i = k % 60;
-    printf("\"");
-    PrintJSONString(name);
-    printf("\":\"%04d-%02d-%02dT%02d:%02d\",", y, m+1, d, h, i);
+    OutPutc('"');
+    OutJSONString(name);
+    OutPrintf("\":\"%04d-%02d-%02dT%02d:%02d\",", y, m+1, d, h, i);
 
 }
 
-void PrintJSONKeyPairTime(char const *name, int t)
+static void OutJSONKeyPairTime(char const *name, int t)
 {
     int h, i;
     if (t == NO_TIME) {
@@ -467,13 +605,61 @@ void PrintJSONKeyPairTime(char const *name, int t)
     }
     h = t / 60;
     i = t % 60;
-    printf("\"");
-    PrintJSONString(name);
-    printf("\":\"%02d:%02d\",", h, i);
+    OutPutc('"');
+    OutJSONString(name);
+    OutPrintf("\":\"%02d:%02d\",", h, i);
+
+}
+
+/* The public versions write straight through to stdout */
+void PrintJSONString(char const *s)
+{
+    OutJSONString(s);
+    OutFlush();
+}
+
+void PrintJSONKeyPairInt(char const *name, int val)
+{
+    OutJSONKeyPairInt(name, val);
+    OutFlush();
+}
+
+void PrintJSONKeyPairString(char const *name, char const *val)
+{
+    OutJSONKeyPairString(name, val);
+    OutFlush();
+}
+
+void PrintJSONKeyPairDate(char const *name, int jul)
+{
+    OutJSONKeyPairDate(name, jul);
+    OutFlush();
+}
 
+void PrintJSONKeyPairDateTime(char const *name, int dt)
+{
+    OutJSONKeyPairDateTime(name, dt);
+    OutFlush();
+}
+
+void PrintJSONKeyPairTime(char const *name, int t)
+{
+    OutJSONKeyPairTime(name, t);
+    OutFlush();
 }
 
 #ifdef REM_USE_WCHAR
+static void OutWideChar(wchar_t const wc)
+{
+    int len;
+
+    if (CAL_OUT_SIZE - CalOutLen < MB_CUR_MAX) OutFlush();
+    len = wctomb(CalOut + CalOutLen, wc);
+    if (len > 0) {
+	CalOutLen += len;
+    }
+}
+
 void PutWideChar(wchar_t const wc)
 {
     char buf[MB_CUR_MAX+1];
@@ -490,7 +676,7 @@ void PutWideChar(wchar_t const wc)
 static char const *
 get_month_abbrev(char const *mon)
 {
-    static char buf[80];
+    static THREAD_LOCAL char buf[80];
 #ifndef REM_USE_WCHAR
     sprintf(buf, "%.3s", mon);
     return buf;
@@ -530,7 +716,7 @@ static int make_wchar_versions(CalEntry *e)
     len = mbstowcs(NULL, e->text, 0);
     if (len == (size_t) -1) return 0;
 
-    buf = calloc(len+1, sizeof(wchar_t));
+    buf = ArenaAlloc(&CalArena, (len+1) * sizeof(wchar_t));
     if (!buf) return 0;
 
     (void) mbstowcs(buf, e->text, len+1);
@@ -543,23 +729,14 @@ static int make_wchar_versions(CalEntry *e)
 #endif
 }
 
-static void gon(void)
-{
-  printf("%s", linestruct->graphics_on);
-}
-static void goff(void)
-{
-  printf("%s", linestruct->graphics_off);
-}
-
 static void
 ClampColor(int *r, int *g, int *b)
 {
-    if (TerminalBackground == TERMINAL_BACKGROUND_UNKNOWN) {
+    if (Ctx->TerminalBackground == TERMINAL_BACKGROUND_UNKNOWN) {
 	/* No special clamping if terminal background is unknown */
 	return;
     }
-    if (TerminalBackground == TERMINAL_BACKGROUND_DARK) {
+    if (Ctx->TerminalBackground == TERMINAL_BACKGROUND_DARK) {
 	if (*r <= 64 && *g <= 64 && *b <= 64) {
 	    int max = *r;
 	    double factor;
@@ -578,7 +755,7 @@ ClampColor(int *r, int *g, int *b)
 	}
 	return;
     }
-    if (TerminalBackground == TERMINAL_BACKGROUND_LIGHT) {
+    if (Ctx->TerminalBackground == TERMINAL_BACKGROUND_LIGHT) {
 	if (*r > 191 && *g > 191 && *b > 191) {
 	    int min = *r;
 	    if (*g < min) min = *g;
@@ -600,7 +777,7 @@ Decolorize(void)
 static char const *
 Colorize256(int r, int g, int b, int bg, int clamp)
 {
-    static char buf[40];
+    static THREAD_LOCAL char buf[40];
     int best = -1;
     int best_dist = 0;
     int dist;
@@ -632,7 +809,7 @@ Colorize256(int r, int g, int b, int bg, int clamp)
 static char const *
 ColorizeTrue(int r, int g, int b, int bg, int clamp)
 {
-    static char buf[40];
+    static THREAD_LOCAL char buf[40];
     if (clamp) {
         ClampColor(&r, &g, &b);
     }
@@ -649,11 +826,11 @@ Colorize(int r, int g, int b, int bg, int clamp)
 {
     int bright = 0;
 
-    if (UseTrueColors) {
+    if (Ctx->UseTrueColors) {
 	return ColorizeTrue(r, g, b, bg, clamp);
     }
 
-    if (Use256Colors) {
+    if (Ctx->Use256Colors) {
 	return Colorize256(r, g, b, bg, clamp);
     }
 
@@ -667,11 +844,11 @@ Colorize(int r, int g, int b, int bg, int clamp)
     if (b > 64) b = 1;
     else b = 0;
 
-    if (clamp && TerminalBackground == TERMINAL_BACKGROUND_DARK && !bg) {
+    if (clamp && Ctx->TerminalBackground == TERMINAL_BACKGROUND_DARK && !bg) {
 	/* Convert black-on-black to grey */
 	if (!r && !g && !b) return VT100Colors[1][0][0][0];
     }
-    if (clamp && TerminalBackground == TERMINAL_BACKGROUND_LIGHT && !bg) {
+    if (clamp && Ctx->TerminalBackground == TERMINAL_BACKGROUND_LIGHT && !bg) {
 	/* Convert white-on-white to grey */
 	if (r && g && b) return VT100Colors[1][0][0][0];
     }
@@ -684,7 +861,7 @@ Colorize(int r, int g, int b, int bg, int clamp)
 
 static void ColorizeEntry(CalEntry const *e, int clamp)
 {
-    printf("%s", Colorize(e->r, e->g, e->b, 0, clamp));
+    OutPuts(Colorize(e->r, e->g, e->b, 0, clamp));
 }
 
 static void
@@ -699,7 +876,7 @@ InitMoonsAndShades(void)
     }
 
     /* Clear SHADEs */
-    if (UseBGVTColors) {
+    if (Ctx->UseBGVTColors) {
         for (i=0; i<=31; i++) {
             bgcolor[i][0] = -1;
             bgcolor[i][1] = -1;
@@ -713,130 +890,1435 @@ InitMoonsAndShades(void)
     }
 }
 
-static void
-SetShadeEntry(int jul, char const *shade)
+static void
+SetShadeEntry(int jul, char const *shade)
+{
+    int y, m, d;
+    int r, g, b;
+    /* Don't bother if we're not doing SHADE specials */
+    if (!Ctx->UseBGVTColors) {
+        return;
+    }
+
+    if (sscanf(shade, "%d %d %d", &r, &g, &b) != 3) {
+        if (sscanf(shade, "%d", &r) != 1) {
+            return;
+        }
+        g = r;
+        b = r;
+    }
+    if (r < 0 || g < 0 || b < 0 || r > 255 || g > 255 || b > 255) {
+        return;
+    }
+    FromJulian(jul, &y, &m, &d);
+    bgcolor[d][0] = r;
+    bgcolor[d][1] = g;
+    bgcolor[d][2] = b;
+}
+
+static void
+SetMoonEntry(int jul, char const *moon)
+{
+    int phase;
+    int y, m, d;
+    char msg[28];
+
+    /* Don't bother unless it's utf-8 */
+    if (!encoding_is_utf8) {
+        return;
+    }
+
+    msg[0] = 0;
+    if (sscanf(moon, "%d %*d %*d %27[^\x01]", &phase, msg) < 4) {
+        if (sscanf(moon, "%d", &phase) != 1) {
+            /* Malformed MOON special; ignore */
+            fprintf(stderr, "Oops 1\n");
+            return;
+        }
+    }
+    if (phase < 0 || phase > 3) {
+        /* Bad phase */
+        fprintf(stderr, "Oops 2\n");
+        return;
+    }
+    FromJulian(jul, &y, &m, &d);
+    if (msg[0]) {
+        snprintf(moons[d], sizeof(moons[d]), "%s %s", moonphase_emojis[phase], msg);
+    } else {
+        snprintf(moons[d], sizeof(moons[d]), "%s", moonphase_emojis[phase]);
+    }
+}
+
+
+/***************************************************************/
+/*                                                             */
+/*  InitCalOutput                                              */
+/*                                                             */
+/*  Set up the line-drawing characters and column widths the   */
+/*  calendar is drawn with.  CalWidth must already be a whole  */
+/*  number of columns wide.                                    */
+/*                                                             */
+/***************************************************************/
+static void InitCalOutput(void)
+{
+    /* Check if current locale is UTF-8, if we have langinfo.h */
+#ifdef HAVE_LANGINFO_H
+    char const *encoding = nl_langinfo(CODESET);
+    if (!strcasecmp(encoding, "utf-8")) {
+        encoding_is_utf8 = 1;
+    }
+
+#endif
+    if (Ctx->UseUTF8Chars) {
+	linestruct = &UTF8Drawing;
+    } else if (Ctx->UseVTChars) {
+        linestruct = &VT100Drawing;
+    } else {
+        linestruct = &NormalDrawing;
+    }
+    Ctx->ShouldCache = 1;
+
+    ColSpaces = (Ctx->CalWidth - 8) / 7;
+    BuildCalLines();
+}
+
+/***************************************************************/
+/*                                                             */
+/*  DoCalendarPart                                             */
+/*                                                             */
+/*  Produce num of the total months (or, if weeks is set,      */
+/*  weeks) of the calendar, starting with the first'th.        */
+/*  JulianToday must be the day the first one starts.          */
+/*                                                             */
+/***************************************************************/
+static void DoCalendarPart(int first, int num, int total, int weeks)
+{
+    int i;
+
+    /* After EXIT, the month or week it was in is the last */
+    for (i=first; i<first+num && !Ctx->Exited; i++) {
+	if (weeks) {
+	    DoCalendarOneWeek(total-1-i);
+	} else {
+	    if (Ctx->HtmlCal) {
+		DoHTMLOneMonth();
+	    } else {
+		DoCalendarOneMonth();
+	    }
+	    DidAMonth = 1;
+	}
+    }
+}
+
+#ifdef USE_THREADS
+/***************************************************************/
+/*                                                             */
+/*  Producing a calendar in parallel                           */
+/*                                                             */
+/*  With --threads, the months (or weeks) of a calendar are    */
+/*  split into runs of consecutive ones, each produced by a    */
+/*  worker thread with its own copy of the context into its    */
+/*  own temporary file.  The files are then copied out in      */
+/*  order, so the output is the same as if the calendar had    */
+/*  been produced in one go.                                   */
+/*                                                             */
+/***************************************************************/
+typedef struct {
+    pthread_t thread;
+    int started;
+    RemContext *ctx;
+    int first, num;	/* The months or weeks it produces */
+    int total, weeks;
+    FILE *out;		/* Its output... */
+    FILE *err;		/* ...and error messages, which may be the same */
+} CalWorker;
+
+static void *RunCalWorker(void *arg)
+{
+    CalWorker *w = (CalWorker *) arg;
+
+    Ctx = w->ctx;
+    ErrFp = w->err;
+    CalOutFp = w->out;
+    InitCalOutput();
+    DidAMonth = (w->first > 0);
+    DoCalendarPart(w->first, w->num, w->total, w->weeks);
+    OutFlush();
+    FreeCalState();
+    return NULL;
+}
+
+static void CopyCalOutput(FILE *from, FILE *to)
+{
+    char buf[8192];
+    size_t n;
+
+    fflush(from);
+    rewind(from);
+    while ((n = fread(buf, 1, sizeof(buf), from)) > 0) {
+	fwrite(buf, 1, n, to);
+    }
+}
+
+static void FreeCalWorkers(CalWorker *w, int n)
+{
+    int i;
+
+    for (i=0; i<n; i++) {
+	if (w[i].err && w[i].err != w[i].out) fclose(w[i].err);
+	if (w[i].out) fclose(w[i].out);
+	FreeContext(w[i].ctx);
+    }
+    free(w);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  DoCalendarInThreads                                        */
+/*                                                             */
+/*  Produce the total months (or weeks) of the calendar that   */
+/*  start on JulianToday with up to CalThreads threads.        */
+/*  Returns 0 without producing anything if it can't be done   */
+/*  in parallel, in which case the caller must do it.          */
+/*                                                             */
+/***************************************************************/
+static int DoCalendarInThreads(int total, int weeks)
+{
+    CalWorker *w;
+    int n, i, y, m, d;
+    FILE *errfp = ErrFp;
+    RemContext *ctx = Ctx;
+
+    n = (Ctx->CalThreads < total) ? Ctx->CalThreads : total;
+
+    /* Debugging output is written as it happens, and standard
+       input can't be read twice */
+    if (n < 2 || Ctx->DebugFlag || Ctx->UseStdin) return 0;
+
+    w = calloc(n, sizeof(CalWorker));
+    if (!w) return 0;
+    FromJulian(Ctx->JulianToday, &y, &m, &d);
+    for (i=0; i<n; i++) {
+	w[i].first = total * i / n;
+	w[i].num = total * (i+1) / n - w[i].first;
+	w[i].total = total;
+	w[i].weeks = weeks;
+	w[i].ctx = CloneContext(Ctx);
+	w[i].out = tmpfile();
+	w[i].err = (ErrFp == stdout) ? w[i].out : tmpfile();
+	if (!w[i].ctx || !w[i].out || !w[i].err) {
+	    FreeCalWorkers(w, i+1);
+	    return 0;
+	}
+	if (weeks) {
+	    w[i].ctx->JulianToday = Ctx->JulianToday + 7 * w[i].first;
+	} else {
+	    w[i].ctx->JulianToday = Julian(y + (m + w[i].first) / 12,
+					   (m + w[i].first) % 12, 1);
+	}
+    }
+
+    /* Anything we have produced comes first */
+    OutFlush();
+
+    for (i=0; i<n; i++) {
+	w[i].started = !pthread_create(&w[i].thread, NULL, RunCalWorker, &w[i]);
+	if (!w[i].started) {
+	    /* Do that part ourselves, then */
+	    RunCalWorker(&w[i]);
+	    Ctx = ctx;
+	    ErrFp = errfp;
+	    CalOutFp = NULL;
+	    InitCalOutput();
+	}
+    }
+    for (i=0; i<n; i++) {
+	if (w[i].started) pthread_join(w[i].thread, NULL);
+	CopyCalOutput(w[i].out, stdout);
+	if (w[i].err != w[i].out) CopyCalOutput(w[i].err, ErrFp);
+    }
+    FreeCalWorkers(w, n);
+    return 1;
+}
+#else
+/* Without threads, a calendar is always produced in one go */
+#define DoCalendarInThreads(total, weeks) 0
+#endif
+
+#ifndef LIBREMIND
+/***************************************************************/
+/*                                                             */
+/*  Producing a calendar in child processes                    */
+/*                                                             */
+/*  With --processes, the months (or weeks) are split up as    */
+/*  for --threads, but each run is produced by a child         */
+/*  process forked after the file's first pass, which needs    */
+/*  no copying of the context and no locking.  Each child      */
+/*  writes to a pipe; we pass the first run's output straight  */
+/*  through and hold on to the others' until their turn.       */
+/*                                                             */
+/***************************************************************/
+typedef struct {
+    pid_t pid;		/* -1 if we couldn't fork it */
+    int fd;		/* Our end of its pipe, or -1 at EOF */
+    int first, num;
+    char *buf;		/* Output read before its turn */
+    size_t len, size;
+} CalChild;
+
+static void StartCalPart(int first, int jul)
+{
+    Ctx->JulianToday = jul;
+    DidAMonth = (first > 0);
+}
+
+/* Returns E_NO_MEM if the output can't be held */
+static int SaveChildOutput(CalChild *c, char const *s, size_t n)
+{
+    char *buf;
+    size_t size;
+
+    if (c->len + n > c->size) {
+	size = c->size ? 2*c->size : 65536;
+	while (size < c->len + n) size *= 2;
+	buf = realloc(c->buf, size);
+	if (!buf) return E_NO_MEM;
+	c->buf = buf;
+	c->size = size;
+    }
+    memcpy(c->buf + c->len, s, n);
+    c->len += n;
+    return OK;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  DoCalendarInProcesses                                      */
+/*                                                             */
+/*  Produce the total months (or weeks) of the calendar that   */
+/*  start on JulianToday with up to CalProcesses child         */
+/*  processes.  Returns 0 without producing anything if it     */
+/*  can't be done in parallel, in which case the caller must   */
+/*  do it.                                                     */
+/*                                                             */
+/***************************************************************/
+static int DoCalendarInProcesses(int total, int weeks)
+{
+    CalChild *c;
+    int n, i, cur, y, m, d, maxfd, status;
+    int fds[2];
+    int *start;
+    fd_set readSet;
+    char buf[8192];
+    ssize_t len;
+
+    n = (Ctx->CalProcesses < total) ? Ctx->CalProcesses : total;
+    if (n < 2 || Ctx->DebugFlag || Ctx->UseStdin) return 0;
+
+    c = calloc(n, sizeof(CalChild));
+    start = calloc(n, sizeof(int));
+    if (!c || !start) {
+	free(c);
+	free(start);
+	return 0;
+    }
+    FromJulian(Ctx->JulianToday, &y, &m, &d);
+    for (i=0; i<n; i++) {
+	c[i].first = total * i / n;
+	c[i].num = total * (i+1) / n - c[i].first;
+	if (weeks) {
+	    start[i] = Ctx->JulianToday + 7 * c[i].first;
+	} else {
+	    start[i] = Julian(y + (m + c[i].first) / 12, (m + c[i].first) % 12, 1);
+	}
+    }
+
+    /* Anything we have produced comes first, and mustn't be
+       written again by the children */
+    OutFlush();
+    fflush(stdout);
+    fflush(ErrFp);
+
+    for (i=0; i<n; i++) {
+	c[i].pid = -1;
+	c[i].fd = -1;
+	if (pipe(fds) < 0) continue;
+	c[i].pid = fork();
+	if (c[i].pid < 0) {
+	    close(fds[0]);
+	    close(fds[1]);
+	    continue;
+	}
+	if (c[i].pid == 0) {
+	    close(fds[0]);
+	    for (cur=0; cur<i; cur++) {
+		if (c[cur].fd >= 0) close(c[cur].fd);
+	    }
+	    if (ErrFp == stdout) {
+		/* Keep error messages in with the output */
+		dup2(fds[1], STDERR_FILENO);
+	    }
+	    dup2(fds[1], STDOUT_FILENO);
+	    close(fds[1]);
+	    StartCalPart(c[i].first, start[i]);
+	    DoCalendarPart(c[i].first, c[i].num, total, weeks);
+	    OutFlush();
+	    fflush(stdout);
+	    fflush(stderr);
+	    _exit(0);
+	}
+	close(fds[1]);
+	c[i].fd = fds[0];
+    }
+
+    cur = 0;
+    while (cur < n) {
+	if (c[cur].pid < 0) {
+	    /* Couldn't fork it, so do it ourselves */
+	    StartCalPart(c[cur].first, start[cur]);
+	    DoCalendarPart(c[cur].first, c[cur].num, total, weeks);
+	    OutFlush();
+	    cur++;
+	    continue;
+	}
+	/* Its turn has come, so whatever it has written so far goes
+	   out now and the rest as it arrives */
+	if (c[cur].len) {
+	    fwrite(c[cur].buf, 1, c[cur].len, stdout);
+	    c[cur].len = 0;
+	}
+	if (c[cur].fd < 0) {
+	    cur++;
+	    continue;
+	}
+	FD_ZERO(&readSet);
+	maxfd = -1;
+	for (i=cur; i<n; i++) {
+	    if (c[i].fd < 0) continue;
+	    FD_SET(c[i].fd, &readSet);
+	    if (c[i].fd > maxfd) maxfd = c[i].fd;
+	}
+	if (select(maxfd+1, &readSet, NULL, NULL, NULL) < 0) {
+	    if (errno == EINTR) continue;
+	    break;
+	}
+	for (i=cur; i<n; i++) {
+	    if (c[i].fd < 0 || !FD_ISSET(c[i].fd, &readSet)) continue;
+	    len = read(c[i].fd, buf, sizeof(buf));
+	    if (len < 0 && errno == EINTR) continue;
+	    if (len <= 0) {
+		close(c[i].fd);
+		c[i].fd = -1;
+	    } else if (i == cur) {
+		fwrite(buf, 1, len, stdout);
+	    } else if (SaveChildOutput(&c[i], buf, len) != OK) {
+		/* Its part is lost; closing the pipe ends the child,
+		   which is reported below */
+		fprintf(ErrFp, "%s\n", ErrMsg[E_NO_MEM]);
+		close(c[i].fd);
+		c[i].fd = -1;
+	    }
+	}
+    }
+    fflush(stdout);
+
+    for (i=0; i<n; i++) {
+	if (c[i].fd >= 0) close(c[i].fd);
+	if (c[i].pid > 0 &&
+	    (waitpid(c[i].pid, &status, 0) < 0 ||
+	     !WIFEXITED(status) || WEXITSTATUS(status))) {
+	    fprintf(ErrFp, "%s: A calendar process failed\n", ArgV[0]);
+	}
+	free(c[i].buf);
+    }
+    free(c);
+    free(start);
+    return 1;
+}
+#else
+#define DoCalendarInProcesses(total, weeks) 0
+#endif
+
+/***************************************************************/
+/*                                                             */
+/*  ProduceCalendar                                            */
+/*                                                             */
+/*  Main loop for generating a calendar.                       */
+/*                                                             */
+/***************************************************************/
+void ProduceCalendar(void)
+{
+    int y, m, d;
+
+    Ctx->CalWidth = 7*((Ctx->CalWidth - 9) / 7) + 8;
+    InitCalOutput();
+
+    /* Run the file once to get potentially-overridden day names */
+    if (Ctx->CalMonths) {
+        FromJulian(Ctx->JulianToday, &y, &m, &d);
+        Ctx->JulianToday = Julian(y, m, 1);
+        GenerateCalEntries(-1);
+	DidAMonth = 0;
+	if (Ctx->HtmlCal) {
+	    WriteHTMLStart();
+	} else if (Ctx->PsCalBinary) {
+	    WriteBinStart();
+	} else if (Ctx->PsCal == PSCAL_LEVEL3) {
+	    OutPuts("[\n");
+	}
+	if (!DoCalendarInProcesses(Ctx->CalMonths, 0) &&
+	    !DoCalendarInThreads(Ctx->CalMonths, 0)) {
+	    DoCalendarPart(0, Ctx->CalMonths, Ctx->CalMonths, 0);
+	}
+	if (Ctx->HtmlCal) {
+	    WriteHTMLEnd();
+	} else if (Ctx->PsCal == PSCAL_LEVEL3) {
+	    OutPuts("\n]\n");
+	}
+	OutFlush();
+	return;
+    } else {
+	if (Ctx->MondayFirst) Ctx->JulianToday -= (Ctx->JulianToday%7);
+	else             Ctx->JulianToday -= ((Ctx->JulianToday+1)%7);
+
+        GenerateCalEntries(-1);
+
+	if (!Ctx->DoSimpleCalendar) {
+  	    WriteWeekHeaderLine();
+	    WriteCalDays();
+	    WriteIntermediateCalLine();
+	}
+
+	if (!DoCalendarInProcesses(Ctx->CalWeeks, 1) &&
+	    !DoCalendarInThreads(Ctx->CalWeeks, 1)) {
+	    DoCalendarPart(0, Ctx->CalWeeks, Ctx->CalWeeks, 1);
+	}
+	OutFlush();
+	return;
+    }
+}
+
+/***************************************************************/
+/*                                                             */
+/*  ProduceJSONCalendar                                        */
+/*                                                             */
+/*  Produce a "-ppp" calendar for n months starting with       */
+/*  month m (0-11) of year y.  Server mode calls this in a     */
+/*  child process for the CALENDAR command.                    */
+/*                                                             */
+/***************************************************************/
+void ProduceJSONCalendar(int y, int m, int n)
+{
+    Ctx->DoCalendar = 0;
+    Ctx->DoSimpleCalendar = 1;
+    Ctx->PsCal = PSCAL_LEVEL3;
+    Ctx->DoPrefixLineNo = 1;
+    Ctx->CalMonths = n;
+    Ctx->JulianToday = Julian(y, m, 1);
+    ProduceCalendar();
+}
+
+/***************************************************************/
+/*                                                             */
+/*  ProduceEventStream                                         */
+/*                                                             */
+/*  Write every reminder occurrence from JulianToday through   */
+/*  EventsUntil as newline-delimited JSON: one object per      */
+/*  line, in the same form as a -pp entry.  Each day is        */
+/*  written out as soon as it has been computed, so memory     */
+/*  use does not grow with the length of the range.            */
+/*                                                             */
+/***************************************************************/
+void ProduceEventStream(void)
+{
+    int jul;
+
+    Ctx->DoSimpleCalendar = 1;
+    Ctx->PsCal = PSCAL_LEVEL2;
+    Ctx->DoPrefixLineNo = 1;
+    Ctx->ShouldCache = 1;
+
+    for (jul = Ctx->JulianToday; jul <= Ctx->EventsUntil && !Ctx->Exited; jul++) {
+	Ctx->JulianToday = jul;
+	GenerateCalEntries(0);
+	WriteSimpleEntries(0, jul);
+	ClearCalColumns();
+    }
+    OutFlush();
+}
+
+/***************************************************************/
+/*                                                             */
+/*  PlainBody                                                  */
+/*                                                             */
+/*  Put the text of an entry less its color numbers and %"     */
+/*  markers in out, as the plain_body of a -pp entry.          */
+/*                                                             */
+/***************************************************************/
+static int PlainBody(CalEntry const *e, DynamicBuffer *out)
+{
+    char const *s = e->text;
+
+    if (e->is_color) s = SkipWords(s, 3);
+    while (*s) {
+	if (*s == '%' && *(s+1) == '"') {
+	    s += 2;
+	    continue;
+	}
+	if (DBufPutc(out, *s++) != OK) return E_NO_MEM;
+    }
+    return OK;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  CalendarOccurrences                                        */
+/*                                                             */
+/*  Run the reminder file for day jul and call fn for each     */
+/*  entry, in calendar order, stopping if it returns non-zero. */
+/*  The strings in the occurrence are only valid during the    */
+/*  call.  This is how libremind enumerates occurrences.       */
+/*                                                             */
+/***************************************************************/
+int CalendarOccurrences(int jul, int (*fn)(RemOccurrence const *occ, void *data),
+			void *data)
+{
+    CalCell *cell = &CalColumn[0];
+    CalEntry *e;
+    RemOccurrence o;
+    DynamicBuffer plain;
+    int y, m, d, i, r;
+
+    Ctx->JulianToday = jul;
+    r = CollectCalEntries(0);
+    FromJulian(jul, &y, &m, &d);
+    DBufInit(&plain);
+    for (i=0; !r && i<cell->num; i++) {
+	e = cell->entries[i];
+	r = PlainBody(e, &plain);
+	if (r) break;
+	o.year = y;
+	o.month = m+1;
+	o.day = d;
+	o.time = (e->time == NO_TIME) ? -1 : e->time;
+	o.duration = (e->duration == NO_TIME) ? -1 : e->duration;
+	o.priority = e->priority;
+	o.passthru = e->passthru;
+	o.is_color = e->is_color;
+	o.r = e->is_color ? e->r : -1;
+	o.g = e->is_color ? e->g : -1;
+	o.b = e->is_color ? e->b : -1;
+	o.tags = e->tags;
+	o.body = e->text;
+	o.plain_body = DBufValue(&plain);
+	o.raw_body = e->raw_text;
+	o.filename = e->filename;
+	o.lineno = e->lineno;
+	r = fn(&o, data);
+	DBufFree(&plain);
+    }
+    DBufFree(&plain);
+    ClearCalColumns();
+    return r;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  RunCalendarFile                                            */
+/*                                                             */
+/*  Run the reminder file for day jul without collecting any   */
+/*  entries, leaving its variables and functions defined.      */
+/*                                                             */
+/***************************************************************/
+int RunCalendarFile(int jul)
+{
+    Ctx->JulianToday = jul;
+    return CollectCalEntries(-1);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  iCalendar (RFC 5545) export                                */
+/*                                                             */
+/*  ProduceICalendar writes a VEVENT for each reminder         */
+/*  occurrence from JulianToday through EventsUntil.  A        */
+/*  reminder whose dates follow a plain daily, weekly,         */
+/*  monthly or yearly pattern, and that nothing (OMIT, SKIP,   */
+/*  IF, expressions, substitutions) can perturb, is written    */
+/*  once at its first occurrence with an RRULE instead.        */
+/*                                                             */
+/***************************************************************/
+#define ICAL_FOLD 75
+#define ICAL_RULE_HASH_SIZE 1024
+
+typedef struct ical_rule {
+    struct ical_rule *next;
+    char uid[1];
+} ICalRule;
+
+static ICalRule *ICalRules[ICAL_RULE_HASH_SIZE];
+static DynamicBuffer ICalLine;
+static DynamicBuffer ICalRuleLine;
+static int ICalStart;
+static char ICalStamp[80];
+
+static char const *ICalDayName[7] = { "MO", "TU", "WE", "TH", "FR", "SA", "SU" };
+
+/* Returns 1 if uid has already been written with an RRULE; otherwise
+   remembers it and returns 0 */
+static int ICalRuleSeen(char const *uid)
+{
+    unsigned int h = HashVal(uid) % ICAL_RULE_HASH_SIZE;
+    ICalRule *r;
+
+    for (r = ICalRules[h]; r; r = r->next) {
+	if (!strcmp(r->uid, uid)) return 1;
+    }
+    r = malloc(sizeof(ICalRule) + strlen(uid));
+    if (r) {
+	strcpy(r->uid, uid);
+	r->next = ICalRules[h];
+	ICalRules[h] = r;
+    }
+    return 0;
+}
+
+/* Append s to the current content line, escaped as an RFC 5545 TEXT value */
+static void ICalPutText(char const *s)
+{
+    for (; *s; s++) {
+	switch(*s) {
+	case '\\': DBufPuts(&ICalLine, "\\\\"); break;
+	case ';':  DBufPuts(&ICalLine, "\\;");  break;
+	case ',':  DBufPuts(&ICalLine, "\\,");  break;
+	case '\n': DBufPuts(&ICalLine, "\\n");  break;
+	case '\r': break;
+	default:   DBufPutc(&ICalLine, *s);     break;
+	}
+    }
+}
+
+/* Write out the current content line, folded so that no physical
+   line exceeds ICAL_FOLD octets and no UTF-8 sequence is split */
+static void ICalEndLine(void)
+{
+    unsigned char const *s = (unsigned char const *) DBufValue(&ICalLine);
+    unsigned char const *start = s;
+    size_t octets = 0, n;
+
+    while (*s) {
+	if      (*s >= 0xF0) n = 4;
+	else if (*s >= 0xE0) n = 3;
+	else if (*s >= 0xC0) n = 2;
+	else                 n = 1;
+	if (octets + n > ICAL_FOLD) {
+	    OutWrite((char const *) start, s - start);
+	    OutPuts("\r\n ");
+	    start = s;
+	    octets = 1;
+	}
+	while (n-- && *s) {
+	    s++;
+	    octets++;
+	}
+    }
+    OutWrite((char const *) start, s - start);
+    OutPuts("\r\n");
+    DBufFree(&ICalLine);
+}
+
+static char const *ICalDateString(int jul)
+{
+    static char buf[48];
+    int y, m, d;
+    FromJulian(jul, &y, &m, &d);
+    sprintf(buf, "%04d%02d%02d", y, m+1, d);
+    return buf;
+}
+
+static char const *ICalDateTimeString(int dt)
+{
+    static char buf[96];
+    sprintf(buf, "%sT%02d%02d00", ICalDateString(dt / MINUTES_PER_DAY),
+	    (dt % MINUTES_PER_DAY) / 60, dt % 60);
+    return buf;
+}
+
+/* Copy the hash from the tag SynthesizeTag() added to e into uid;
+   return 0 if there is no such tag */
+static int ICalUID(CalEntry const *e, char *uid, size_t len)
+{
+    char const *s = strstr(e->tags, "__syn__");
+    size_t n;
+
+    while (s && s != e->tags && *(s-1) != ',') {
+	s = strstr(s+1, "__syn__");
+    }
+    if (!s) return 0;
+    s += 7;
+    n = strcspn(s, ",");
+    if (n >= len) n = len-1;
+    memcpy(uid, s, n);
+    uid[n] = 0;
+    return 1;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  ICalRRule                                                  */
+/*                                                             */
+/*  If e's trigger is a pure repeating pattern, put the        */
+/*  RRULE for it in ICalRuleLine and return 1; otherwise       */
+/*  return 0.                                                  */
+/*                                                             */
+/***************************************************************/
+static int ICalRRule(CalEntry const *e)
+{
+    Trigger const *t = &e->trig;
+    char const *s;
+    char buf[128];
+    int i, done;
+
+    DBufFree(&ICalRuleLine);
+
+    /* Anything that can move or suppress an occurrence, or change
+       its text from one day to the next, rules out an RRULE */
+    if (e->nonconst_expr || e->if_depth ||
+	t->skip != NO_SKIP || t->localomit != NO_WD || t->omitfunc[0] ||
+	t->back != NO_BACK || t->adj_for_last || t->once != NO_ONCE ||
+	t->scanfrom != Ctx->JulianToday) {
+	return 0;
+    }
+    /* The body's [expressions] are only evaluated after nonconst_expr
+       has been recorded, so don't trust any of them */
+    if (strchr(e->raw_text, '[')) {
+	return 0;
+    }
+    for (s = e->raw_text; (s = strchr(s, '%')) != NULL; s += 2) {
+	if (*(s+1) != '"') return 0;
+    }
+    if (UserFuncExists("calprefix") == 1 || UserFuncExists("calsuffix") == 1) {
+	return 0;
+    }
+
+    if (t->y != NO_YR) {
+	/* A fixed date with *rep repeats every rep days */
+	if (t->rep == NO_REP || t->wd != NO_WD ||
+	    t->m == NO_MON || t->d == NO_DAY) {
+	    return 0;
+	}
+	sprintf(buf, "FREQ=DAILY;INTERVAL=%d", t->rep);
+	DBufPuts(&ICalRuleLine, buf);
+    } else if (t->rep != NO_REP) {
+	return 0;
+    } else if (t->m == NO_MON && t->d == NO_DAY) {
+	DBufPuts(&ICalRuleLine, (t->wd == NO_WD) ? "FREQ=DAILY" : "FREQ=WEEKLY");
+    } else if (t->d == NO_DAY) {
+	/* "REM Feb" and the like; not worth the trouble */
+	return 0;
+    } else {
+	/* A weekday with a day means the first such weekday on or
+	   after the day.  Keep it inside the month so BYMONTHDAY
+	   can express it. */
+	if (t->wd != NO_WD && t->d > 22) {
+	    return 0;
+	}
+	if (t->m == NO_MON) {
+	    DBufPuts(&ICalRuleLine, "FREQ=MONTHLY");
+	} else {
+	    sprintf(buf, "FREQ=YEARLY;BYMONTH=%d", t->m+1);
+	    DBufPuts(&ICalRuleLine, buf);
+	}
+	DBufPuts(&ICalRuleLine, ";BYMONTHDAY=");
+	if (t->wd == NO_WD) {
+	    sprintf(buf, "%d", t->d);
+	} else {
+	    sprintf(buf, "%d,%d,%d,%d,%d,%d,%d", t->d, t->d+1, t->d+2,
+		    t->d+3, t->d+4, t->d+5, t->d+6);
+	}
+	DBufPuts(&ICalRuleLine, buf);
+    }
+
+    if (t->wd != NO_WD && t->rep == NO_REP) {
+	DBufPuts(&ICalRuleLine, ";BYDAY=");
+	done = 0;
+	for (i=0; i<7; i++) {
+	    if (t->wd & (1 << i)) {
+		if (done) DBufPutc(&ICalRuleLine, ',');
+		DBufPuts(&ICalRuleLine, ICalDayName[i]);
+		done = 1;
+	    }
+	}
+    }
+    if (t->until != NO_UNTIL) {
+	DBufPuts(&ICalRuleLine, ";UNTIL=");
+	DBufPuts(&ICalRuleLine, ICalDateString(t->until));
+	if (e->time != NO_TIME) {
+	    DBufPuts(&ICalRuleLine, "T235959");
+	}
+    }
+    return 1;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  WriteICalEntry                                             */
+/*                                                             */
+/*  Write the VEVENT for one calendar entry on day jul.        */
+/*                                                             */
+/***************************************************************/
+static void WriteICalEntry(CalEntry const *e, int jul, char const *uid)
+{
+    char const *s, *t;
+    int start = NO_TIME, duration = NO_TIME;
+    int done, is_rule;
+    char buf[32];
+
+    /* A multi-day event appears on every day it spans.  Write it
+       once, on the day it starts or on the first day of the range. */
+    if (e->trig.eventstart != NO_TIME) {
+	if (e->trig.eventstart / MINUTES_PER_DAY < jul && jul != ICalStart) {
+	    return;
+	}
+	start = e->trig.eventstart;
+	duration = e->trig.eventduration;
+    } else if (e->time != NO_TIME) {
+	start = jul * MINUTES_PER_DAY + e->time;
+	duration = e->duration;
+    }
+
+    /* A repeating event is written once, at its first occurrence,
+       and its UID is that of the reminder rather than the day */
+    is_rule = ICalRRule(e);
+    if (is_rule && ICalRuleSeen(uid)) {
+	return;
+    }
+
+    OutPuts("BEGIN:VEVENT\r\n");
+    DBufPuts(&ICalLine, "UID:");
+    DBufPuts(&ICalLine, uid);
+    if (!is_rule) {
+	DBufPutc(&ICalLine, '-');
+	DBufPuts(&ICalLine, ICalDateString((start != NO_TIME) ?
+					   start / MINUTES_PER_DAY : jul));
+    }
+    DBufPuts(&ICalLine, "@remind");
+    ICalEndLine();
+    DBufPuts(&ICalLine, "DTSTAMP:");
+    DBufPuts(&ICalLine, ICalStamp);
+    ICalEndLine();
+    if (start != NO_TIME) {
+	DBufPuts(&ICalLine, "DTSTART:");
+	DBufPuts(&ICalLine, ICalDateTimeString(start));
+	ICalEndLine();
+	if (duration != NO_TIME && duration > 0) {
+	    DBufPuts(&ICalLine, "DURATION:PT");
+	    if (duration / 60) {
+		sprintf(buf, "%dH", duration / 60);
+		DBufPuts(&ICalLine, buf);
+	    }
+	    if (duration % 60) {
+		sprintf(buf, "%dM", duration % 60);
+		DBufPuts(&ICalLine, buf);
+	    }
+	    ICalEndLine();
+	}
+    } else {
+	DBufPuts(&ICalLine, "DTSTART;VALUE=DATE:");
+	DBufPuts(&ICalLine, ICalDateString(jul));
+	ICalEndLine();
+    }
+    if (is_rule) {
+	DBufPuts(&ICalLine, "RRULE:");
+	DBufPuts(&ICalLine, DBufValue(&ICalRuleLine));
+	ICalEndLine();
+    }
+
+    /* Skip the color numbers in front of a COLOR reminder */
+    s = e->text;
+    if (e->is_color) {
+	for (done=0; done<3; done++) {
+	    while(*s && !isspace(*s)) s++;
+	    while(*s && isspace(*s)) s++;
+	}
+    }
+    DBufPuts(&ICalLine, "SUMMARY:");
+    ICalPutText(s);
+    ICalEndLine();
+
+    /* Every tag except the synthesized one becomes a category */
+    done = 0;
+    for (s = e->tags; *s; s = t) {
+	t = strchr(s, ',');
+	if (!t) t = s + strlen(s);
+	if (t > s && strncmp(s, "__syn__", 7)) {
+	    if (!done) DBufPuts(&ICalLine, "CATEGORIES:");
+	    else DBufPutc(&ICalLine, ',');
+	    done = 1;
+	    while (s < t) {
+		if (*s == '\\' || *s == ';') DBufPutc(&ICalLine, '\\');
+		DBufPutc(&ICalLine, *s++);
+	    }
+	}
+	if (*t) t++;
+    }
+    if (done) ICalEndLine();
+
+    OutPuts("END:VEVENT\r\n");
+}
+
+/***************************************************************/
+/*                                                             */
+/*  ProduceICalendar                                           */
+/*                                                             */
+/*  Write the occurrences from JulianToday through EventsUntil */
+/*  as a VCALENDAR.  Like ProduceEventStream, each day is      */
+/*  written out as soon as it has been computed.               */
+/*                                                             */
+/***************************************************************/
+void ProduceICalendar(void)
+{
+    CalCell *cell;
+    CalEntry *e;
+    char uid[64], other[64];
+    int jul, i, j;
+    time_t now;
+    struct tm *t;
+
+    Ctx->DoSimpleCalendar = 1;
+    Ctx->PsCal = PSCAL_LEVEL2;
+    Ctx->ShouldCache = 1;
+    Ctx->SynthesizeTags = 1;
+    /* The time goes in DTSTART, not in the summary */
+    Ctx->ScFormat = SC_NOTIME;
+
+    now = time(NULL);
+    t = gmtime(&now);
+    sprintf(ICalStamp, "%04d%02d%02dT%02d%02d%02dZ",
+	    t->tm_year + 1900, t->tm_mon + 1, t->tm_mday,
+	    t->tm_hour, t->tm_min, t->tm_sec);
+
+    DBufInit(&ICalLine);
+    DBufInit(&ICalRuleLine);
+    OutPuts("BEGIN:VCALENDAR\r\n");
+    OutPuts("VERSION:2.0\r\n");
+    OutPuts("PRODID:-//Dianne Skoll//Remind " VERSION "//EN\r\n");
+    OutPuts("CALSCALE:GREGORIAN\r\n");
+
+    ICalStart = Ctx->JulianToday;
+    for (jul = Ctx->JulianToday; jul <= Ctx->EventsUntil && !Ctx->Exited; jul++) {
+	Ctx->JulianToday = jul;
+	GenerateCalEntries(0);
+	cell = &CalColumn[0];
+	for (i=0; i<cell->num; i++) {
+	    e = cell->entries[i];
+	    /* Only COLOR reminders among the specials carry an event */
+	    if (e->passthru[0] && !e->is_color) continue;
+	    if (!ICalUID(e, uid, sizeof(uid))) continue;
+
+	    /* Identical reminders on the same day are the same event */
+	    for (j=0; j<i; j++) {
+		if (ICalUID(cell->entries[j], other, sizeof(other)) &&
+		    !strcmp(uid, other)) {
+		    break;
+		}
+	    }
+	    if (j < i) continue;
+	    WriteICalEntry(e, jul, uid);
+	}
+	ClearCalColumns();
+    }
+    OutPuts("END:VCALENDAR\r\n");
+    OutFlush();
+}
+
+/***************************************************************/
+/*                                                             */
+/*  HTML calendar                                              */
+/*                                                             */
+/*  With --html, each month is written as an HTML table laid   */
+/*  out like the ones rem2html makes from -pp output, with     */
+/*  the same CSS classes, so existing stylesheets still work.  */
+/*  The SHADE, MOON, WEEK, COLOR, HTML and HTMLCLASS specials  */
+/*  are honoured.  Each day is written out as soon as its      */
+/*  entries have been computed.                                */
+/*                                                             */
+/***************************************************************/
+static char const *HTMLStyle =
+    "table.rem-cal {\n"
+    "  font-family: helvetica, arial, sans-serif;\n"
+    "  font-size: 12pt;\n"
+    "  width: 100%;\n"
+    "  border-collapse: collapse;\n"
+    "}\n"
+    "table.rem-sc-table {\n"
+    "  font-family: helvetica, arial, sans-serif;\n"
+    "  font-size: 10pt;\n"
+    "  width: 95%;\n"
+    "  float: left;\n"
+    "}\n"
+    "caption.rem-cal-caption {\n"
+    "  font-size: 14pt;\n"
+    "  font-weight: bold;\n"
+    "}\n"
+    "th.rem-cal-hdr {\n"
+    "  width: 14%;\n"
+    "  border-style: solid;\n"
+    "  border-width: 1px;\n"
+    "  vertical-align: top;\n"
+    "}\n"
+    "td.rem-empty, td.rem-cell, td.rem-small-calendar {\n"
+    "  width: 14%;\n"
+    "  height: 7em;\n"
+    "  border-style: solid;\n"
+    "  border-width: 1px;\n"
+    "  vertical-align: top;\n"
+    "}\n"
+    "td.rem-today {\n"
+    "  width: 14%;\n"
+    "  height: 7em;\n"
+    "  border-style: solid;\n"
+    "  border-width: 2px;\n"
+    "  border-color: #EE3333;\n"
+    "  vertical-align: top;\n"
+    "}\n"
+    "div.rem-daynumber {\n"
+    "  float: right;\n"
+    "  text-align: right;\n"
+    "  vertical-align: top;\n"
+    "  font-size: 14pt;\n"
+    "}\n"
+    "p.rem-entry {\n"
+    "  clear: both;\n"
+    "}\n"
+    "div.rem-moon {\n"
+    "  float: left;\n"
+    "  text-align: left;\n"
+    "  vertical-align: top;\n"
+    "}\n"
+    "th.rem-sc-hdr {\n"
+    "  text-align: right;\n"
+    "}\n"
+    "td.rem-sc-empty-cell, td.rem-sc-cell {\n"
+    "  text-align: right;\n"
+    "  width: 14%;\n"
+    "}\n"
+    "caption.rem-sc-caption {\n"
+    "  font-size: 12pt;\n"
+    "}\n";
+
+/* Moon phases as character references, so the page is plain ASCII */
+static char const *HTMLMoons[4][2] = {
+    { "&#x1F311;", "New Moon" },
+    { "&#x1F313;", "First Quarter" },
+    { "&#x1F315;", "Full Moon" },
+    { "&#x1F317;", "Last Quarter" }
+};
+
+static void OutHTMLString(char const *s)
+{
+    while (*s) {
+	switch(*s) {
+	case '&': OutPuts("&amp;"); break;
+	case '<': OutPuts("&lt;"); break;
+	case '>': OutPuts("&gt;"); break;
+	case '"': OutPuts("&quot;"); break;
+	default: OutPutc(*s); break;
+	}
+	s++;
+    }
+}
+
+/* Skip n white-space separated words of s */
+static char const *SkipWords(char const *s, int n)
+{
+    while (n--) {
+	while (*s && isspace(*s)) s++;
+	while (*s && !isspace(*s)) s++;
+    }
+    while (*s && isspace(*s)) s++;
+    return s;
+}
+
+/* Column (0-6) of the first day of month m of year y */
+static int HTMLFirstCol(int y, int m)
+{
+    int wd = (Julian(y, m, 1) + 1) % 7;
+    if (Ctx->MondayFirst) return (wd + 6) % 7;
+    return wd;
+}
+
+/* Write the day names; only their first character if abbrev */
+static void WriteHTMLDayNames(char const *cls, int abbrev)
+{
+    char const *s;
+    int i;
+
+    for (i=0; i<7; i++) {
+	s = get_day_name(Ctx->MondayFirst ? i : (i+6) % 7);
+	OutPrintf("<th class=\"%s\">", cls);
+	if (abbrev) {
+	    /* Keep a multi-byte UTF-8 character whole */
+	    OutPutc(*s);
+	    if (*s) {
+		s++;
+		while ((*s & 0xC0) == 0x80) OutPutc(*s++);
+	    }
+	} else {
+	    OutHTMLString(s);
+	}
+	OutPuts("</th>");
+    }
+    OutPuts("</tr>\n");
+}
+
+/***************************************************************/
+/*                                                             */
+/*  WriteHTMLStart / WriteHTMLEnd                              */
+/*                                                             */
+/*  The head and tail of the page.  Nothing is written for     */
+/*  --html=table.                                              */
+/*                                                             */
+/***************************************************************/
+static void WriteHTMLStart(void)
+{
+    if (Ctx->HtmlCal != HTML_PAGE) return;
+    OutPuts("<html>\n<head>\n<title>HTML Calendar</title>\n");
+    OutPuts("<style>\n");
+    OutPuts(HTMLStyle);
+    OutPuts("</style>\n</head>\n<body>\n");
+}
+
+static void WriteHTMLEnd(void)
+{
+    if (Ctx->HtmlCal != HTML_PAGE) return;
+    OutPuts("</body>\n</html>\n");
+}
+
+/***************************************************************/
+/*                                                             */
+/*  WriteHTMLSmallCalendar                                     */
+/*                                                             */
+/*  Write a cell holding a small calendar for month m of y.   */
+/*                                                             */
+/***************************************************************/
+static void WriteHTMLSmallCalendar(int y, int m)
 {
-    int y, m, d;
-    int r, g, b;
-    /* Don't bother if we're not doing SHADE specials */
-    if (!UseBGVTColors) {
-        return;
+    int first = HTMLFirstCol(y, m);
+    int len = DaysInMonth(m, y);
+    int col, d;
+
+    OutPuts("<td class=\"rem-small-calendar\">\n<table class=\"rem-sc-table\">\n");
+    OutPuts("<caption class=\"rem-sc-caption\">");
+    OutHTMLString(get_month_name(m));
+    OutPuts("</caption>\n<tr class=\"rem-sc-hdr-row\">");
+    WriteHTMLDayNames("rem-sc-hdr", 1);
+
+    for (col=0; col<first; col++) {
+	if (!col) OutPuts("<tr>\n");
+	OutPuts("<td class=\"rem-sc-empty-cell\">&nbsp;</td>");
     }
-
-    if (sscanf(shade, "%d %d %d", &r, &g, &b) != 3) {
-        if (sscanf(shade, "%d", &r) != 1) {
-            return;
-        }
-        g = r;
-        b = r;
+    for (d=1; d<=len; d++) {
+	if (!col) OutPuts("<tr>\n");
+	OutPrintf("<td class=\"rem-sc-cell\">%d</td>", d);
+	if (++col == 7) {
+	    OutPuts("</tr>\n");
+	    col = 0;
+	}
     }
-    if (r < 0 || g < 0 || b < 0 || r > 255 || g > 255 || b > 255) {
-        return;
+    if (col) {
+	for (; col<7; col++) {
+	    OutPuts("<td class=\"rem-sc-empty-cell\">&nbsp;</td>");
+	}
+	OutPuts("</tr>\n");
     }
-    FromJulian(jul, &y, &m, &d);
-    bgcolor[d][0] = r;
-    bgcolor[d][1] = g;
-    bgcolor[d][2] = b;
+    OutPuts("</table>\n</td>\n");
 }
 
-static void
-SetMoonEntry(int jul, char const *moon)
+/***************************************************************/
+/*                                                             */
+/*  WriteHTMLDay                                               */
+/*                                                             */
+/*  Compute the entries for JulianToday and write its cell.    */
+/*                                                             */
+/***************************************************************/
+static void WriteHTMLDay(int rows)
 {
-    int phase;
-    int y, m, d;
-    char msg[28];
+    CalCell *cell = &CalColumn[0];
+    CalEntry *e;
+    CalEntry const *moon = NULL;
+    char const *cls = NULL;
+    char const *week = NULL;
+    char const *s;
+    int shade = 0, r, g, b, n, phase, i, y, m, d;
+
+    FromJulian(Ctx->JulianToday, &y, &m, &d);
+    GenerateCalEntries(0);
+
+    /* Gather the specials that decorate the cell itself */
+    for (i=0; i<cell->num; i++) {
+	e = cell->entries[i];
+	if (!StrCmpi(e->passthru, "HTMLCLASS")) {
+	    cls = e->text;
+	} else if (!StrCmpi(e->passthru, "WEEK")) {
+	    week = e->text;
+	} else if (!StrCmpi(e->passthru, "MOON")) {
+	    moon = e;
+	} else if (!StrCmpi(e->passthru, "SHADE")) {
+	    n = sscanf(e->text, "%d %d %d", &r, &g, &b);
+	    if (n < 1) continue;
+	    if (n < 3) {
+		g = r;
+		b = r;
+	    }
+	    if (r < 0) r = 0;
+	    else if (r > 255) r = 255;
+	    if (g < 0) g = 0;
+	    else if (g > 255) g = 255;
+	    if (b < 0) b = 0;
+	    else if (b > 255) b = 255;
+	    shade = 1;
+	}
+    }
 
-    /* Don't bother unless it's utf-8 */
-    if (!encoding_is_utf8) {
-        return;
+    if (cls) {
+	OutPuts("<td class=\"");
+	OutHTMLString(SkipWords(cls, 0));
+	OutPuts("\"");
+    } else {
+	OutPrintf("<td class=\"rem-cell rem-cell-%d-rows\"", rows);
+    }
+    if (shade) {
+	OutPrintf(" style=\"background: #%02X%02X%02X;\"", r, g, b);
     }
+    OutPuts(">\n");
 
-    msg[0] = 0;
-    if (sscanf(moon, "%d %*d %*d %27[^\x01]", &phase, msg) < 4) {
-        if (sscanf(moon, "%d", &phase) != 1) {
-            /* Malformed MOON special; ignore */
-            fprintf(stderr, "Oops 1\n");
-            return;
-        }
+    if (moon && sscanf(moon->text, "%d", &phase) == 1 &&
+	phase >= 0 && phase <= 3) {
+	OutPrintf("<div class=\"rem-moon\"><span title=\"%s\">%s</span>",
+		  HTMLMoons[phase][1], HTMLMoons[phase][0]);
+	s = SkipWords(moon->text, 3);
+	if (*s) {
+	    OutPuts("&nbsp;");
+	    OutHTMLString(s);
+	}
+	OutPuts("</div>");
     }
-    if (phase < 0 || phase > 3) {
-        /* Bad phase */
-        fprintf(stderr, "Oops 2\n");
-        return;
+
+    OutPrintf("<div class=\"rem-daynumber\">%d", d);
+    if (week) {
+	OutPutc(' ');
+	OutHTMLString(SkipWords(week, 0));
     }
-    FromJulian(jul, &y, &m, &d);
-    if (msg[0]) {
-        snprintf(moons[d], sizeof(moons[d]), "%s %s", moonphase_emojis[phase], msg);
-    } else {
-        snprintf(moons[d], sizeof(moons[d]), "%s", moonphase_emojis[phase]);
+    OutPuts("</div>\n");
+
+    for (i=0; i<cell->num; i++) {
+	e = cell->entries[i];
+	if (!e->passthru[0]) {
+	    OutPuts("<p class=\"rem-entry\">");
+	    OutHTMLString(e->text);
+	    OutPuts("</p>\n");
+	} else if (e->is_color) {
+	    OutPrintf("<p class=\"rem-entry\" style=\"color: #%02X%02X%02X;\">",
+		      e->r, e->g, e->b);
+	    OutHTMLString(SkipWords(e->text, 3));
+	    OutPuts("</p>\n");
+	} else if (!StrCmpi(e->passthru, "HTML")) {
+	    OutPuts(e->text);
+	    OutPutc('\n');
+	}
     }
+    OutPuts("</td>\n");
+    ClearCalColumns();
 }
 
-
 /***************************************************************/
 /*                                                             */
-/*  ProduceCalendar                                            */
+/*  DoHTMLOneMonth                                             */
 /*                                                             */
-/*  Main loop for generating a calendar.                       */
+/*  Write the month starting at JulianToday as an HTML table,  */
+/*  with small calendars for the months before and after in   */
+/*  the empty cells, and leave JulianToday at the first day    */
+/*  of the next month.                                         */
 /*                                                             */
 /***************************************************************/
-void ProduceCalendar(void)
+static void DoHTMLOneMonth(void)
 {
-    int y, m, d;
-
-    /* Check if current locale is UTF-8, if we have langinfo.h */
-#ifdef HAVE_LANGINFO_H
-    char const *encoding = nl_langinfo(CODESET);
-    if (!strcasecmp(encoding, "utf-8")) {
-        encoding_is_utf8 = 1;
+    int y, m, d, py, pm, ny, nm;
+    int first, last, len, rows, col, start;
+    char empty[64];
+
+    FromJulian(Ctx->JulianToday, &y, &m, &d);
+    start = Ctx->JulianToday;
+    len = DaysInMonth(m, y);
+    first = HTMLFirstCol(y, m);
+    last = (first + len - 1) % 7;
+    rows = (first + len + 6) / 7;
+    /* A 28-day February from the first column needs a row for the
+       small calendars */
+    if (first == 0 && last == 6) rows++;
+
+    pm = m-1; py = y;
+    if (pm < 0) {
+	pm = 11; py--;
     }
-
-#endif
-    if (UseUTF8Chars) {
-	linestruct = &UTF8Drawing;
-    } else if (UseVTChars) {
-        linestruct = &VT100Drawing;
-    } else {
-        linestruct = &NormalDrawing;
+    nm = m+1; ny = y;
+    if (nm > 11) {
+	nm = 0; ny++;
     }
-    ShouldCache = 1;
-
-    ColSpaces = (CalWidth - 9) / 7;
-    CalWidth = 7*ColSpaces + 8;
-
-    /* Run the file once to get potentially-overridden day names */
-    if (CalMonths) {
-        FromJulian(JulianToday, &y, &m, &d);
-        JulianToday = Julian(y, m, 1);
-        GenerateCalEntries(-1);
-	DidAMonth = 0;
-	if (PsCal == PSCAL_LEVEL3) {
-	    printf("[\n");
-	}
-	while (CalMonths--) {
-	    DoCalendarOneMonth();
-	    DidAMonth = 1;
+    sprintf(empty, "<td class=\"rem-empty rem-empty-%d-rows\">&nbsp;</td>\n", rows);
+
+    OutPuts("<table class=\"rem-cal\"><caption class=\"rem-cal-caption\">");
+    OutHTMLString(get_month_name(m));
+    OutPrintf(" %d</caption>\n<tr class=\"rem-cal-hdr-row\">", y);
+    WriteHTMLDayNames("rem-cal-hdr", 0);
+    OutPrintf("<tr class=\"rem-cal-row rem-cal-row-%d-rows\">\n", rows);
+
+    col = 0;
+    if (first > 0) {
+	WriteHTMLSmallCalendar(py, pm);
+	col++;
+	if (last == 6) {
+	    WriteHTMLSmallCalendar(ny, nm);
+	    col++;
 	}
-	if (PsCal == PSCAL_LEVEL3) {
-	    printf("\n]\n");
+    }
+    for (; col<first; col++) OutPuts(empty);
+
+    for (d=1; d<=len; d++) {
+	Ctx->JulianToday = start + d - 1;
+	WriteHTMLDay(rows);
+	if (++col == 7) {
+	    col = 0;
+	    OutPuts("</tr>\n");
+	    if (d < len) {
+		OutPrintf("<tr class=\"rem-cal-row rem-cal-row-%d-rows\">\n", rows);
+	    }
 	}
-	return;
-    } else {
-	if (MondayFirst) JulianToday -= (JulianToday%7);
-	else             JulianToday -= ((JulianToday+1)%7);
-
-        GenerateCalEntries(-1);
+    }
 
-	if (!DoSimpleCalendar) {
-  	    WriteWeekHeaderLine();
-	    WriteCalDays();
-	    WriteIntermediateCalLine();
+    if (col) {
+	for (; col<7; col++) {
+	    if (col == 5 && first == 0) {
+		WriteHTMLSmallCalendar(py, pm);
+	    } else if (col == 6) {
+		WriteHTMLSmallCalendar(ny, nm);
+	    } else {
+		OutPuts(empty);
+	    }
 	}
+	OutPuts("</tr>\n");
+    }
 
-	while (CalWeeks--)
-	    DoCalendarOneWeek(CalWeeks);
-	return;
+    if (first == 0 && last == 6) {
+	OutPrintf("<tr class=\"rem-cal-row rem-cal-row-%d-rows\">\n", rows);
+	WriteHTMLSmallCalendar(py, pm);
+	for (col=1; col<6; col++) OutPuts(empty);
+	WriteHTMLSmallCalendar(ny, nm);
+	OutPuts("</tr>\n");
     }
+    OutPuts("</table>\n");
+    Ctx->JulianToday = start + len;
 }
 
 /***************************************************************/
@@ -851,34 +2333,33 @@ static void DoCalendarOneWeek(int nleft)
     int y, m, d, done, i, l, wd;
     char buf[128];
     int LinesWritten = 0;
-    int OrigJul = JulianToday;
+    int OrigJul = Ctx->JulianToday;
 
     InitMoonsAndShades();
 /* Fill in the column entries */
     for (i=0; i<7; i++) {
-        ColToDay[i] = DayOf(JulianToday);
+        ColToDay[i] = DayOf(Ctx->JulianToday);
 	GenerateCalEntries(i);
-	JulianToday++;
+	Ctx->JulianToday++;
     }
 
     /* Figure out weekday of first column */
 
-    if (MondayFirst) wd = JulianToday % 7;
-    else             wd = (JulianToday + 1) % 7;
+    if (Ctx->MondayFirst) wd = Ctx->JulianToday % 7;
+    else             wd = (Ctx->JulianToday + 1) % 7;
 
 /* Output the entries */
 /* If it's "Simple Calendar" format, do it simply... */
-    if (DoSimpleCalendar) {
+    if (Ctx->DoSimpleCalendar) {
 	for (i=0; i<7; i++) {
 	    WriteSimpleEntries(i, OrigJul+i-wd);
 	}
+	ClearCalColumns();
 	return;
     }
 
 /* Here come the first few lines... */
-    gon();
-    DRAW(tb);
-    goff();
+    WriteColSep();
     for (i=0; i<7; i++) {
         FromJulian(OrigJul+i, &y, &m, &d);
         char const *mon = get_month_name(m);
@@ -895,37 +2376,31 @@ static void DoCalendarOneWeek(int nleft)
                 snprintf(buf, sizeof(buf), "%d %s ", d, get_month_abbrev(mon));
             }
         }
-	if (OrigJul+i == RealToday) {
-            if (UseVTColors) {
-                printf("\x1B[1m"); /* Bold */
+	if (OrigJul+i == Ctx->RealToday) {
+            if (Ctx->UseVTColors) {
+                OutPuts("\x1B[1m"); /* Bold */
             }
 	    PrintLeft(buf, ColSpaces-1, '*');
-            if (UseVTColors) {
-                printf("\x1B[0m"); /* Normal */
+            if (Ctx->UseVTColors) {
+                OutPuts("\x1B[0m"); /* Normal */
             }
-            putchar(' ');
+            OutPutc(' ');
         } else {
 	    PrintLeft(buf, ColSpaces, ' ');
         }
-	gon();
-	DRAW(tb);
-	goff();
-    }
-    putchar('\n');
-    for (l=0; l<CalPad; l++) {
-	gon();
-	DRAW(tb);
-	goff();
+	WriteColSep();
+    }
+    OutPutc('\n');
+    for (l=0; l<Ctx->CalPad; l++) {
+	WriteColSep();
 	for (i=0; i<7; i++) {
             d = ColToDay[i];
             Backgroundize(d);
 	    PrintLeft("", ColSpaces, ' ');
             UnBackgroundize(d);
-	    gon();
-	    DRAW(tb);
-	    goff();
+	    WriteColSep();
 	}
-	putchar('\n');
+	OutPutc('\n');
     }
 
 /* Write the body lines */
@@ -934,22 +2409,19 @@ static void DoCalendarOneWeek(int nleft)
 	done = WriteOneCalLine(OrigJul, wd);
 	LinesWritten++;
     }
+    ClearCalColumns();
 
 /* Write any blank lines required */
-    while (LinesWritten++ < CalLines) {
-        gon();
-        DRAW(tb);
-        goff();
+    while (LinesWritten++ < Ctx->CalLines) {
+        WriteColSep();
 	for (i=0; i<7; i++) {
             d = ColToDay[i];
             Backgroundize(d);
 	    PrintLeft("", ColSpaces, ' ');
             UnBackgroundize(d);
-	    gon();
-	    DRAW(tb);
-	    goff();
+	    WriteColSep();
 	}
-	putchar('\n');
+	OutPutc('\n');
     }
 
 /* Write the final line */
@@ -973,42 +2445,45 @@ static void DoCalendarOneMonth(void)
 
     InitMoonsAndShades();
 
-    if (!DoSimpleCalendar) WriteCalHeader();
+    if (!Ctx->DoSimpleCalendar) WriteCalHeader();
 
     DidADay = 0;
 
-    if (PsCal) {
-	FromJulian(JulianToday, &y, &m, &d);
-	if (PsCal == PSCAL_LEVEL1) {
-	    printf("%s\n", PSBEGIN);
-	} else if (PsCal == PSCAL_LEVEL2) {
-	    printf("%s\n", PSBEGIN2);
+    if (Ctx->PsCalBinary) {
+	FromJulian(Ctx->JulianToday, &y, &m, &d);
+	WriteBinMonth(y, m);
+    } else if (Ctx->PsCal) {
+	FromJulian(Ctx->JulianToday, &y, &m, &d);
+	if (Ctx->PsCal == PSCAL_LEVEL1) {
+	    OutPrintf("%s\n", PSBEGIN);
+	} else if (Ctx->PsCal == PSCAL_LEVEL2) {
+	    OutPrintf("%s\n", PSBEGIN2);
 	} else {
 	    if (DidAMonth) {
-		printf(",\n");
+		OutPuts(",\n");
 	    }
-	    printf("{\n");
+	    OutPuts("{\n");
 	}
-	if (PsCal < PSCAL_LEVEL3) {
-	    printf("%s %d %d %d %d\n",
-		   despace(get_month_name(m)), y, DaysInMonth(m, y), (JulianToday+1) % 7,
-		   MondayFirst);
+	if (Ctx->PsCal < PSCAL_LEVEL3) {
+	    OutPrintf("%s %d %d %d %d\n",
+		   despace(get_month_name(m)), y, DaysInMonth(m, y), (Ctx->JulianToday+1) % 7,
+		   Ctx->MondayFirst);
             for (i=0; i<7; i++) {
                 j=(i+6)%7;
                 if (i) {
-                    printf(" %s", despace(get_day_name(j)));
+                    OutPrintf(" %s", despace(get_day_name(j)));
                 } else {
-                    printf("%s", despace(get_day_name(j)));
+                    OutPuts(despace(get_day_name(j)));
                 }
             }
-            printf("\n");
+            OutPuts("\n");
 	} else {
-	    PrintJSONKeyPairString("monthname", get_month_name(m));
-	    PrintJSONKeyPairInt("year", y);
-	    PrintJSONKeyPairInt("daysinmonth", DaysInMonth(m, y));
-	    PrintJSONKeyPairInt("firstwkday", (JulianToday+1) % 7);
-	    PrintJSONKeyPairInt("mondayfirst", MondayFirst);
-	    printf("\"daynames\":[\"%s\",\"%s\",\"%s\",\"%s\",\"%s\",\"%s\",\"%s\"],",
+	    OutJSONKeyPairString("monthname", get_month_name(m));
+	    OutJSONKeyPairInt("year", y);
+	    OutJSONKeyPairInt("daysinmonth", DaysInMonth(m, y));
+	    OutJSONKeyPairInt("firstwkday", (Ctx->JulianToday+1) % 7);
+	    OutJSONKeyPairInt("mondayfirst", Ctx->MondayFirst);
+	    OutPrintf("\"daynames\":[\"%s\",\"%s\",\"%s\",\"%s\",\"%s\",\"%s\",\"%s\"],",
 		   get_day_name(6), get_day_name(0), get_day_name(1), get_day_name(2),
 		   get_day_name(3), get_day_name(4), get_day_name(5));
 	}
@@ -1017,39 +2492,41 @@ static void DoCalendarOneMonth(void)
 	    mm = 11; yy = y-1;
 	} else yy=y;
 
-	if (PsCal < PSCAL_LEVEL3) {
-	    printf("%s %d\n", despace(get_month_name(mm)), DaysInMonth(mm,yy));
+	if (Ctx->PsCal < PSCAL_LEVEL3) {
+	    OutPrintf("%s %d\n", despace(get_month_name(mm)), DaysInMonth(mm,yy));
 	} else {
-	    PrintJSONKeyPairString("prevmonthname", get_month_name(mm));
-	    PrintJSONKeyPairInt("daysinprevmonth", DaysInMonth(mm, yy));
-	    PrintJSONKeyPairInt("prevmonthyear", yy);
+	    OutJSONKeyPairString("prevmonthname", get_month_name(mm));
+	    OutJSONKeyPairInt("daysinprevmonth", DaysInMonth(mm, yy));
+	    OutJSONKeyPairInt("prevmonthyear", yy);
 	}
 	mm = m+1;
 	if (mm>11) {
 	    mm = 0; yy = y+1;
 	} else yy=y;
-	if (PsCal < PSCAL_LEVEL3) {
-	    printf("%s %d\n", despace(get_month_name(mm)), DaysInMonth(mm,yy));
+	if (Ctx->PsCal < PSCAL_LEVEL3) {
+	    OutPrintf("%s %d\n", despace(get_month_name(mm)), DaysInMonth(mm,yy));
 	} else {
-	    PrintJSONKeyPairString("nextmonthname", get_month_name(mm));
-	    PrintJSONKeyPairInt("daysinnextmonth", DaysInMonth(mm, yy));
-	    PrintJSONKeyPairInt("nextmonthyear", yy);
-	    printf("\"entries\":[\n");
+	    OutJSONKeyPairString("nextmonthname", get_month_name(mm));
+	    OutJSONKeyPairInt("daysinnextmonth", DaysInMonth(mm, yy));
+	    OutJSONKeyPairInt("nextmonthyear", yy);
+	    OutPuts("\"entries\":[\n");
 	}
     }
     while (WriteCalendarRow()) continue;
 
-    if (PsCal == PSCAL_LEVEL1) {
-	printf("%s\n", PSEND);
-    } else if (PsCal == PSCAL_LEVEL2) {
-	printf("%s\n", PSEND2);
-    } else if (PsCal == PSCAL_LEVEL3){
+    if (Ctx->PsCalBinary) {
+	OutBinRecord(PSBIN_END, 0);
+    } else if (Ctx->PsCal == PSCAL_LEVEL1) {
+	OutPrintf("%s\n", PSEND);
+    } else if (Ctx->PsCal == PSCAL_LEVEL2) {
+	OutPrintf("%s\n", PSEND2);
+    } else if (Ctx->PsCal == PSCAL_LEVEL3){
 	if (DidADay) {
-	    printf("\n");
+	    OutPuts("\n");
 	}
-	printf("]\n}");
+	OutPuts("]\n}");
     }
-    if (!DoSimpleCalendar) WriteCalTrailer();
+    if (!Ctx->DoSimpleCalendar) WriteCalTrailer();
 }
 
 /***************************************************************/
@@ -1064,14 +2541,14 @@ static int WriteCalendarRow(void)
     int y, m, d, wd, i, l;
     int done;
     char buf[81];
-    int OrigJul = JulianToday;
+    int OrigJul = Ctx->JulianToday;
     int LinesWritten = 0;
     int moreleft;
 
 /* Get the date of the first day */
-    FromJulian(JulianToday, &y, &m, &d);
-    if (!MondayFirst) wd = (JulianToday + 1) % 7;
-    else		     wd = JulianToday % 7;
+    FromJulian(Ctx->JulianToday, &y, &m, &d);
+    if (!Ctx->MondayFirst) wd = (Ctx->JulianToday + 1) % 7;
+    else		     wd = Ctx->JulianToday % 7;
 
     for (i=0; i<7; i++) {
         ColToDay[i] = 0;
@@ -1081,25 +2558,24 @@ static int WriteCalendarRow(void)
     for (i=wd; i<7; i++) {
 	if (d+i-wd > DaysInMonth(m, y)) break;
 	GenerateCalEntries(i);
-        ColToDay[i] = DayOf(JulianToday);
-	JulianToday++;
+        ColToDay[i] = DayOf(Ctx->JulianToday);
+	Ctx->JulianToday++;
     }
 
 /* Output the entries */
 
 /* If it's "Simple Calendar" format, do it simply... */
-    if (DoSimpleCalendar) {
+    if (Ctx->DoSimpleCalendar) {
 	for (i=wd; i<7 && d+i-wd<=DaysInMonth(m, y); i++) {
 	    WriteSimpleEntries(i, OrigJul+i-wd);
 	}
+	ClearCalColumns();
 	return (d+7-wd <= DaysInMonth(m, y));
     }
 
 
 /* Here come the first few lines... */
-    gon();
-    DRAW(tb);
-    goff();
+    WriteColSep();
     for (i=0; i<7; i++) {
 	if (i < wd || d+i-wd>DaysInMonth(m, y))
 	    PrintLeft("", ColSpaces, ' ');
@@ -1117,37 +2593,31 @@ static int WriteCalendarRow(void)
                     snprintf(buf, sizeof(buf), "%d ", d+i-wd);
                 }
             }
-	    if (Julian(y, m, d+i-wd) == RealToday) {
-                if (UseVTColors) {
-                    printf("\x1B[1m"); /* Bold */
+	    if (Julian(y, m, d+i-wd) == Ctx->RealToday) {
+                if (Ctx->UseVTColors) {
+                    OutPuts("\x1B[1m"); /* Bold */
                 }
 		PrintLeft(buf, ColSpaces-1, '*');
-                if (UseVTColors) {
-                    printf("\x1B[0m"); /* Normal */
+                if (Ctx->UseVTColors) {
+                    OutPuts("\x1B[0m"); /* Normal */
                 }
-		putchar(' ');
+		OutPutc(' ');
 	    } else {
 		PrintLeft(buf, ColSpaces, ' ');
 	    }
 	}
-	gon();
-	DRAW(tb);
-	goff();
+	WriteColSep();
     }
-    putchar('\n');
-    for (l=0; l<CalPad; l++) {
-        gon();
-	DRAW(tb);
-	goff();
+    OutPutc('\n');
+    for (l=0; l<Ctx->CalPad; l++) {
+        WriteColSep();
 	for (i=0; i<7; i++) {
             Backgroundize(ColToDay[i]);
 	    PrintLeft("", ColSpaces, ' ');
             UnBackgroundize(ColToDay[i]);
-	    gon();
-	    DRAW(tb);
-	    goff();
+	    WriteColSep();
 	}
-	putchar('\n');
+	OutPutc('\n');
     }
 
 /* Write the body lines */
@@ -1156,21 +2626,18 @@ static int WriteCalendarRow(void)
 	done = WriteOneCalLine(OrigJul, wd);
 	LinesWritten++;
     }
+    ClearCalColumns();
 
 /* Write any blank lines required */
-    while (LinesWritten++ < CalLines) {
-        gon();
-	DRAW(tb);
-	goff();
+    while (LinesWritten++ < Ctx->CalLines) {
+        WriteColSep();
 	for (i=0; i<7; i++) {
             Backgroundize(ColToDay[i]);
 	    PrintLeft("", ColSpaces, ' ');
             UnBackgroundize(ColToDay[i]);
-	    gon();
-	    DRAW(tb);
-	    goff();
+	    WriteColSep();
 	}
-	putchar('\n');
+	OutPutc('\n');
     }
 
     moreleft = (d+7-wd <= DaysInMonth(m, y));
@@ -1195,8 +2662,8 @@ static void PrintLeft(char const *s, int width, char pad)
 {
 #ifndef REM_USE_WCHAR
     int len = strlen(s);
-    printf("%s", s);
-    while (len++ < width) putchar(pad);
+    OutPuts(s);
+    OutPad(pad, width - len);
 #else
     size_t len = mbstowcs(NULL, s, 0);
     int i;
@@ -1206,19 +2673,19 @@ static void PrintLeft(char const *s, int width, char pad)
     int display_len;
 
     if (!len) {
-	for (i=0; i<width; i++) {
-	    fputc(pad, stdout);
-	}
+	OutPad(pad, width);
 	return;
     }
-    if (len + 1 <= 128) {
-	buf = static_buf;
-    } else {
+    buf = static_buf;
+    if (len + 1 > 128) {
 	buf = calloc(len+1, sizeof(wchar_t));
 	if (!buf) {
-	    /* Uh-oh... cannot recover */
-	    fprintf(stderr, "%s\n", ErrMsg[E_NO_MEM]);
-	    exit(1);
+	    /* Out of memory; columns are seldom wider than the
+	       static buffer, so make do with what fits in it,
+	       leaving room for the terminator */
+	    buf = static_buf;
+	    static_buf[127] = 0;
+	    len = 126;
 	}
     }
     (void) mbstowcs(buf, s, len+1);
@@ -1227,7 +2694,7 @@ static void PrintLeft(char const *s, int width, char pad)
     ws = buf;
     for (i=0; i<width;) {
 	if (*ws) {
-            PutWideChar(*ws++);
+            OutWideChar(*ws++);
             i+= wcwidth(*ws);
         } else {
             break;
@@ -1235,13 +2702,13 @@ static void PrintLeft(char const *s, int width, char pad)
     }
     /* Mop up any potential combining characters */
     while (*ws && wcwidth(*ws) == 0) {
-        PutWideChar(*ws++);
+        OutWideChar(*ws++);
     }
 
     /* Possibly send lrm control sequence */
     send_lrm();
 
-    for (i=display_len; i<width; i++) fputc(pad, stdout);
+    OutPad(pad, width - display_len);
     if (buf != static_buf) free(buf);
 #endif
 
@@ -1254,27 +2721,27 @@ static void PrintLeft(char const *s, int width, char pad)
 /*  Center a piece of text                                      */
 /*                                                             */
 /***************************************************************/
-static void PrintCentered(char const *s, int width, char *pad)
+static void PrintCentered(char const *s, int width, char pad)
 {
 #ifndef REM_USE_WCHAR
     int len = strlen(s);
     int d = (width - len) / 2;
     int i;
 
-    for (i=0; i<d; i++) fputs(pad, stdout);
+    OutPad(pad, d);
     for (i=0; i<width; i++) {
 	if (*s) {
             if (isspace(*s)) {
-                putchar(' ');
+                OutPutc(' ');
                 s++;
             } else {
-                putchar(*s++);
+                OutPutc(*s++);
             }
         } else {
             break;
         }
     }
-    for (i=d+len; i<width; i++) fputs(pad, stdout);
+    OutPad(pad, width - d - len);
 #else
     size_t len = mbstowcs(NULL, s, 0);
     int display_len;
@@ -1285,19 +2752,19 @@ static void PrintCentered(char const *s, int width, char *pad)
     int d;
 
     if (!len) {
-	for (i=0; i<width; i++) {
-	    fputs(pad, stdout);
-	}
+	OutPad(pad, width);
 	return;
     }
-    if (len + 1 <= 128) {
-	buf = static_buf;
-    } else {
+    buf = static_buf;
+    if (len + 1 > 128) {
 	buf = calloc(len+1, sizeof(wchar_t));
 	if (!buf) {
-	    /* Uh-oh... cannot recover */
-	    fprintf(stderr, "%s\n", ErrMsg[E_NO_MEM]);
-	    exit(1);
+	    /* Out of memory; columns are seldom wider than the
+	       static buffer, so make do with what fits in it,
+	       leaving room for the terminator */
+	    buf = static_buf;
+	    static_buf[127] = 0;
+	    len = 126;
 	}
     }
     (void) mbstowcs(buf, s, len+1);
@@ -1305,10 +2772,10 @@ static void PrintCentered(char const *s, int width, char *pad)
     d = (width - display_len) / 2;
     if (d < 0) d = 0;
     ws = buf;
-    for (i=0; i<d; i++) fputs(pad, stdout);
+    OutPad(pad, d);
     for (i=0; i<width; i++) {
 	if (*ws) {
-            PutWideChar(*ws++);
+            OutWideChar(*ws++);
             if (wcwidth(*ws) == 0) {
                 /* Don't count this character... it's zero-width */
                 i--;
@@ -1319,12 +2786,12 @@ static void PrintCentered(char const *s, int width, char *pad)
     }
     /* Mop up any potential combining characters */
     while (*ws && wcwidth(*ws) == 0) {
-        PutWideChar(*ws++);
+        OutWideChar(*ws++);
     }
     /* Possibly send lrm control sequence */
     send_lrm();
 
-    for (i=d+display_len; i<width; i++) fputs(pad, stdout);
+    OutPad(pad, width - d - display_len);
     if (buf != static_buf) free(buf);
 #endif
 }
@@ -1341,25 +2808,21 @@ static int WriteOneCalLine(int start_jul, int wd)
     int done = 1, i;
     int y, m, d;
 
-    gon();
-    DRAW(tb);
-    goff();
+    WriteColSep();
     for (i=0; i<7; i++) {
         FromJulian(start_jul+i, &y, &m, &d);
         d -= wd;
-	if (CalColumn[i]) {
+	if (CalColumn[i].cur < CalColumn[i].num) {
             Backgroundize(ColToDay[i]);
 	    if (WriteOneColLine(i)) done = 0;
 	} else {
             Backgroundize(ColToDay[i]);
-	    PrintCentered("", ColSpaces, " ");
+	    PrintCentered("", ColSpaces, ' ');
 	}
         UnBackgroundize(ColToDay[i]);
-	gon();
-	DRAW(tb);
-	goff();
+	WriteColSep();
     }
-    putchar('\n');
+    OutPutc('\n');
 
     return done;
 }
@@ -1374,7 +2837,9 @@ static int WriteOneCalLine(int start_jul, int wd)
 /***************************************************************/
 static int WriteOneColLine(int col)
 {
-    CalEntry *e = CalColumn[col];
+    CalCell *cell = &CalColumn[col];
+    CalEntry *e = cell->entries[cell->cur];
+    int more = (cell->cur+1 < cell->num);
     char const *s;
     char const *space;
 
@@ -1386,7 +2851,7 @@ static int WriteOneColLine(int col)
     int clamp = 1;
     int numwritten = 0;
     int d = ColToDay[col];
-    if (d && UseBGVTColors && bgcolor[d][0] != -1) {
+    if (d && Ctx->UseBGVTColors && bgcolor[d][0] != -1) {
         clamp = 0;
     }
     /* Print as many characters as possible within the column */
@@ -1397,14 +2862,9 @@ static int WriteOneColLine(int col)
 
 	/* If we're at the end, and there's another entry, do a blank
 	   line and move to next entry. */
-	if (!*ws && e->next) {
+	if (!*ws && more) {
 	    PrintLeft("", ColSpaces, ' ');
-	    CalColumn[col] = e->next;
-	    free(e->text);
-	    free(e->raw_text);
-	    free(e->filename);
-	    if (e->wc_text) free(e->wc_text);
-	    free(e);
+	    cell->cur++;
 	    return 1;
 	}
 
@@ -1430,7 +2890,7 @@ static int WriteOneColLine(int col)
 	}
 
 	/* Colorize reminder if necessary */
-	if (UseVTColors && e->is_color) {
+	if (Ctx->UseVTColors && e->is_color) {
 	    ColorizeEntry(e, clamp);
 	}
 
@@ -1439,7 +2899,7 @@ static int WriteOneColLine(int col)
 	    for (ws = e->wc_pos; numwritten < ColSpaces; ws++) {
 		if (!*ws) break;
                 if (iswspace(*ws)) {
-                    putchar(' ');
+                    OutPutc(' ');
                     numwritten++;
                 } else {
                     if (wcwidth(*ws) > 0) {
@@ -1448,7 +2908,7 @@ static int WriteOneColLine(int col)
                         }
                         numwritten += wcwidth(*ws);
                     }
-                    PutWideChar(*ws);
+                    OutWideChar(*ws);
                 }
 	    }
 	    e->wc_pos = ws;
@@ -1457,20 +2917,20 @@ static int WriteOneColLine(int col)
 	    for (ws = e->wc_pos; ws<wspace; ws++) {
 		if (!*ws) break;
                 if (iswspace(*ws)) {
-                    putchar(' ');
+                    OutPutc(' ');
                     numwritten++;
                 } else {
                     if (wcwidth(*ws) > 0) {
                         numwritten += wcwidth(*ws);
                     }
-                    PutWideChar(*ws);
+                    OutWideChar(*ws);
                 }
 	    }
 	}
 
 	/* Decolorize reminder if necessary, but keep any SHADE */
-	if (UseVTColors && e->is_color) {
-	    printf("%s", Decolorize());
+	if (Ctx->UseVTColors && e->is_color) {
+	    OutPuts(Decolorize());
             Backgroundize(d);
 	}
 
@@ -1478,23 +2938,18 @@ static int WriteOneColLine(int col)
         send_lrm();
 
 	/* Flesh out the rest of the column */
-	while(numwritten++ < ColSpaces) putchar(' ');
+	OutPad(' ', ColSpaces - numwritten);
 
 	/* Skip any spaces before next word */
 	while (iswspace(*ws)) ws++;
 
-	/* If done, free memory if no next entry. */
-	if (!*ws && !e->next) {
-	    CalColumn[col] = e->next;
-	    free(e->text);
-	    free(e->raw_text);
-	    free(e->filename);
-	    if (e->wc_text) free(e->wc_text);
-	    free(e);
-	} else {
-	    e->wc_pos = ws;
+	/* If done, move past this entry if there's no next entry. */
+	if (!*ws && !more) {
+	    cell->cur++;
+	    return 0;
 	}
-	if (CalColumn[col]) return 1; else return 0;
+	e->wc_pos = ws;
+	return 1;
     } else {
 #endif
 	space = NULL;
@@ -1502,16 +2957,9 @@ static int WriteOneColLine(int col)
 
 	/* If we're at the end, and there's another entry, do a blank
 	   line and move to next entry. */
-	if (!*s && e->next) {
+	if (!*s && more) {
 	    PrintLeft("", ColSpaces, ' ');
-	    CalColumn[col] = e->next;
-	    free(e->text);
-	    free(e->filename);
-#ifdef REM_USE_WCHAR
-	    if (e->wc_text) free(e->wc_text);
-#endif
-	    free(e->raw_text);
-	    free(e);
+	    cell->cur++;
 	    return 1;
 	}
 
@@ -1523,7 +2971,7 @@ static int WriteOneColLine(int col)
 	}
 
 	/* Colorize reminder if necessary */
-	if (UseVTColors && e->is_color) {
+	if (Ctx->UseVTColors && e->is_color) {
 	    ColorizeEntry(e, clamp);
 	}
 
@@ -1533,9 +2981,9 @@ static int WriteOneColLine(int col)
 		if (!*s) break;
 		numwritten++;
                 if (isspace(*s)) {
-                    putchar(' ');
+                    OutPutc(' ');
                 } else {
-                    putchar(*s);
+                    OutPutc(*s);
                 }
 	    }
 	    e->pos = s;
@@ -1545,39 +2993,32 @@ static int WriteOneColLine(int col)
 		if (!*s) break;
 		numwritten++;
                 if (isspace(*s)) {
-                    putchar(' ');
+                    OutPutc(' ');
                 } else {
-                    putchar(*s);
+                    OutPutc(*s);
                 }
 	    }
 	}
 
 	/* Decolorize reminder if necessary, but keep SHADE */
-	if (UseVTColors && e->is_color) {
-	    printf("%s", Decolorize());
+	if (Ctx->UseVTColors && e->is_color) {
+	    OutPuts(Decolorize());
             Backgroundize(d);
 	}
 
 	/* Flesh out the rest of the column */
-	while(numwritten++ < ColSpaces) putchar(' ');
+	OutPad(' ', ColSpaces - numwritten);
 
 	/* Skip any spaces before next word */
 	while (isspace(*s)) s++;
 
-	/* If done, free memory if no next entry. */
-	if (!*s && !e->next) {
-	    CalColumn[col] = e->next;
-	    free(e->text);
-	    free(e->filename);
-#ifdef REM_USE_WCHAR
-	    if (e->wc_text) free(e->wc_text);
-#endif
-	    free(e->raw_text);
-	    free(e);
-	} else {
-	    e->pos = s;
+	/* If done, move past this entry if there's no next entry. */
+	if (!*s && !more) {
+	    cell->cur++;
+	    return 0;
 	}
-	if (CalColumn[col]) return 1; else return 0;
+	e->pos = s;
+	return 1;
 #ifdef REM_USE_WCHAR
     }
 #endif
@@ -1587,36 +3028,65 @@ static int WriteOneColLine(int col)
 /*                                                             */
 /*  GenerateCalEntries                                         */
 /*                                                             */
-/*  Generate the calendar entries for the ith column           */
+/*  Generate the calendar entries for the ith column.  If the  */
+/*  file can't be read, Remind exits, unless TrapExit is set;  */
+/*  then, as after EXIT, the rest of the calendar is left      */
+/*  without entries.                                           */
 /*                                                             */
 /***************************************************************/
 static void GenerateCalEntries(int col)
+{
+    int r;
+
+    if (Ctx->Exited) return;
+    r = CollectCalEntries(col);
+    if (r == OK || r == E_EXIT) return;
+    if (!Ctx->TrapExit) exit(1);
+    Ctx->Exited = 1;
+    Ctx->ExitStatus = 1;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  CollectCalEntries                                          */
+/*                                                             */
+/*  Run the reminder file for JulianToday, adding its entries  */
+/*  to the ith column (or none if col is negative.)  Returns   */
+/*  an error if the file could not be read.                    */
+/*                                                             */
+/***************************************************************/
+static int CollectCalEntries(int col)
 {
     int r;
     Token tok;
     char const *s;
     Parser p;
 
+    /* Reminders may write to stdout themselves, so get everything
+       produced so far out first */
+    OutFlush();
+
 /* Do some initialization first... */
     PerIterationInit();
+    ClearIncludeStack();
 
-    r=IncludeFile(InitialFile);
+    r=IncludeFile(Ctx->InitialFile);
     if (r) {
-	fprintf(ErrFp, "%s %s: %s\n", ErrMsg[E_ERR_READING], InitialFile, ErrMsg[r]);
-	exit(1);
+	fprintf(ErrFp, "%s %s: %s\n", ErrMsg[E_ERR_READING], Ctx->InitialFile, ErrMsg[r]);
+	return r;
     }
 
     while(1) {
 	r = ReadLine();
-	if (r == E_EOF) return;
+	if (r == E_EOF) break;
 	if (r) {
 	    Eprint("%s: %s", ErrMsg[E_ERR_READING], ErrMsg[r]);
-	    exit(1);
+	    return r;
 	}
-	s = FindInitialToken(&tok, CurLine);
+	s = FindInitialToken(&tok, Ctx->CurLine);
 
 	/* Should we ignore it? */
-	if (NumIfs &&
+	if (Ctx->NumIfs &&
 	    tok.type != T_If &&
 	    tok.type != T_Else &&
 	    tok.type != T_EndIf &&
@@ -1646,7 +3116,7 @@ static void GenerateCalEntries(int col)
 	    case T_IncludeR: r=DoInclude(&p, tok.type); break;
 
 	    case T_IncludeCmd: r=DoIncludeCmd(&p); break;
-	    case T_Exit:    DoExit(&p);	     break;
+	    case T_Exit:    r=DoExit(&p);    break;
 	    case T_Set:     r=DoSet(&p);     break;
 	    case T_Fset:    r=DoFset(&p);    break;
 	    case T_Funset:  r=DoFunset(&p);  break;
@@ -1670,7 +3140,7 @@ static void GenerateCalEntries(int col)
 		r=DoRun(&p);
 		break;
 	    } else {
-		CreateParser(CurLine, &p);
+		CreateParser(Ctx->CurLine, &p);
 		r=DoCalRem(&p, col);
 		break;
 	    }
@@ -1679,16 +3149,27 @@ static void GenerateCalEntries(int col)
 	    /* Note:  Since the parser hasn't been used yet, we don't */
 	    /* need to destroy it here. */
 
-	    default:        CreateParser(CurLine, &p);
+	    default:        CreateParser(Ctx->CurLine, &p);
 		r=DoCalRem(&p, col);
 		break;
 	    }
-	    if (r && (!Hush || r != E_RUN_DISABLED)) Eprint("%s", ErrMsg[r]);
+	    if (r == E_EXIT) {
+		/* Nothing more of the file is read; the entries so far
+		   stand */
+		DestroyParser(&p);
+		ClearIncludeStack();
+		break;
+	    }
+	    if (r && (!Ctx->Hush || r != E_RUN_DISABLED)) Eprint("%s", ErrMsg[r]);
 
 	    /* Destroy the parser - free up resources it may be tying up */
 	    DestroyParser(&p);
 	}
     }
+
+    /* The column is complete; put its entries in order */
+    if (col >= 0) SortCol(&CalColumn[col]);
+    return (r == E_EXIT) ? E_EXIT : OK;
 }
 
 
@@ -1702,19 +3183,15 @@ static void WriteCalHeader(void)
     char buf[80];
     int y, m, d;
 
-    FromJulian(JulianToday, &y, &m, &d);
+    FromJulian(Ctx->JulianToday, &y, &m, &d);
     sprintf(buf, "%s %d", get_month_name(m), y);
 
     WriteTopCalLine();
 
-    gon();
-    DRAW(tb);
-    goff();
-    PrintCentered(buf, CalWidth-2, " ");
-    gon();
-    DRAW(tb);
-    goff();
-    putchar('\n');
+    WriteColSep();
+    PrintCentered(buf, Ctx->CalWidth-2, ' ');
+    WriteColSep();
+    OutPutc('\n');
 
     WritePostHeaderLine();
     WriteCalDays();
@@ -1728,7 +3205,7 @@ static void WriteCalHeader(void)
 /***************************************************************/
 static void WriteCalTrailer(void)
 {
-    putchar('\f');
+    OutPutc('\f');
 }
 
 /***************************************************************/
@@ -1746,7 +3223,6 @@ static int DoCalRem(ParsePtr p, int col)
     Value v;
     int r, err;
     int jul;
-    CalEntry *CurCol;
     CalEntry *e;
     char const *s, *s2;
     DynamicBuffer buf, obuf, pre_buf, raw_buf;
@@ -1755,11 +3231,6 @@ static int DoCalRem(ParsePtr p, int col)
 
     int is_color, col_r, col_g, col_b;
 
-    if (col >= 0) {
-        CurCol = CalColumn[col];
-    } else {
-        CurCol = NULL;
-    }
     is_color = 0;
     DBufInit(&buf);
     DBufInit(&pre_buf);
@@ -1775,13 +3246,13 @@ static int DoCalRem(ParsePtr p, int col)
 	trig.typ == CAL_TYPE ||
 	trig.typ == MSF_TYPE) {
 	is_color = (
-	    DefaultColorR != -1
-	    && DefaultColorG != -1
-	    && DefaultColorB != -1);
+	    Ctx->DefaultColorR != -1
+	    && Ctx->DefaultColorG != -1
+	    && Ctx->DefaultColorB != -1);
 	if (is_color) {
-	    col_r = DefaultColorR;
-	    col_g = DefaultColorG;
-	    col_b = DefaultColorB;
+	    col_r = Ctx->DefaultColorR;
+	    col_g = Ctx->DefaultColorG;
+	    col_b = Ctx->DefaultColorB;
 	}
     }
 
@@ -1799,7 +3270,7 @@ static int DoCalRem(ParsePtr p, int col)
 	    if (r == E_EXPIRED) return OK;
 	    return r;
 	}
-	if (!LastTrigValid) {
+	if (!Ctx->LastTrigValid) {
 	    FreeTrig(&trig);
 	    return OK;
 	}
@@ -1834,17 +3305,17 @@ static int DoCalRem(ParsePtr p, int col)
             trig.typ == CAL_TYPE ||
             trig.typ == MSF_TYPE) {
             is_color = (
-                DefaultColorR != -1
-                && DefaultColorG != -1
-                && DefaultColorB != -1);
+                Ctx->DefaultColorR != -1
+                && Ctx->DefaultColorG != -1
+                && Ctx->DefaultColorB != -1);
             if (is_color) {
-                col_r = DefaultColorR;
-                col_g = DefaultColorG;
-                col_b = DefaultColorB;
+                col_r = Ctx->DefaultColorR;
+                col_g = Ctx->DefaultColorG;
+                col_b = Ctx->DefaultColorB;
             }
         }
-	jul = LastTriggerDate;
-	if (!LastTrigValid) {
+	jul = Ctx->LastTriggerDate;
+	if (!Ctx->LastTrigValid) {
 	    FreeTrig(&trig);
 	    return OK;
 	}
@@ -1869,6 +3340,13 @@ static int DoCalRem(ParsePtr p, int col)
         }
     }
 
+    /* If we're compiling a table, record the occurrence */
+    if (col < 0 && Ctx->TableFile) {
+	r = TableAddReminder(p, &trig, &tim, jul);
+	FreeTrig(&trig);
+	return r;
+    }
+
     /* If we're not actually generating any calendar entries, we're done */
     if (col < 0) {
 	FreeTrig(&trig);
@@ -1876,7 +3354,7 @@ static int DoCalRem(ParsePtr p, int col)
     }
 
     /* Don't include timed reminders in calendar if -a option supplied. */
-    if (DontIssueAts && tim.ttime != NO_TIME) {
+    if (Ctx->DontIssueAts && tim.ttime != NO_TIME) {
 	FreeTrig(&trig);
 	return OK;
     }
@@ -1897,7 +3375,7 @@ static int DoCalRem(ParsePtr p, int col)
     if (trig.typ == MSG_TYPE ||
 	trig.typ == CAL_TYPE ||
 	trig.typ == MSF_TYPE) {
-	if (PsCal && is_color) {
+	if (Ctx->PsCal && is_color) {
 	    char cbuf[24];
 	    sprintf(cbuf, "%d %d %d ", col_r, col_g, col_b);
 	    DBufPuts(&pre_buf, cbuf);
@@ -1906,8 +3384,8 @@ static int DoCalRem(ParsePtr p, int col)
 	}
     }
     if (trig.typ == PASSTHRU_TYPE) {
-        if (!PsCal && !StrCmpi(trig.passthru, "SHADE")) {
-            if (jul == JulianToday) {
+        if (!Ctx->PsCal && !StrCmpi(trig.passthru, "SHADE")) {
+            if (jul == Ctx->JulianToday) {
                 DBufInit(&obuf);
                 r = DoSubst(p, &obuf, &trig, &tim, jul, CAL_MODE);
                 if (r) {
@@ -1919,8 +3397,8 @@ static int DoCalRem(ParsePtr p, int col)
                 DBufFree(&obuf);
             }
         }
-        if (!PsCal && !StrCmpi(trig.passthru, "WEEK")) {
-            if (jul == JulianToday) {
+        if (!Ctx->PsCal && !StrCmpi(trig.passthru, "WEEK")) {
+            if (jul == Ctx->JulianToday) {
                 DBufInit(&obuf);
                 r = DoSubst(p, &obuf, &trig, &tim, jul, CAL_MODE);
                 if (r) {
@@ -1932,12 +3410,12 @@ static int DoCalRem(ParsePtr p, int col)
                 DBufFree(&obuf);
             }
         }
-	if (!PsCal && StrCmpi(trig.passthru, "COLOR") && StrCmpi(trig.passthru, "COLOUR") && StrCmpi(trig.passthru, "MOON")) {
+	if (!Ctx->PsCal && StrCmpi(trig.passthru, "COLOR") && StrCmpi(trig.passthru, "COLOUR") && StrCmpi(trig.passthru, "MOON")) {
 	    FreeTrig(&trig);
 	    return OK;
 	}
-        if (!PsCal && !StrCmpi(trig.passthru, "MOON")) {
-            if (jul == JulianToday) {
+        if (!Ctx->PsCal && !StrCmpi(trig.passthru, "MOON")) {
+            if (jul == Ctx->JulianToday) {
                 DBufInit(&obuf);
                 r = DoSubst(p, &obuf, &trig, &tim, jul, CAL_MODE);
                 if (r) {
@@ -1986,7 +3464,7 @@ static int DoCalRem(ParsePtr p, int col)
 	    else if (col_g > 255) col_g = 255;
 	    if (col_b < 0) col_b = 0;
 	    else if (col_b > 255) col_b = 255;
-	    if (!PsCal && !DoSimpleCalendar) {
+	    if (!Ctx->PsCal && !Ctx->DoSimpleCalendar) {
 		DBufFree(&pre_buf);
 	    }
 	}
@@ -1994,10 +3472,10 @@ static int DoCalRem(ParsePtr p, int col)
 
     /* If trigger date == today, add it to the current entry */
     DBufInit(&obuf);
-    if ((jul == JulianToday) ||
-	(DoSimpleCalDelta &&
+    if ((jul == Ctx->JulianToday) ||
+	(Ctx->DoSimpleCalDelta &&
 	 ShouldTriggerReminder(&trig, &tim, jul, &err))) {
-	NumTriggered++;
+	Ctx->NumTriggered++;
 
 	/* The parse_ptr should not be nested, but just in case... */
 	if (!p->isnested) {
@@ -2008,9 +3486,9 @@ static int DoCalRem(ParsePtr p, int col)
 		return E_NO_MEM;
 	    }
 	}
-	if (DoSimpleCalendar || tim.ttime != NO_TIME) {
+	if (Ctx->DoSimpleCalendar || tim.ttime != NO_TIME) {
 	    /* Suppress time if it's not today or if it's a non-COLOR special */
-	    if (jul != JulianToday ||
+	    if (jul != Ctx->JulianToday ||
 		(trig.typ == PASSTHRU_TYPE &&
 		 StrCmpi(trig.passthru, "COLOUR") &&
 		 StrCmpi(trig.passthru, "COLOR"))) {
@@ -2055,7 +3533,7 @@ static int DoCalRem(ParsePtr p, int col)
 
 	/* In -sa mode, run in ADVANCE mode if we're triggering
 	 * before the actual date */
-	if (jul != JulianToday) {
+	if (jul != Ctx->JulianToday) {
 	    r = DoSubst(p, &obuf, &trig, &tim, jul, ADVANCE_MODE);
 	} else {
 	    r = DoSubst(p, &obuf, &trig, &tim, jul, CAL_MODE);
@@ -2095,10 +3573,10 @@ static int DoCalRem(ParsePtr p, int col)
 	    }
 	}
 	s = DBufValue(&obuf);
-	if (!DoSimpleCalendar) while (isempty(*s)) s++;
+	if (!Ctx->DoSimpleCalendar) while (isempty(*s)) s++;
 	DBufPuts(&pre_buf, s);
 	s = DBufValue(&pre_buf);
-	e = NEW(CalEntry);
+	e = ArenaAlloc(&CalArena, sizeof(CalEntry));
 	if (!e) {
 	    DBufFree(&obuf);
 	    DBufFree(&raw_buf);
@@ -2107,7 +3585,7 @@ static int DoCalRem(ParsePtr p, int col)
 	    return E_NO_MEM;
 	}
 	e->nonconst_expr = nonconst_expr;
-	e->if_depth = NumIfs;
+	e->if_depth = Ctx->NumIfs;
 	e->trig = trig;
 	e->tt = tim;
 #ifdef REM_USE_WCHAR
@@ -2118,40 +3596,34 @@ static int DoCalRem(ParsePtr p, int col)
 	e->r = col_r;
 	e->g = col_g;
 	e->b = col_b;
-	e->text = StrDup(s);
-	e->raw_text = StrDup(DBufValue(&raw_buf));
+	e->text = ArenaStrDup(&CalArena, s);
+	e->raw_text = ArenaStrDup(&CalArena, DBufValue(&raw_buf));
 	DBufFree(&raw_buf);
 	DBufFree(&obuf);
 	DBufFree(&pre_buf);
 	if (!e->text || !e->raw_text) {
-	    if (e->text) free(e->text);
-	    if (e->raw_text) free(e->raw_text);
-	    free(e);
 	    FreeTrig(&trig);
 	    return E_NO_MEM;
 	}
 	make_wchar_versions(e);
-	DBufInit(&(e->tags));
-	DBufPuts(&(e->tags), DBufValue(&(trig.tags)));
-	if (SynthesizeTags) {
-	    AppendTag(&(e->tags), SynthesizeTag());
+	if (Ctx->SynthesizeTags) {
+	    AppendTag(&(trig.tags), SynthesizeTag());
+	}
+	e->tags = ArenaStrDup(&CalArena, DBufValue(&(trig.tags)));
+	if (!e->tags) {
+	    FreeTrig(&trig);
+	    return E_NO_MEM;
 	}
 
 	/* Don't need tags any more */
 	FreeTrig(&trig);
 	e->duration = tim.duration;
 	e->priority = trig.priority;
-	e->filename = StrDup(FileName);
+	e->filename = ArenaStrDup(&CalArena, Ctx->FileName);
 	if(!e->filename) {
-	    if (e->text) free(e->text);
-	    if (e->raw_text) free(e->raw_text);
-#ifdef REM_USE_WCHAR
-            if (e->wc_text) free(e->wc_text);
-#endif
-	    free(e);
 	    return E_NO_MEM;
 	}
-	e->lineno = LineNo;
+	e->lineno = Ctx->LineNo;
 
 	if (trig.typ == PASSTHRU_TYPE || is_color) {
 	    StrnCpy(e->passthru, trig.passthru, PASSTHRU_LEN);
@@ -2159,14 +3631,14 @@ static int DoCalRem(ParsePtr p, int col)
 	    e->passthru[0] = 0;
 	}
 	e->pos = e->text;
-	if (jul == JulianToday) {
+	if (jul == Ctx->JulianToday) {
 	    e->time = tim.ttime;
 	} else {
 	    e->time = NO_TIME;
 	}
-	e->next = CurCol;
-	CalColumn[col] = e;
-	SortCol(&CalColumn[col]);
+	if (AddToCol(&CalColumn[col], e) != OK) {
+	    return E_NO_MEM;
+	}
     } else {
         /* Parse the rest of the line to catch expression-pasting errors */
         while (ParseChar(p, &r, 0)) {
@@ -2181,26 +3653,26 @@ static int DoCalRem(ParsePtr p, int col)
 static void WriteSimpleEntryProtocol1(CalEntry *e)
 {
 	if (e->passthru[0]) {
-	    printf(" %s", e->passthru);
+	    OutPrintf(" %s", e->passthru);
 	} else {
-	    printf(" *");
+	    OutPuts(" *");
 	}
-	if (*DBufValue(&(e->tags))) {
-	    printf(" %s ", DBufValue(&(e->tags)));
+	if (*e->tags) {
+	    OutPrintf(" %s ", e->tags);
 	} else {
-	    printf(" * ");
+	    OutPuts(" * ");
 	}
 	if (e->duration != NO_TIME) {
-	    printf("%d ", e->duration);
+	    OutPrintf("%d ", e->duration);
 	} else {
-	    printf("* ");
+	    OutPuts("* ");
 	}
 	if (e->time != NO_TIME) {
-	    printf("%d ", e->time);
+	    OutPrintf("%d ", e->time);
 	} else {
-	    printf("* ");
+	    OutPuts("* ");
 	}
-	printf("%s\n", e->text);
+	OutPrintf("%s\n", e->text);
 }
 
 
@@ -2208,111 +3680,111 @@ static void WriteSimpleEntryProtocol2(CalEntry *e, int today)
 {
     int done = 0;
     char const *s;
-    if (DoPrefixLineNo) {
-	PrintJSONKeyPairString("filename", e->filename);
-	PrintJSONKeyPairInt("lineno", e->lineno);
+    if (Ctx->DoPrefixLineNo) {
+	OutJSONKeyPairString("filename", e->filename);
+	OutJSONKeyPairInt("lineno", e->lineno);
     }
-    PrintJSONKeyPairString("passthru", e->passthru);
-    PrintJSONKeyPairString("tags", DBufValue(&(e->tags)));
+    OutJSONKeyPairString("passthru", e->passthru);
+    OutJSONKeyPairString("tags", e->tags);
     if (e->duration != NO_TIME) {
-	PrintJSONKeyPairInt("duration", e->duration);
+	OutJSONKeyPairInt("duration", e->duration);
     }
     if (e->time != NO_TIME) {
-	PrintJSONKeyPairInt("time", e->time);
+	OutJSONKeyPairInt("time", e->time);
 	if (e->tt.delta) {
-	    PrintJSONKeyPairInt("tdelta", e->tt.delta);
+	    OutJSONKeyPairInt("tdelta", e->tt.delta);
 	}
 	if (e->tt.rep) {
-	    PrintJSONKeyPairInt("trep", e->tt.rep);
+	    OutJSONKeyPairInt("trep", e->tt.rep);
 	}
     }
     if (e->trig.eventduration != NO_TIME) {
-	PrintJSONKeyPairInt("eventduration", e->trig.eventduration);
+	OutJSONKeyPairInt("eventduration", e->trig.eventduration);
     }
     /* wd is an array of days from 0=monday to 6=sunday.
        We convert to array of strings */
     if (e->trig.wd != NO_WD) {
-	printf("\"wd\":[");
+	OutPuts("\"wd\":[");
 	done = 0;
 	int i;
 	for (i=0; i<7; i++) {
 	    if (e->trig.wd & (1 << i)) {
 		if (done) {
-		    printf(",");
+		    OutPuts(",");
 		}
 		done = 1;
-		printf("\"%s\"", EnglishDayName[i]);
+		OutPrintf("\"%s\"", EnglishDayName[i]);
 	    }
 	}
-	printf("],");
+	OutPuts("],");
     }
     if (e->trig.d != NO_DAY) {
-	PrintJSONKeyPairInt("d", e->trig.d);
+	OutJSONKeyPairInt("d", e->trig.d);
     }
     if (e->trig.m != NO_MON) {
-	PrintJSONKeyPairInt("m", e->trig.m+1);
+	OutJSONKeyPairInt("m", e->trig.m+1);
     }
     if (e->trig.y != NO_YR) {
-	PrintJSONKeyPairInt("y", e->trig.y);
+	OutJSONKeyPairInt("y", e->trig.y);
     }
-    PrintJSONKeyPairDateTime("eventstart", e->trig.eventstart);
+    OutJSONKeyPairDateTime("eventstart", e->trig.eventstart);
     if (e->trig.back) {
-	PrintJSONKeyPairInt("back", e->trig.back);
+	OutJSONKeyPairInt("back", e->trig.back);
     }
     if (e->trig.delta) {
-	PrintJSONKeyPairInt("delta", e->trig.delta);
+	OutJSONKeyPairInt("delta", e->trig.delta);
     }
     if (e->trig.rep) {
-	PrintJSONKeyPairInt("rep", e->trig.rep);
+	OutJSONKeyPairInt("rep", e->trig.rep);
     }
     if (e->nonconst_expr) {
-	PrintJSONKeyPairInt("nonconst_expr", e->nonconst_expr);
+	OutJSONKeyPairInt("nonconst_expr", e->nonconst_expr);
     }
     if (e->if_depth) {
-	PrintJSONKeyPairInt("if_depth", e->if_depth);
+	OutJSONKeyPairInt("if_depth", e->if_depth);
     }
     switch(e->trig.skip) {
     case SKIP_SKIP:
-	PrintJSONKeyPairString("skip", "SKIP");
+	OutJSONKeyPairString("skip", "SKIP");
 	break;
     case BEFORE_SKIP:
-	PrintJSONKeyPairString("skip", "BEFORE");
+	OutJSONKeyPairString("skip", "BEFORE");
 	break;
     case AFTER_SKIP:
-	PrintJSONKeyPairString("skip", "AFTER");
+	OutJSONKeyPairString("skip", "AFTER");
 	break;
     }
     /* Local omit is an array of days from 0=monday to 6=sunday.
        We convert to array of strings */
     if (e->trig.localomit != NO_WD) {
-	printf("\"localomit\":[");
+	OutPuts("\"localomit\":[");
 	done = 0;
 	int i;
 	for (i=0; i<7; i++) {
 	    if (e->trig.localomit & (1 << i)) {
 		if (done) {
-		    printf(",");
+		    OutPuts(",");
 		}
 		done = 1;
-		printf("\"%s\"", EnglishDayName[i]);
+		OutPrintf("\"%s\"", EnglishDayName[i]);
 	    }
 	}
-	printf("],");
+	OutPuts("],");
     }
-    PrintJSONKeyPairDate("until", e->trig.until);
+    OutJSONKeyPairDate("until", e->trig.until);
     if (e->trig.once != NO_ONCE) {
-	PrintJSONKeyPairInt("once", e->trig.once);
+	OutJSONKeyPairInt("once", e->trig.once);
     }
     if (e->trig.scanfrom != today) {
-	PrintJSONKeyPairDate("scanfrom", e->trig.scanfrom);
+	OutJSONKeyPairDate("scanfrom", e->trig.scanfrom);
     }
-    PrintJSONKeyPairDate("from", e->trig.from);
-    PrintJSONKeyPairInt("priority", e->trig.priority);
+    OutJSONKeyPairDate("from", e->trig.from);
+    OutJSONKeyPairInt("priority", e->trig.priority);
 
     if (e->is_color) {
-	PrintJSONKeyPairInt("r", e->r);
-	PrintJSONKeyPairInt("g", e->g);
-	PrintJSONKeyPairInt("b", e->b);
+	OutJSONKeyPairInt("r", e->r);
+	OutJSONKeyPairInt("g", e->g);
+	OutJSONKeyPairInt("b", e->b);
     } else if (!StrCmpi(e->passthru, "SHADE")) {
 	int r, g, b, n;
 	n = sscanf(e->text, "%d %d %d", &r, &g, &b);
@@ -2326,34 +3798,34 @@ static void WriteSimpleEntryProtocol2(CalEntry *e, int today)
 	else if (g > 255) g = 255;
 	if (b < 0) b = 0;
 	else if (b > 255) b = 255;
-	PrintJSONKeyPairInt("r", r);
-	PrintJSONKeyPairInt("g", g);
-	PrintJSONKeyPairInt("b", b);
+	OutJSONKeyPairInt("r", r);
+	OutJSONKeyPairInt("g", g);
+	OutJSONKeyPairInt("b", b);
     }
     /* Only print rawbody if it differs from body */
     if (strcmp(e->raw_text, e->text)) {
-	PrintJSONKeyPairString("rawbody", e->raw_text);
+	OutJSONKeyPairString("rawbody", e->raw_text);
     }
 
     /* Figure out calendar_body and plain_body */
-    if (DontSuppressQuoteMarkers) {
+    if (Ctx->DontSuppressQuoteMarkers) {
         s = strstr(e->text, "%\"");
         if (s) {
             s += 2;
-            printf("\"calendar_body\":\"");
+            OutPuts("\"calendar_body\":\"");
             while (*s) {
                 if (*s == '%' && *(s+1) == '"') {
                     break;
                 }
-                PrintJSONChar(*s);
+                OutJSONChar(*s);
                 s++;
             }
-            printf("\",");
+            OutPuts("\",");
         }
     }
     s = strstr(e->text, "%\"");
     if (s || e->is_color) {
-        printf("\"plain_body\":\"");
+        OutPuts("\"plain_body\":\"");
         s = e->text;
         if (e->is_color) {
             while(*s && !isspace(*s)) s++;
@@ -2368,14 +3840,14 @@ static void WriteSimpleEntryProtocol2(CalEntry *e, int today)
                 s += 2;
                 continue;
             }
-            PrintJSONChar(*s);
+            OutJSONChar(*s);
             s++;
         }
-        printf("\",");
+        OutPuts("\",");
     }
-    printf("\"body\":\"");
-    PrintJSONString(e->text);
-    printf("\"");
+    OutPuts("\"body\":\"");
+    OutJSONString(e->text);
+    OutPuts("\"");
 }
 
 /***************************************************************/
@@ -2387,46 +3859,127 @@ static void WriteSimpleEntryProtocol2(CalEntry *e, int today)
 /***************************************************************/
 static void WriteSimpleEntries(int col, int jul)
 {
-    CalEntry *e = CalColumn[col];
-    CalEntry *n;
+    CalCell *cell = &CalColumn[col];
+    CalEntry *e;
     int y, m, d;
 
     FromJulian(jul, &y, &m, &d);
-    while(e) {
-	if (DoPrefixLineNo) {
-	    if (PsCal != PSCAL_LEVEL2 && PsCal != PSCAL_LEVEL3) {
-		printf("# fileinfo %d %s\n", e->lineno, e->filename);
+    for (; cell->cur < cell->num; cell->cur++) {
+	e = cell->entries[cell->cur];
+	if (Ctx->PsCalBinary) {
+	    WriteBinEntry(e, d);
+	    continue;
+	}
+	if (Ctx->DoPrefixLineNo) {
+	    if (Ctx->PsCal != PSCAL_LEVEL2 && Ctx->PsCal != PSCAL_LEVEL3) {
+		OutPrintf("# fileinfo %d %s\n", e->lineno, e->filename);
 	    }
 	}
-	if (PsCal >= PSCAL_LEVEL2) {
-	    if (PsCal == PSCAL_LEVEL3) {
+	if (Ctx->PsCal >= PSCAL_LEVEL2) {
+	    if (Ctx->PsCal == PSCAL_LEVEL3) {
 		if (DidADay) {
-		    printf(",\n");
+		    OutPuts(",\n");
 		}
 	    }
 	    DidADay = 1;
-	    printf("{\"date\":\"%04d-%02d-%02d\",", y, m+1, d);
+	    OutPrintf("{\"date\":\"%04d-%02d-%02d\",", y, m+1, d);
 	    WriteSimpleEntryProtocol2(e, jul);
-	    printf("}");
-	    if (PsCal != PSCAL_LEVEL3) {
-		printf("\n");
+	    OutPuts("}");
+	    if (Ctx->PsCal != PSCAL_LEVEL3) {
+		OutPuts("\n");
 	    }
 	} else {
-	    printf("%04d/%02d/%02d", y, m+1, d);
+	    OutPrintf("%04d/%02d/%02d", y, m+1, d);
 	    WriteSimpleEntryProtocol1(e);
 	}
+    }
+}
 
-	free(e->text);
-	free(e->raw_text);
-	free(e->filename);
-#ifdef REM_USE_WCHAR
-	if (e->wc_text) free(e->wc_text);
-#endif
-	n = e->next;
-	free(e);
-	e = n;
+/***************************************************************/
+/*                                                             */
+/*  Functions for writing the binary interchange format used   */
+/*  by -pb.  See custom.h for the layout.                      */
+/*                                                             */
+/***************************************************************/
+#define BIN_STRING_LEN(s) (4 + strlen(s))
+
+static void OutBinInt(int n)
+{
+    unsigned long u = (unsigned long) n;
+    char b[4];
+
+    b[0] = u & 0xFF;
+    b[1] = (u >> 8) & 0xFF;
+    b[2] = (u >> 16) & 0xFF;
+    b[3] = (u >> 24) & 0xFF;
+    OutWrite(b, 4);
+}
+
+static void OutBinString(char const *s)
+{
+    size_t len = strlen(s);
+
+    OutBinInt((int) len);
+    OutWrite(s, len);
+}
+
+static void OutBinRecord(int type, size_t len)
+{
+    OutPutc(type);
+    OutBinInt((int) len);
+}
+
+static void WriteBinStart(void)
+{
+    OutWrite(PSBIN_MAGIC, PSBIN_MAGIC_LEN);
+    OutBinInt(PSBIN_VERSION);
+}
+
+static void WriteBinMonth(int y, int m)
+{
+    int pm = (m+11) % 12, py = (m ? y : y-1);
+    int nm = (m+1) % 12,  ny = (m == 11 ? y+1 : y);
+    size_t len;
+    int i;
+
+    len = 6 * 4 +
+	BIN_STRING_LEN(get_month_name(m)) +
+	BIN_STRING_LEN(get_month_name(pm)) +
+	BIN_STRING_LEN(get_month_name(nm));
+    for (i=0; i<7; i++) {
+	len += BIN_STRING_LEN(get_day_name((i+6)%7));
+    }
+
+    OutBinRecord(PSBIN_MONTH, len);
+    OutBinString(get_month_name(m));
+    OutBinInt(y);
+    OutBinInt(DaysInMonth(m, y));
+    OutBinInt((Ctx->JulianToday+1) % 7);
+    OutBinInt(Ctx->MondayFirst);
+    for (i=0; i<7; i++) {
+	OutBinString(get_day_name((i+6)%7));
     }
-    CalColumn[col] = NULL;
+    OutBinString(get_month_name(pm));
+    OutBinInt(DaysInMonth(pm, py));
+    OutBinString(get_month_name(nm));
+    OutBinInt(DaysInMonth(nm, ny));
+}
+
+static void WriteBinEntry(CalEntry const *e, int d)
+{
+    OutBinRecord(PSBIN_ENTRY, 4 * 4 +
+		 BIN_STRING_LEN(e->passthru) +
+		 BIN_STRING_LEN(e->tags) +
+		 BIN_STRING_LEN(e->text) +
+		 BIN_STRING_LEN(e->filename));
+    OutBinInt(d);
+    OutBinInt(e->time == NO_TIME ? -1 : e->time);
+    OutBinInt(e->duration == NO_TIME ? -1 : e->duration);
+    OutBinString(e->passthru);
+    OutBinString(e->tags);
+    OutBinString(e->text);
+    OutBinString(e->filename);
+    OutBinInt(e->lineno);
 }
 
 /***************************************************************/
@@ -2436,99 +3989,110 @@ static void WriteSimpleEntries(int col, int jul)
 /***************************************************************/
 static void WriteTopCalLine(void)
 {
-    gon();
-    DRAW(br);
-    PrintCentered("", CalWidth-2, linestruct->lr);
-    DRAW(bl);
-    goff();
-    putchar('\n');
+    OutDBuf(&TopLine);
 }
 
 static void WriteBottomCalLine(void)
 {
-    int i;
-    gon();
-    DRAW(tr);
-    for (i=0; i<7; i++) {
-	PrintCentered("", ColSpaces, linestruct->lr);
-	if (i != 6) {
-	    DRAW(tlr);
-	} else {
-	    DRAW(tl);
-	}
-    }
-    goff();
-    putchar('\n');
+    OutDBuf(&BottomLine);
 }
 
 static void WritePostHeaderLine(void)
 {
-    int i;
-    gon();
-    DRAW(tbr);
-    for (i=0; i<7; i++) {
-	PrintCentered("", ColSpaces, linestruct->lr);
-	if (i != 6) {
-	    DRAW(blr);
-	} else {
-	    DRAW(tbl);
-	}
-    }
-    goff();
-    putchar('\n');
+    OutDBuf(&PostHeaderLine);
 }
 
 static void WriteWeekHeaderLine(void)
 {
-    int i;
-    gon();
-    DRAW(br);
+    OutDBuf(&WeekHeaderLine);
+}
+
+static void WriteIntermediateCalLine(void)
+{
+    OutDBuf(&IntermediateLine);
+}
+
+static void WriteColSep(void)
+{
+    OutDBuf(&ColSep);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  BuildCalLines                                              */
+/*                                                             */
+/*  The horizontal rules and the column separator are the same */
+/*  all through a calendar, so build them just once.           */
+/*                                                             */
+/***************************************************************/
+static void BuildRule(DynamicBuffer *dbuf, char const *left,
+		      char const *mid, char const *right)
+{
+    int i, j;
+
+    DBufFree(dbuf);
+    DBufPuts(dbuf, linestruct->graphics_on);
+    DBufPuts(dbuf, left);
     for (i=0; i<7; i++) {
-	PrintCentered("", ColSpaces, linestruct->lr);
-	if (i != 6) {
-	    DRAW(blr);
-	} else {
-	    DRAW(bl);
+	for (j=0; j<ColSpaces; j++) {
+	    DBufPuts(dbuf, linestruct->lr);
 	}
+	DBufPuts(dbuf, (i != 6) ? mid : right);
     }
-    goff();
-    putchar('\n');
+    DBufPuts(dbuf, linestruct->graphics_off);
+    DBufPutc(dbuf, '\n');
 }
 
-static void WriteIntermediateCalLine(void)
+static void BuildCalLines(void)
+{
+    struct line_drawing *l = linestruct;
+
+    DBufFree(&ColSep);
+    DBufPuts(&ColSep, l->graphics_on);
+    DBufPuts(&ColSep, l->tb);
+    DBufPuts(&ColSep, l->graphics_off);
+
+    /* The top line has no column breaks, but is as wide as the others */
+    BuildRule(&TopLine, l->br, l->lr, l->bl);
+    BuildRule(&BottomLine, l->tr, l->tlr, l->tl);
+    BuildRule(&PostHeaderLine, l->tbr, l->blr, l->tbl);
+    BuildRule(&WeekHeaderLine, l->br, l->blr, l->bl);
+    BuildRule(&IntermediateLine, l->tbr, l->tblr, l->tbl);
+}
+
+#ifdef USE_THREADS
+/* Free what a worker thread's BuildCalLines and columns allocated */
+static void FreeCalState(void)
 {
     int i;
 
-    gon();
-    DRAW(tbr);
+    DBufFree(&ColSep);
+    DBufFree(&TopLine);
+    DBufFree(&BottomLine);
+    DBufFree(&PostHeaderLine);
+    DBufFree(&WeekHeaderLine);
+    DBufFree(&IntermediateLine);
     for (i=0; i<7; i++) {
-	PrintCentered("", ColSpaces, linestruct->lr);
-	if (i != 6) {
-	    DRAW(tblr);
-	} else {
-	    DRAW(tbl);
-	}
+	free(CalColumn[i].entries);
+	CalColumn[i].entries = NULL;
+	CalColumn[i].size = 0;
     }
-    goff();
-    putchar('\n');
+    ArenaFree(&CalArena);
 }
+#endif
 
 static void WriteCalDays(void)
 {
     int i;
-    gon();
-    DRAW(tb);
-    goff();
+    WriteColSep();
     for (i=0; i<7; i++) {
-	if (!MondayFirst)
-	    PrintCentered(get_day_name((i+6)%7), ColSpaces, " ");
+	if (!Ctx->MondayFirst)
+	    PrintCentered(get_day_name((i+6)%7), ColSpaces, ' ');
 	else
-	    PrintCentered(get_day_name(i%7), ColSpaces, " ");
-	gon();
-	DRAW(tb);
-	goff();
+	    PrintCentered(get_day_name(i%7), ColSpaces, ' ');
+	WriteColSep();
     }
-    putchar('\n');
+    OutPutc('\n');
 }
 
 /***************************************************************/
@@ -2544,7 +4108,7 @@ static void WriteCalDays(void)
 char const *
 CalendarTime(int tim, int duration)
 {
-    static char buf[128];
+    static THREAD_LOCAL char buf[128];
     int h, min, hh;
     int h2, min2, hh2, newtim, days;
     char const *ampm1;
@@ -2585,14 +4149,14 @@ CalendarTime(int tim, int duration)
     }
 
     if (h >= 12) {
-	ampm1 = DynamicPm;
+	ampm1 = Ctx->DynamicPm;
     } else {
-	ampm1 = DynamicAm;
+	ampm1 = Ctx->DynamicAm;
     }
     if (h2 >= 12) {
-	ampm2 = DynamicPm;
+	ampm2 = Ctx->DynamicPm;
     } else {
-	ampm2 = DynamicAm;
+	ampm2 = Ctx->DynamicAm;
     }
     if (!days) {
 	if (!strcmp(ampm1, ampm2)) {
@@ -2600,15 +4164,15 @@ CalendarTime(int tim, int duration)
 	}
     }
 
-    switch(ScFormat) {
+    switch(Ctx->ScFormat) {
     case SC_AMPM:
 	sprintf(buf, "%d%c%02d%s-%d%c%02d%s%s ",
-		hh, TimeSep, min, ampm1, hh2, TimeSep, min2, ampm2, daybuf);
+		hh, Ctx->TimeSep, min, ampm1, hh2, Ctx->TimeSep, min2, ampm2, daybuf);
 	break;
 
     case SC_MIL:
 	sprintf(buf, "%02d%c%02d-%02d%c%02d%s ",
-		h, TimeSep, min, h2, TimeSep, min2, daybuf);
+		h, Ctx->TimeSep, min, h2, Ctx->TimeSep, min2, daybuf);
 	break;
     }
     return buf;
@@ -2625,12 +4189,12 @@ CalendarTime(int tim, int duration)
 /***************************************************************/
 char const *SimpleTime(int tim)
 {
-    static char buf[32];
+    static THREAD_LOCAL char buf[32];
     int h, min, hh;
 
     buf[0] = 0;
 
-    switch(ScFormat) {
+    switch(Ctx->ScFormat) {
 
     case SC_AMPM:
 	if (tim != NO_TIME) {
@@ -2639,7 +4203,7 @@ char const *SimpleTime(int tim)
 	    if (h == 0) hh=12;
 	    else if (h > 12) hh=h-12;
 	    else hh=h;
-	    sprintf(buf, "%d%c%02d%s ", hh, TimeSep, min, (h>=12) ? DynamicPm : DynamicAm);
+	    sprintf(buf, "%d%c%02d%s ", hh, Ctx->TimeSep, min, (h>=12) ? Ctx->DynamicPm : Ctx->DynamicAm);
 	}
 	break;
 
@@ -2647,7 +4211,7 @@ char const *SimpleTime(int tim)
 	if (tim != NO_TIME) {
 	    h = tim / 60;
 	    min = tim % 60;
-	    sprintf(buf, "%02d%c%02d ", h, TimeSep, min);
+	    sprintf(buf, "%02d%c%02d ", h, Ctx->TimeSep, min);
 	}
 	break;
     }
@@ -2656,38 +4220,107 @@ char const *SimpleTime(int tim)
 
 /***************************************************************/
 /*                                                             */
-/*  SortCol                                                    */
+/*  AddToCol                                                   */
 /*                                                             */
-/*  Sort the calendar entries in a column by time and priority */
+/*  Append an entry to a column.                               */
+/*                                                             */
+/***************************************************************/
+static int AddToCol(CalCell *col, CalEntry *e)
+{
+    CalEntry **entries;
+    int size;
+
+    if (col->num == col->size) {
+	size = col->size ? 2*col->size : 16;
+	entries = realloc(col->entries, size * sizeof(CalEntry *));
+	if (!entries) return E_NO_MEM;
+	col->entries = entries;
+	col->size = size;
+    }
+    col->entries[col->num++] = e;
+    return OK;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  ClearCalColumns                                            */
+/*                                                             */
+/*  Discard all the entries once a row has been written.  The  */
+/*  entry arrays are kept for the next row.                    */
 /*                                                             */
 /***************************************************************/
-static void SortCol(CalEntry **col)
+static void ClearCalColumns(void)
+{
+    int i;
+    for (i=0; i<7; i++) {
+	CalColumn[i].num = 0;
+	CalColumn[i].cur = 0;
+    }
+    ArenaFree(&CalArena);
+}
+
+/* Return true if entry b must come before entry a, which precedes
+   it in file order.  Entries that compare equal keep file order. */
+static int ColShouldComeBefore(CalEntry const *b, CalEntry const *a)
 {
-    CalEntry *cur, *prev, *next;
+    return CompareRems(0, a->time, a->priority,
+		       0, b->time, b->priority,
+		       Ctx->SortByDate, Ctx->SortByTime, Ctx->SortByPrio, Ctx->UntimedBeforeTimed) < 0;
+}
+
+static void MergeSortEntries(CalEntry **e, CalEntry **tmp, int n)
+{
+    int mid = n/2;
+    int i = 0, j = mid, k = 0;
 
-    cur = *col;
-    prev = NULL;
+    if (n < 2) return;
+    MergeSortEntries(e, tmp, mid);
+    MergeSortEntries(e+mid, tmp, n-mid);
 
-/* Note that we use <= comparison rather than > comparison to preserve the
-   file order of reminders which have the same time and priority */
+    /* Already in order? */
+    if (!ColShouldComeBefore(e[mid], e[mid-1])) return;
 
-    while (cur->next &&
-	   CompareRems(0, cur->time, cur->priority,
-		       0, cur->next->time, cur->next->priority,
-		       SortByDate, SortByTime, SortByPrio, UntimedBeforeTimed) <= 0) {
-	next = cur->next;
-	/* Swap cur and next */
-	if (!prev) {
-	    *col = next;
-	    cur->next = next->next;
-	    next->next = cur;
-	    prev = next;
+    while (i < mid && j < n) {
+	if (ColShouldComeBefore(e[j], e[i])) {
+	    tmp[k++] = e[j++];
 	} else {
-	    prev->next = next;
-	    cur->next = next->next;
-	    next->next = cur;
-	    prev = next;
+	    tmp[k++] = e[i++];
+	}
+    }
+    while (i < mid) tmp[k++] = e[i++];
+    while (j < n)   tmp[k++] = e[j++];
+    memcpy(e, tmp, n * sizeof(CalEntry *));
+}
+
+/***************************************************************/
+/*                                                             */
+/*  SortCol                                                    */
+/*                                                             */
+/*  Sort the calendar entries in a column by time and priority */
+/*  with a stable merge sort, so that reminders with the same  */
+/*  time and priority stay in file order.                      */
+/*                                                             */
+/***************************************************************/
+static void SortCol(CalCell *col)
+{
+    CalEntry **tmp;
+    CalEntry *e;
+    int i, j;
+
+    if (col->num < 2) return;
+    tmp = ArenaAlloc(&CalArena, col->num * sizeof(CalEntry *));
+    if (tmp) {
+	MergeSortEntries(col->entries, tmp, col->num);
+	return;
+    }
+
+    /* No memory for the merge; fall back on insertion sort */
+    for (i=1; i<col->num; i++) {
+	e = col->entries[i];
+	for (j=i; j>0 && ColShouldComeBefore(e, col->entries[j-1]); j--) {
+	    col->entries[j] = col->entries[j-1];
 	}
+	col->entries[j] = e;
     }
 }
 
@@ -2695,9 +4328,9 @@ char const *SynthesizeTag(void)
 {
     struct MD5Context ctx;
     unsigned char buf[16];
-    static char out[128];
+    static THREAD_LOCAL char out[128];
     MD5Init(&ctx);
-    MD5Update(&ctx, (unsigned char *) CurLine, strlen(CurLine));
+    MD5Update(&ctx, (unsigned char *) Ctx->CurLine, strlen(Ctx->CurLine));
     MD5Final(buf, &ctx);
     sprintf(out, "__syn__%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x",
 	    (unsigned int) buf[0], (unsigned int) buf[1],
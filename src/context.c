@@ -0,0 +1,207 @@
+/***************************************************************/
+/*                                                             */
+/*  CONTEXT.C                                                  */
+/*                                                             */
+/*  Creating, destroying and switching between interpreter     */
+/*  contexts.                                                  */
+/*                                                             */
+/*  This file is part of REMIND.                               */
+/*  Copyright (C) 1992-2022 by Dianne Skoll                    */
+/*                                                             */
+/***************************************************************/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "types.h"
+#include "protos.h"
+#include "globals.h"
+#include "err.h"
+
+/***************************************************************/
+/*                                                             */
+/*  NewContext                                                 */
+/*                                                             */
+/*  Allocate a context holding the same state a fresh run of   */
+/*  Remind starts with.  Returns NULL if out of memory.        */
+/*                                                             */
+/***************************************************************/
+RemContext *NewContext(void)
+{
+    RemContext *ctx, *old;
+    int r;
+
+    ctx = calloc(1, sizeof(RemContext));
+    if (!ctx) return NULL;
+
+    ctx->AddBlankLines = 1;
+    ctx->Iterations = 1;
+    ctx->CalWidth = 80;
+    ctx->DefaultPrio = NO_PRIORITY;
+    ctx->SysTime = -1L;
+    ctx->EventsUntil = NO_DATE;
+    ctx->DateSep = DATESEP;
+    ctx->TimeSep = TIMESEP;
+    ctx->DateTimeSep = DATETIMESEP;
+    ctx->DefaultColorR = -1;
+    ctx->DefaultColorG = -1;
+    ctx->DefaultColorB = -1;
+    ctx->ScFormat = SC_AMPM;
+    ctx->MaxSatIter = 1000;
+    ctx->MaxStringLen = MAX_STR_LEN;
+    ctx->CalLines = CAL_LINES;
+    ctx->CalPad = 1;
+    ctx->TerminalBackground = TERMINAL_BACKGROUND_UNKNOWN;
+
+    ctx->Longitude = DEFAULT_LONGITUDE;
+    ctx->Latitude = DEFAULT_LATITUDE;
+    ctx->Location = LOCATION;
+    ctx->CalculateUTC = 1;
+
+    ctx->FormWidth = 72;
+    ctx->EndSent = ".?!";
+    ctx->EndSentIg = "\"')]}>";
+
+    ctx->SysDir = STRSYSDIR(SYSDIR);
+
+    ctx->CacheJul = -1;
+    ctx->CacheHebJul = -1;
+
+    DBufInit(&ctx->Banner);
+    DBufInit(&ctx->LineBuffer);
+    DBufInit(&ctx->ExprBuf);
+    DBufInit(&ctx->LastTrigger.tags);
+
+    /* The strings that SET can change must be ours to free; the
+       language's words and banner are copied in by SetLanguage */
+    old = SwitchContext(ctx);
+    r = InitSysVars();
+    if (!r) r = SetLanguage(DefaultLanguage());
+    SwitchContext(old);
+    if (r) {
+	FreeContext(ctx);
+	return NULL;
+    }
+    return ctx;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  CloneContext                                               */
+/*                                                             */
+/*  Allocate a copy of src, with its own copies of src's       */
+/*  settings, variables, functions and OMITs, for running the  */
+/*  same file in another thread.  The copy has nothing on its  */
+/*  INCLUDE stack, sorted or pushed.  Returns NULL if out of   */
+/*  memory.                                                    */
+/*                                                             */
+/***************************************************************/
+RemContext *CloneContext(RemContext const *src)
+{
+    RemContext *ctx, *old;
+    int r;
+
+    ctx = malloc(sizeof(RemContext));
+    if (!ctx) return NULL;
+    *ctx = *src;
+
+    /* Drop everything that belongs to src */
+    memset(ctx->VHashTbl, 0, sizeof(ctx->VHashTbl));
+    ctx->BaseVars = NULL;
+    memset(ctx->FuncHash, 0, sizeof(ctx->FuncHash));
+    ctx->SavedOmitContexts = NULL;
+    ctx->BaseOmits = NULL;
+    ctx->IStackPtr = 0;
+    ctx->fp = NULL;
+    ctx->CLine = NULL;
+    ctx->TableFile = NULL;
+    ctx->TableLines = NULL;
+    ctx->TableLinesSize = 0;
+    ctx->CurLine = NULL;
+    ctx->FileName = NULL;
+    ctx->PurgeFP = NULL;
+    ctx->SortBuf = NULL;
+    ctx->NumSortRems = 0;
+    ctx->SortBufSize = 0;
+    ArenaInit(&ctx->SortArena);
+    ctx->callstack = NULL;
+    ctx->ValStackPtr = 0;
+    ctx->OpStackPtr = 0;
+    ctx->LastTrigValid = 0;
+    DBufInit(&ctx->Banner);
+    DBufInit(&ctx->LineBuffer);
+    DBufInit(&ctx->ExprBuf);
+    DBufInit(&ctx->LastTrigger.tags);
+
+    old = SwitchContext(ctx);
+
+    /* The strings SET can change still point to src's; copy them.
+       If that fails, InitSysVars leaves them all NULL, so the copy
+       owns nothing of src's and FreeContext is safe. */
+    r = InitSysVars();
+    if (!r) r = DBufPuts(&ctx->Banner, DBufValue(&src->Banner));
+    if (!r) r = CopyVars(src);
+    if (!r) r = CopyBaseVars(src);
+    if (!r) r = CopyUserFuncs(src);
+    if (!r) r = CopyBaseOmits(src);
+    SwitchContext(old);
+    if (r) {
+	FreeContext(ctx);
+	return NULL;
+    }
+    return ctx;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  FreeContext                                                */
+/*                                                             */
+/*  Free a context and everything it owns: variables, user-    */
+/*  defined functions, saved OMIT contexts, the INCLUDE stack  */
+/*  and so on.                                                 */
+/*                                                             */
+/***************************************************************/
+void FreeContext(RemContext *ctx)
+{
+    RemContext *old;
+
+    if (!ctx) return;
+
+    old = SwitchContext(ctx);
+    DestroyVars(1);
+    DestroyBaseVars();
+    DestroyUserFuncs();
+    DestroyOmitContexts();
+    DestroyBaseOmits();
+    FreeSortBuffer();
+    clear_callstack();
+    DestroySysVars();
+    DBufFree(&ctx->Banner);
+    DBufFree(&ctx->LineBuffer);
+    DBufFree(&ctx->ExprBuf);
+    DBufFree(&ctx->LastTrigger.tags);
+    ClearIncludeStack();
+    free(ctx->FileName);
+    free(ctx->TableLines);
+    free(ctx->TableFile);
+    SwitchContext(old == ctx ? NULL : old);
+
+    free(ctx);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  SwitchContext                                              */
+/*                                                             */
+/*  Make ctx the current context and return the previous one.  */
+/*                                                             */
+/***************************************************************/
+RemContext *SwitchContext(RemContext *ctx)
+{
+    RemContext *old = Ctx;
+    Ctx = ctx;
+    return old;
+}
@@ -0,0 +1,224 @@
+/***************************************************************/
+/*                                                             */
+/*  CONTEXT.H                                                  */
+/*                                                             */
+/*  The state of one Remind interpreter: options, the date     */
+/*  being evaluated, variables, user-defined functions,        */
+/*  OMITs, the INCLUDE stack and so on.  All of it is reached  */
+/*  through Ctx, so several interpreters can live in one       */
+/*  process; see context.c.                                    */
+/*                                                             */
+/*  This file is part of REMIND.                               */
+/*  Copyright (C) 1992-2022 by Dianne Skoll                    */
+/*                                                             */
+/***************************************************************/
+
+#ifndef CONTEXT_H
+#define CONTEXT_H
+
+#include <stdio.h>
+#include "arena.h"
+
+/* The variable hash table */
+#define VAR_HASH_SIZE 64
+
+/* Size of User-defined function hash table */
+#define FUNC_HASH_SIZE 32
+
+typedef struct RemContext {
+    /* The date being evaluated and the position in the input */
+    int		JulianToday;
+    int		RealToday;
+    int		CurDay;
+    int		CurMon;
+    int		CurYear;
+    int		LineNo;
+    int		FreshLine;
+    char const	*CurLine;
+    char	*FileName;
+    char const	*InitialFile;
+    int		FileAccessDate;
+    int		UseStdin;
+
+    /* Options */
+    char const	*MsgCommand;
+    int		ShowAllErrors;
+    int		DebugFlag;
+    int		DoCalendar;
+    int		DoSimpleCalendar;
+    int		DoSimpleCalDelta;
+    int		DoPrefixLineNo;
+    int		MondayFirst;
+    int		AddBlankLines;
+    int		Iterations;
+    int		PsCal;
+    int		PsCalBinary;
+    int		HtmlCal;
+    int		CalWidth;
+    int		CalWeeks;
+    int		CalMonths;
+    int		CalThreads;
+    int		CalProcesses;
+    int		Hush;
+    int		NextMode;
+    int		InfiniteDelta;
+    int		DefaultTDelta;
+    int		DeltaOffset;
+    int		RunDisabled;
+    int		IgnoreOnce;
+    int		SortByTime;
+    int		SortByDate;
+    int		SortByPrio;
+    int		UntimedBeforeTimed;
+    int		DefaultPrio;
+    long	SysTime;
+    int		WeekdayOmits;
+    int		DontSuppressQuoteMarkers;
+    int		DontFork;
+    int		DontQueue;
+    int		TrapExit;
+    int		NumQueued;
+    int		DontIssueAts;
+    int		Daemon;
+    int		EventsUntil;
+    int		DoICalendar;
+    char	*TableFile;
+    char	DateSep;
+    char	TimeSep;
+    char	DateTimeSep;
+    int		DefaultColorR;
+    int		DefaultColorB;
+    int		DefaultColorG;
+    int		SynthesizeTags;
+    int		ScFormat;
+    int		MaxSatIter;
+    int		MaxStringLen;
+    int		PurgeMode;
+    int		PurgeIncludeDepth;
+    FILE	*PurgeFP;
+    int		ShouldCache;
+    int		CalLines;
+    int		CalPad;
+    int		UseVTChars;
+    int		UseBGVTColors;
+    int		UseUTF8Chars;
+    int		UseVTColors;
+    int		Use256Colors;
+    int		UseTrueColors;
+    int		TerminalBackground;
+    int		SuppressLRM;
+
+    /* IF nesting and the most recent trigger */
+    int		NumIfs;
+    unsigned int IfFlags;
+    int		LastTrigValid;
+    Trigger	LastTrigger;
+    TimeTrig	LastTimeTrig;
+    int		LastTriggerDate;
+    int		LastTriggerTime;
+    int		NumTriggered;
+    int		DidMsgReminder;
+
+    /* Set by EXIT when TrapExit keeps it from ending the program */
+    int		Exited;
+    int		ExitStatus;
+
+    /* Latitude and longitude */
+    int		LatDeg;
+    int		LatMin;
+    int		LatSec;
+    int		LongDeg;
+    int		LongMin;
+    int		LongSec;
+    double	Longitude;
+    double	Latitude;
+    char	*Location;
+
+    /* UTC calculation stuff */
+    int		MinsFromUTC;
+    int		CalculateUTC;
+    int		FoldYear;
+
+    /* Parameters for formatting MSGF reminders */
+    int		FormWidth;
+    int		FirstIndent;
+    int		SubsIndent;
+    char	*EndSent;
+    char	*EndSentIg;
+
+    DynamicBuffer Banner;
+    DynamicBuffer LineBuffer;
+    DynamicBuffer ExprBuf;
+
+    /* The language, and names that may be changed with SET $Monday
+       and the like, which start out as the language's */
+    LangTable const *Lang;
+    char	*DynamicMonthName[12];
+    char	*DynamicDayName[7];
+    char	*DynamicAgo;
+    char	*DynamicAm;
+    char	*DynamicAnd;
+    char	*DynamicAt;
+    char	*DynamicFromnow;
+    char	*DynamicHour;
+    char	*DynamicHplu;
+    char	*DynamicIs;
+    char	*DynamicMinute;
+    char	*DynamicMplu;
+    char	*DynamicNow;
+    char	*DynamicOn;
+    char	*DynamicPm;
+    char	*DynamicToday;
+    char	*DynamicTomorrow;
+    char	*DynamicWas;
+    char	*SysDir;
+
+    /* Expression evaluation stacks (expr.c) */
+    Value	ValStack[VAL_STACK_SIZE];
+    int		ValStackPtr;
+    Operator	OpStack[OP_STACK_SIZE];
+    int		OpStackPtr;
+
+    /* Variables (var.c) and user-defined functions (userfns.c) */
+    Var		*VHashTbl[VAR_HASH_SIZE];
+    Var		*BaseVars;
+    struct udf_struct *FuncHash[FUNC_HASH_SIZE];
+
+    /* Global OMITs (omit.c) */
+    int		FullOmitArray[MAX_FULL_OMITS];
+    int		PartialOmitArray[MAX_PARTIAL_OMITS];
+    int		NumFullOmits;
+    int		NumPartialOmits;
+    struct omitcontext *SavedOmitContexts;
+    struct omitcontext *BaseOmits;
+
+    /* The INCLUDE stack (files.c) */
+    IncludeStruct IStack[INCLUDE_NEST];
+    int		IStackPtr;
+    FILE	*fp;
+    CachedLine	*CLine;
+
+    /* The lines of a compiled table being read (table.c) */
+    CachedLine	*TableLines;
+    int		TableLinesSize;
+
+    /* The sort buffer (sort.c) */
+    struct sortrem *SortBuf;
+    int		NumSortRems;
+    int		SortBufSize;
+    Arena	SortArena;
+
+    /* Call stack for error messages (utils.c) */
+    struct cs_s *callstack;
+
+    /* Date conversion caches and one-time warnings (funcs.c) */
+    int		CacheJul;
+    int		CacheYear, CacheMon, CacheDay;
+    int		CacheHebJul;
+    int		CacheHebYear, CacheHebMon, CacheHebDay;
+    int		psshade_warned;
+    int		psmoon_warned;
+    int		LastTrig;
+} RemContext;
+
+#endif /* CONTEXT_H */
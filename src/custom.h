@@ -154,6 +154,17 @@
 /*---------------------------------------------------------------------*/
 #define CAL_LINES 5
 
+/*---------------------------------------------------------------------*/
+/* How many clients can be connected to the server-mode socket?        */
+/*---------------------------------------------------------------------*/
+#define MAX_SERVER_CLIENTS 64
+
+/*---------------------------------------------------------------------*/
+/* How many threads or processes may --threads or --processes use to   */
+/* produce a calendar?                                                 */
+/*---------------------------------------------------------------------*/
+#define MAX_CAL_WORKERS 64
+
 /*---------------------------------------------------------------------*/
 /* Don't change the next definitions                                   */
 /*---------------------------------------------------------------------*/
@@ -171,6 +182,46 @@
 #define PSBEGIN2 "# rem2ps2 begin"
 #define PSEND2   "# rem2ps2 end"
 
+/* Binary interchange format written by remind -pb and read by rem2ps.
+   The stream starts with PSBIN_MAGIC and a 4-byte version number.
+   Then come records, each a 1-byte type and a 4-byte length followed
+   by that many bytes of data.  Integers are 4 bytes, little-endian;
+   strings are a 4-byte length followed by the characters.
+
+   PSBIN_MONTH:  month name, year, days in month, weekday of the 1st,
+                 Monday-first flag, 7 day names starting with Sunday,
+                 previous month's name and length, next month's name
+                 and length
+   PSBIN_ENTRY:  day, time, duration, passthru, tags, body, file name,
+                 line number
+   PSBIN_END:    no data; ends the month
+
+   Readers skip records of types they don't know. */
+#define PSBIN_MAGIC     "\x89REMIND\n"
+#define PSBIN_MAGIC_LEN 8
+#define PSBIN_VERSION   1
+#define PSBIN_MONTH     'M'
+#define PSBIN_ENTRY     'E'
+#define PSBIN_END       'Z'
+
+/* Compiled table written by remind --compile and read by INCLUDE.
+   Integers are 4 bytes, little-endian; strings are a 4-byte length
+   followed by the characters and a terminating NUL.  Dates are days
+   since 1 January of BASE.  After TABLE_MAGIC come:
+
+   version, BASE, first and last dates compiled, weekday OMIT mask
+   (bit 0 is Monday)
+   number of partial OMITs, then each as (month-1)*32 + day, sorted
+   number of full OMITs, then each date, sorted
+   number of REM commands, then for each:  its line number in the
+   original file, its number of runs, and for each run in order:
+   the first date of the run and the REM command, with a literal
+   date, that the original triggers on each date until the next
+   run starts ("" for nothing) */
+#define TABLE_MAGIC     "\x89REMTBL\n"
+#define TABLE_MAGIC_LEN 8
+#define TABLE_VERSION   1
+
 #if defined(HAVE_MBSTOWCS) && defined(HAVE_WCTYPE_H)
 #define REM_USE_WCHAR 1
 #else
@@ -68,13 +68,13 @@ int DoRem(ParsePtr p)
     }
 
     if (trig.typ == NO_TYPE) {
-	PurgeEchoLine("%s\n%s\n", "#!P! Cannot parse next line", CurLine);
+	PurgeEchoLine("%s\n%s\n", "#!P! Cannot parse next line", Ctx->CurLine);
 	FreeTrig(&trig);
 	return E_EOLN;
     }
     if (trig.typ == SAT_TYPE) {
 	PurgeEchoLine("%s\n", "#!P: Cannot purge SATISFY-type reminders");
-	PurgeEchoLine("%s\n", CurLine);
+	PurgeEchoLine("%s\n", Ctx->CurLine);
 	r=DoSatRemind(&trig, &tim, p);
 	if (r) {
             if (r == E_CANT_TRIG && trig.maybe_uncomputable) {
@@ -84,7 +84,7 @@ int DoRem(ParsePtr p)
 	    if (r == E_EXPIRED) return OK;
 	    return r;
 	}
-	if (!LastTrigValid) {
+	if (!Ctx->LastTrigValid) {
 	    FreeTrig(&trig);
 	    return OK;
 	}
@@ -98,7 +98,7 @@ int DoRem(ParsePtr p)
 	if (tok.type == T_Empty || tok.type == T_Comment) {
             r = OK;
             if (trig.addomit) {
-                r = AddGlobalOmit(LastTriggerDate);
+                r = AddGlobalOmit(Ctx->LastTriggerDate);
             }
 	    DBufFree(&buf);
 	    FreeTrig(&trig);
@@ -124,8 +124,8 @@ int DoRem(ParsePtr p)
 	    DBufFree(&buf);
 	}
 	trig.typ = tok.val;
-	jul = LastTriggerDate;
-	if (!LastTrigValid || PurgeMode) {
+	jul = Ctx->LastTriggerDate;
+	if (!Ctx->LastTrigValid || Ctx->PurgeMode) {
 	    FreeTrig(&trig);
 	    return OK;
 	}
@@ -133,9 +133,9 @@ int DoRem(ParsePtr p)
 	/* Calculate the trigger date */
 	jul = ComputeTrigger(trig.scanfrom, &trig, &tim, &r, 1);
 	if (r) {
-	    if (PurgeMode) {
+	    if (Ctx->PurgeMode) {
 		PurgeEchoLine("%s: %s\n", "#!P! Problem calculating trigger date", ErrMsg[r]);
-		PurgeEchoLine("%s\n", CurLine);
+		PurgeEchoLine("%s\n", Ctx->CurLine);
 	    }
             if (r == E_CANT_TRIG && trig.maybe_uncomputable) {
                 r = OK;
@@ -153,34 +153,34 @@ int DoRem(ParsePtr p)
             return r;
         }
     }
-    if (PurgeMode) {
-	if (trig.expired || jul < JulianToday) {
+    if (Ctx->PurgeMode) {
+	if (trig.expired || jul < Ctx->JulianToday) {
 	    if (p->expr_happened) {
 		if (p->nonconst_expr) {
 		    PurgeEchoLine("%s\n", "#!P: Next line may have expired, but contains non-constant expression");
-		    PurgeEchoLine("%s\n", CurLine);
+		    PurgeEchoLine("%s\n", Ctx->CurLine);
 		} else {
 		    PurgeEchoLine("%s\n", "#!P: Next line has expired, but contains expression...  please verify");
-		    PurgeEchoLine("#!P: Expired: %s\n", CurLine);
+		    PurgeEchoLine("#!P: Expired: %s\n", Ctx->CurLine);
 		}
 	    } else {
-		PurgeEchoLine("#!P: Expired: %s\n", CurLine);
+		PurgeEchoLine("#!P: Expired: %s\n", Ctx->CurLine);
 	    }
 	} else {
-	    PurgeEchoLine("%s\n", CurLine);
+	    PurgeEchoLine("%s\n", Ctx->CurLine);
 	}
 	FreeTrig(&trig);
 	return OK;
     }
 
     /* Queue the reminder, if necessary */
-    if (jul == JulianToday &&
-	!(!IgnoreOnce &&
+    if (jul == Ctx->JulianToday &&
+	!(!Ctx->IgnoreOnce &&
 	  trig.once != NO_ONCE &&
-	  FileAccessDate == JulianToday))
+	  Ctx->FileAccessDate == Ctx->JulianToday))
 	QueueReminder(p, &trig, &tim, trig.sched);
     /* If we're in daemon mode, do nothing over here */
-    if (Daemon) {
+    if (Ctx->Daemon) {
 	FreeTrig(&trig);
 	return OK;
     }
@@ -237,7 +237,7 @@ int ParseRem(ParsePtr s, Trigger *trig, TimeTrig *tim, int save_in_globals)
     trig->typ = NO_TYPE;
     trig->scanfrom = NO_DATE;
     trig->from = NO_DATE;
-    trig->priority = DefaultPrio;
+    trig->priority = Ctx->DefaultPrio;
     trig->sched[0] = 0;
     trig->warn[0] = 0;
     trig->omitfunc[0] = 0;
@@ -248,14 +248,14 @@ int ParseRem(ParsePtr s, Trigger *trig, TimeTrig *tim, int save_in_globals)
     DBufInit(&(trig->tags));
     trig->passthru[0] = 0;
     tim->ttime = NO_TIME;
-    tim->delta = DefaultTDelta;
+    tim->delta = Ctx->DefaultTDelta;
     tim->rep   = NO_REP;
     tim->duration = NO_TIME;
     trig->need_wkday = 0;
     trig->adj_for_last = 0;
 
     if (save_in_globals) {
-	LastTriggerTime = NO_TIME;
+	Ctx->LastTriggerTime = NO_TIME;
     }
 
     int parsing = 1;
@@ -308,7 +308,7 @@ int ParseRem(ParsePtr s, Trigger *trig, TimeTrig *tim, int save_in_globals)
 	    trig->d = d;
 	    tim->ttime = (tok.val % MINUTES_PER_DAY);
 	    if (save_in_globals) {
-		LastTriggerTime = tim->ttime;
+		Ctx->LastTriggerTime = tim->ttime;
 		SaveLastTimeTrig(tim);
 	    }
 	    break;
@@ -573,7 +573,7 @@ int ParseRem(ParsePtr s, Trigger *trig, TimeTrig *tim, int save_in_globals)
 
     /* Set scanfrom to default if not set explicitly */
     if (trig->scanfrom == NO_DATE) {
-        trig->scanfrom = JulianToday;
+        trig->scanfrom = Ctx->JulianToday;
     }
 
     return OK;
@@ -621,7 +621,7 @@ static int ParseTimeTrig(ParsePtr s, TimeTrig *tim, int save_in_globals)
 
 	    /* Save trigger time in global variable */
 	    if (save_in_globals) {
-		LastTriggerTime = tim->ttime;
+		Ctx->LastTriggerTime = tim->ttime;
 		SaveLastTimeTrig(tim);
 	    }
 	    PushToken(DBufValue(&buf), s);
@@ -848,7 +848,7 @@ static int ParseScanFrom(ParsePtr s, Trigger *t, int type)
 	    if (tok.val < 0) {
 		tok.val = -tok.val;
 	    }
-	    FromJulian(JulianToday - tok.val, &y, &m, &d);
+	    FromJulian(Ctx->JulianToday - tok.val, &y, &m, &d);
 	    break;
 
 	default:
@@ -864,8 +864,8 @@ static int ParseScanFrom(ParsePtr s, Trigger *t, int type)
 	    t->scanfrom = Julian(y, m, d);
 	    if (type == FROM_TYPE) {
 		t->from = t->scanfrom;
-		if (t->scanfrom < JulianToday) {
-		    t->scanfrom = JulianToday;
+		if (t->scanfrom < Ctx->JulianToday) {
+		    t->scanfrom = Ctx->JulianToday;
 		}
 	    } else {
 		t->from = NO_DATE;
@@ -902,7 +902,7 @@ int TriggerReminder(ParsePtr p, Trigger *t, TimeTrig *tim, int jul)
     DBufInit(&buf);
     DBufInit(&calRow);
     DBufInit(&pre_buf);
-    if (t->typ == RUN_TYPE && RunDisabled) return E_RUN_DISABLED;
+    if (t->typ == RUN_TYPE && Ctx->RunDisabled) return E_RUN_DISABLED;
     if ((t->typ == PASSTHRU_TYPE && StrCmpi(t->passthru, "COLOR") && StrCmpi(t->passthru, "COLOUR")) ||
 	t->typ == CAL_TYPE ||
 	t->typ == PS_TYPE ||
@@ -914,7 +914,7 @@ int TriggerReminder(ParsePtr p, Trigger *t, TimeTrig *tim, int jul)
 	/* Strip off three tokens */
 	r = ParseToken(p, &buf);
 	sscanf(DBufValue(&buf), "%d", &red);
-	if (!NextMode) {
+	if (!Ctx->NextMode) {
 	    DBufPuts(&pre_buf, DBufValue(&buf));
 	    DBufPutc(&pre_buf, ' ');
 	}
@@ -922,7 +922,7 @@ int TriggerReminder(ParsePtr p, Trigger *t, TimeTrig *tim, int jul)
 	if (r) return r;
 	r = ParseToken(p, &buf);
 	sscanf(DBufValue(&buf), "%d", &green);
-	if (!NextMode) {
+	if (!Ctx->NextMode) {
 	    DBufPuts(&pre_buf, DBufValue(&buf));
 	    DBufPutc(&pre_buf, ' ');
 	}
@@ -930,7 +930,7 @@ int TriggerReminder(ParsePtr p, Trigger *t, TimeTrig *tim, int jul)
 	if (r) return r;
 	r = ParseToken(p, &buf);
 	sscanf(DBufValue(&buf), "%d", &blue);
-	if (!NextMode) {
+	if (!Ctx->NextMode) {
 	    DBufPuts(&pre_buf, DBufValue(&buf));
 	    DBufPutc(&pre_buf, ' ');
 	}
@@ -940,10 +940,10 @@ int TriggerReminder(ParsePtr p, Trigger *t, TimeTrig *tim, int jul)
     }
 /* If it's a MSG-type reminder, and no -k option was used, issue the banner. */
     if ((t->typ == MSG_TYPE || t->typ == MSF_TYPE) 
-	&& !DidMsgReminder && !NextMode && !MsgCommand) {
-        DidMsgReminder = 1;
-	if (!DoSubstFromString(DBufValue(&Banner), &buf,
-			       JulianToday, NO_TIME) &&
+	&& !Ctx->DidMsgReminder && !Ctx->NextMode && !Ctx->MsgCommand) {
+        Ctx->DidMsgReminder = 1;
+	if (!DoSubstFromString(DBufValue(&Ctx->Banner), &buf,
+			       Ctx->JulianToday, NO_TIME) &&
 	    DBufLen(&buf)) {
             printf("%s\n", DBufValue(&buf));
         }
@@ -952,7 +952,7 @@ int TriggerReminder(ParsePtr p, Trigger *t, TimeTrig *tim, int jul)
 
 /* If it's NextMode, process as a ADVANCE_MODE-type entry, and issue
    simple-calendar format. */
-    if (NextMode) {
+    if (Ctx->NextMode) {
 	if ( (r=DoSubst(p, &buf, t, tim, jul, ADVANCE_MODE)) ) return r;
 	if (!DBufLen(&buf)) {
 	    DBufFree(&buf);
@@ -967,7 +967,7 @@ int TriggerReminder(ParsePtr p, Trigger *t, TimeTrig *tim, int jul)
  	    return E_NO_MEM;
  	}
  	/* If DoSimpleCalendar==1, output *all* simple calendar fields */
- 	if (DoSimpleCalendar) {
+ 	if (Ctx->DoSimpleCalendar) {
  	    /* ignore passthru field when in NextMode */
  	    if (DBufPuts(&calRow, "* ") != OK) {
  		DBufFree(&calRow);
@@ -1015,12 +1015,12 @@ int TriggerReminder(ParsePtr p, Trigger *t, TimeTrig *tim, int jul)
     }
 
     /* Correct colors */
-    if (UseVTColors) {
+    if (Ctx->UseVTColors) {
 	if (red == -1 && green == -1 && blue == -1) {
-	    if (DefaultColorR != -1 && DefaultColorG != -1 && DefaultColorB != -1) {
-		red = DefaultColorR;
-		green = DefaultColorG;
-		blue = DefaultColorB;
+	    if (Ctx->DefaultColorR != -1 && Ctx->DefaultColorG != -1 && Ctx->DefaultColorB != -1) {
+		red = Ctx->DefaultColorR;
+		green = Ctx->DefaultColorG;
+		blue = Ctx->DefaultColorB;
 	    }
 	}
 	if (red >= 0 && green >= 0 && blue >= 0) {
@@ -1084,7 +1084,7 @@ int TriggerReminder(ParsePtr p, Trigger *t, TimeTrig *tim, int jul)
 	DBufPuts(&buf, Decolorize());
     }
 
-    if ((!MsgCommand && t->typ == MSG_TYPE) || t->typ == MSF_TYPE) {
+    if ((!Ctx->MsgCommand && t->typ == MSG_TYPE) || t->typ == MSF_TYPE) {
 	if (DBufPutc(&buf, '\n') != OK) {
 	    DBufFree(&buf);
 	    return E_NO_MEM;
@@ -1092,11 +1092,11 @@ int TriggerReminder(ParsePtr p, Trigger *t, TimeTrig *tim, int jul)
     }
 
 /* If we are sorting, just queue it up in the sort buffer */
-    if (SortByDate) {
+    if (Ctx->SortByDate) {
 	if (InsertIntoSortBuffer(jul, tim->ttime, DBufValue(&buf),
 				 t->typ, t->priority) == OK) {
 	    DBufFree(&buf);
-	    NumTriggered++;
+	    Ctx->NumTriggered++;
 	    return OK;
 	}
     }
@@ -1106,8 +1106,8 @@ int TriggerReminder(ParsePtr p, Trigger *t, TimeTrig *tim, int jul)
     switch(t->typ) {
     case MSG_TYPE:
     case PASSTHRU_TYPE:
-	if (MsgCommand) {
-	    DoMsgCommand(MsgCommand, DBufValue(&buf));
+	if (Ctx->MsgCommand) {
+	    DoMsgCommand(Ctx->MsgCommand, DBufValue(&buf));
 	} else {
 	    printf("%s", DBufValue(&buf));
 	}
@@ -1127,7 +1127,7 @@ int TriggerReminder(ParsePtr p, Trigger *t, TimeTrig *tim, int jul)
     }
 
     DBufFree(&buf);
-    NumTriggered++;
+    Ctx->NumTriggered++;
     return OK;
 }
 
@@ -1146,15 +1146,15 @@ int ShouldTriggerReminder(Trigger *t, TimeTrig *tim, int jul, int *err)
     *err = 0;
 
     /* Handle the ONCE modifier in the reminder. */
-    if (!IgnoreOnce && t->once !=NO_ONCE && FileAccessDate == JulianToday)
+    if (!Ctx->IgnoreOnce && t->once !=NO_ONCE && Ctx->FileAccessDate == Ctx->JulianToday)
 	return 0;
 
-    if (jul < JulianToday) return 0;
+    if (jul < Ctx->JulianToday) return 0;
 
     /* Don't trigger timed reminders if DontIssueAts is true, and if the
        reminder is for today */
-    if (jul == JulianToday && DontIssueAts && tim->ttime != NO_TIME) {
-	if (DontIssueAts > 1) {
+    if (jul == Ctx->JulianToday && Ctx->DontIssueAts && tim->ttime != NO_TIME) {
+	if (Ctx->DontIssueAts > 1) {
 	    /* If two or more -a options, then *DO* issue ats that are in the
 	       future */
 	    if (tim->ttime < SystemTime(0) / 60) {
@@ -1173,12 +1173,12 @@ int ShouldTriggerReminder(Trigger *t, TimeTrig *tim, int jul, int *err)
   *** ...UNTIL HERE */
 
     /* If "infinite delta" option is chosen, always trigger future reminders */
-    if (InfiniteDelta || NextMode) return 1;
+    if (Ctx->InfiniteDelta || Ctx->NextMode) return 1;
 
     /* If there's a "warn" function, it overrides any deltas */
     if (t->warn[0] != 0) {
-	if (DeltaOffset) {
-	    if (jul <= JulianToday + DeltaOffset) {
+	if (Ctx->DeltaOffset) {
+	    if (jul <= Ctx->JulianToday + Ctx->DeltaOffset) {
 		return 1;
 	    }
 	}
@@ -1191,11 +1191,11 @@ int ShouldTriggerReminder(Trigger *t, TimeTrig *tim, int jul, int *err)
 	    jul = jul + t->delta;
 	else {
 	    int iter = 0;
-	    int max = MaxSatIter;
+	    int max = Ctx->MaxSatIter;
 	    r = t->delta;
 	    if (max < r*2) max = r*2;
 	    while(iter++ < max) {
-		if (!r || (jul <= JulianToday)) {
+		if (!r || (jul <= Ctx->JulianToday)) {
 		    break;
 		}
 		jul--;
@@ -1212,7 +1212,7 @@ int ShouldTriggerReminder(Trigger *t, TimeTrig *tim, int jul, int *err)
     }
 
     /* Should we trigger the reminder? */
-    return (jul <= JulianToday + DeltaOffset);
+    return (jul <= Ctx->JulianToday + Ctx->DeltaOffset);
 }
 
 /***************************************************************/
@@ -1232,7 +1232,7 @@ int DoSatRemind(Trigger *trig, TimeTrig *tt, ParsePtr p)
     t = p->pos;
     iter = 0;
     start = trig->scanfrom;
-    while (iter++ < MaxSatIter) {
+    while (iter++ < Ctx->MaxSatIter) {
 	jul = ComputeTriggerNoAdjustDuration(start, trig, tt, &r, 1, 0);
 	if (r) {
 	    if (r == E_CANT_TRIG) return OK; else return r;
@@ -1262,12 +1262,12 @@ int DoSatRemind(Trigger *trig, TimeTrig *tt, ParsePtr p)
 	if ((v.type == INT_TYPE && v.v.val) ||
 	    (v.type == STR_TYPE && *v.v.str)) {
 	    AdjustTriggerForDuration(trig->scanfrom, jul, trig, tt, 1);
-	    if (DebugFlag & DB_PRTTRIG) {
+	    if (Ctx->DebugFlag & DB_PRTTRIG) {
 		int y, m, d;
-		FromJulian(LastTriggerDate, &y, &m, &d);
+		FromJulian(Ctx->LastTriggerDate, &y, &m, &d);
 		fprintf(ErrFp, "%s(%d): Trig(satisfied) = %s, %d %s, %d",
-			FileName, LineNo,
-			get_day_name(LastTriggerDate % 7),
+			Ctx->FileName, Ctx->LineNo,
+			get_day_name(Ctx->LastTriggerDate % 7),
 			d,
 			get_month_name(m),
 			y);
@@ -1293,7 +1293,7 @@ int DoSatRemind(Trigger *trig, TimeTrig *tt, ParsePtr p)
 	}
     }
     p->pos = t;
-    LastTrigValid = 0;
+    Ctx->LastTrigValid = 0;
     return E_CANT_TRIG;
 }
 
@@ -1408,7 +1408,7 @@ static int ShouldTriggerBasedOnWarn(Trigger *t, int jul, int *err)
     /* If no proper function exists, barf... */
     if (UserFuncExists(t->warn) != 1) {
 	Eprint("%s: `%s'", ErrMsg[M_BAD_WARN_FUNC], t->warn);
-	return (jul == JulianToday);
+	return (jul == Ctx->JulianToday);
     }
     for (i=1; ; i++) {
 	sprintf(buffer, "%s(%d)", t->warn, i);
@@ -1417,30 +1417,30 @@ static int ShouldTriggerBasedOnWarn(Trigger *t, int jul, int *err)
 	if (r) {
 	    Eprint("%s: `%s': %s", ErrMsg[M_BAD_WARN_FUNC],
 		   t->warn, ErrMsg[r]);
-	    return (jul == JulianToday);
+	    return (jul == Ctx->JulianToday);
 	}
 	if (v.type != INT_TYPE) {
 	    DestroyValue(v);
 	    Eprint("%s: `%s': %s", ErrMsg[M_BAD_WARN_FUNC],
 		   t->warn, ErrMsg[E_BAD_TYPE]);
-	    return (jul == JulianToday);
+	    return (jul == Ctx->JulianToday);
 	}
 
 	/* If absolute value of return is not monotonically
            decreasing, exit */
 	if (i > 1 && abs(v.v.val) >= lastReturnVal) {
-	    return (jul == JulianToday);
+	    return (jul == Ctx->JulianToday);
 	}
 
 	lastReturnVal = abs(v.v.val);
 	/* Positive values: Just subtract.  Negative values:
            skip omitted days. */
 	if (v.v.val >= 0) {
-	    if (JulianToday + v.v.val == jul) return 1;
+	    if (Ctx->JulianToday + v.v.val == jul) return 1;
 	} else {
 	    int j = jul;
 	    int iter = 0;
-	    int max = MaxSatIter;
+	    int max = Ctx->MaxSatIter;
 	    if (max < v.v.val * 2) max = v.v.val*2;
 	    while(iter++ <= max) {
 		j--;
@@ -1455,7 +1455,7 @@ static int ShouldTriggerBasedOnWarn(Trigger *t, int jul, int *err)
 	        Eprint("Delta: Bad OMITFUNC? %s", ErrMsg[E_CANT_TRIG]);
 	        return 0;
 	    }
-	    if (j == JulianToday) return 1;
+	    if (j == Ctx->JulianToday) return 1;
 	}
     }
 }
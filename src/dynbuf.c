@@ -112,6 +112,29 @@ int DBufPuts(DynamicBuffer *dbuf, char const *str)
     return OK;
 }
 
+/**********************************************************************
+%FUNCTION: DBufPutsN
+%ARGUMENTS:
+ dbuf -- pointer to a dynamic buffer
+ str -- characters to append to buffer
+ n -- number of characters to append
+%RETURNS:
+ OK if all went well; E_NO_MEM if out of memory
+%DESCRIPTION:
+ Appends the first n characters of str to the buffer.  str must not
+ contain a '\0' within those n characters.
+**********************************************************************/
+int DBufPutsN(DynamicBuffer *dbuf, char const *str, size_t n)
+{
+    if (!n) return OK;
+
+    if (DBufMakeRoom(dbuf, dbuf->len+n) != OK) return E_NO_MEM;
+    memcpy((dbuf->buffer+dbuf->len), str, n);
+    dbuf->len += n;
+    dbuf->buffer[dbuf->len] = 0;
+    return OK;
+}
+
 /**********************************************************************
 %FUNCTION: DBufFree
 %ARGUMENTS:
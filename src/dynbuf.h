@@ -25,6 +25,7 @@ typedef struct {
 void DBufInit(DynamicBuffer *dbuf);
 int DBufPutcFN(DynamicBuffer *dbuf, char c);
 int DBufPuts(DynamicBuffer *dbuf, char const *str);
+int DBufPutsN(DynamicBuffer *dbuf, char const *str, size_t n);
 void DBufFree(DynamicBuffer *dbuf);
 int DBufGets(DynamicBuffer *dbuf, FILE *fp);
 
@@ -84,13 +84,6 @@ Operator UnOp[] = {
 
 extern BuiltinFunc Func[];
 
-static Operator OpStack[OP_STACK_SIZE];
-static int      OpStackPtr = 0;
-
-/* ValStack can't be static - needed by funcs.c */
-       Value    ValStack[VAL_STACK_SIZE];
-       int      ValStackPtr = 0;
-
 /***************************************************************/
 /*                                                             */
 /*  DebugPerform                                               */
@@ -104,17 +97,17 @@ static int DebugPerform(Operator *op)
 
     if (op->type == UN_OP) {
 	fprintf(ErrFp, "%s ", op->name);
-	PrintValue(&ValStack[ValStackPtr-1], ErrFp);
+	PrintValue(&Ctx->ValStack[Ctx->ValStackPtr-1], ErrFp);
     } else { /* Must be binary operator */
-	PrintValue(&ValStack[ValStackPtr-2], ErrFp);
+	PrintValue(&Ctx->ValStack[Ctx->ValStackPtr-2], ErrFp);
 	fprintf(ErrFp, " %s ", op->name);
-	PrintValue(&ValStack[ValStackPtr-1], ErrFp);
+	PrintValue(&Ctx->ValStack[Ctx->ValStackPtr-1], ErrFp);
     }
 
     r = (op->func)();
     fprintf(ErrFp, " => ");
     if (!r) {
-	PrintValue(&ValStack[ValStackPtr-1], ErrFp);
+	PrintValue(&Ctx->ValStack[Ctx->ValStackPtr-1], ErrFp);
 	putc('\n', ErrFp);
     } else {
 	fprintf(ErrFp, "%s\n", ErrMsg[r]);
@@ -133,9 +126,9 @@ static void CleanStack(int old_op_stack_ptr, int old_val_stack_ptr)
 {
     int i;
 
-    for (i=old_val_stack_ptr; i<ValStackPtr; i++) DestroyValue(ValStack[i]);
-    ValStackPtr = old_val_stack_ptr;
-    OpStackPtr = old_op_stack_ptr;
+    for (i=old_val_stack_ptr; i<Ctx->ValStackPtr; i++) DestroyValue(Ctx->ValStack[i]);
+    Ctx->ValStackPtr = old_val_stack_ptr;
+    Ctx->OpStackPtr = old_op_stack_ptr;
 }
 
 /***************************************************************/
@@ -293,7 +286,7 @@ static int ParseExprToken(DynamicBuffer *buf, char const **in)
     }
 
     /* Parse a constant, variable name or function */
-    while (ISID(**in) || **in == ':' || **in == '.' || **in == TimeSep) {
+    while (ISID(**in) || **in == ':' || **in == '.' || **in == Ctx->TimeSep) {
 	if (DBufPutc(buf, **in) != OK) {
 	    DBufFree(buf);
 	    return E_NO_MEM;
@@ -325,24 +318,24 @@ int EvalExpr(char const **e, Value *v, ParsePtr p)
 {
     int r;
 
-    int old_op_stack_ptr = OpStackPtr;
-    int old_val_stack_ptr = ValStackPtr;
+    int old_op_stack_ptr = Ctx->OpStackPtr;
+    int old_val_stack_ptr = Ctx->ValStackPtr;
 
     r = Evaluate(e, NULL, p);
 
     /* Put last character parsed back onto input stream */
-    if (DBufLen(&ExprBuf)) (*e)--;
-    DBufFree(&ExprBuf);
+    if (DBufLen(&Ctx->ExprBuf)) (*e)--;
+    DBufFree(&Ctx->ExprBuf);
 
     if (r) {
 	CleanStack(old_op_stack_ptr, old_val_stack_ptr);
         /* fprintf(stderr, "O=%d V=%d\n", OpStackPtr, ValStackPtr); */
 	return r;
     }
-    OpStackPtr = old_op_stack_ptr;
-    ValStackPtr = old_val_stack_ptr;
-    *v = ValStack[old_val_stack_ptr];
-    ValStack[old_val_stack_ptr].type = ERR_TYPE;
+    Ctx->OpStackPtr = old_op_stack_ptr;
+    Ctx->ValStackPtr = old_val_stack_ptr;
+    *v = Ctx->ValStack[old_val_stack_ptr];
+    Ctx->ValStack[old_val_stack_ptr].type = ERR_TYPE;
     /* fprintf(stderr, "O=%d V=%d\n", OpStackPtr, ValStackPtr); */
     return r;
 }
@@ -359,40 +352,40 @@ int Evaluate(char const **s, Var *locals, ParsePtr p)
     Value va;
     char const *ufname = NULL; /* Stop GCC from complaining about use of uninit var */
 
-    OpBase = OpStackPtr;
-    ValBase = ValStackPtr;
+    OpBase = Ctx->OpStackPtr;
+    ValBase = Ctx->ValStackPtr;
 
     while(1) {
 /* Looking for a value.  Accept: value, unary op, func. call or left paren */
-	r = ParseExprToken(&ExprBuf, s);
+	r = ParseExprToken(&Ctx->ExprBuf, s);
 	if (r) return r;
-	if (!DBufLen(&ExprBuf)) {
-	    DBufFree(&ExprBuf);
+	if (!DBufLen(&Ctx->ExprBuf)) {
+	    DBufFree(&Ctx->ExprBuf);
 	    return E_EOLN;
 	}
 
-	if (*DBufValue(&ExprBuf) == '(') { /* Parenthesized expression */
-	    DBufFree(&ExprBuf);
+	if (*DBufValue(&Ctx->ExprBuf) == '(') { /* Parenthesized expression */
+	    DBufFree(&Ctx->ExprBuf);
 	    r = Evaluate(s, locals, p);  /* Leaves the last parsed token in ExprBuf */
 	    if (r) return r;
 	    r = OK;
-	    if (*DBufValue(&ExprBuf) != ')') {
-		DBufFree(&ExprBuf);
+	    if (*DBufValue(&Ctx->ExprBuf) != ')') {
+		DBufFree(&Ctx->ExprBuf);
 		return E_MISS_RIGHT_PAREN;
 	    }
 	    if (r) return r;
-	} else if (*DBufValue(&ExprBuf) == '+') {
+	} else if (*DBufValue(&Ctx->ExprBuf) == '+') {
 	    continue; /* Ignore unary + */
 	}
-	else if (*(DBufValue(&ExprBuf) + DBufLen(&ExprBuf) -1) == '(') { /* Function Call */
-	    *(DBufValue(&ExprBuf) + DBufLen(&ExprBuf) - 1) = 0;
-	    f = FindFunc(DBufValue(&ExprBuf), Func, NumFuncs);
+	else if (*(DBufValue(&Ctx->ExprBuf) + DBufLen(&Ctx->ExprBuf) -1) == '(') { /* Function Call */
+	    *(DBufValue(&Ctx->ExprBuf) + DBufLen(&Ctx->ExprBuf) - 1) = 0;
+	    f = FindFunc(DBufValue(&Ctx->ExprBuf), Func, NumFuncs);
 	    if (!f) {
-		ufname = StrDup(DBufValue(&ExprBuf));
-		DBufFree(&ExprBuf);
+		ufname = StrDup(DBufValue(&Ctx->ExprBuf));
+		DBufFree(&Ctx->ExprBuf);
 		if (!ufname) return E_NO_MEM;
 	    } else {
-		DBufFree(&ExprBuf);
+		DBufFree(&Ctx->ExprBuf);
 	    }
 	    args = 0;
 	    if (PeekChar(s) == ')') { /* Function has no arguments */
@@ -404,7 +397,7 @@ int Evaluate(char const **s, Var *locals, ParsePtr p)
 		    free((char *) ufname);
 		}
 		if (r) return r;
-		r = ParseExprToken(&ExprBuf, s); /* Guaranteed to be right paren. */
+		r = ParseExprToken(&Ctx->ExprBuf, s); /* Guaranteed to be right paren. */
 		if (r) return r;
 	    } else { /* Function has some arguments */
 		while(1) {
@@ -414,12 +407,12 @@ int Evaluate(char const **s, Var *locals, ParsePtr p)
 			if (!f) free((char *) ufname);
 			return r;
 		    }
-		    if (*DBufValue(&ExprBuf) == ')') break;
-		    else if (*DBufValue(&ExprBuf) != ',') {
+		    if (*DBufValue(&Ctx->ExprBuf) == ')') break;
+		    else if (*DBufValue(&Ctx->ExprBuf) != ',') {
 			if (!f) free((char *) ufname);
 			Eprint("%s: `%c'", ErrMsg[E_EXPECT_COMMA],
-			       *DBufValue(&ExprBuf));
-			DBufFree(&ExprBuf);
+			       *DBufValue(&Ctx->ExprBuf));
+			DBufFree(&Ctx->ExprBuf);
 			return E_EXPECT_COMMA;
 		    }
 		}
@@ -430,69 +423,69 @@ int Evaluate(char const **s, Var *locals, ParsePtr p)
 		    r = CallUserFunc(ufname, args, p);
 		    free((char *) ufname);
 		}
-		DBufFree(&ExprBuf);
+		DBufFree(&Ctx->ExprBuf);
 		if (r) return r;
 	    }
 	} else { /* Unary operator */
-	    o = FindOperator(DBufValue(&ExprBuf), UnOp, NUM_UN_OPS);
+	    o = FindOperator(DBufValue(&Ctx->ExprBuf), UnOp, NUM_UN_OPS);
 	    if (o) {
-		DBufFree(&ExprBuf);
+		DBufFree(&Ctx->ExprBuf);
 		PushOpStack(*o);
 		continue;  /* Still looking for an atomic vlue */
-	    } else if (!ISID(*DBufValue(&ExprBuf)) &&
-		       *DBufValue(&ExprBuf) != '$' &&
-		       *DBufValue(&ExprBuf) != '"' &&
-		       *DBufValue(&ExprBuf) != '\'') {
+	    } else if (!ISID(*DBufValue(&Ctx->ExprBuf)) &&
+		       *DBufValue(&Ctx->ExprBuf) != '$' &&
+		       *DBufValue(&Ctx->ExprBuf) != '"' &&
+		       *DBufValue(&Ctx->ExprBuf) != '\'') {
 		Eprint("%s `%c'", ErrMsg[E_ILLEGAL_CHAR],
-		       *DBufValue(&ExprBuf));
-		DBufFree(&ExprBuf);
+		       *DBufValue(&Ctx->ExprBuf));
+		DBufFree(&Ctx->ExprBuf);
 		return E_ILLEGAL_CHAR;
 	    } else { /* Must be a literal value */
-		r = MakeValue(DBufValue(&ExprBuf), &va, locals, p);
-		DBufFree(&ExprBuf);
+		r = MakeValue(DBufValue(&Ctx->ExprBuf), &va, locals, p);
+		DBufFree(&Ctx->ExprBuf);
 		if (r) return r;
 		PushValStack(va);
 	    }
 	}
 /* OK, we've got a literal value; now, we're looking for the end of the
    expression, or a binary operator. */
-	r = ParseExprToken(&ExprBuf, s);
+	r = ParseExprToken(&Ctx->ExprBuf, s);
 	if (r) return r;
-	if (*DBufValue(&ExprBuf) == 0 ||
-	    *DBufValue(&ExprBuf) == ',' ||
-	    *DBufValue(&ExprBuf) == ']' ||
-	    *DBufValue(&ExprBuf) == ')') {
+	if (*DBufValue(&Ctx->ExprBuf) == 0 ||
+	    *DBufValue(&Ctx->ExprBuf) == ',' ||
+	    *DBufValue(&Ctx->ExprBuf) == ']' ||
+	    *DBufValue(&Ctx->ExprBuf) == ')') {
 	    /* We've hit the end of the expression.  Pop off and evaluate until
 	       OpStackPtr = OpBase and ValStackPtr = ValBase+1 */
-	    while (OpStackPtr > OpBase) {
+	    while (Ctx->OpStackPtr > OpBase) {
 		PopOpStack(op);
-		if (DebugFlag & DB_PRTEXPR)
+		if (Ctx->DebugFlag & DB_PRTEXPR)
 		    r=DebugPerform(&op);
 		else
 		    r=(op.func)();
 		if (r) {
-		    DBufFree(&ExprBuf);
+		    DBufFree(&Ctx->ExprBuf);
 		    Eprint("`%s': %s", op.name, ErrMsg[r]);
 		    return r;
 		}
 	    }
-	    if (ValStackPtr != ValBase+1) {
-		DBufFree(&ExprBuf);
+	    if (Ctx->ValStackPtr != ValBase+1) {
+		DBufFree(&Ctx->ExprBuf);
 		return E_STACK_ERR;
 	    }
 	    return OK;
 	}
 	/* Must be a binary operator */
-	o = FindOperator(DBufValue(&ExprBuf), BinOp, NUM_BIN_OPS);
-	DBufFree(&ExprBuf);
+	o = FindOperator(DBufValue(&Ctx->ExprBuf), BinOp, NUM_BIN_OPS);
+	DBufFree(&Ctx->ExprBuf);
 	if (!o) return E_EXPECTING_BINOP;
 
 	/* While operators of higher or equal precedence are on the stack,
 	   pop them off and evaluate */
-	while (OpStackPtr > OpBase && OpStack[OpStackPtr-1].prec >= o->prec) {
+	while (Ctx->OpStackPtr > OpBase && Ctx->OpStack[Ctx->OpStackPtr-1].prec >= o->prec) {
 	    PopOpStack(op2);
 	    if (r) return r;
-	    if (DebugFlag & DB_PRTEXPR)
+	    if (Ctx->DebugFlag & DB_PRTEXPR)
 		r=DebugPerform(&op2);
 	    else
 		r=(op2.func)();
@@ -554,7 +547,7 @@ static int MakeValue(char const *s, Value *v, Var *locals, ParsePtr p)
             }
             prev_val = len;
 	}
-	if (*s == ':' || *s == '.' || *s == TimeSep) { /* Must be a literal time */
+	if (*s == ':' || *s == '.' || *s == Ctx->TimeSep) { /* Must be a literal time */
 	    s++;
 	    if (!isdigit(*s)) return E_BAD_TIME;
 	    h = len;
@@ -596,22 +589,22 @@ static int MakeValue(char const *s, Value *v, Var *locals, ParsePtr p)
 	return OK;
     } else if (*s == '$') { /* A system variable */
 	if (p) p->nonconst_expr = 1;
-	if (DebugFlag & DB_PRTEXPR)
+	if (Ctx->DebugFlag & DB_PRTEXPR)
 	    fprintf(ErrFp, "%s => ", s);
 	r = GetSysVar(s+1, v);
 
-	if (! (DebugFlag & DB_PRTEXPR)) return r;
+	if (! (Ctx->DebugFlag & DB_PRTEXPR)) return r;
 	if (r == OK) {
 	    PrintValue(v, ErrFp);
 	    putc('\n', ErrFp);
 	}
 	return r;
     } else { /* Must be a symbol */
-	if (DebugFlag & DB_PRTEXPR)
+	if (Ctx->DebugFlag & DB_PRTEXPR)
 	    fprintf(ErrFp, "%s => ", s);
     }
     r = GetVarValue(s, v, locals, p);
-    if (! (DebugFlag & DB_PRTEXPR)) return r;
+    if (! (Ctx->DebugFlag & DB_PRTEXPR)) return r;
     if (r == OK) {
 	PrintValue(v, ErrFp);
 	putc('\n', ErrFp);
@@ -660,11 +653,11 @@ int DoCoerce(char type, Value *v)
 	switch(v->type) {
 	case INT_TYPE: sprintf(coerce_buf, "%d", v->v.val); break;
 	case TIME_TYPE: sprintf(coerce_buf, "%02d%c%02d", v->v.val / 60,
-			       TimeSep, v->v.val % 60);
+			       Ctx->TimeSep, v->v.val % 60);
 	break;
 	case DATE_TYPE: FromJulian(v->v.val, &y, &m, &d);
 	    sprintf(coerce_buf, "%04d%c%02d%c%02d",
-		    y, DateSep, m+1, DateSep, d);
+		    y, Ctx->DateSep, m+1, Ctx->DateSep, d);
 	    break;
 	case DATETIME_TYPE:
 	    i = v->v.val / MINUTES_PER_DAY;
@@ -673,7 +666,7 @@ int DoCoerce(char type, Value *v)
 	    h = k / 60;
 	    i = k % 60;
 	    sprintf(coerce_buf, "%04d%c%02d%c%02d%c%02d%c%02d",
-		    y, DateSep, m+1, DateSep, d, DateTimeSep, h, TimeSep, i);
+		    y, Ctx->DateSep, m+1, Ctx->DateSep, d, Ctx->DateTimeSep, h, Ctx->TimeSep, i);
 	    break;
 	default: return E_CANT_COERCE;
 	}
@@ -847,7 +840,7 @@ static int Add(void)
 	v3.type = STR_TYPE;
 	l1 = strlen(v1.v.str);
 	l2 = strlen(v2.v.str);
-	if (MaxStringLen > 0 && (l1 + l2 > (size_t) MaxStringLen)) {
+	if (Ctx->MaxStringLen > 0 && (l1 + l2 > (size_t) Ctx->MaxStringLen)) {
 	    DestroyValue(v1); DestroyValue(v2);
 	    return E_STRING_TOO_LONG;
 	}
@@ -1170,7 +1163,7 @@ static int LogAND(void)
 /***************************************************************/
 static int UnMinus(void)
 {
-    Value *v = &ValStack[ValStackPtr-1];
+    Value *v = &Ctx->ValStack[Ctx->ValStackPtr-1];
     if (v->type != INT_TYPE) return E_BAD_TYPE;
     if (v->v.val == INT_MIN) return E_2HIGH;
     v->v.val = -v->v.val;
@@ -1186,7 +1179,7 @@ static int UnMinus(void)
 /***************************************************************/
 static int LogNot(void)
 {
-    Value *v = &ValStack[ValStackPtr-1];
+    Value *v = &Ctx->ValStack[Ctx->ValStackPtr-1];
     if (v->type != INT_TYPE) return E_BAD_TYPE;
     if (v->v.val) v->v.val = 0; else v->v.val = 1;
     return OK;
@@ -1288,15 +1281,15 @@ void PrintValue (Value *v, FILE *fp)
     }
     else if (v->type == INT_TYPE) fprintf(fp, "%d", v->v.val);
     else if (v->type == TIME_TYPE) fprintf(fp, "%02d%c%02d", v->v.val / 60,
-					   TimeSep, v->v.val % 60);
+					   Ctx->TimeSep, v->v.val % 60);
     else if (v->type == DATE_TYPE) {
 	FromJulian(v->v.val, &y, &m, &d);
-	fprintf(fp, "%04d%c%02d%c%02d", y, DateSep, m+1, DateSep, d);
+	fprintf(fp, "%04d%c%02d%c%02d", y, Ctx->DateSep, m+1, Ctx->DateSep, d);
     }
     else if (v->type == DATETIME_TYPE) {
 	FromJulian(v->v.val / MINUTES_PER_DAY, &y, &m, &d);
-	fprintf(fp, "%04d%c%02d%c%02d%c%02d%c%02d", y, DateSep, m+1, DateSep, d, DateTimeSep,
-		(v->v.val % MINUTES_PER_DAY) / 60, TimeSep, (v->v.val % MINUTES_PER_DAY) % 60);
+	fprintf(fp, "%04d%c%02d%c%02d%c%02d%c%02d", y, Ctx->DateSep, m+1, Ctx->DateSep, d, Ctx->DateTimeSep,
+		(v->v.val % MINUTES_PER_DAY) / 60, Ctx->TimeSep, (v->v.val % MINUTES_PER_DAY) % 60);
     }
     else fprintf(fp, "ERR");
 }
@@ -1331,7 +1324,7 @@ int ParseLiteralTime(char const **s, int *tim)
 	h *= 10;
 	h += *(*s)++ - '0';
     }
-    if (**s != ':' && **s != '.' && **s != TimeSep) return E_BAD_TIME;
+    if (**s != ':' && **s != '.' && **s != Ctx->TimeSep) return E_BAD_TIME;
     (*s)++;
     if (!isdigit(**s)) return E_BAD_TIME;
     while(isdigit(**s)) {
@@ -1384,7 +1377,7 @@ int ParseLiteralDate(char const **s, int *jul, int *tim)
 	y *= 10;
 	y += *(*s)++ - '0';
     }
-    if (**s != '/' && **s != '-' && **s != DateSep) return E_BAD_DATE;
+    if (**s != '/' && **s != '-' && **s != Ctx->DateSep) return E_BAD_DATE;
     (*s)++;
     if (!isdigit(**s)) return E_BAD_DATE;
     while (isdigit(**s)) {
@@ -1392,7 +1385,7 @@ int ParseLiteralDate(char const **s, int *jul, int *tim)
 	m += *(*s)++ - '0';
     }
     m--;
-    if (**s != '/' && **s != '-' && **s != DateSep) return E_BAD_DATE;
+    if (**s != '/' && **s != '-' && **s != Ctx->DateSep) return E_BAD_DATE;
     (*s)++;
     if (!isdigit(**s)) return E_BAD_DATE;
     while (isdigit(**s)) {
@@ -1423,10 +1416,10 @@ int ParseLiteralDate(char const **s, int *jul, int *tim)
 /***************************************************************/
 int FnPopValStack(Value *val)
 {
-    if (ValStackPtr <= 0)
+    if (Ctx->ValStackPtr <= 0)
 	return E_VA_STK_UNDER;
     else {
-	*val = ValStack[--ValStackPtr];
+	*val = Ctx->ValStack[--Ctx->ValStackPtr];
 	return OK;
     }
 }
@@ -31,28 +31,28 @@
    for speed.  BEWARE:  These macros invoke return if an error happens ! */
 
 #define PushOpStack(op) \
-if (OpStackPtr >= OP_STACK_SIZE) \
+if (Ctx->OpStackPtr >= OP_STACK_SIZE) \
 return E_OP_STK_OVER; \
 else \
-OpStack[OpStackPtr++] = (op)
+Ctx->OpStack[Ctx->OpStackPtr++] = (op)
 
 #define PopOpStack(op) \
-if (OpStackPtr <= 0) \
+if (Ctx->OpStackPtr <= 0) \
 return E_OP_STK_UNDER; \
 else \
-(op) = OpStack[--OpStackPtr]
+(op) = Ctx->OpStack[--Ctx->OpStackPtr]
 
 #define PushValStack(val) \
-if (ValStackPtr >= VAL_STACK_SIZE) \
+if (Ctx->ValStackPtr >= VAL_STACK_SIZE) \
 return E_VA_STK_OVER; \
 else \
-ValStack[ValStackPtr++] = (val)
+Ctx->ValStack[Ctx->ValStackPtr++] = (val)
 
 #define PopValStack(val) \
-if (ValStackPtr <= 0) \
+if (Ctx->ValStackPtr <= 0) \
 return E_VA_STK_UNDER; \
 else \
-(val) = ValStack[--ValStackPtr]
+(val) = Ctx->ValStack[--Ctx->ValStackPtr]
 
 /* These functions are in utils.c and are used to detect overflow
    in various arithmetic operators.  They have to be in separate
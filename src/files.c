@@ -39,61 +39,51 @@
 #include "globals.h"
 #include "err.h"
 
+#ifdef USE_THREADS
+#include <pthread.h>
+#endif
 
 /* Convenient macros for closing files */
 #define FCLOSE(fp) (((fp)&&((fp)!=stdin)) ? (fclose(fp),(fp)=NULL) : ((fp)=NULL))
 #define PCLOSE(fp) (((fp)&&((fp)!=stdin)) ? (pclose(fp),(fp)=NULL) : ((fp)=NULL))
 
 /* Define the structures needed by the file caching system */
-typedef struct cache {
-    struct cache *next;
-    char const *text;
-    int LineNo;
-} CachedLine;
-
 typedef struct cheader {
     struct cheader *next;
     char const *filename;
     CachedLine *cache;
     int ownedByMe;
+    time_t mtime;		/* When cached, or 0 if not a plain file */
+    off_t size;
 } CachedFile;
 
-/* A linked list of filenames if we INCLUDE /some/directory/  */
-typedef struct fname_chain {
-    struct fname_chain *next;
-    char const *filename;
-} FilenameChain;
-
 /* Cache filename chains for directories */
 typedef struct directory_fname_chain {
     struct directory_fname_chain *next;
     FilenameChain *chain;
     char const *dirname;
+    time_t mtime;
 } DirectoryFilenameChain;
 
-/* Define the structures needed by the INCLUDE file system */
-typedef struct {
-    char const *filename;
-    FilenameChain *chain;
-    int LineNo;
-    unsigned int IfFlags;
-    int NumIfs;
-    long offset;
-    CachedLine *CLine;
-    int ownedByMe;
-} IncludeStruct;
-
 static CachedFile *CachedFiles = (CachedFile *) NULL;
-static CachedLine *CLine = (CachedLine *) NULL;
 static DirectoryFilenameChain *CachedDirectoryChains = NULL;
 
-static FILE *fp;
-
-static IncludeStruct IStack[INCLUDE_NEST];
-static int IStackPtr = 0;
+/* Calendar worker threads share the cache, so only one at a time may
+   look things up in it or add to it.  Cached lines are never changed,
+   so reading them needs no lock. */
+#ifdef USE_THREADS
+static pthread_mutex_t CacheLock = PTHREAD_MUTEX_INITIALIZER;
+#define LOCK_CACHE() pthread_mutex_lock(&CacheLock)
+#define UNLOCK_CACHE() pthread_mutex_unlock(&CacheLock)
+#else
+#define LOCK_CACHE()
+#define UNLOCK_CACHE()
+#endif
 
 static int ReadLineFromFile (int use_pclose);
 static int CacheFile (char const *fname, int use_pclose);
+static int OpenFileUnlocked (char const *fname);
+static int IncludeCmdUnlocked (char const *cmd);
 static void DestroyCache (CachedFile *cf);
 static int CheckSafety (void);
 static int PopFile (void);
@@ -102,23 +92,23 @@ static void OpenPurgeFile(char const *fname, char const *mode)
 {
     DynamicBuffer fname_buf;
 
-    if (PurgeFP != NULL && PurgeFP != stdout) {
-	fclose(PurgeFP);
+    if (Ctx->PurgeFP != NULL && Ctx->PurgeFP != stdout) {
+	fclose(Ctx->PurgeFP);
     }
-    PurgeFP = NULL;
+    Ctx->PurgeFP = NULL;
 
     /* Do not open a purge file if we're below purge
        include depth */
-    if (IStackPtr-2 >= PurgeIncludeDepth) {
-	PurgeFP = NULL;
+    if (Ctx->IStackPtr-2 >= Ctx->PurgeIncludeDepth) {
+	Ctx->PurgeFP = NULL;
 	return;
     }
 
     DBufInit(&fname_buf);
     if (DBufPuts(&fname_buf, fname) != OK) return;
     if (DBufPuts(&fname_buf, ".purged") != OK) return;
-    PurgeFP = fopen(DBufValue(&fname_buf), mode);
-    if (!PurgeFP) {
+    Ctx->PurgeFP = fopen(DBufValue(&fname_buf), mode);
+    if (!Ctx->PurgeFP) {
 	fprintf(ErrFp, "Cannot open `%s' for writing: %s\n", DBufValue(&fname_buf), strerror(errno));
     }
     DBufFree(&fname_buf);
@@ -152,19 +142,19 @@ int ReadLine(void)
     int r;
 
 /* If we're at the end of a file, pop */
-    while (!CLine && !fp) {
+    while (!Ctx->CLine && !Ctx->fp) {
 	r = PopFile();
 	if (r) return r;
     }
 
 /* If it's cached, read line from the cache */
-    if (CLine) {
-	CurLine = CLine->text;
-	LineNo = CLine->LineNo;
-	CLine = CLine->next;
-	FreshLine = 1;
+    if (Ctx->CLine) {
+	Ctx->CurLine = Ctx->CLine->text;
+	Ctx->LineNo = Ctx->CLine->LineNo;
+	Ctx->CLine = Ctx->CLine->next;
+	Ctx->FreshLine = 1;
         clear_callstack();
-	if (DebugFlag & DB_ECHO_LINE) OutputLine(ErrFp);
+	if (Ctx->DebugFlag & DB_ECHO_LINE) OutputLine(ErrFp);
 	return OK;
     }
 
@@ -188,87 +178,87 @@ static int ReadLineFromFile(int use_pclose)
     DynamicBuffer buf;
 
     DBufInit(&buf);
-    DBufFree(&LineBuffer);
+    DBufFree(&Ctx->LineBuffer);
 
-    while(fp) {
-	if (DBufGets(&buf, fp) != OK) {
-	    DBufFree(&LineBuffer);
+    while(Ctx->fp) {
+	if (DBufGets(&buf, Ctx->fp) != OK) {
+	    DBufFree(&Ctx->LineBuffer);
 	    return E_NO_MEM;
 	}
-	LineNo++;
-	if (ferror(fp)) {
+	Ctx->LineNo++;
+	if (ferror(Ctx->fp)) {
 	    DBufFree(&buf);
-	    DBufFree(&LineBuffer);
+	    DBufFree(&Ctx->LineBuffer);
 	    return E_IO_ERR;
 	}
-	if (feof(fp)) {
+	if (feof(Ctx->fp)) {
             if (use_pclose) {
-                PCLOSE(fp);
+                PCLOSE(Ctx->fp);
             } else {
-                FCLOSE(fp);
+                FCLOSE(Ctx->fp);
             }
 	    if ((DBufLen(&buf) == 0) &&
-		(DBufLen(&LineBuffer) == 0) && PurgeMode) {
-		if (PurgeFP != NULL && PurgeFP != stdout) fclose(PurgeFP);
-		PurgeFP = NULL;
+		(DBufLen(&Ctx->LineBuffer) == 0) && Ctx->PurgeMode) {
+		if (Ctx->PurgeFP != NULL && Ctx->PurgeFP != stdout) fclose(Ctx->PurgeFP);
+		Ctx->PurgeFP = NULL;
 	    }
 	}
 	l = DBufLen(&buf);
 	if (l && (DBufValue(&buf)[l-1] == '\\')) {
-	    if (PurgeMode) {
-		if (DBufPuts(&LineBuffer, DBufValue(&buf)) != OK) {
+	    if (Ctx->PurgeMode) {
+		if (DBufPuts(&Ctx->LineBuffer, DBufValue(&buf)) != OK) {
 		    DBufFree(&buf);
-		    DBufFree(&LineBuffer);
+		    DBufFree(&Ctx->LineBuffer);
 		    return E_NO_MEM;
 		}
-		if (DBufPutc(&LineBuffer, '\n') != OK) {
+		if (DBufPutc(&Ctx->LineBuffer, '\n') != OK) {
 		    DBufFree(&buf);
-		    DBufFree(&LineBuffer);
+		    DBufFree(&Ctx->LineBuffer);
 		    return E_NO_MEM;
 		}
 	    } else {
 		DBufValue(&buf)[l-1] = '\n';
-		if (DBufPuts(&LineBuffer, DBufValue(&buf)) != OK) {
+		if (DBufPuts(&Ctx->LineBuffer, DBufValue(&buf)) != OK) {
 		    DBufFree(&buf);
-		    DBufFree(&LineBuffer);
+		    DBufFree(&Ctx->LineBuffer);
 		    return E_NO_MEM;
 		}
 	    }
 	    continue;
 	}
-	if (DBufPuts(&LineBuffer, DBufValue(&buf)) != OK) {
+	if (DBufPuts(&Ctx->LineBuffer, DBufValue(&buf)) != OK) {
 	    DBufFree(&buf);
-	    DBufFree(&LineBuffer);
+	    DBufFree(&Ctx->LineBuffer);
 	    return E_NO_MEM;
 	}
 	DBufFree(&buf);
 
 	/* If the line is: __EOF__ treat it as end-of-file */
-	CurLine = DBufValue(&LineBuffer);
-	if (!strcmp(CurLine, "__EOF__")) {
-	    if (PurgeMode && PurgeFP) {
+	Ctx->CurLine = DBufValue(&Ctx->LineBuffer);
+	if (!strcmp(Ctx->CurLine, "__EOF__")) {
+	    if (Ctx->PurgeMode && Ctx->PurgeFP) {
 		PurgeEchoLine("%s\n", "__EOF__");
-		while ((n = fread(copy_buffer, 1, sizeof(copy_buffer), fp)) != 0) {
-		    fwrite(copy_buffer, 1, n, PurgeFP);
+		while ((n = fread(copy_buffer, 1, sizeof(copy_buffer), Ctx->fp)) != 0) {
+		    fwrite(copy_buffer, 1, n, Ctx->PurgeFP);
 		}
-		if (PurgeFP != stdout) fclose(PurgeFP);
-		PurgeFP = NULL;
+		if (Ctx->PurgeFP != stdout) fclose(Ctx->PurgeFP);
+		Ctx->PurgeFP = NULL;
 	    }
             if (use_pclose) {
-                PCLOSE(fp);
+                PCLOSE(Ctx->fp);
             } else {
-                FCLOSE(fp);
+                FCLOSE(Ctx->fp);
             }
-	    DBufFree(&LineBuffer);
-	    CurLine = DBufValue(&LineBuffer);
+	    DBufFree(&Ctx->LineBuffer);
+	    Ctx->CurLine = DBufValue(&Ctx->LineBuffer);
 	}
 
-	FreshLine = 1;
+	Ctx->FreshLine = 1;
         clear_callstack();
-	if (DebugFlag & DB_ECHO_LINE) OutputLine(ErrFp);
+	if (Ctx->DebugFlag & DB_ECHO_LINE) OutputLine(ErrFp);
 	return OK;
     }
-    CurLine = DBufValue(&LineBuffer);
+    Ctx->CurLine = DBufValue(&Ctx->LineBuffer);
     return OK;
 }
 
@@ -282,78 +272,97 @@ static int ReadLineFromFile(int use_pclose)
 /*                                                             */
 /***************************************************************/
 int OpenFile(char const *fname)
+{
+    int r;
+
+    LOCK_CACHE();
+    r = OpenFileUnlocked(fname);
+    UNLOCK_CACHE();
+    return r;
+}
+
+static int OpenFileUnlocked(char const *fname)
 {
     CachedFile *h = CachedFiles;
     int r;
 
-    if (PurgeMode) {
-	if (PurgeFP != NULL && PurgeFP != stdout) {
-	    fclose(PurgeFP);
+    if (Ctx->PurgeMode) {
+	if (Ctx->PurgeFP != NULL && Ctx->PurgeFP != stdout) {
+	    fclose(Ctx->PurgeFP);
 	}
-	PurgeFP = NULL;
+	Ctx->PurgeFP = NULL;
     }
 
+/* A compiled table isn't read line by line */
+    if (IsTable(fname, NULL)) return OpenTable(fname, NULL);
+
 /* If it's in the cache, get it from there. */
 
     while (h) {
 	if (!strcmp(fname, h->filename)) {
-	    if (DebugFlag & DB_TRACE_FILES) {
+	    if (Ctx->DebugFlag & DB_TRACE_FILES) {
 		fprintf(ErrFp, "Reading `%s': Found in cache\n", fname);
 	    }
-	    CLine = h->cache;
-	    STRSET(FileName, fname);
-	    LineNo = 0;
+	    Ctx->CLine = h->cache;
+	    STRSET(Ctx->FileName, fname);
+	    Ctx->LineNo = 0;
 	    if (!h->ownedByMe) {
-		RunDisabled |= RUN_NOTOWNER;
+		Ctx->RunDisabled |= RUN_NOTOWNER;
 	    } else {
-		RunDisabled &= ~RUN_NOTOWNER;
+		Ctx->RunDisabled &= ~RUN_NOTOWNER;
             }
-	    if (FileName) return OK; else return E_NO_MEM;
+	    if (Ctx->FileName) return OK; else return E_NO_MEM;
 	}
 	h = h->next;
     }
 
 /* If it's a dash, then it's stdin */
     if (!strcmp(fname, "-")) {
-	fp = stdin;
-        RunDisabled &= ~RUN_NOTOWNER;
-	if (PurgeMode) {
-	    PurgeFP = stdout;
+	Ctx->fp = stdin;
+        Ctx->RunDisabled &= ~RUN_NOTOWNER;
+	if (Ctx->PurgeMode) {
+	    Ctx->PurgeFP = stdout;
 	}
-	if (DebugFlag & DB_TRACE_FILES) {
+	if (Ctx->DebugFlag & DB_TRACE_FILES) {
 	    fprintf(ErrFp, "Reading `-': Reading stdin\n");
 	}
     } else {
-	fp = fopen(fname, "r");
-	if (DebugFlag & DB_TRACE_FILES) {
+	Ctx->fp = fopen(fname, "r");
+	if (Ctx->DebugFlag & DB_TRACE_FILES) {
 	    fprintf(ErrFp, "Reading `%s': Opening file on disk\n", fname);
 	}
-	if (PurgeMode) {
+	if (Ctx->fp && IsTable(fname, Ctx->fp)) {
+	    if (!CheckSafety()) return E_CANT_OPEN;
+	    r = OpenTable(fname, Ctx->fp);
+	    FCLOSE(Ctx->fp);
+	    return r;
+	}
+	if (Ctx->PurgeMode) {
 	    OpenPurgeFile(fname, "w");
 	}
     }
-    if (!fp || !CheckSafety()) return E_CANT_OPEN;
-    CLine = NULL;
-    if (ShouldCache) {
-	LineNo = 0;
+    if (!Ctx->fp || !CheckSafety()) return E_CANT_OPEN;
+    Ctx->CLine = NULL;
+    if (Ctx->ShouldCache) {
+	Ctx->LineNo = 0;
 	r = CacheFile(fname, 0);
 	if (r == OK) {
-	    fp = NULL;
-	    CLine = CachedFiles->cache;
+	    Ctx->fp = NULL;
+	    Ctx->CLine = CachedFiles->cache;
 	} else {
 	    if (strcmp(fname, "-")) {
-		fp = fopen(fname, "r");
-		if (!fp || !CheckSafety()) return E_CANT_OPEN;
-		if (PurgeMode) OpenPurgeFile(fname, "w");
+		Ctx->fp = fopen(fname, "r");
+		if (!Ctx->fp || !CheckSafety()) return E_CANT_OPEN;
+		if (Ctx->PurgeMode) OpenPurgeFile(fname, "w");
 	    } else {
-		fp = stdin;
-		if (PurgeMode) PurgeFP = stdout;
+		Ctx->fp = stdin;
+		if (Ctx->PurgeMode) Ctx->PurgeFP = stdout;
 	    }
 	}
     }
-    STRSET(FileName, fname);
-    LineNo = 0;
-    if (FileName) return OK; else return E_NO_MEM;
+    STRSET(Ctx->FileName, fname);
+    Ctx->LineNo = 0;
+    if (Ctx->FileName) return OK; else return E_NO_MEM;
 }
 
 /***************************************************************/
@@ -370,69 +379,79 @@ static int CacheFile(char const *fname, int use_pclose)
     CachedFile *cf;
     CachedLine *cl;
     char const *s;
+    struct stat statbuf;
 
-    if (DebugFlag & DB_TRACE_FILES) {
+    if (Ctx->DebugFlag & DB_TRACE_FILES) {
 	fprintf(ErrFp, "Caching file `%s' in memory\n", fname);
     }
     cl = NULL;
 /* Create a file header */
     cf = NEW(CachedFile);
     if (!cf) {
-	ShouldCache = 0;
+	Ctx->ShouldCache = 0;
         if (use_pclose) {
-            PCLOSE(fp);
+            PCLOSE(Ctx->fp);
         } else {
-            FCLOSE(fp);
+            FCLOSE(Ctx->fp);
         }
 	return E_NO_MEM;
     }
     cf->cache = NULL;
     cf->filename = StrDup(fname);
     if (!cf->filename) {
-	ShouldCache = 0;
+	Ctx->ShouldCache = 0;
         if (use_pclose) {
-            PCLOSE(fp);
+            PCLOSE(Ctx->fp);
         } else {
-            FCLOSE(fp);
+            FCLOSE(Ctx->fp);
         }
 	free(cf);
 	return E_NO_MEM;
     }
 
-    if (RunDisabled & RUN_NOTOWNER) {
+    if (Ctx->RunDisabled & RUN_NOTOWNER) {
 	cf->ownedByMe = 0;
     } else {
 	cf->ownedByMe = 1;
     }
 
+    /* Remember what the file looked like, so FileCacheStale can
+       tell if it has changed since */
+    cf->mtime = 0;
+    cf->size = 0;
+    if (!use_pclose && Ctx->fp != stdin && !fstat(fileno(Ctx->fp), &statbuf)) {
+	cf->mtime = statbuf.st_mtime;
+	cf->size = statbuf.st_size;
+    }
+
 /* Read the file */
-    while(fp) {
+    while(Ctx->fp) {
 	r = ReadLineFromFile(use_pclose);
 	if (r) {
 	    DestroyCache(cf);
-	    ShouldCache = 0;
+	    Ctx->ShouldCache = 0;
             if (use_pclose) {
-                PCLOSE(fp);
+                PCLOSE(Ctx->fp);
             } else {
-                FCLOSE(fp);
+                FCLOSE(Ctx->fp);
             }
 	    return r;
 	}
 /* Skip blank chars */
-	s = DBufValue(&LineBuffer);
+	s = DBufValue(&Ctx->LineBuffer);
 	while (isempty(*s)) s++;
 	if (*s && *s!=';' && *s!='#') {
 /* Add the line to the cache */
 	    if (!cl) {
 		cf->cache = NEW(CachedLine);
 		if (!cf->cache) {
-		    DBufFree(&LineBuffer);
+		    DBufFree(&Ctx->LineBuffer);
 		    DestroyCache(cf);
-		    ShouldCache = 0;
+		    Ctx->ShouldCache = 0;
                     if (use_pclose) {
-                        PCLOSE(fp);
+                        PCLOSE(Ctx->fp);
                     } else {
-                        FCLOSE(fp);
+                        FCLOSE(Ctx->fp);
                     }
 		    return E_NO_MEM;
 		}
@@ -440,29 +459,29 @@ static int CacheFile(char const *fname, int use_pclose)
 	    } else {
 		cl->next = NEW(CachedLine);
 		if (!cl->next) {
-		    DBufFree(&LineBuffer);
+		    DBufFree(&Ctx->LineBuffer);
 		    DestroyCache(cf);
-		    ShouldCache = 0;
+		    Ctx->ShouldCache = 0;
                     if (use_pclose) {
-                        PCLOSE(fp);
+                        PCLOSE(Ctx->fp);
                     } else {
-                        FCLOSE(fp);
+                        FCLOSE(Ctx->fp);
                     }
 		    return E_NO_MEM;
 		}
 		cl = cl->next;
 	    }
 	    cl->next = NULL;
-	    cl->LineNo = LineNo;
+	    cl->LineNo = Ctx->LineNo;
 	    cl->text = StrDup(s);
-	    DBufFree(&LineBuffer);
+	    DBufFree(&Ctx->LineBuffer);
 	    if (!cl->text) {
 		DestroyCache(cf);
-		ShouldCache = 0;
+		Ctx->ShouldCache = 0;
                 if (use_pclose) {
-                    PCLOSE(fp);
+                    PCLOSE(Ctx->fp);
                 } else {
-                    FCLOSE(fp);
+                    FCLOSE(Ctx->fp);
                 }
 		return E_NO_MEM;
 	    }
@@ -506,47 +525,47 @@ static int PopFile(void)
 {
     IncludeStruct *i;
 
-    if (!Hush && NumIfs) Eprint("%s", ErrMsg[E_MISS_ENDIF]);
-    if (!IStackPtr) return E_EOF;
-    i = &IStack[IStackPtr-1];
+    if (!Ctx->Hush && Ctx->NumIfs) Eprint("%s", ErrMsg[E_MISS_ENDIF]);
+    if (!Ctx->IStackPtr) return E_EOF;
+    i = &Ctx->IStack[Ctx->IStackPtr-1];
 
     if (i->chain) {
-	int oldRunDisabled = RunDisabled;
+	int oldRunDisabled = Ctx->RunDisabled;
 	if (NextChainedFile(i) == OK) {
 	    return OK;
 	}
-	RunDisabled = oldRunDisabled;
+	Ctx->RunDisabled = oldRunDisabled;
     }
 
-    if (IStackPtr <= 1) {
+    if (Ctx->IStackPtr <= 1) {
 	return E_EOF;
     }
 
-    IStackPtr--;
+    Ctx->IStackPtr--;
 
-    LineNo = i->LineNo;
-    IfFlags = i->IfFlags;
-    NumIfs = i->NumIfs;
-    CLine = i->CLine;
-    fp = NULL;
-    STRSET(FileName, i->filename);
+    Ctx->LineNo = i->LineNo;
+    Ctx->IfFlags = i->IfFlags;
+    Ctx->NumIfs = i->NumIfs;
+    Ctx->CLine = i->CLine;
+    Ctx->fp = NULL;
+    STRSET(Ctx->FileName, i->filename);
     if (!i->ownedByMe) {
-	RunDisabled |= RUN_NOTOWNER;
+	Ctx->RunDisabled |= RUN_NOTOWNER;
     } else {
-	RunDisabled &= ~RUN_NOTOWNER;
+	Ctx->RunDisabled &= ~RUN_NOTOWNER;
     }
-    if (!CLine && (i->offset != -1L || !strcmp(i->filename, "-"))) {
+    if (!Ctx->CLine && (i->offset != -1L || !strcmp(i->filename, "-"))) {
 	/* We must open the file, then seek to specified position */
 	if (strcmp(i->filename, "-")) {
-	    fp = fopen(i->filename, "r");
-	    if (!fp || !CheckSafety()) return E_CANT_OPEN;
-	    if (PurgeMode) OpenPurgeFile(i->filename, "a");
+	    Ctx->fp = fopen(i->filename, "r");
+	    if (!Ctx->fp || !CheckSafety()) return E_CANT_OPEN;
+	    if (Ctx->PurgeMode) OpenPurgeFile(i->filename, "a");
 	} else {
-	    fp = stdin;
-	    if (PurgeMode) PurgeFP = stdout;
+	    Ctx->fp = stdin;
+	    if (Ctx->PurgeMode) Ctx->PurgeFP = stdout;
 	}
-	if (fp != stdin)
-	    (void) fseek(fp, i->offset, 0);  /* Trust that it works... */
+	if (Ctx->fp != stdin)
+	    (void) fseek(Ctx->fp, i->offset, 0);  /* Trust that it works... */
     }
     free((char *) i->filename);
     return OK;
@@ -578,7 +597,7 @@ int DoInclude(ParsePtr p, enum TokTypes tok)
     if (tok == T_IncludeR && *(DBufValue(&buf)) != '/') {
         /* Relative include: Include relative to dir
            containing current file */
-        if (DBufPuts(&path, FileName) != OK) {
+        if (DBufPuts(&path, Ctx->FileName) != OK) {
             r = E_NO_MEM;
             goto bailout;
         }
@@ -613,8 +632,8 @@ int DoInclude(ParsePtr p, enum TokTypes tok)
         goto bailout;
     }
 
-    NumIfs = 0;
-    IfFlags = 0;
+    Ctx->NumIfs = 0;
+    Ctx->IfFlags = 0;
 
   bailout:
     DBufFree(&buf);
@@ -666,7 +685,7 @@ int DoIncludeCmd(ParsePtr p)
 	}
     }
 
-    if (RunDisabled) {
+    if (Ctx->RunDisabled) {
         DBufFree(&buf);
         return E_RUN_DISABLED;
     }
@@ -676,19 +695,20 @@ int DoIncludeCmd(ParsePtr p)
 	return r;
     }
     DBufFree(&buf);
-    NumIfs = 0;
-    IfFlags = 0;
+    Ctx->NumIfs = 0;
+    Ctx->IfFlags = 0;
     return OK;
 }
 
 #ifdef HAVE_GLOB
-static int SetupGlobChain(char const *dirname, IncludeStruct *i)
+static int SetupGlobChainUnlocked(char const *dirname, IncludeStruct *i)
 {
     DynamicBuffer pattern;
     char *dir;
     size_t l;
     int r;
     glob_t glob_buf;
+    struct stat statbuf;
     DirectoryFilenameChain *dc = CachedDirectoryChains;
 
     i->chain = NULL;
@@ -716,7 +736,7 @@ static int SetupGlobChain(char const *dirname, IncludeStruct *i)
     /* Check the cache */
     while(dc) {
 	if (!strcmp(dc->dirname, dir)) {
-	    if (DebugFlag & DB_TRACE_FILES) {
+	    if (Ctx->DebugFlag & DB_TRACE_FILES) {
 		fprintf(ErrFp, "Found cached directory listing for `%s'\n",
 			dir);
 	    }
@@ -727,11 +747,11 @@ static int SetupGlobChain(char const *dirname, IncludeStruct *i)
 	dc = dc->next;
     }
 
-    if (DebugFlag & DB_TRACE_FILES) {
+    if (Ctx->DebugFlag & DB_TRACE_FILES) {
 	fprintf(ErrFp, "Scanning directory `%s' for *.rem files\n", dir);
     }
 
-    if (ShouldCache) {
+    if (Ctx->ShouldCache) {
 	dc = malloc(sizeof(DirectoryFilenameChain));
 	if (dc) {
 	    dc->dirname = StrDup(dir);
@@ -741,11 +761,13 @@ static int SetupGlobChain(char const *dirname, IncludeStruct *i)
 	    }
 	}
 	if (dc) {
-	    if (DebugFlag & DB_TRACE_FILES) {
+	    if (Ctx->DebugFlag & DB_TRACE_FILES) {
 		fprintf(ErrFp, "Caching directory `%s' listing\n", dir);
 	    }
 
 	    dc->chain = NULL;
+	    dc->mtime = 0;
+	    if (!stat(dir, &statbuf)) dc->mtime = statbuf.st_mtime;
 	    dc->next = CachedDirectoryChains;
 	    CachedDirectoryChains = dc;
 	}
@@ -799,6 +821,16 @@ static int SetupGlobChain(char const *dirname, IncludeStruct *i)
     globfree(&glob_buf);
     return OK;
 }
+
+static int SetupGlobChain(char const *dirname, IncludeStruct *i)
+{
+    int r;
+
+    LOCK_CACHE();
+    r = SetupGlobChainUnlocked(dirname, i);
+    UNLOCK_CACHE();
+    return r;
+}
 #endif
 
 /***************************************************************/
@@ -810,6 +842,16 @@ static int SetupGlobChain(char const *dirname, IncludeStruct *i)
 /*                                                             */
 /***************************************************************/
 static int IncludeCmd(char const *cmd)
+{
+    int r;
+
+    LOCK_CACHE();
+    r = IncludeCmdUnlocked(cmd);
+    UNLOCK_CACHE();
+    return r;
+}
+
+static int IncludeCmdUnlocked(char const *cmd)
 {
     IncludeStruct *i;
     DynamicBuffer buf;
@@ -819,10 +861,10 @@ static int IncludeCmd(char const *cmd)
     char const *fname;
     int old_flag;
 
-    FreshLine = 1;
+    Ctx->FreshLine = 1;
     clear_callstack();
-    if (IStackPtr+1 >= INCLUDE_NEST) return E_NESTED_INCLUDE;
-    i = &IStack[IStackPtr];
+    if (Ctx->IStackPtr+1 >= INCLUDE_NEST) return E_NESTED_INCLUDE;
+    i = &Ctx->IStack[Ctx->IStackPtr];
 
     /* Use "cmd|" as the filename */
     DBufInit(&buf);
@@ -836,8 +878,8 @@ static int IncludeCmd(char const *cmd)
     }
     fname = DBufValue(&buf);
 
-    if (FileName) {
-	i->filename = StrDup(FileName);
+    if (Ctx->FileName) {
+	i->filename = StrDup(Ctx->FileName);
 	if (!i->filename) {
 	    DBufFree(&buf);
 	    return E_NO_MEM;
@@ -846,40 +888,40 @@ static int IncludeCmd(char const *cmd)
 	i->filename = NULL;
     }
     i->ownedByMe = 1;
-    i->LineNo = LineNo;
-    i->NumIfs = NumIfs;
-    i->IfFlags = IfFlags;
-    i->CLine = CLine;
+    i->LineNo = Ctx->LineNo;
+    i->NumIfs = Ctx->NumIfs;
+    i->IfFlags = Ctx->IfFlags;
+    i->CLine = Ctx->CLine;
     i->offset = -1L;
     i->chain = NULL;
-    if (fp) {
-	i->offset = ftell(fp);
-	FCLOSE(fp);
+    if (Ctx->fp) {
+	i->offset = ftell(Ctx->fp);
+	FCLOSE(Ctx->fp);
     }
-    IStackPtr++;
+    Ctx->IStackPtr++;
 
     /* If the file is cached, use it */
     h = CachedFiles;
     while(h) {
         if (!strcmp(fname, h->filename)) {
-            if (DebugFlag & DB_TRACE_FILES) {
+            if (Ctx->DebugFlag & DB_TRACE_FILES) {
                 fprintf(ErrFp, "Reading command `%s': Found in cache\n", fname);
             }
-            CLine = h->cache;
-            STRSET(FileName, fname);
+            Ctx->CLine = h->cache;
+            STRSET(Ctx->FileName, fname);
             DBufFree(&buf);
-            LineNo = 0;
+            Ctx->LineNo = 0;
             if (!h->ownedByMe) {
-                RunDisabled |= RUN_NOTOWNER;
+                Ctx->RunDisabled |= RUN_NOTOWNER;
             } else {
-                RunDisabled &= ~RUN_NOTOWNER;
+                Ctx->RunDisabled &= ~RUN_NOTOWNER;
             }
-            if (FileName) return OK; else return E_NO_MEM;
+            if (Ctx->FileName) return OK; else return E_NO_MEM;
         }
         h = h->next;
     }
 
-    if (DebugFlag & DB_TRACE_FILES) {
+    if (Ctx->DebugFlag & DB_TRACE_FILES) {
         fprintf(ErrFp, "Executing `%s' for INCLUDECMD and caching as `%s'\n",
                 cmd, fname);
     }
@@ -896,24 +938,24 @@ static int IncludeCmd(char const *cmd)
 	DBufFree(&buf);
 	return E_CANT_OPEN;
     }
-    fp = fp2;
-    LineNo = 0;
+    Ctx->fp = fp2;
+    Ctx->LineNo = 0;
 
     /* Temporarily turn of file tracing */
-    old_flag = DebugFlag;
-    DebugFlag &= (~DB_TRACE_FILES);
+    old_flag = Ctx->DebugFlag;
+    Ctx->DebugFlag &= (~DB_TRACE_FILES);
 
     if (cmd[0] == '!') {
-        RunDisabled |= RUN_NOTOWNER;
+        Ctx->RunDisabled |= RUN_NOTOWNER;
     }
     r = CacheFile(fname, 1);
 
-    DebugFlag = old_flag;
+    Ctx->DebugFlag = old_flag;
     if (r == OK) {
-	fp = NULL;
-	CLine = CachedFiles->cache;
-	LineNo = 0;
-	STRSET(FileName, fname);
+	Ctx->fp = NULL;
+	Ctx->CLine = CachedFiles->cache;
+	Ctx->LineNo = 0;
+	STRSET(Ctx->FileName, fname);
 	DBufFree(&buf);
 	return OK;
     }
@@ -937,34 +979,34 @@ int IncludeFile(char const *fname)
     int oldRunDisabled;
     struct stat statbuf;
 
-    FreshLine = 1;
+    Ctx->FreshLine = 1;
     clear_callstack();
-    if (IStackPtr+1 >= INCLUDE_NEST) return E_NESTED_INCLUDE;
-    i = &IStack[IStackPtr];
+    if (Ctx->IStackPtr+1 >= INCLUDE_NEST) return E_NESTED_INCLUDE;
+    i = &Ctx->IStack[Ctx->IStackPtr];
 
-    if (FileName) {
-	i->filename = StrDup(FileName);
+    if (Ctx->FileName) {
+	i->filename = StrDup(Ctx->FileName);
 	if (!i->filename) return E_NO_MEM;
     } else {
 	i->filename = NULL;
     }
-    i->LineNo = LineNo;
-    i->NumIfs = NumIfs;
-    i->IfFlags = IfFlags;
-    i->CLine = CLine;
+    i->LineNo = Ctx->LineNo;
+    i->NumIfs = Ctx->NumIfs;
+    i->IfFlags = Ctx->IfFlags;
+    i->CLine = Ctx->CLine;
     i->offset = -1L;
     i->chain = NULL;
-    if (RunDisabled & RUN_NOTOWNER) {
+    if (Ctx->RunDisabled & RUN_NOTOWNER) {
 	i->ownedByMe = 0;
     } else {
 	i->ownedByMe = 1;
     }
-    if (fp) {
-	i->offset = ftell(fp);
-	FCLOSE(fp);
+    if (Ctx->fp) {
+	i->offset = ftell(Ctx->fp);
+	FCLOSE(Ctx->fp);
     }
 
-    IStackPtr++;
+    Ctx->IStackPtr++;
 
 #ifdef HAVE_GLOB
     /* If it's a directory, set up the glob chain here. */
@@ -973,7 +1015,7 @@ int IncludeFile(char const *fname)
 	if (S_ISDIR(statbuf.st_mode)) {
 	    if (SetupGlobChain(fname, i) == OK) { /* Glob succeeded */
 		if (!i->chain) { /* Oops... no matching files */
-		    if (!Hush) {
+		    if (!Ctx->Hush) {
 			Eprint("%s: %s", fname, ErrMsg[E_NO_MATCHING_REMS]);
 		    }
 		    PopFile();
@@ -984,17 +1026,17 @@ int IncludeFile(char const *fname)
 		    i->chain = i->chain->next;
 
 		    /* Munch first file */
-		    oldRunDisabled = RunDisabled;
+		    oldRunDisabled = Ctx->RunDisabled;
 		    if (!OpenFile(fc->filename)) {
 			return OK;
 		    }
 		    Eprint("%s: %s", ErrMsg[E_CANT_OPEN], fc->filename);
-		    RunDisabled = oldRunDisabled;
+		    Ctx->RunDisabled = oldRunDisabled;
 		}
 		/* Couldn't open anything... bail */
 		return PopFile();
 	    } else {
-		if (!Hush) {
+		if (!Ctx->Hush) {
 		    Eprint("%s: %s", fname, ErrMsg[E_NO_MATCHING_REMS]);
 		}
 	    }
@@ -1003,12 +1045,12 @@ int IncludeFile(char const *fname)
     }
 #endif
 
-    oldRunDisabled = RunDisabled;
+    oldRunDisabled = Ctx->RunDisabled;
     /* Try to open the new file */
     if (!OpenFile(fname)) {
 	return OK;
     }
-    RunDisabled = oldRunDisabled;
+    Ctx->RunDisabled = oldRunDisabled;
     Eprint("%s: %s", ErrMsg[E_CANT_OPEN], fname);
     /* Ugh!  We failed!  */
     PopFile();
@@ -1023,15 +1065,17 @@ int IncludeFile(char const *fname)
 int GetAccessDate(char const *file)
 {
     struct stat statbuf;
-    struct tm *t1;
+    struct tm t1;
 
     if (stat(file, &statbuf)) return -1;
-    t1 = localtime(&(statbuf.st_atime));
+    LockTz();
+    localtime_r(&(statbuf.st_atime), &t1);
+    UnlockTz();
 
-    if (t1->tm_year + 1900 < BASE)
+    if (t1.tm_year + 1900 < BASE)
 	return 0;
     else
-	return Julian(t1->tm_year+1900, t1->tm_mon, t1->tm_mday);
+	return Julian(t1.tm_year+1900, t1.tm_mon, t1.tm_mday);
 }
 
 /***************************************************************/
@@ -1067,6 +1111,100 @@ static void DestroyCache(CachedFile *cf)
     free(cf);
 }
 
+/***************************************************************/
+/*                                                             */
+/*  ClearFileCache                                             */
+/*                                                             */
+/*  Forget all cached files and directory listings, so that    */
+/*  they are read from disk again.                             */
+/*                                                             */
+/***************************************************************/
+void ClearFileCache(void)
+{
+    DirectoryFilenameChain *dc;
+
+    while (CachedFiles) DestroyCache(CachedFiles);
+    ClearTables(NULL);
+    while (CachedDirectoryChains) {
+	dc = CachedDirectoryChains;
+	CachedDirectoryChains = dc->next;
+	FreeChain(dc->chain);
+	free((char *) dc->dirname);
+	free(dc);
+    }
+}
+
+/***************************************************************/
+/*                                                             */
+/*  UncacheFile                                                */
+/*                                                             */
+/*  Forget the cached copy of fname, if there is one.          */
+/*                                                             */
+/***************************************************************/
+void UncacheFile(char const *fname)
+{
+    CachedFile *cf;
+
+    ClearTables(fname);
+    for (cf = CachedFiles; cf; cf = cf->next) {
+	if (!strcmp(cf->filename, fname)) {
+	    DestroyCache(cf);
+	    return;
+	}
+    }
+}
+
+/***************************************************************/
+/*                                                             */
+/*  FileCacheStale                                             */
+/*                                                             */
+/*  Return 1 if any cached file or directory has changed on    */
+/*  disk (or vanished) since it was cached, 0 otherwise.       */
+/*                                                             */
+/***************************************************************/
+int FileCacheStale(void)
+{
+    CachedFile *cf;
+    DirectoryFilenameChain *dc;
+    struct stat statbuf;
+
+    for (cf = CachedFiles; cf; cf = cf->next) {
+	if (!cf->mtime) continue;
+	if (stat(cf->filename, &statbuf) ||
+	    statbuf.st_mtime != cf->mtime || statbuf.st_size != cf->size) {
+	    return 1;
+	}
+    }
+    for (dc = CachedDirectoryChains; dc; dc = dc->next) {
+	if (!dc->mtime) continue;
+	if (stat(dc->dirname, &statbuf) || statbuf.st_mtime != dc->mtime) {
+	    return 1;
+	}
+    }
+    return TablesStale();
+}
+
+/***************************************************************/
+/*                                                             */
+/*  ClearIncludeStack                                          */
+/*                                                             */
+/*  Close any file still open and empty the INCLUDE stack, so  */
+/*  that the next IncludeFile starts again at the top level.   */
+/*                                                             */
+/***************************************************************/
+void ClearIncludeStack(void)
+{
+    FCLOSE(Ctx->fp);
+    while (Ctx->IStackPtr > 0) {
+	Ctx->IStackPtr--;
+	free((char *) Ctx->IStack[Ctx->IStackPtr].filename);
+	Ctx->IStack[Ctx->IStackPtr].filename = NULL;
+    }
+    Ctx->CLine = NULL;
+    Ctx->NumIfs = 0;
+    Ctx->IfFlags = 0;
+}
+
 /***************************************************************/
 /*                                                             */
 /*  TopLevel                                                   */
@@ -1076,7 +1214,7 @@ static void DestroyCache(CachedFile *cf)
 /***************************************************************/
 int TopLevel(void)
 {
-    return IStackPtr <= 1;
+    return Ctx->IStackPtr <= 1;
 }
 
 /***************************************************************/
@@ -1095,13 +1233,13 @@ static int CheckSafety(void)
 {
     struct stat statbuf;
 
-    if (fp == stdin) {
+    if (Ctx->fp == stdin) {
 	return 1;
     }
 
-    if (fstat(fileno(fp), &statbuf)) {
-	fclose(fp);
-	fp = NULL;
+    if (fstat(fileno(Ctx->fp), &statbuf)) {
+	fclose(Ctx->fp);
+	Ctx->fp = NULL;
 	return 0;
     }
 
@@ -1110,8 +1248,8 @@ static int CheckSafety(void)
 	/* Reject files not owned by root or group/world writable */
 	if (statbuf.st_uid != 0) {
 	    fprintf(ErrFp, "SECURITY: Won't read non-root-owned file when running as root!\n");
-	    fclose(fp);
-	    fp = NULL;
+	    fclose(Ctx->fp);
+	    Ctx->fp = NULL;
 	    return 0;
 	}
     }
@@ -1122,24 +1260,24 @@ static int CheckSafety(void)
     }
     if ((statbuf.st_mode & S_IWOTH)) {
 	fprintf(ErrFp, "SECURITY: Won't read world-writable file!\n");
-	fclose(fp);
-	fp = NULL;
+	fclose(Ctx->fp);
+	Ctx->fp = NULL;
 	return 0;
     }
 
     /* If file is not owned by me or a trusted user, disable RUN command */
 
     /* Assume unsafe */
-    RunDisabled |= RUN_NOTOWNER;
+    Ctx->RunDisabled |= RUN_NOTOWNER;
     if (statbuf.st_uid == geteuid()) {
         /* Owned by me... safe */
-	RunDisabled &= ~RUN_NOTOWNER;
+	Ctx->RunDisabled &= ~RUN_NOTOWNER;
     } else {
         int i;
         for (i=0; i<NumTrustedUsers; i++) {
             if (statbuf.st_uid == TrustedUsers[i]) {
                 /* Owned by a trusted user... safe */
-                RunDisabled &= ~RUN_NOTOWNER;
+                Ctx->RunDisabled &= ~RUN_NOTOWNER;
                 break;
             }
         }
@@ -55,6 +55,20 @@
 #include "err.h"
 #include "expr.h"
 
+#ifdef USE_THREADS
+#include <pthread.h>
+
+/* TZ is shared by every thread, and tzconvert() and utctolocal()
+   change it while they work, so every mktime() and localtime_r()
+   that might run in a calendar thread must hold TzLock */
+static pthread_mutex_t TzLock = PTHREAD_MUTEX_INITIALIZER;
+void LockTz(void) { pthread_mutex_lock(&TzLock); }
+void UnlockTz(void) { pthread_mutex_unlock(&TzLock); }
+#else
+void LockTz(void) {}
+void UnlockTz(void) {}
+#endif
+
 /* Defines that used to be static variables */
 #define Nargs (info->nargs)
 #define RetVal (info->retval)
@@ -180,21 +194,9 @@ static int tz_set_tz       (char const *tz);
 /* "Overload" the struct Operator definition */
 #define NO_MAX 127
 
-/* Caches for extracting months, days, years from dates - may
-   improve performance slightly. */
-static int CacheJul = -1;
-static int CacheYear, CacheMon, CacheDay;
-
-static int CacheHebJul = -1;
-static int CacheHebYear, CacheHebMon, CacheHebDay;
-
-/* We need access to the value stack */
-extern Value ValStack[];
-extern int ValStackPtr;
-
 /* Macro for accessing arguments from the value stack - args are numbered
    from 0 to (Nargs - 1) */
-#define ARG(x) (ValStack[ValStackPtr - Nargs + (x)])
+#define ARG(x) (Ctx->ValStack[Ctx->ValStackPtr - Nargs + (x)])
 
 #define ARGV(x) ARG(x).v.val
 #define ARGSTR(x) ARG(x).v.str
@@ -358,7 +360,7 @@ int CallFunc(BuiltinFunc *f, int nargs)
     Nargs = nargs;
     RetVal.type = ERR_TYPE;
 
-    if (DebugFlag & DB_PRTEXPR) {
+    if (Ctx->DebugFlag & DB_PRTEXPR) {
 	fprintf(ErrFp, "%s(", f->name);
 	for (i=0; i<nargs; i++) {
 	    PrintValue(&ARG(i), ErrFp);
@@ -378,13 +380,13 @@ int CallFunc(BuiltinFunc *f, int nargs)
     r = (*(f->func))(info);
     if (r) {
 	DestroyValue(RetVal);
-	if (DebugFlag & DB_PRTEXPR)
+	if (Ctx->DebugFlag & DB_PRTEXPR)
 	    fprintf(ErrFp, "%s\n", ErrMsg[r]);
 	else
 	    Eprint("%s(): %s", f->name, ErrMsg[r]);
 	return r;
     }
-    if (DebugFlag & DB_PRTEXPR) {
+    if (Ctx->DebugFlag & DB_PRTEXPR) {
 	PrintValue(&RetVal, ErrFp);
 	fprintf(ErrFp, "\n");
     }
@@ -742,14 +744,14 @@ static int FDay(func_info *info)
     if (!HASDATE(ARG(0))) return E_BAD_TYPE;
     v = DATEPART(ARG(0));
 
-    if (v == CacheJul)
-	d = CacheDay;
+    if (v == Ctx->CacheJul)
+	d = Ctx->CacheDay;
     else {
 	FromJulian(v, &y, &m, &d);
-	CacheJul = v;
-	CacheYear = y;
-	CacheMon = m;
-	CacheDay = d;
+	Ctx->CacheJul = v;
+	Ctx->CacheYear = y;
+	Ctx->CacheMon = m;
+	Ctx->CacheDay = d;
     }
     RetVal.type = INT_TYPE;
     RETVAL = d;
@@ -762,14 +764,14 @@ static int FMonnum(func_info *info)
     if (!HASDATE(ARG(0))) return E_BAD_TYPE;
     v = DATEPART(ARG(0));
 
-    if (v == CacheJul)
-	m = CacheMon;
+    if (v == Ctx->CacheJul)
+	m = Ctx->CacheMon;
     else {
 	FromJulian(v, &y, &m, &d);
-	CacheJul = v;
-	CacheYear = y;
-	CacheMon = m;
-	CacheDay = d;
+	Ctx->CacheJul = v;
+	Ctx->CacheYear = y;
+	Ctx->CacheMon = m;
+	Ctx->CacheDay = d;
     }
     RetVal.type = INT_TYPE;
     RETVAL = m+1;
@@ -782,14 +784,14 @@ static int FYear(func_info *info)
     if (!HASDATE(ARG(0))) return E_BAD_TYPE;
     v = DATEPART(ARG(0));
 
-    if (v == CacheJul)
-	y = CacheYear;
+    if (v == Ctx->CacheJul)
+	y = Ctx->CacheYear;
     else {
 	FromJulian(v, &y, &m, &d);
-	CacheJul = v;
-	CacheYear = y;
-	CacheMon = m;
-	CacheDay = d;
+	Ctx->CacheJul = v;
+	Ctx->CacheYear = y;
+	Ctx->CacheMon = m;
+	Ctx->CacheDay = d;
     }
     RetVal.type = INT_TYPE;
     RETVAL = y;
@@ -838,14 +840,14 @@ static int FMon(func_info *info)
 	if (m > 11) return E_2HIGH;
     } else {
 	v = DATEPART(ARG(0));
-	if (v == CacheJul)
-	    m = CacheMon;
+	if (v == Ctx->CacheJul)
+	    m = Ctx->CacheMon;
 	else {
 	    FromJulian(v, &y, &m, &d);
-	    CacheJul = v;
-	    CacheYear = y;
-	    CacheMon = m;
-	    CacheDay = d;
+	    Ctx->CacheJul = v;
+	    Ctx->CacheYear = y;
+	    Ctx->CacheMon = m;
+	    Ctx->CacheDay = d;
 	}
     }
     s = get_month_name(m);
@@ -995,7 +997,7 @@ static int FAnsicolor(func_info *info)
     }
 
     /* All righ!  We have our parameters; now return the string */
-    if (!UseVTColors) {
+    if (!Ctx->UseVTColors) {
         /* Not using any colors: Empty strin */
         return RetStrVal("", info);
     }
@@ -1043,15 +1045,15 @@ static int FAmpm(func_info *info)
 	/* AM */
 	if (h == 0) {
 	    if (ARG(0).type == DATETIME_TYPE) {
-		snprintf(outbuf, sizeof(outbuf), "%04d%c%02d%c%02d%c12%c%02d", yr, DateSep, mo+1, DateSep, da, DateTimeSep, TimeSep, m);
+		snprintf(outbuf, sizeof(outbuf), "%04d%c%02d%c%02d%c12%c%02d", yr, Ctx->DateSep, mo+1, Ctx->DateSep, da, Ctx->DateTimeSep, Ctx->TimeSep, m);
 	    } else {
-		snprintf(outbuf, sizeof(outbuf), "12%c%02d", TimeSep, m);
+		snprintf(outbuf, sizeof(outbuf), "12%c%02d", Ctx->TimeSep, m);
 	    }
 	} else {
 	    if (ARG(0).type == DATETIME_TYPE) {
-		snprintf(outbuf, sizeof(outbuf), "%04d%c%02d%c%02d%c%d%c%02d", yr, DateSep, mo+1, DateSep, da, DateTimeSep, h, TimeSep, m);
+		snprintf(outbuf, sizeof(outbuf), "%04d%c%02d%c%02d%c%d%c%02d", yr, Ctx->DateSep, mo+1, Ctx->DateSep, da, Ctx->DateTimeSep, h, Ctx->TimeSep, m);
 	    } else {
-		snprintf(outbuf, sizeof(outbuf), "%d%c%02d", h, TimeSep, m);
+		snprintf(outbuf, sizeof(outbuf), "%d%c%02d", h, Ctx->TimeSep, m);
 	    }
 	}
 	ampm = am;
@@ -1060,9 +1062,9 @@ static int FAmpm(func_info *info)
 	    h -= 12;
 	}
 	if (ARG(0).type == DATETIME_TYPE) {
-	    snprintf(outbuf, sizeof(outbuf), "%04d%c%02d%c%02d%c%d%c%02d", yr, DateSep, mo+1, DateSep, da, DateTimeSep, h, TimeSep, m);
+	    snprintf(outbuf, sizeof(outbuf), "%04d%c%02d%c%02d%c%d%c%02d", yr, Ctx->DateSep, mo+1, Ctx->DateSep, da, Ctx->DateTimeSep, h, Ctx->TimeSep, m);
 	} else {
-	    snprintf(outbuf, sizeof(outbuf), "%d%c%02d", h, TimeSep, m);
+	    snprintf(outbuf, sizeof(outbuf), "%d%c%02d", h, Ctx->TimeSep, m);
 	}
 	ampm = pm;
     }
@@ -1145,7 +1147,7 @@ static int FPad(func_info *info)
         return E_BAD_TYPE;
     }
 
-    if (MaxStringLen > 0 && wantlen > (size_t) MaxStringLen) {
+    if (Ctx->MaxStringLen > 0 && wantlen > (size_t) Ctx->MaxStringLen) {
         return E_STRING_TOO_LONG;
     }
 
@@ -1382,14 +1384,14 @@ static int FStdout(func_info *info)
 static int FToday(func_info *info)
 {
     RetVal.type = DATE_TYPE;
-    RETVAL = JulianToday;
+    RETVAL = Ctx->JulianToday;
     return OK;
 }
 
 static int FRealtoday(func_info *info)
 {
     RetVal.type = DATE_TYPE;
-    RETVAL = RealToday;
+    RETVAL = Ctx->RealToday;
     return OK;
 }
 
@@ -1410,14 +1412,14 @@ static int FRealnow(func_info *info)
 static int FCurrent(func_info *info)
 {
     RetVal.type = DATETIME_TYPE;
-    RETVAL = JulianToday * MINUTES_PER_DAY + (SystemTime(0) / 60);
+    RETVAL = Ctx->JulianToday * MINUTES_PER_DAY + (SystemTime(0) / 60);
     return OK;
 }
 
 static int FRealCurrent(func_info *info)
 {
     RetVal.type = DATETIME_TYPE;
-    RETVAL = RealToday * MINUTES_PER_DAY + (SystemTime(1) / 60);
+    RETVAL = Ctx->RealToday * MINUTES_PER_DAY + (SystemTime(1) / 60);
     return OK;
 }
 
@@ -1491,9 +1493,9 @@ static int FDefined(func_info *info)
 /***************************************************************/
 static int FTrigdate(func_info *info)
 {
-    if (LastTrigValid) {
+    if (Ctx->LastTrigValid) {
 	RetVal.type = DATE_TYPE;
-	RETVAL = LastTriggerDate;
+	RETVAL = Ctx->LastTriggerDate;
     } else {
 	RetVal.type = INT_TYPE;
 	RETVAL = 0;
@@ -1504,63 +1506,63 @@ static int FTrigdate(func_info *info)
 static int FTrigback(func_info *info)
 {
     RetVal.type = INT_TYPE;
-    RETVAL = LastTrigger.back;
+    RETVAL = Ctx->LastTrigger.back;
     return OK;
 }
 
 static int FTrigdelta(func_info *info)
 {
     RetVal.type = INT_TYPE;
-    RETVAL = LastTrigger.delta;
+    RETVAL = Ctx->LastTrigger.delta;
     return OK;
 }
 
 static int FTrigtimedelta(func_info *info)
 {
     RetVal.type = INT_TYPE;
-    RETVAL = LastTimeTrig.delta;
+    RETVAL = Ctx->LastTimeTrig.delta;
     return OK;
 }
 
 static int FTrigtimerep(func_info *info)
 {
     RetVal.type = INT_TYPE;
-    RETVAL = LastTimeTrig.rep;
+    RETVAL = Ctx->LastTimeTrig.rep;
     return OK;
 }
 
 static int FTrigeventduration(func_info *info)
 {
-    if (LastTrigger.eventduration == NO_TIME) {
+    if (Ctx->LastTrigger.eventduration == NO_TIME) {
 	RetVal.type = INT_TYPE;
 	RETVAL = -1;
     } else {
 	RetVal.type = TIME_TYPE;
-	RETVAL = LastTrigger.eventduration;
+	RETVAL = Ctx->LastTrigger.eventduration;
     }
     return OK;
 }
 
 static int FTrigeventstart(func_info *info)
 {
-    if (LastTrigger.eventstart == NO_TIME) {
+    if (Ctx->LastTrigger.eventstart == NO_TIME) {
 	RetVal.type = INT_TYPE;
 	RETVAL = -1;
     } else {
 	RetVal.type = DATETIME_TYPE;
-	RETVAL = LastTrigger.eventstart;
+	RETVAL = Ctx->LastTrigger.eventstart;
     }
     return OK;
 }
 
 static int FTrigduration(func_info *info)
 {
-    if (LastTimeTrig.duration == NO_TIME) {
+    if (Ctx->LastTimeTrig.duration == NO_TIME) {
 	RetVal.type = INT_TYPE;
 	RETVAL = -1;
     } else {
 	RetVal.type = TIME_TYPE;
-	RETVAL = LastTimeTrig.duration;
+	RETVAL = Ctx->LastTimeTrig.duration;
     }
     return OK;
 }
@@ -1568,54 +1570,54 @@ static int FTrigduration(func_info *info)
 static int FTrigrep(func_info *info)
 {
     RetVal.type = INT_TYPE;
-    RETVAL = LastTrigger.rep;
+    RETVAL = Ctx->LastTrigger.rep;
     return OK;
 }
 
 static int FTrigtags(func_info *info)
 {
-    return RetStrVal(DBufValue(&(LastTrigger.tags)), info);
+    return RetStrVal(DBufValue(&(Ctx->LastTrigger.tags)), info);
 }
 
 static int FTrigpriority(func_info *info)
 {
     RetVal.type = INT_TYPE;
-    RETVAL = LastTrigger.priority;
+    RETVAL = Ctx->LastTrigger.priority;
     return OK;
 }
 
 static int FTriguntil(func_info *info)
 {
-    if (LastTrigger.until == NO_UNTIL) {
+    if (Ctx->LastTrigger.until == NO_UNTIL) {
 	RetVal.type = INT_TYPE;
 	RETVAL = -1;
     } else {
 	RetVal.type = DATE_TYPE;
-	RETVAL = LastTrigger.until;
+	RETVAL = Ctx->LastTrigger.until;
     }
     return OK;
 }
 
 static int FTrigscanfrom(func_info *info)
 {
-    if (LastTrigger.scanfrom == NO_DATE) {
+    if (Ctx->LastTrigger.scanfrom == NO_DATE) {
 	RetVal.type = INT_TYPE;
 	RETVAL = -1;
     } else {
 	RetVal.type = DATE_TYPE;
-	RETVAL = LastTrigger.scanfrom;
+	RETVAL = Ctx->LastTrigger.scanfrom;
     }
     return OK;
 }
 
 static int FTrigfrom(func_info *info)
 {
-    if (LastTrigger.from == NO_DATE) {
+    if (Ctx->LastTrigger.from == NO_DATE) {
 	RetVal.type = INT_TYPE;
 	RETVAL = -1;
     } else {
 	RetVal.type = DATE_TYPE;
-	RETVAL = LastTrigger.from;
+	RETVAL = Ctx->LastTrigger.from;
     }
     return OK;
 }
@@ -1623,15 +1625,15 @@ static int FTrigfrom(func_info *info)
 static int FTrigvalid(func_info *info)
 {
     RetVal.type = INT_TYPE;
-    RETVAL = LastTrigValid;
+    RETVAL = Ctx->LastTrigValid;
     return OK;
 }
 
 static int FTrigtime(func_info *info)
 {
-    if (LastTriggerTime != NO_TIME) {
+    if (Ctx->LastTriggerTime != NO_TIME) {
 	RetVal.type = TIME_TYPE;
-	RETVAL = LastTriggerTime;
+	RETVAL = Ctx->LastTriggerTime;
     } else {
 	RetVal.type = INT_TYPE;
 	RETVAL = 0;
@@ -1641,15 +1643,15 @@ static int FTrigtime(func_info *info)
 
 static int FTrigdatetime(func_info *info)
 {
-    if (!LastTrigValid) {
+    if (!Ctx->LastTrigValid) {
 	RetVal.type = INT_TYPE;
 	RETVAL = 0;
-    } else if (LastTriggerTime != NO_TIME) {
+    } else if (Ctx->LastTriggerTime != NO_TIME) {
 	RetVal.type = DATETIME_TYPE;
-	RETVAL = LastTriggerDate * MINUTES_PER_DAY + LastTriggerTime;
+	RETVAL = Ctx->LastTriggerDate * MINUTES_PER_DAY + Ctx->LastTriggerTime;
     } else {
 	RetVal.type = DATE_TYPE;
-	RETVAL = LastTriggerDate;
+	RETVAL = Ctx->LastTriggerDate;
     }
     return OK;
 }
@@ -1779,7 +1781,7 @@ static int FShell(func_info *info)
     int maxlen = 511;
 
     DBufInit(&buf);
-    if (RunDisabled) return E_RUN_DISABLED;
+    if (Ctx->RunDisabled) return E_RUN_DISABLED;
     ASSERT_TYPE(0, STR_TYPE);
     if (Nargs >= 2) {
 	ASSERT_TYPE(1, INT_TYPE);
@@ -1788,9 +1790,9 @@ static int FShell(func_info *info)
 
     /* Don't allow maxlen to exceed the maximum length of
        a string variable */
-    if (MaxStringLen > 0) {
-        if (maxlen <= 0 || maxlen > MaxStringLen) {
-            maxlen = MaxStringLen;
+    if (Ctx->MaxStringLen > 0) {
+        if (maxlen <= 0 || maxlen > Ctx->MaxStringLen) {
+            maxlen = Ctx->MaxStringLen;
         }
     }
 
@@ -1957,7 +1959,7 @@ static int FIif(func_info *info)
 /***************************************************************/
 static int FFilename(func_info *info)
 {
-    return RetStrVal(FileName, info);
+    return RetStrVal(Ctx->FileName, info);
 }
 
 /***************************************************************/
@@ -1975,7 +1977,7 @@ static int FFiledir(func_info *info)
 
     DBufInit(&buf);
 
-    if (DBufPuts(&buf, FileName) != OK) return E_NO_MEM;
+    if (DBufPuts(&buf, Ctx->FileName) != OK) return E_NO_MEM;
     if (DBufLen(&buf) == 0) {
 	DBufFree(&buf);
 	return RetStrVal(".", info);
@@ -2053,7 +2055,7 @@ static int FTypeof(func_info *info)
 /***************************************************************/
 static int FLanguage(func_info *info)
 {
-    return RetStrVal(L_LANGNAME, info);
+    return RetStrVal(Ctx->Lang->Name, info);
 }
 
 /***************************************************************/
@@ -2133,7 +2135,7 @@ static int FHebdate(func_info *info)
     mon = HebNameToNum(ARGSTR(1));
     if (mon < 0) return E_BAD_HEBDATE;
     if (Nargs == 2) {
-	r = GetNextHebrewDate(JulianToday, mon, day, 0, 0, &ans);
+	r = GetNextHebrewDate(Ctx->JulianToday, mon, day, 0, 0, &ans);
 	if (r) return r;
 	RetVal.type = DATE_TYPE;
 	RETVAL = ans;
@@ -2181,14 +2183,14 @@ static int FHebday(func_info *info)
 
     if (!HASDATE(ARG(0))) return E_BAD_TYPE;
     v = DATEPART(ARG(0));
-    if (v == CacheHebJul)
-	d = CacheHebDay;
+    if (v == Ctx->CacheHebJul)
+	d = Ctx->CacheHebDay;
     else {
 	JulToHeb(v, &y, &m, &d);
-	CacheHebJul = v;
-	CacheHebYear = y;
-	CacheHebMon = m;
-	CacheHebDay = d;
+	Ctx->CacheHebJul = v;
+	Ctx->CacheHebYear = y;
+	Ctx->CacheHebMon = m;
+	Ctx->CacheHebDay = d;
     }
     RetVal.type = INT_TYPE;
     RETVAL = d;
@@ -2202,15 +2204,15 @@ static int FHebmon(func_info *info)
     if (!HASDATE(ARG(0))) return E_BAD_TYPE;
     v = DATEPART(ARG(0));
 
-    if (v == CacheHebJul) {
-	m = CacheHebMon;
-	y = CacheHebYear;
+    if (v == Ctx->CacheHebJul) {
+	m = Ctx->CacheHebMon;
+	y = Ctx->CacheHebYear;
     } else {
 	JulToHeb(v, &y, &m, &d);
-	CacheHebJul = v;
-	CacheHebYear = y;
-	CacheHebMon = m;
-	CacheHebDay = d;
+	Ctx->CacheHebJul = v;
+	Ctx->CacheHebYear = y;
+	Ctx->CacheHebMon = m;
+	Ctx->CacheHebDay = d;
     }
     return RetStrVal(HebMonthName(m, y), info);
 }
@@ -2222,14 +2224,14 @@ static int FHebyear(func_info *info)
     if (!HASDATE(ARG(0))) return E_BAD_TYPE;
     v = DATEPART(ARG(0));
 
-    if (v == CacheHebJul)
-	y = CacheHebYear;
+    if (v == Ctx->CacheHebJul)
+	y = Ctx->CacheHebYear;
     else {
 	JulToHeb(v, &y, &m, &d);
-	CacheHebJul = v;
-	CacheHebYear = y;
-	CacheHebMon = m;
-	CacheHebDay = d;
+	Ctx->CacheHebJul = v;
+	Ctx->CacheHebYear = y;
+	Ctx->CacheHebMon = m;
+	Ctx->CacheHebDay = d;
     }
     RetVal.type = INT_TYPE;
     RETVAL = y;
@@ -2310,7 +2312,7 @@ static int FTimeStuff(int wantmins, func_info *info)
     int jul, tim;
     int mins, dst;
 
-    jul = JulianToday;
+    jul = Ctx->JulianToday;
     tim = 0;
 
     if (Nargs >= 1) {
@@ -2336,12 +2338,12 @@ static int FTimeStuff(int wantmins, func_info *info)
 static int FTimezone(func_info *info)
 {
     int yr, mon, day, hr, min, jul, now;
-    struct tm local, *withzone;
+    struct tm local, withzone;
     time_t t;
     char buf[64];
 
     if (Nargs == 0) {
-        jul = JulianToday;
+        jul = Ctx->JulianToday;
         now = (SystemTime(0) / 60);
     } else {
         if (!HASDATE(ARG(0))) return E_BAD_TYPE;
@@ -2365,10 +2367,12 @@ static int FTimezone(func_info *info)
     local.tm_year = yr-1900;
     local.tm_isdst = -1;
 
+    LockTz();
     t = mktime(&local);
-    withzone = localtime(&t);
+    localtime_r(&t, &withzone);
     buf[0] = 0;
-    strftime(buf, sizeof(buf), "%Z", withzone);
+    strftime(buf, sizeof(buf), "%Z", &withzone);
+    UnlockTz();
     return RetStrVal(buf, info);
 }
 
@@ -2376,7 +2380,7 @@ static int FLocalToUTC(func_info *info)
 {
     int yr, mon, day, hr, min, jul;
     time_t loc_t;
-    struct tm local, *utc;
+    struct tm local, utc;
 
     ASSERT_TYPE(0, DATETIME_TYPE);
 
@@ -2392,15 +2396,17 @@ static int FLocalToUTC(func_info *info)
     local.tm_mon = mon;
     local.tm_year = yr-1900;
     local.tm_isdst = -1;
+    LockTz();
     loc_t = mktime(&local);
+    UnlockTz();
     if (loc_t == -1) {
         return E_MKTIME_PROBLEM;
     }
 
-    utc = gmtime(&loc_t);
-    jul = Julian(utc->tm_year+1900, utc->tm_mon, utc->tm_mday);
+    gmtime_r(&loc_t, &utc);
+    jul = Julian(utc.tm_year+1900, utc.tm_mon, utc.tm_mday);
     RetVal.type = DATETIME_TYPE;
-    RETVAL = MINUTES_PER_DAY * jul + utc->tm_hour*60 + utc->tm_min;
+    RETVAL = MINUTES_PER_DAY * jul + utc.tm_hour*60 + utc.tm_min;
     return OK;
 }
 
@@ -2408,7 +2414,7 @@ static int FUTCToLocal(func_info *info)
 {
     int yr, mon, day, hr, min, jul;
     time_t utc_t;
-    struct tm *local, utc;
+    struct tm local, utc;
     char const *old_tz;
 
     ASSERT_TYPE(0, DATETIME_TYPE);
@@ -2416,6 +2422,7 @@ static int FUTCToLocal(func_info *info)
     hr = TIMEPART(ARG(0))/60;
     min = TIMEPART(ARG(0))%60;
 
+    LockTz();
     old_tz = getenv("TZ");
 
     tz_set_tz("UTC");
@@ -2432,13 +2439,15 @@ static int FUTCToLocal(func_info *info)
     tz_set_tz(old_tz);
 
     if (utc_t == -1) {
+	UnlockTz();
         return E_MKTIME_PROBLEM;
     }
 
-    local = localtime(&utc_t);
-    jul = Julian(local->tm_year+1900, local->tm_mon, local->tm_mday);
+    localtime_r(&utc_t, &local);
+    UnlockTz();
+    jul = Julian(local.tm_year+1900, local.tm_mon, local.tm_mday);
     RetVal.type = DATETIME_TYPE;
-    RETVAL = MINUTES_PER_DAY * jul + local->tm_hour*60 + local->tm_min;
+    RETVAL = MINUTES_PER_DAY * jul + local.tm_hour*60 + local.tm_min;
     return OK;
 }
 
@@ -2469,16 +2478,16 @@ static int SunStuff(int rise, double cosz, int jul)
     double latitude, longdeg, UT, local;
 
 /* Get offset from UTC */
-    if (CalculateUTC) {
+    if (Ctx->CalculateUTC) {
 	if (CalcMinsFromUTC(jul, 12*60, &mins, NULL)) {
 	    Eprint(ErrMsg[E_MKTIME_PROBLEM]);
 	    return NO_TIME;
 	}
-    } else mins = MinsFromUTC;
+    } else mins = Ctx->MinsFromUTC;
 
 /* Get latitude and longitude */
-    longdeg = -Longitude;
-    latitude = DEGRAD * Latitude;
+    longdeg = -Ctx->Longitude;
+    latitude = DEGRAD * Ctx->Latitude;
 
     FromJulian(jul, &year, &mon, &day);
 
@@ -2570,7 +2579,7 @@ static int SunStuff(int rise, double cosz, int jul)
 /***************************************************************/
 static int FSun(int rise, func_info *info)
 {
-    int jul = JulianToday;
+    int jul = Ctx->JulianToday;
     /* Assignment below is not necessary, but it silences
        a GCC warning about a possibly-uninitialized variable */
     double cosz = 0.0;
@@ -2654,7 +2663,7 @@ static int FADusk(func_info *info)
 static int FFiledate(func_info *info)
 {
     struct stat statbuf;
-    struct tm *t1;
+    struct tm t1;
 
     RetVal.type = DATE_TYPE;
 
@@ -2665,12 +2674,14 @@ static int FFiledate(func_info *info)
 	return OK;
     }
 
-    t1 = localtime(&(statbuf.st_mtime));
+    LockTz();
+    localtime_r(&(statbuf.st_mtime), &t1);
+    UnlockTz();
 
-    if (t1->tm_year + 1900 < BASE)
+    if (t1.tm_year + 1900 < BASE)
 	RETVAL=0;
     else
-	RETVAL=Julian(t1->tm_year+1900, t1->tm_mon, t1->tm_mday);
+	RETVAL=Julian(t1.tm_year+1900, t1.tm_mon, t1.tm_mday);
 
     return OK;
 }
@@ -2685,7 +2696,7 @@ static int FFiledate(func_info *info)
 static int FFiledatetime(func_info *info)
 {
     struct stat statbuf;
-    struct tm *t1;
+    struct tm t1;
 
     RetVal.type = DATETIME_TYPE;
 
@@ -2696,12 +2707,14 @@ static int FFiledatetime(func_info *info)
 	return OK;
     }
 
-    t1 = localtime(&(statbuf.st_mtime));
+    LockTz();
+    localtime_r(&(statbuf.st_mtime), &t1);
+    UnlockTz();
 
-    if (t1->tm_year + 1900 < BASE)
+    if (t1.tm_year + 1900 < BASE)
 	RETVAL=0;
     else
-	RETVAL = MINUTES_PER_DAY * Julian(t1->tm_year+1900, t1->tm_mon, t1->tm_mday) + t1->tm_hour * 60 + t1->tm_min;
+	RETVAL = MINUTES_PER_DAY * Julian(t1.tm_year+1900, t1.tm_mon, t1.tm_mday) + t1.tm_hour * 60 + t1.tm_min;
 
     return OK;
 }
@@ -2713,7 +2726,6 @@ static int FFiledatetime(func_info *info)
 /*  Canned PostScript code for shading a calendar square       */
 /*                                                             */
 /***************************************************************/
-static int psshade_warned = 0;
 static int FPsshade(func_info *info)
 {
     char psbuff[256];
@@ -2729,8 +2741,8 @@ static int FPsshade(func_info *info)
 	if (ARG(i).v.val > 100) return E_2HIGH;
     }
 
-    if (!psshade_warned) {
-	psshade_warned = 1;
+    if (!Ctx->psshade_warned) {
+	Ctx->psshade_warned = 1;
 	Wprint("psshade() is deprecated; use SPECIAL SHADE instead.");
     }
 
@@ -2755,7 +2767,6 @@ static int FPsshade(func_info *info)
 /*  Canned PostScript code for generating moon phases          */
 /*                                                             */
 /***************************************************************/
-static int psmoon_warned = 0;
 
 static int FPsmoon(func_info *info)
 {
@@ -2784,8 +2795,8 @@ static int FPsmoon(func_info *info)
 	    }
 	}
     }
-    if (!psmoon_warned) {
-	psmoon_warned = 1;
+    if (!Ctx->psmoon_warned) {
+	Ctx->psmoon_warned = 1;
 	Wprint("psmoon() is deprecated; use SPECIAL MOON instead.");
     }
     if (size > 0) {
@@ -2859,7 +2870,7 @@ static int FMoonphase(func_info *info)
 
     switch(Nargs) {
     case 0:
-	date = JulianToday;
+	date = Ctx->JulianToday;
 	time = 0;
 	break;
     case 1:
@@ -2914,7 +2925,7 @@ static int MoonStuff(int type_wanted, func_info *info)
     int startdate, starttim;
     int d, t;
 
-    startdate = JulianToday;
+    startdate = Ctx->JulianToday;
     starttim = 0;
 
     ASSERT_TYPE(0, INT_TYPE);
@@ -3103,6 +3114,7 @@ static int FTzconvert(func_info *info)
     hour = r / 60;
     minute = r % 60;
 
+    LockTz();
     if (Nargs == 2) {
 	r = tz_convert(year, month, day, hour, minute,
 		       ARGSTR(1), NULL, &tm);
@@ -3110,6 +3122,7 @@ static int FTzconvert(func_info *info)
 	r = tz_convert(year, month, day, hour, minute,
 		       ARGSTR(1), ARGSTR(2), &tm);
     }
+    UnlockTz();
 
     if (r == -1) return E_CANT_CONVERT_TZ;
 
@@ -3143,7 +3156,7 @@ FSlide(func_info *info)
     }
 
     /* If ALL weekdays are omitted... barf! */
-    if ((WeekdayOmits | localomit) == 0x7F && amt != 0) return E_2MANY_LOCALOMIT;
+    if ((Ctx->WeekdayOmits | localomit) == 0x7F && amt != 0) return E_2MANY_LOCALOMIT;
     if (amt > 0) {
 	while(amt) {
 	    d++;
@@ -3204,7 +3217,7 @@ FNonomitted(func_info *info)
 static int
 FWeekno(func_info *info)
 {
-    int jul = JulianToday;
+    int jul = Ctx->JulianToday;
     int wkstart = 0; /* Week start on Monday */
     int daystart = 29; /* First week starts on wkstart on or after Dec. 29 */
     int monstart;
@@ -3302,7 +3315,7 @@ FEvalTrig(func_info *info)
 	jul = ComputeTrigger(trig.scanfrom, &trig, &tim, &r, 0);
     } else {
 	/* Hokey... */
-	if (trig.scanfrom != JulianToday) {
+	if (trig.scanfrom != Ctx->JulianToday) {
 	    Wprint("Warning: SCANFROM is ignored in two-argument form of evaltrig()");
 	}
 	jul = ComputeTrigger(scanfrom, &trig, &tim, &r, 0);
@@ -3327,7 +3340,6 @@ FEvalTrig(func_info *info)
     return OK;
 }
 
-static int LastTrig = 0;
 static int
 FTrig(func_info *info)
 {
@@ -3340,7 +3352,7 @@ FTrig(func_info *info)
 
     RetVal.type = DATE_TYPE;
     if (Nargs == 0) {
-        RETVAL = LastTrig;
+        RETVAL = Ctx->LastTrig;
         return OK;
     }
 
@@ -3371,7 +3383,7 @@ FTrig(func_info *info)
             continue;
         }
         if (ShouldTriggerReminder(&trig, &tim, jul, &r)) {
-            LastTrig = jul;
+            Ctx->LastTrig = jul;
             RETVAL = jul;
             DestroyParser(&p);
             FreeTrig(&trig);
@@ -0,0 +1,1024 @@
+/***************************************************************/
+/*                                                             */
+/*  ICS2REM.C                                                  */
+/*                                                             */
+/*  Convert the events in iCalendar (RFC 5545) files into      */
+/*  REM commands.                                              */
+/*                                                             */
+/*  This file is part of REMIND.                               */
+/*  Copyright (C) 1992-2022 by Dianne Skoll                    */
+/*                                                             */
+/***************************************************************/
+
+#include "version.h"
+#include "config.h"
+#include "dynbuf.h"
+#include "err.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <time.h>
+
+#define NO_TIME -1
+#define NO_DAY  INT_MIN
+
+#define FREQ_DAILY   0
+#define FREQ_WEEKLY  1
+#define FREQ_MONTHLY 2
+#define FREQ_YEARLY  3
+
+/* Most BYxxx values any rule will list */
+#define MAX_BY 31
+
+/* How far ahead to look for the last occurrence of a COUNT rule */
+#define MAX_SCAN_YEARS 200
+
+static char const *DayName[7] = {
+    "Mon", "Tue", "Wed", "Thu", "Fri", "Sat", "Sun"
+};
+static char const *MonthName[12] = {
+    "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+    "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"
+};
+static char const *ICalDay[7] = {
+    "MO", "TU", "WE", "TH", "FR", "SA", "SU"
+};
+static char const *Ordinal[5] = {
+    "Last", "First", "Second", "Third", "Fourth"
+};
+
+/* A list of dates, for EXDATE and RDATE */
+typedef struct {
+    int *day;
+    int num;
+    int max;
+} DayList;
+
+/* The parts of a VEVENT we use.  Days are counted from
+   1970-01-01; times are minutes after midnight. */
+typedef struct {
+    DynamicBuffer summary;
+    DynamicBuffer categories;
+    DynamicBuffer rrule;
+    DayList exdate;
+    DayList rdate;
+    int start_day;
+    int start_time;
+    int end_day;
+    int end_time;
+    int duration;
+    int cancelled;
+} Event;
+
+/* A parsed RRULE */
+typedef struct {
+    int freq;
+    int interval;
+    int count;
+    int until;
+    int wkst;
+    int nbyday;
+    int byday_wd[MAX_BY];
+    int byday_n[MAX_BY];
+    int nbymonthday;
+    int bymonthday[MAX_BY];
+    int nbymonth;
+    int bymonth[MAX_BY];
+} Rule;
+
+/* Reads unfolded content lines from a file */
+typedef struct {
+    FILE *fp;
+    DynamicBuffer next;
+    int have_next;
+} Reader;
+
+/* Occurrences of rules we can't express as REM commands are
+   written out from Today for this many years */
+static int Today;
+static int Years = 1;
+
+static void Usage(char const *s);
+
+/***************************************************************/
+/*                                                             */
+/*  Calendar arithmetic                                        */
+/*                                                             */
+/***************************************************************/
+static int DaysFromCivil(int y, int m, int d)
+{
+    int era, yoe, doy, doe;
+
+    /* m is 1-12 */
+    y -= (m <= 2);
+    era = (y >= 0 ? y : y-399) / 400;
+    yoe = y - era * 400;
+    doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    doe = yoe * 365 + yoe/4 - yoe/100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+static void CivilFromDays(int z, int *y, int *m, int *d)
+{
+    int era, doe, yoe, doy, mp;
+
+    z += 719468;
+    era = (z >= 0 ? z : z - 146096) / 146097;
+    doe = z - era * 146097;
+    yoe = (doe - doe/1460 + doe/36524 - doe/146096) / 365;
+    doy = doe - (365*yoe + yoe/4 - yoe/100);
+    mp = (5*doy + 2)/153;
+    *d = doy - (153*mp+2)/5 + 1;
+    *m = mp + (mp < 10 ? 3 : -9);
+    *y = yoe + era * 400 + (*m <= 2);
+}
+
+static int DaysInMonth(int y, int m)
+{
+    static int const dim[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    if (m == 2 && ((y % 4 == 0 && y % 100 != 0) || y % 400 == 0)) {
+	return 29;
+    }
+    return dim[m-1];
+}
+
+/* 0 = Monday ... 6 = Sunday */
+static int WeekDay(int day)
+{
+    return ((day % 7) + 10) % 7;
+}
+
+static char const *DateString(int day)
+{
+    static char buf[32];
+    int y, m, d;
+    CivilFromDays(day, &y, &m, &d);
+    sprintf(buf, "%04d-%02d-%02d", y, m, d);
+    return buf;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  ParseDateTime                                              */
+/*                                                             */
+/*  Parse an iCalendar DATE or DATE-TIME.  UTC times are       */
+/*  converted to local time; times with a TZID are taken to be */
+/*  local already.  Returns 0 on success.                      */
+/*                                                             */
+/***************************************************************/
+static int ParseDateTime(char const *s, int *day, int *tim)
+{
+    int y, m, d, h, i, sec;
+    time_t t;
+    struct tm *tm;
+
+    if (sscanf(s, "%4d%2d%2d", &y, &m, &d) != 3 || m < 1 || m > 12 ||
+	d < 1 || d > DaysInMonth(y, m)) {
+	return -1;
+    }
+    *day = DaysFromCivil(y, m, d);
+    *tim = NO_TIME;
+    if (s[8] != 'T') return 0;
+
+    if (sscanf(s+9, "%2d%2d%2d", &h, &i, &sec) != 3) return -1;
+    *tim = h * 60 + i;
+    if (s[15] == 'Z') {
+	t = (time_t) *day * 86400 + (time_t) h * 3600 + i * 60 + sec;
+	tm = localtime(&t);
+	if (tm) {
+	    *day = DaysFromCivil(tm->tm_year + 1900, tm->tm_mon + 1, tm->tm_mday);
+	    *tim = tm->tm_hour * 60 + tm->tm_min;
+	}
+    }
+    return 0;
+}
+
+/* Parse an iCalendar DURATION into minutes; returns 0 on success */
+static int ParseDuration(char const *s, int *minutes)
+{
+    int n, total = 0, in_time = 0;
+
+    if (*s == '+') s++;
+    if (*s != 'P') return -1;
+    s++;
+    while (*s) {
+	if (*s == 'T') {
+	    in_time = 1;
+	    s++;
+	    continue;
+	}
+	if (!isdigit((unsigned char) *s)) return -1;
+	n = 0;
+	while (isdigit((unsigned char) *s)) n = n * 10 + (*s++ - '0');
+	switch(*s++) {
+	case 'W': total += n * 7 * 1440; break;
+	case 'D': total += n * 1440; break;
+	case 'H': total += n * 60; break;
+	case 'M': if (in_time) total += n; else return -1; break;
+	case 'S': total += n / 60; break;
+	default: return -1;
+	}
+    }
+    *minutes = total;
+    return 0;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  Reading content lines                                      */
+/*                                                             */
+/***************************************************************/
+
+/* Read one physical line, without its line terminator; returns 0 at EOF */
+static int ReadRawLine(Reader *rd, DynamicBuffer *buf)
+{
+    if (feof(rd->fp)) return 0;
+    if (DBufGets(buf, rd->fp) != OK) {
+	fprintf(stderr, "ics2rem: Out of memory\n");
+	exit(1);
+    }
+    if (!DBufLen(buf) && feof(rd->fp)) return 0;
+    if (DBufLen(buf) && DBufValue(buf)[DBufLen(buf)-1] == '\r') {
+	DBufValue(buf)[DBufLen(buf)-1] = 0;
+	buf->len--;
+    }
+    return 1;
+}
+
+/* Read one logical content line, joining folded continuation lines;
+   returns 0 at EOF */
+static int ReadContentLine(Reader *rd, DynamicBuffer *line)
+{
+    DBufFree(line);
+    if (!rd->have_next && !ReadRawLine(rd, &rd->next)) return 0;
+    DBufPuts(line, DBufValue(&rd->next));
+    while (1) {
+	if (!ReadRawLine(rd, &rd->next)) {
+	    rd->have_next = 0;
+	    return 1;
+	}
+	if (*DBufValue(&rd->next) != ' ' && *DBufValue(&rd->next) != '\t') {
+	    rd->have_next = 1;
+	    return 1;
+	}
+	DBufPuts(line, DBufValue(&rd->next) + 1);
+    }
+}
+
+/* Split a content line in place into name and value; returns the value,
+   or NULL if the line is malformed.  Parameters are dropped. */
+static char *SplitContentLine(char *line)
+{
+    char *s = line;
+    int quoted = 0;
+
+    while (*s && *s != ';' && *s != ':') s++;
+    if (*s == ';') {
+	*s++ = 0;
+	while (*s && (quoted || *s != ':')) {
+	    if (*s == '"') quoted = !quoted;
+	    s++;
+	}
+    }
+    if (*s != ':') return NULL;
+    *s++ = 0;
+    return s;
+}
+
+/* Append an iCalendar TEXT value to buf, undoing its escapes */
+static void UnescapeText(DynamicBuffer *buf, char const *s)
+{
+    for (; *s; s++) {
+	if (*s == '\\' && *(s+1)) {
+	    s++;
+	    if (*s == 'n' || *s == 'N') {
+		DBufPutc(buf, '\n');
+	    } else {
+		DBufPutc(buf, *s);
+	    }
+	} else {
+	    DBufPutc(buf, *s);
+	}
+    }
+}
+
+static void AddDays(DayList *l, char const *value)
+{
+    int day, tim;
+    char const *s = value;
+
+    while (*s) {
+	if (!ParseDateTime(s, &day, &tim)) {
+	    if (l->num == l->max) {
+		l->max = l->max ? l->max * 2 : 8;
+		l->day = realloc(l->day, l->max * sizeof(int));
+		if (!l->day) {
+		    fprintf(stderr, "ics2rem: Out of memory\n");
+		    exit(1);
+		}
+	    }
+	    l->day[l->num++] = day;
+	}
+	s = strchr(s, ',');
+	if (!s) break;
+	s++;
+    }
+}
+
+static int InDays(DayList const *l, int day)
+{
+    int i;
+    for (i=0; i<l->num; i++) {
+	if (l->day[i] == day) return 1;
+    }
+    return 0;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  ParseRule                                                  */
+/*                                                             */
+/*  Parse an RRULE value.  Returns 0 if the rule uses only     */
+/*  parts we understand.                                       */
+/*                                                             */
+/***************************************************************/
+static int ParseRule(char const *s, Rule *r)
+{
+    char part[256], *val, *v;
+    size_t n;
+    int i, x, tim;
+
+    memset(r, 0, sizeof(*r));
+    r->freq = -1;
+    r->interval = 1;
+    r->until = NO_DAY;
+
+    while (*s) {
+	n = strcspn(s, ";");
+	if (n >= sizeof(part)) return -1;
+	memcpy(part, s, n);
+	part[n] = 0;
+	s += n;
+	if (*s) s++;
+
+	val = strchr(part, '=');
+	if (!val) return -1;
+	*val++ = 0;
+
+	if (!strcasecmp(part, "FREQ")) {
+	    if      (!strcasecmp(val, "DAILY"))   r->freq = FREQ_DAILY;
+	    else if (!strcasecmp(val, "WEEKLY"))  r->freq = FREQ_WEEKLY;
+	    else if (!strcasecmp(val, "MONTHLY")) r->freq = FREQ_MONTHLY;
+	    else if (!strcasecmp(val, "YEARLY"))  r->freq = FREQ_YEARLY;
+	    else return -1;
+	} else if (!strcasecmp(part, "INTERVAL")) {
+	    r->interval = atoi(val);
+	    if (r->interval < 1) return -1;
+	} else if (!strcasecmp(part, "COUNT")) {
+	    r->count = atoi(val);
+	    if (r->count < 1) return -1;
+	} else if (!strcasecmp(part, "UNTIL")) {
+	    if (ParseDateTime(val, &r->until, &tim)) return -1;
+	} else if (!strcasecmp(part, "WKST")) {
+	    for (i=0; i<7; i++) {
+		if (!strcasecmp(val, ICalDay[i])) r->wkst = i;
+	    }
+	} else if (!strcasecmp(part, "BYDAY")) {
+	    for (v = strtok(val, ","); v; v = strtok(NULL, ",")) {
+		if (r->nbyday == MAX_BY) return -1;
+		x = 0;
+		if (*v == '+' || *v == '-' || isdigit((unsigned char) *v)) {
+		    x = (int) strtol(v, &v, 10);
+		    if (!x || x < -53 || x > 53) return -1;
+		}
+		for (i=0; i<7; i++) {
+		    if (!strcasecmp(v, ICalDay[i])) break;
+		}
+		if (i == 7) return -1;
+		r->byday_wd[r->nbyday] = i;
+		r->byday_n[r->nbyday++] = x;
+	    }
+	} else if (!strcasecmp(part, "BYMONTHDAY")) {
+	    for (v = strtok(val, ","); v; v = strtok(NULL, ",")) {
+		if (r->nbymonthday == MAX_BY) return -1;
+		x = atoi(v);
+		if (!x || x < -31 || x > 31) return -1;
+		r->bymonthday[r->nbymonthday++] = x;
+	    }
+	} else if (!strcasecmp(part, "BYMONTH")) {
+	    for (v = strtok(val, ","); v; v = strtok(NULL, ",")) {
+		if (r->nbymonth == MAX_BY) return -1;
+		x = atoi(v);
+		if (x < 1 || x > 12) return -1;
+		r->bymonth[r->nbymonth++] = x;
+	    }
+	} else {
+	    /* BYSETPOS, BYYEARDAY, BYWEEKNO, BYHOUR and friends */
+	    return -1;
+	}
+    }
+    if (r->freq < 0) return -1;
+
+    /* An ordinal BYDAY only makes sense within a month or year */
+    for (i=0; i<r->nbyday; i++) {
+	if (r->byday_n[i] &&
+	    (r->freq == FREQ_DAILY || r->freq == FREQ_WEEKLY)) {
+	    return -1;
+	}
+    }
+    return 0;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  RuleMatches                                                */
+/*                                                             */
+/*  Return 1 if day (on or after the start of e) is an         */
+/*  occurrence of rule r.  COUNT, UNTIL, EXDATE and RDATE are  */
+/*  left to the caller.                                        */
+/*                                                             */
+/***************************************************************/
+static int RuleMatches(Rule const *r, Event const *e, int day)
+{
+    int y, m, d, sy, sm, sd, wd, dim;
+    int i, ok, pos, neg, diff;
+
+    CivilFromDays(day, &y, &m, &d);
+    CivilFromDays(e->start_day, &sy, &sm, &sd);
+    wd = WeekDay(day);
+    dim = DaysInMonth(y, m);
+
+    /* Is it in a period the interval selects? */
+    switch(r->freq) {
+    case FREQ_DAILY:
+	diff = day - e->start_day;
+	break;
+    case FREQ_WEEKLY:
+	diff = ((day - (wd - r->wkst + 7) % 7) -
+		(e->start_day - (WeekDay(e->start_day) - r->wkst + 7) % 7)) / 7;
+	break;
+    case FREQ_MONTHLY:
+	diff = (y * 12 + m) - (sy * 12 + sm);
+	break;
+    default:
+	diff = y - sy;
+	break;
+    }
+    if (diff % r->interval) return 0;
+
+    if (r->nbymonth) {
+	for (i=0, ok=0; i<r->nbymonth; i++) {
+	    if (r->bymonth[i] == m) ok = 1;
+	}
+	if (!ok) return 0;
+    }
+
+    if (r->nbymonthday) {
+	for (i=0, ok=0; i<r->nbymonthday; i++) {
+	    if (r->bymonthday[i] == d ||
+		r->bymonthday[i] == d - dim - 1) {
+		ok = 1;
+	    }
+	}
+	if (!ok) return 0;
+    }
+
+    if (r->nbyday) {
+	/* Ordinals count within the year unless a month is in play */
+	if (r->freq == FREQ_YEARLY && !r->nbymonth) {
+	    pos = (day - DaysFromCivil(y, 1, 1)) / 7 + 1;
+	    neg = (DaysFromCivil(y, 12, 31) - day) / 7 + 1;
+	} else {
+	    pos = (d - 1) / 7 + 1;
+	    neg = (dim - d) / 7 + 1;
+	}
+	for (i=0, ok=0; i<r->nbyday; i++) {
+	    if (r->byday_wd[i] != wd) continue;
+	    if (!r->byday_n[i] || r->byday_n[i] == pos ||
+		r->byday_n[i] == -neg) {
+		ok = 1;
+	    }
+	}
+	if (!ok) return 0;
+    }
+
+    /* Parts the rule leaves out come from DTSTART */
+    switch(r->freq) {
+    case FREQ_WEEKLY:
+	if (!r->nbyday && wd != WeekDay(e->start_day)) return 0;
+	break;
+    case FREQ_MONTHLY:
+	if (!r->nbyday && !r->nbymonthday && d != sd) return 0;
+	break;
+    case FREQ_YEARLY:
+	if (!r->nbyday && !r->nbymonthday) {
+	    if (d != sd) return 0;
+	    if (!r->nbymonth && m != sm) return 0;
+	}
+	break;
+    }
+    return 1;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  Writing REM commands                                       */
+/*                                                             */
+/***************************************************************/
+
+/* Append s to buf so that REM reads it back literally */
+static void PutRemText(DynamicBuffer *buf, char const *s)
+{
+    for (; *s; s++) {
+	switch(*s) {
+	case '%':  DBufPuts(buf, "%%"); break;
+	case '[':  DBufPuts(buf, "[\"[\"]"); break;
+	case '\n': DBufPutc(buf, ' '); break;
+	case '\r': break;
+	default:   DBufPutc(buf, *s); break;
+	}
+    }
+    /* A trailing backslash would continue the line */
+    if (DBufLen(buf) && DBufValue(buf)[DBufLen(buf)-1] == '\\') {
+	DBufPutc(buf, ' ');
+    }
+}
+
+/* Build everything that follows the trigger date: the time,
+   duration, tags and body */
+static void BuildTail(Event const *e, DynamicBuffer *tail)
+{
+    char buf[64];
+    char const *s;
+    int dur;
+
+    DBufFree(tail);
+    if (e->start_time != NO_TIME) {
+	sprintf(buf, " AT %02d:%02d", e->start_time / 60, e->start_time % 60);
+	DBufPuts(tail, buf);
+	dur = e->duration;
+	if (dur == NO_TIME && e->end_day != NO_DAY && e->end_time != NO_TIME) {
+	    dur = (e->end_day - e->start_day) * 1440 + e->end_time - e->start_time;
+	}
+	if (dur != NO_TIME && dur > 0) {
+	    sprintf(buf, " DURATION %d:%02d", dur / 60, dur % 60);
+	    DBufPuts(tail, buf);
+	}
+    }
+
+    /* Each category becomes a tag; tags can't contain white space
+       or start an expression */
+    for (s = DBufValue(&e->categories); *s; ) {
+	while (*s == ',' || isspace((unsigned char) *s)) s++;
+	if (!*s) break;
+	DBufPuts(tail, " TAG ");
+	while (*s && *s != ',') {
+	    if (isspace((unsigned char) *s) || *s == '[' || *s == ']' || *s == '%') {
+		DBufPutc(tail, '_');
+	    } else {
+		DBufPutc(tail, *s);
+	    }
+	    s++;
+	}
+	while (DBufValue(tail)[DBufLen(tail)-1] == '_') {
+	    DBufValue(tail)[--tail->len] = 0;
+	}
+    }
+
+    DBufPuts(tail, " MSG ");
+    PutRemText(tail, DBufValue(&e->summary));
+}
+
+/* Number of days an all-day event spans */
+static int AllDaySpan(Event const *e)
+{
+    if (e->start_time != NO_TIME) return 1;
+    if (e->duration != NO_TIME) {
+	return (e->duration >= 1440) ? e->duration / 1440 : 1;
+    }
+    if (e->end_day != NO_DAY && e->end_day > e->start_day) {
+	return e->end_day - e->start_day;
+    }
+    return 1;
+}
+
+/* Write the REM for a single occurrence starting on day */
+static void WriteOne(Event const *e, int day, DynamicBuffer const *tail)
+{
+    int span = AllDaySpan(e);
+
+    printf("REM %s", DateString(day));
+    if (span > 1) {
+	printf(" THROUGH %s", DateString(day + span - 1));
+    }
+    printf("%s\n", DBufValue(tail));
+}
+
+/* Write "REM <trigger> FROM <start> [UNTIL <until>]<tail>" */
+static void WriteRule(Event const *e, char const *trigger, int until,
+		      DynamicBuffer const *tail)
+{
+    printf("REM %s FROM %s", trigger, DateString(e->start_day));
+    if (until != NO_DAY) {
+	printf(" UNTIL %s", DateString(until));
+    }
+    printf("%s\n", DBufValue(tail));
+}
+
+/***************************************************************/
+/*                                                             */
+/*  MapRule                                                    */
+/*                                                             */
+/*  Write r as one or more REM commands whose dates are        */
+/*  exactly those of the rule.  Returns 0 if it did, or -1 if  */
+/*  the rule can't be expressed that way (in which case        */
+/*  nothing has been written.)                                 */
+/*                                                             */
+/***************************************************************/
+static int MapRule(Event const *e, Rule const *r, DynamicBuffer const *tail)
+{
+    char trig[128];
+    int until = r->until;
+    int i, j, n, first, day, limit;
+    int months[MAX_BY], nmonths;
+
+    if (e->exdate.num || e->rdate.num || AllDaySpan(e) > 1) return -1;
+
+    /* DTSTART is always the first occurrence, even if it doesn't fit
+       the rule; a REM can't say that */
+    if (!RuleMatches(r, e, e->start_day)) return -1;
+
+    /* Check the rule is one of the shapes below before writing anything */
+    switch(r->freq) {
+    case FREQ_DAILY:
+	if (r->nbymonth || r->nbymonthday) return -1;
+	if (r->nbyday && r->interval > 1) return -1;
+	break;
+    case FREQ_WEEKLY:
+	if (r->nbymonth || r->nbymonthday) return -1;
+	break;
+    case FREQ_MONTHLY:
+    case FREQ_YEARLY:
+	if (r->interval > 1 || (r->nbyday && r->nbymonthday)) return -1;
+	if (r->freq == FREQ_MONTHLY && r->nbymonth) return -1;
+	if (r->freq == FREQ_YEARLY && !r->nbymonth &&
+	    (r->nbyday || r->nbymonthday)) {
+	    return -1;
+	}
+	for (i=0; i<r->nbyday; i++) {
+	    if (r->byday_n[i] < -1 || r->byday_n[i] > 4) return -1;
+	}
+	break;
+    }
+
+    /* A COUNT becomes an UNTIL on the last occurrence */
+    if (r->count) {
+	limit = e->start_day + MAX_SCAN_YEARS * 366;
+	for (n=0, day=e->start_day; day <= limit; day++) {
+	    if (day == e->start_day || RuleMatches(r, e, day)) {
+		until = day;
+		if (++n == r->count) break;
+	    }
+	}
+	if (n < r->count) return -1;
+    }
+
+    switch(r->freq) {
+    case FREQ_DAILY:
+	if (!r->nbyday) {
+	    sprintf(trig, "%s *%d", DateString(e->start_day), r->interval);
+	    printf("REM %s", trig);
+	    if (until != NO_DAY) printf(" UNTIL %s", DateString(until));
+	    printf("%s\n", DBufValue(tail));
+	    return 0;
+	}
+	/* Otherwise every listed weekday, as for FREQ_WEEKLY */
+	/* FALLTHROUGH */
+
+    case FREQ_WEEKLY:
+	if (r->interval == 1) {
+	    trig[0] = 0;
+	    if (!r->nbyday) {
+		strcpy(trig, DayName[WeekDay(e->start_day)]);
+	    }
+	    for (i=0; i<r->nbyday; i++) {
+		if (i) strcat(trig, " ");
+		strcat(trig, DayName[r->byday_wd[i]]);
+	    }
+	    WriteRule(e, trig, until, tail);
+	    return 0;
+	}
+	/* Every n weeks: one repeating REM per weekday, starting
+	   from its first date in or after the first week */
+	n = r->nbyday ? r->nbyday : 1;
+	for (i=0; i<n; i++) {
+	    j = r->nbyday ? r->byday_wd[i] : WeekDay(e->start_day);
+	    first = e->start_day - (WeekDay(e->start_day) - r->wkst + 7) % 7 +
+		(j - r->wkst + 7) % 7;
+	    if (first < e->start_day) first += 7 * r->interval;
+	    if (until != NO_DAY && first > until) continue;
+	    printf("REM %s *%d", DateString(first), 7 * r->interval);
+	    if (until != NO_DAY) printf(" UNTIL %s", DateString(until));
+	    printf("%s\n", DBufValue(tail));
+	}
+	return 0;
+    }
+
+    /* Monthly and yearly: one REM for each month (or for every
+       month) and each day of the month or weekday */
+    nmonths = 0;
+    if (r->freq == FREQ_YEARLY) {
+	if (r->nbymonth) {
+	    for (i=0; i<r->nbymonth; i++) months[nmonths++] = r->bymonth[i];
+	} else {
+	    int y, m, d;
+	    CivilFromDays(e->start_day, &y, &m, &d);
+	    months[nmonths++] = m;
+	}
+    } else {
+	months[nmonths++] = 0;
+    }
+
+    for (i=0; i<nmonths; i++) {
+	char mon[8];
+	if (months[i]) sprintf(mon, " %s", MonthName[months[i]-1]);
+	else mon[0] = 0;
+
+	if (r->nbymonthday) {
+	    for (j=0; j<r->nbymonthday; j++) {
+		if (r->bymonthday[j] > 0) {
+		    sprintf(trig, "%d%s", r->bymonthday[j], mon);
+		} else {
+		    sprintf(trig, "%s%s~~%d", mon[0] ? mon+1 : "", mon[0] ? " " : "",
+			    -r->bymonthday[j]);
+		}
+		WriteRule(e, trig, until, tail);
+	    }
+	} else if (r->nbyday) {
+	    for (j=0; j<r->nbyday; j++) {
+		if (r->byday_n[j]) {
+		    sprintf(trig, "%s %s%s", Ordinal[r->byday_n[j] < 0 ? 0 : r->byday_n[j]],
+			    DayName[r->byday_wd[j]], mon);
+		} else {
+		    sprintf(trig, "%s%s", DayName[r->byday_wd[j]], mon);
+		}
+		WriteRule(e, trig, until, tail);
+	    }
+	} else {
+	    int y, m, d;
+	    CivilFromDays(e->start_day, &y, &m, &d);
+	    sprintf(trig, "%d%s", d, mon);
+	    WriteRule(e, trig, until, tail);
+	}
+    }
+    return 0;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  ExpandRule                                                 */
+/*                                                             */
+/*  Write a REM for each occurrence of the rule from Today to  */
+/*  Years years later.                                         */
+/*                                                             */
+/***************************************************************/
+static void ExpandRule(Event const *e, Rule const *r, DynamicBuffer const *tail)
+{
+    int y, m, d, day, end, n = 0;
+
+    CivilFromDays(Today, &y, &m, &d);
+    y += Years;
+    if (d > DaysInMonth(y, m)) d = DaysInMonth(y, m);
+    end = DaysFromCivil(y, m, d);
+    if (r->until != NO_DAY && r->until < end) end = r->until;
+
+    for (day = e->start_day; day <= end; day++) {
+	if (day == e->start_day || RuleMatches(r, e, day)) {
+	    n++;
+	    if (day >= Today && !InDays(&e->exdate, day)) {
+		WriteOne(e, day, tail);
+	    }
+	    if (r->count && n == r->count) break;
+	} else if (day >= Today && InDays(&e->rdate, day) &&
+		   !InDays(&e->exdate, day)) {
+	    WriteOne(e, day, tail);
+	}
+    }
+}
+
+/***************************************************************/
+/*                                                             */
+/*  WriteEvent                                                 */
+/*                                                             */
+/*  Write the REM commands for one VEVENT.                     */
+/*                                                             */
+/***************************************************************/
+static void WriteEvent(Event const *e)
+{
+    DynamicBuffer tail;
+    Rule r;
+    int i;
+
+    if (e->start_day == NO_DAY || e->cancelled) return;
+
+    DBufInit(&tail);
+    BuildTail(e, &tail);
+
+    if (!DBufLen(&e->rrule)) {
+	WriteOne(e, e->start_day, &tail);
+	for (i=0; i<e->rdate.num; i++) {
+	    if (e->rdate.day[i] != e->start_day) {
+		WriteOne(e, e->rdate.day[i], &tail);
+	    }
+	}
+    } else if (ParseRule(DBufValue(&e->rrule), &r)) {
+	printf("# ics2rem: Can't handle RRULE:%s; only its first date is included\n",
+	       DBufValue(&e->rrule));
+	WriteOne(e, e->start_day, &tail);
+    } else if (MapRule(e, &r, &tail)) {
+	ExpandRule(e, &r, &tail);
+    }
+    DBufFree(&tail);
+}
+
+static void InitEvent(Event *e)
+{
+    DBufInit(&e->summary);
+    DBufInit(&e->categories);
+    DBufInit(&e->rrule);
+    e->exdate.num = 0;
+    e->rdate.num = 0;
+    e->start_day = NO_DAY;
+    e->start_time = NO_TIME;
+    e->end_day = NO_DAY;
+    e->end_time = NO_TIME;
+    e->duration = NO_TIME;
+    e->cancelled = 0;
+}
+
+static void FreeEvent(Event *e)
+{
+    DBufFree(&e->summary);
+    DBufFree(&e->categories);
+    DBufFree(&e->rrule);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  ConvertFile                                                */
+/*                                                             */
+/*  Read an iCalendar stream, writing each VEVENT as soon as   */
+/*  its END:VEVENT is seen.                                    */
+/*                                                             */
+/***************************************************************/
+static void ConvertFile(FILE *fp)
+{
+    Reader rd;
+    DynamicBuffer line;
+    Event e;
+    char *name, *value;
+    int in_event = 0;
+    int depth = 0;   /* Components nested inside the VEVENT, eg VALARM */
+
+    rd.fp = fp;
+    rd.have_next = 0;
+    DBufInit(&rd.next);
+    DBufInit(&line);
+    e.exdate.day = NULL;
+    e.exdate.max = 0;
+    e.rdate.day = NULL;
+    e.rdate.max = 0;
+
+    while (ReadContentLine(&rd, &line)) {
+	name = DBufValue(&line);
+	value = SplitContentLine(name);
+	if (!value) continue;
+
+	if (!strcasecmp(name, "BEGIN")) {
+	    if (in_event) {
+		depth++;
+	    } else if (!strcasecmp(value, "VEVENT")) {
+		in_event = 1;
+		InitEvent(&e);
+	    }
+	    continue;
+	}
+	if (!strcasecmp(name, "END")) {
+	    if (depth) {
+		depth--;
+	    } else if (in_event && !strcasecmp(value, "VEVENT")) {
+		WriteEvent(&e);
+		FreeEvent(&e);
+		in_event = 0;
+	    }
+	    continue;
+	}
+	if (!in_event || depth) continue;
+
+	if (!strcasecmp(name, "SUMMARY")) {
+	    DBufFree(&e.summary);
+	    UnescapeText(&e.summary, value);
+	} else if (!strcasecmp(name, "CATEGORIES")) {
+	    if (DBufLen(&e.categories)) DBufPutc(&e.categories, ',');
+	    UnescapeText(&e.categories, value);
+	} else if (!strcasecmp(name, "DTSTART")) {
+	    if (ParseDateTime(value, &e.start_day, &e.start_time)) {
+		e.start_day = NO_DAY;
+	    }
+	} else if (!strcasecmp(name, "DTEND")) {
+	    if (ParseDateTime(value, &e.end_day, &e.end_time)) {
+		e.end_day = NO_DAY;
+	    }
+	} else if (!strcasecmp(name, "DURATION")) {
+	    if (ParseDuration(value, &e.duration)) e.duration = NO_TIME;
+	} else if (!strcasecmp(name, "RRULE")) {
+	    DBufFree(&e.rrule);
+	    DBufPuts(&e.rrule, value);
+	} else if (!strcasecmp(name, "EXDATE")) {
+	    AddDays(&e.exdate, value);
+	} else if (!strcasecmp(name, "RDATE")) {
+	    AddDays(&e.rdate, value);
+	} else if (!strcasecmp(name, "STATUS")) {
+	    e.cancelled = !strcasecmp(value, "CANCELLED");
+	}
+    }
+    if (in_event) FreeEvent(&e);
+    free(e.exdate.day);
+    free(e.rdate.day);
+    DBufFree(&line);
+    DBufFree(&rd.next);
+}
+
+/***************************************************************/
+/*                                                             */
+/*   MAIN PROGRAM                                              */
+/*                                                             */
+/***************************************************************/
+int main(int argc, char *argv[])
+{
+    int i, y, m, d, files = 0;
+    time_t now;
+    struct tm *tm;
+    FILE *fp;
+
+    now = time(NULL);
+    tm = localtime(&now);
+    Today = DaysFromCivil(tm->tm_year + 1900, tm->tm_mon + 1, tm->tm_mday);
+
+    for (i=1; i<argc; i++) {
+	if (argv[i][0] != '-' || !argv[i][1]) {
+	    break;
+	}
+	switch(argv[i][1]) {
+	case 't':
+	    if (++i == argc || sscanf(argv[i], "%d-%d-%d", &y, &m, &d) != 3 ||
+		m < 1 || m > 12 || d < 1 || d > DaysInMonth(y, m)) {
+		Usage("-t requires a date of the form yyyy-mm-dd");
+	    }
+	    Today = DaysFromCivil(y, m, d);
+	    break;
+
+	case 'y':
+	    if (++i == argc || (Years = atoi(argv[i])) < 0) {
+		Usage("-y requires a number of years");
+	    }
+	    break;
+
+	default:
+	    Usage("Unknown option");
+	}
+    }
+
+    for (; i<argc; i++) {
+	files++;
+	if (!strcmp(argv[i], "-")) {
+	    ConvertFile(stdin);
+	    continue;
+	}
+	fp = fopen(argv[i], "r");
+	if (!fp) {
+	    fprintf(stderr, "ics2rem: Can't open %s\n", argv[i]);
+	    return 1;
+	}
+	ConvertFile(fp);
+	fclose(fp);
+    }
+    if (!files) ConvertFile(stdin);
+    return 0;
+}
+
+static void Usage(char const *s)
+{
+    if (s) fprintf(stderr, "ics2rem: %s\n\n", s);
+
+    fprintf(stderr, "ics2rem %s: Convert iCalendar events to Remind reminders.\n\n", VERSION);
+    fprintf(stderr, "Usage: ics2rem [options] [file...]\n\n");
+    fprintf(stderr, "Options:\n\n");
+    fprintf(stderr, "-t yyyy-mm-dd Write expanded occurrences from this date (default today)\n");
+    fprintf(stderr, "-y years      ... for this many years (default 1)\n");
+    exit(1);
+}
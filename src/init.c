@@ -52,6 +52,7 @@
  *  -w[n,n,n] = Specify output device width, padding and spacing
  *  -s[n]    = Produce calendar in "simple calendar" format
  *  -p[n]    = Produce calendar in format compatible with rem2ps
+ *  -pb[n]   = Same, but in rem2ps's binary format
  *  -l       = Prefix simple calendar lines with a comment containing
  *             their trigger line numbers and filenames
  *  -v       = Verbose mode
@@ -78,6 +79,23 @@
  *  -iVAR=EXPR = Initialize and preserve VAR.
  *  -m       = Start calendar with Monday instead of Sunday.
  *  -j[n]    = Purge all junk from reminder files (n = INCLUDE depth)
+ *  --socket=path = In server mode, also accept clients on a Unix socket
+ *  --serve=path = Answer queries from clients on a Unix socket (or
+ *             on stdin if path is -)
+ *  --batch=file = Run each job listed in 'file' (- for stdin)
+ *  --prelude=file = With --batch, run 'file' once and start each job from there
+ *  --queue-state=file = Keep the state of queued reminders in 'file'
+ *  --events=yyyy-mm-dd = Write each reminder occurrence up to the
+ *             given date as a line of JSON
+ *  --ical=yyyy-mm-dd = Write reminders up to the given date as
+ *             iCalendar VEVENTs
+ *  --compile=table,yyyy-mm-dd = Compile the reminder file's OMITs and
+ *             occurrences up to the given date into 'table'
+ *  --html[=table] = Write the calendar as HTML rather than text
+ *  --threads[=n] = Produce the months or weeks of a calendar in
+ *             n threads (def. one per processor)
+ *  --processes[=n] = Likewise, but in n child processes
+ *  --lang=xx = Use language xx (a code such as "de", or a name)
  *  A minus sign alone indicates to take input from stdin
  *
  **************************************************************/
@@ -93,9 +111,11 @@ while (isdigit(*(s))) {    \
 
 static void ChgUser(char const *u);
 static void InitializeVar(char const *str);
+static void ProcessLongOption(char const *arg);
 
-static char const *BadDate = "Illegal date on command line\n";
+static char const *BadDate = "Illegal date on command line";
 static void AddTrustedUser(char const *username);
+static void BadCommandLine(char const *msg);
 
 static DynamicBuffer default_filename_buf;
 
@@ -108,13 +128,13 @@ InitCalWidthAndFormWidth(int fd)
         return;
     }
     if (ioctl(fd, TIOCGWINSZ, &w) == 0) {
-        CalWidth = w.ws_col;
-        if (CalWidth < 71) {
-            CalWidth = 71;
+        Ctx->CalWidth = w.ws_col;
+        if (Ctx->CalWidth < 71) {
+            Ctx->CalWidth = 71;
         }
-        FormWidth = w.ws_col - 8;
-        if (FormWidth < 20) FormWidth = 20;
-        if (FormWidth > 500) FormWidth = 500;
+        Ctx->FormWidth = w.ws_col - 8;
+        if (Ctx->FormWidth < 20) Ctx->FormWidth = 20;
+        if (Ctx->FormWidth > 500) Ctx->FormWidth = 500;
     }
 }
 
@@ -147,6 +167,27 @@ static char const *DefaultFilename(void)
     return DBufValue(&default_filename_buf);
 }
 
+/***************************************************************/
+/*                                                             */
+/*  BadCommandLine                                             */
+/*                                                             */
+/*  Complain about the file name, date, time or *rep on the    */
+/*  command line:  print msg, if any, and the usage, and exit. */
+/*  A batch job is only rejected, so the rest of the batch     */
+/*  still runs.                                                */
+/*                                                             */
+/***************************************************************/
+static void BadCommandLine(char const *msg)
+{
+    if (InBatchJob) {
+	RejectBatchJob(msg ? msg : "Expecting a reminder file, then [date] [time] [*rep]");
+	return;
+    }
+    if (msg) fprintf(ErrFp, "%s\n", msg);
+    Usage();
+    exit(EXIT_FAILURE);
+}
+
 /***************************************************************/
 /*                                                             */
 /*  InitRemind                                                 */
@@ -173,14 +214,7 @@ void InitRemind(int argc, char const *argv[])
        but clamp to [20, 500] */
     InitCalWidthAndFormWidth(STDOUT_FILENO);
 
-    /* Initialize global dynamic buffers */
-    DBufInit(&Banner);
-    DBufInit(&LineBuffer);
-    DBufInit(&ExprBuf);
-
-    DBufPuts(&Banner, L_BANNER);
-
-    PurgeFP = NULL;
+    Ctx->PurgeFP = NULL;
 
     /* Make sure remind is not installed set-uid or set-gid */
     if (getgid() != getegid() ||
@@ -194,13 +228,13 @@ void InitRemind(int argc, char const *argv[])
     d = NO_DAY;
     rep = NO_REP;
 
-    RealToday = SystemDate(&CurYear, &CurMon, &CurDay);
-    if (RealToday < 0) {
+    Ctx->RealToday = SystemDate(&Ctx->CurYear, &Ctx->CurMon, &Ctx->CurDay);
+    if (Ctx->RealToday < 0) {
 	fprintf(ErrFp, ErrMsg[M_BAD_SYS_DATE], BASE);
 	exit(EXIT_FAILURE);
     }
-    JulianToday = RealToday;
-    FromJulian(JulianToday, &CurYear, &CurMon, &CurDay);
+    Ctx->JulianToday = Ctx->RealToday;
+    FromJulian(Ctx->JulianToday, &Ctx->CurYear, &Ctx->CurMon, &Ctx->CurDay);
 
     /* Initialize Latitude and Longitude */
     set_components_from_lat_and_long();
@@ -230,26 +264,31 @@ void InitRemind(int argc, char const *argv[])
 	i++;
 	arg++;
 	if (!*arg) {
-	    UseStdin = 1;
-	    IgnoreOnce = 1;
+	    Ctx->UseStdin = 1;
+	    Ctx->IgnoreOnce = 1;
 	    i--;
 	    break;
 	}
 	while (*arg) {
 	    switch(*arg++) {
+	    case '-':
+		ProcessLongOption(arg);
+		while(*arg) arg++;
+		break;
+
             case '+':
                 AddTrustedUser(arg);
                 while(*arg) arg++;
                 break;
 
 	    case '@':
-		UseVTColors = 1;
+		Ctx->UseVTColors = 1;
 		if (*arg) {
 		    PARSENUM(x, arg);
 		    if (x == 1) {
-			Use256Colors = 1;
+			Ctx->Use256Colors = 1;
 		    } else if (x == 2) {
-			UseTrueColors = 1;
+			Ctx->UseTrueColors = 1;
 		    } else if (x != 0) {
                         fprintf(ErrFp, "%s: -@n,m,b: n must be 0, 1 or 2 (assuming 0)\n",
                                 argv[0]);
@@ -260,11 +299,11 @@ void InitRemind(int argc, char const *argv[])
                     if (*arg != ',') {
                         PARSENUM(x, arg);
                         if (x == 0) {
-                            TerminalBackground = TERMINAL_BACKGROUND_DARK;
+                            Ctx->TerminalBackground = TERMINAL_BACKGROUND_DARK;
                         } else if (x == 1) {
-                            TerminalBackground = TERMINAL_BACKGROUND_LIGHT;
+                            Ctx->TerminalBackground = TERMINAL_BACKGROUND_LIGHT;
                         } else if (x == 2) {
-                            TerminalBackground = TERMINAL_BACKGROUND_UNKNOWN;
+                            Ctx->TerminalBackground = TERMINAL_BACKGROUND_UNKNOWN;
                         } else {
                             fprintf(ErrFp, "%s: -@n,m,b: m must be 0, 1 or 2 (assuming 2)\n",
                                     argv[0]);
@@ -279,15 +318,15 @@ void InitRemind(int argc, char const *argv[])
                                 argv[0]);
                         x = 0;
                     }
-                    UseBGVTColors = x;
+                    Ctx->UseBGVTColors = x;
                 }
 		break;
 
 	    case 'j':
 	    case 'J':
-		PurgeMode = 1;
+		Ctx->PurgeMode = 1;
 	        if (*arg) {
-		    PARSENUM(PurgeIncludeDepth, arg);
+		    PARSENUM(Ctx->PurgeIncludeDepth, arg);
                 }
 	        break;
             case 'i':
@@ -298,29 +337,29 @@ void InitRemind(int argc, char const *argv[])
 
 	    case 'n':
 	    case 'N':
-		NextMode = 1;
-		DontQueue = 1;
-		Daemon = 0;
+		Ctx->NextMode = 1;
+		Ctx->DontQueue = 1;
+		Ctx->Daemon = 0;
 		break;
 
 	    case 'r':
 	    case 'R':
-		RunDisabled = RUN_CMDLINE;
+		Ctx->RunDisabled = RUN_CMDLINE;
 		break;
 
 	    case 'm':
 	    case 'M':
-		MondayFirst = 1;
+		Ctx->MondayFirst = 1;
 		break;
 
 	    case 'o':
 	    case 'O':
-		IgnoreOnce = 1;
+		Ctx->IgnoreOnce = 1;
 		break;
 
 	    case 'y':
 	    case 'Y':
-		SynthesizeTags = 1;
+		Ctx->SynthesizeTags = 1;
 		break;
 
 	    case 't':
@@ -328,21 +367,21 @@ void InitRemind(int argc, char const *argv[])
                 if (*arg == 'T' || *arg == 't') {
                     arg++;
                     if (!*arg) {
-                        DefaultTDelta = 5;
+                        Ctx->DefaultTDelta = 5;
                     } else {
-                        PARSENUM(DefaultTDelta, arg);
-                        if (DefaultTDelta < 0) {
-                            DefaultTDelta = 0;
-                        } else if (DefaultTDelta > 1440) {
-                            DefaultTDelta = 1440;
+                        PARSENUM(Ctx->DefaultTDelta, arg);
+                        if (Ctx->DefaultTDelta < 0) {
+                            Ctx->DefaultTDelta = 0;
+                        } else if (Ctx->DefaultTDelta > 1440) {
+                            Ctx->DefaultTDelta = 1440;
                         }
                     }
                 } else if (!*arg) {
-		    InfiniteDelta = 1;
+		    Ctx->InfiniteDelta = 1;
 		} else {
-		    PARSENUM(DeltaOffset, arg);
-		    if (DeltaOffset < 0) {
-			DeltaOffset = 0;
+		    PARSENUM(Ctx->DeltaOffset, arg);
+		    if (Ctx->DeltaOffset < 0) {
+			Ctx->DeltaOffset = 0;
 		    }
 		}
 		break;
@@ -353,85 +392,90 @@ void InitRemind(int argc, char const *argv[])
 
 	    case 'h':
 	    case 'H':
-		Hush = 1;
+		Ctx->Hush = 1;
 		break;
 
 	    case 'g':
 	    case 'G':
-		SortByDate = SORT_ASCEND;
-		SortByTime = SORT_ASCEND;
-		SortByPrio = SORT_ASCEND;
-		UntimedBeforeTimed = 0;
+		Ctx->SortByDate = SORT_ASCEND;
+		Ctx->SortByTime = SORT_ASCEND;
+		Ctx->SortByPrio = SORT_ASCEND;
+		Ctx->UntimedBeforeTimed = 0;
 		if (*arg) {
 		    if (*arg == 'D' || *arg == 'd')
-			SortByDate = SORT_DESCEND;
+			Ctx->SortByDate = SORT_DESCEND;
 		    arg++;
 		}
 		if (*arg) {
 		    if (*arg == 'D' || *arg == 'd')
-			SortByTime = SORT_DESCEND;
+			Ctx->SortByTime = SORT_DESCEND;
 		    arg++;
 		}
 		if (*arg) {
 		    if (*arg == 'D' || *arg == 'd')
-			SortByPrio = SORT_DESCEND;
+			Ctx->SortByPrio = SORT_DESCEND;
 		    arg++;
 		}
 		if (*arg) {
 		    if (*arg == 'D' || *arg == 'd')
-			UntimedBeforeTimed = 1;
+			Ctx->UntimedBeforeTimed = 1;
 		    arg++;
 		}
 		break;
 
 	    case 'u':
 	    case 'U':
+		if (InBatchJob) {
+		    RejectBatchOption("-u");
+		    while (*arg) arg++;
+		    break;
+		}
                 if (*arg == '+') {
                     ChgUser(arg+1);
                 } else {
-                    RunDisabled = RUN_CMDLINE;
+                    Ctx->RunDisabled = RUN_CMDLINE;
                     ChgUser(arg);
                 }
 		while (*arg) arg++;
 		break;
 	    case 'z':
 	    case 'Z':
-		DontFork = 1;
+		Ctx->DontFork = 1;
 		if (*arg == '0') {
-		    PARSENUM(Daemon, arg);
-		    if (Daemon == 0) Daemon = -1;
-		    else if (Daemon < 1) Daemon = 1;
-		    else if (Daemon > 60) Daemon = 60;
+		    PARSENUM(Ctx->Daemon, arg);
+		    if (Ctx->Daemon == 0) Ctx->Daemon = -1;
+		    else if (Ctx->Daemon < 1) Ctx->Daemon = 1;
+		    else if (Ctx->Daemon > 60) Ctx->Daemon = 60;
 		} else {
-		    PARSENUM(Daemon, arg);
-		    if (Daemon<1) Daemon=1;
-		    else if (Daemon>60) Daemon=60;
+		    PARSENUM(Ctx->Daemon, arg);
+		    if (Ctx->Daemon<1) Ctx->Daemon=1;
+		    else if (Ctx->Daemon>60) Ctx->Daemon=60;
 		}
 		break;
 
 	    case 'a':
 	    case 'A':
-		DontIssueAts++;
+		Ctx->DontIssueAts++;
 		break;
 
 	    case 'q':
 	    case 'Q':
-		DontQueue = 1;
+		Ctx->DontQueue = 1;
 		break;
 
 	    case 'f':
 	    case 'F':
-		DontFork = 1;
+		Ctx->DontFork = 1;
 		break;
 	    case 'c':
 	    case 'C':
-		DoCalendar = 1;
+		Ctx->DoCalendar = 1;
 		weeks = 0;
 		/* Parse the flags */
 		while(*arg) {
 		    if (*arg == 'a' ||
 		        *arg == 'A') {
-		        DoSimpleCalDelta = 1;
+		        Ctx->DoSimpleCalDelta = 1;
 			arg++;
 			continue;
 		    }
@@ -441,38 +485,38 @@ void InitRemind(int argc, char const *argv[])
 			continue;
 		    }
 		    if (*arg == 'l' || *arg == 'L') {
-		        UseVTChars = 1;
+		        Ctx->UseVTChars = 1;
 			arg++;
 			continue;
 		    }
 		    if (*arg == 'u' || *arg == 'U') {
-			UseUTF8Chars = 1;
+			Ctx->UseUTF8Chars = 1;
 			arg++;
 			continue;
 		    }
 		    if (*arg == 'c' || *arg == 'C') {
-		        UseVTColors = 1;
+		        Ctx->UseVTColors = 1;
 		        arg++;
 		        continue;
 		    }
 		    break;
 		}
 		if (weeks) {
-		    PARSENUM(CalWeeks, arg);
-		    if (!CalWeeks) CalWeeks = 1;
+		    PARSENUM(Ctx->CalWeeks, arg);
+		    if (!Ctx->CalWeeks) Ctx->CalWeeks = 1;
 		} else {
-		    PARSENUM(CalMonths, arg);
-		    if (!CalMonths) CalMonths = 1;
+		    PARSENUM(Ctx->CalMonths, arg);
+		    if (!Ctx->CalMonths) Ctx->CalMonths = 1;
 		}
 		break;
 
 	    case 's':
 	    case 'S':
-		DoSimpleCalendar = 1;
+		Ctx->DoSimpleCalendar = 1;
 		weeks = 0;
 		while(*arg) {
 		    if (*arg == 'a' || *arg == 'A') {
-			DoSimpleCalDelta = 1;
+			Ctx->DoSimpleCalDelta = 1;
 			arg++;
 			continue;
 		    }
@@ -484,44 +528,51 @@ void InitRemind(int argc, char const *argv[])
 		    break;
 		}
 		if (weeks) {
-		    PARSENUM(CalWeeks, arg);
-		    if (!CalWeeks) CalWeeks = 1;
+		    PARSENUM(Ctx->CalWeeks, arg);
+		    if (!Ctx->CalWeeks) Ctx->CalWeeks = 1;
 		} else {
-		    PARSENUM(CalMonths, arg);
-		    if (!CalMonths) CalMonths = 1;
+		    PARSENUM(Ctx->CalMonths, arg);
+		    if (!Ctx->CalMonths) Ctx->CalMonths = 1;
 		}
 		break;
 
 	    case 'p':
 	    case 'P':
-		DoSimpleCalendar = 1;
-		PsCal = PSCAL_LEVEL1;
+		Ctx->DoSimpleCalendar = 1;
+		Ctx->PsCal = PSCAL_LEVEL1;
 		while (*arg == 'a' || *arg == 'A' ||
                        *arg == 'q' || *arg == 'Q' ||
+		       *arg == 'b' || *arg == 'B' ||
 		       *arg == 'p' || *arg == 'P') {
 		    if (*arg == 'a' || *arg == 'A') {
-			DoSimpleCalDelta = 1;
+			Ctx->DoSimpleCalDelta = 1;
+		    } else if (*arg == 'b' || *arg == 'B') {
+			Ctx->PsCalBinary = 1;
 		    } else if (*arg == 'p' || *arg == 'P') {
 			/* JSON interchange formats always include
 			   file and line number info */
-			DoPrefixLineNo = 1;
-			if (PsCal == PSCAL_LEVEL1) {
-			    PsCal = PSCAL_LEVEL2;
+			Ctx->DoPrefixLineNo = 1;
+			if (Ctx->PsCal == PSCAL_LEVEL1) {
+			    Ctx->PsCal = PSCAL_LEVEL2;
 			} else {
-			    PsCal = PSCAL_LEVEL3;
+			    Ctx->PsCal = PSCAL_LEVEL3;
 			}
 		    } else if (*arg == 'q' || *arg == 'Q') {
-                        DontSuppressQuoteMarkers = 1;
+                        Ctx->DontSuppressQuoteMarkers = 1;
                     }
 		    arg++;
 		}
-		PARSENUM(CalMonths, arg);
-		if (!CalMonths) CalMonths = 1;
+		/* The binary format carries what -p does */
+		if (Ctx->PsCalBinary) {
+		    Ctx->PsCal = PSCAL_LEVEL1;
+		}
+		PARSENUM(Ctx->CalMonths, arg);
+		if (!Ctx->CalMonths) Ctx->CalMonths = 1;
 		break;
 
 	    case 'l':
 	    case 'L':
-		DoPrefixLineNo = 1;
+		Ctx->DoPrefixLineNo = 1;
 		break;
 
 	    case 'w':
@@ -539,26 +590,26 @@ void InitRemind(int argc, char const *argv[])
                             close(ttyfd);
                         }
                     } else {
-                        PARSENUM(CalWidth, arg);
-                        if (CalWidth != 0 && CalWidth < 71) CalWidth = 71;
-                        if (CalWidth == 0) {
-                            CalWidth = -1;
+                        PARSENUM(Ctx->CalWidth, arg);
+                        if (Ctx->CalWidth != 0 && Ctx->CalWidth < 71) Ctx->CalWidth = 71;
+                        if (Ctx->CalWidth == 0) {
+                            Ctx->CalWidth = -1;
                         }
-                        FormWidth = CalWidth - 8;
-                        if (FormWidth < 20) FormWidth = 20;
-                        if (FormWidth > 500) FormWidth = 500;
+                        Ctx->FormWidth = Ctx->CalWidth - 8;
+                        if (Ctx->FormWidth < 20) Ctx->FormWidth = 20;
+                        if (Ctx->FormWidth > 500) Ctx->FormWidth = 500;
                     }
 		}
 		if (*arg == ',') {
 		    arg++;
 		    if (*arg != ',') {
-			PARSENUM(CalLines, arg);
-			if (CalLines > 20) CalLines = 20;
+			PARSENUM(Ctx->CalLines, arg);
+			if (Ctx->CalLines > 20) Ctx->CalLines = 20;
 		    }
 		    if (*arg == ',') {
 			arg++;
-			PARSENUM(CalPad, arg);
-			if (CalPad > 20) CalPad = 20;
+			PARSENUM(Ctx->CalPad, arg);
+			if (Ctx->CalPad > 20) Ctx->CalPad = 20;
 		    }
 		}
 		break;
@@ -567,12 +618,12 @@ void InitRemind(int argc, char const *argv[])
 	    case 'D':
 		while (*arg) {
 		    switch(*arg++) {
-		    case 'e': case 'E': DebugFlag |= DB_ECHO_LINE;   break;
-		    case 'x': case 'X': DebugFlag |= DB_PRTEXPR;     break;
-		    case 't': case 'T': DebugFlag |= DB_PRTTRIG;     break;
-		    case 'v': case 'V': DebugFlag |= DB_DUMP_VARS;   break;
-		    case 'l': case 'L': DebugFlag |= DB_PRTLINE;     break;
-		    case 'f': case 'F': DebugFlag |= DB_TRACE_FILES; break;
+		    case 'e': case 'E': Ctx->DebugFlag |= DB_ECHO_LINE;   break;
+		    case 'x': case 'X': Ctx->DebugFlag |= DB_PRTEXPR;     break;
+		    case 't': case 'T': Ctx->DebugFlag |= DB_PRTTRIG;     break;
+		    case 'v': case 'V': Ctx->DebugFlag |= DB_DUMP_VARS;   break;
+		    case 'l': case 'L': Ctx->DebugFlag |= DB_PRTLINE;     break;
+		    case 'f': case 'F': Ctx->DebugFlag |= DB_TRACE_FILES; break;
 		    default:
 		        fprintf(ErrFp, ErrMsg[M_BAD_DB_FLAG], *(arg-1));
 		    }
@@ -581,25 +632,25 @@ void InitRemind(int argc, char const *argv[])
 
 	    case 'v':
 	    case 'V':
-		DebugFlag |= DB_PRTLINE;
-		ShowAllErrors = 1;
+		Ctx->DebugFlag |= DB_PRTLINE;
+		Ctx->ShowAllErrors = 1;
 		break;
 
 	    case 'b':
 	    case 'B':
-		PARSENUM(ScFormat, arg);
-		if (ScFormat<0 || ScFormat>2) ScFormat=SC_AMPM;
+		PARSENUM(Ctx->ScFormat, arg);
+		if (Ctx->ScFormat<0 || Ctx->ScFormat>2) Ctx->ScFormat=SC_AMPM;
 		break;
 
 	    case 'x':
 	    case 'X':
-		PARSENUM(MaxSatIter, arg);
-		if (MaxSatIter < 10) MaxSatIter=10;
+		PARSENUM(Ctx->MaxSatIter, arg);
+		if (Ctx->MaxSatIter < 10) Ctx->MaxSatIter=10;
 		break;
 
 	    case 'k':
 	    case 'K':
-		MsgCommand = arg;
+		Ctx->MsgCommand = arg;
 		while (*arg) arg++;  /* Chew up remaining chars in this arg */
 		break;
 
@@ -610,15 +661,32 @@ void InitRemind(int argc, char const *argv[])
 	}
     }
 
+    /* There is no HTML rendering of a weekly calendar, and -c+n
+       must not quietly turn into a month */
+    if (Ctx->HtmlCal) {
+	if (Ctx->CalWeeks && !Ctx->CalMonths) {
+	    if (InBatchJob) {
+		RejectBatchJob("--html cannot produce a weekly calendar (-c+n)");
+		return;
+	    }
+	    fprintf(ErrFp, "%s: --html cannot produce a weekly calendar (-c+n)\n", ArgV[0]);
+	    exit(EXIT_FAILURE);
+	}
+	if (!Ctx->CalMonths) Ctx->CalMonths = 1;
+    }
+
+    /* A batch gets its files from the manifest */
+    if (BatchFile && !InBatchJob) return;
+
     /* Get the filename. */
     if (!InvokedAsRem) {
 	if (i >= argc) {
-	    Usage();
-	    exit(EXIT_FAILURE);
+	    BadCommandLine(NULL);
+	    return;
 	}
-	InitialFile = argv[i++];
+	Ctx->InitialFile = argv[i++];
     } else {
-	InitialFile = DefaultFilename();
+	Ctx->InitialFile = DefaultFilename();
     }
 
     /* Get the date, if any */
@@ -628,57 +696,77 @@ void InitRemind(int argc, char const *argv[])
 	    FindToken(arg, &tok);
 	    switch (tok.type) {
 	    case T_Time:
-		if (SysTime != -1L) Usage();
-		else {
-		    SysTime = (long) tok.val * 60L;
-		    DontQueue = 1;
-		    Daemon = 0;
+		if (Ctx->SysTime != -1L) {
+		    BadCommandLine(NULL);
+		    return;
 		}
+		Ctx->SysTime = (long) tok.val * 60L;
+		Ctx->DontQueue = 1;
+		Ctx->Daemon = 0;
 		break;
 
 	    case T_DateTime:
-		if (SysTime != -1L) Usage();
-		if (m != NO_MON || d != NO_DAY || y != NO_YR || jul != NO_DATE) Usage();
-		SysTime = (tok.val % MINUTES_PER_DAY) * 60;
-		DontQueue = 1;
-		Daemon = 0;
+		if (Ctx->SysTime != -1L ||
+		    m != NO_MON || d != NO_DAY || y != NO_YR || jul != NO_DATE) {
+		    BadCommandLine(NULL);
+		    return;
+		}
+		Ctx->SysTime = (tok.val % MINUTES_PER_DAY) * 60;
+		Ctx->DontQueue = 1;
+		Ctx->Daemon = 0;
 		jul = tok.val / MINUTES_PER_DAY;
 		break;
 
 	    case T_Date:
-		if (m != NO_MON || d != NO_DAY || y != NO_YR || jul != NO_DATE) Usage();
+		if (m != NO_MON || d != NO_DAY || y != NO_YR || jul != NO_DATE) {
+		    BadCommandLine(NULL);
+		    return;
+		}
 		jul = tok.val;
 		break;
 
 	    case T_Month:
-		if (m != NO_MON || jul != NO_DATE) Usage();
-		else m = tok.val;
+		if (m != NO_MON || jul != NO_DATE) {
+		    BadCommandLine(NULL);
+		    return;
+		}
+		m = tok.val;
 		break;
 
 	    case T_Day:
-		if (d != NO_DAY || jul != NO_DATE) Usage();
-		else d = tok.val;
+		if (d != NO_DAY || jul != NO_DATE) {
+		    BadCommandLine(NULL);
+		    return;
+		}
+		d = tok.val;
 		break;
 
 	    case T_Year:
-		if (y != NO_YR || jul != NO_DATE) Usage();
-		else y = tok.val;
+		if (y != NO_YR || jul != NO_DATE) {
+		    BadCommandLine(NULL);
+		    return;
+		}
+		y = tok.val;
 		break;
 
 	    case T_Rep:
-		if (rep != NO_REP) Usage();
-		else rep = tok.val;
+		if (rep != NO_REP) {
+		    BadCommandLine(NULL);
+		    return;
+		}
+		rep = tok.val;
 		break;
 
 	    default:
-		Usage();
+		BadCommandLine(NULL);
+		return;
 	    }
 	}
 
 	if (rep > 0) {
-	    Iterations = rep;
-	    DontQueue = 1;
-	    Daemon = 0;
+	    Ctx->Iterations = rep;
+	    Ctx->DontQueue = 1;
+	    Ctx->Daemon = 0;
 	}
 
 	if (jul != NO_DATE) {
@@ -687,36 +775,36 @@ void InitRemind(int argc, char const *argv[])
 /* Must supply date in the form:  day, mon, yr OR mon, yr */
 	if (m != NO_MON || y != NO_YR || d != NO_DAY) {
 	    if (m == NO_MON || y == NO_YR) {
-		if (rep == NO_REP) Usage();
-		else if (m != NO_MON || y != NO_YR) Usage();
-		else {
-		    m = CurMon;
-		    y = CurYear;
-		    if (d == NO_DAY) d = CurDay;
+		if (rep == NO_REP || m != NO_MON || y != NO_YR) {
+		    BadCommandLine(NULL);
+		    return;
 		}
+		m = Ctx->CurMon;
+		y = Ctx->CurYear;
+		if (d == NO_DAY) d = Ctx->CurDay;
 	    }
 	    if (d == NO_DAY) d=1;
 	    if (d > DaysInMonth(m, y)) {
-		fprintf(ErrFp, "%s", BadDate);
-		Usage();
+		BadCommandLine(BadDate);
+		return;
 	    }
-	    JulianToday = Julian(y, m, d);
-	    if (JulianToday == -1) {
-		fprintf(ErrFp, "%s", BadDate);
-		Usage();
+	    Ctx->JulianToday = Julian(y, m, d);
+	    if (Ctx->JulianToday == -1) {
+		BadCommandLine(BadDate);
+		return;
 	    }
-	    CurYear = y;
-	    CurMon = m;
-	    CurDay = d;
-	    if (JulianToday != RealToday) IgnoreOnce = 1;
+	    Ctx->CurYear = y;
+	    Ctx->CurMon = m;
+	    Ctx->CurDay = d;
+	    if (Ctx->JulianToday != Ctx->RealToday) Ctx->IgnoreOnce = 1;
 	}
 
     }
 
 /* Figure out the offset from UTC */
-    if (CalculateUTC)
-	(void) CalcMinsFromUTC(JulianToday, SystemTime(0)/60,
-			       &MinsFromUTC, NULL);
+    if (Ctx->CalculateUTC)
+	(void) CalcMinsFromUTC(Ctx->JulianToday, SystemTime(0)/60,
+			       &Ctx->MinsFromUTC, NULL);
 }
 
 /***************************************************************/
@@ -743,6 +831,7 @@ void Usage(void)
     fprintf(ErrFp, " -w[n[,p[,s]]]  Specify width, padding and spacing of calendar\n");
     fprintf(ErrFp, " -s[a][+][n] Produce `simple calendar' for n (1) months (weeks)\n");
     fprintf(ErrFp, " -p[a][n] Same as -s, but input compatible with rem2ps\n");
+    fprintf(ErrFp, " -pb[n] Same as -p, but in a binary format that rem2ps reads faster\n");
     fprintf(ErrFp, " -l     Prefix each simple calendar line with line number and filename comment\n");
     fprintf(ErrFp, " -v     Verbose mode\n");
     fprintf(ErrFp, " -o     Ignore ONCE directives\n");
@@ -762,6 +851,18 @@ void Usage(void)
     fprintf(ErrFp, " -m     Start calendar with Monday rather than Sunday\n");
     fprintf(ErrFp, " -y     Synthesize tags for tagless reminders\n");
     fprintf(ErrFp, " -j[n]  Run in 'purge' mode.  [n = INCLUDE depth]\n");
+    fprintf(ErrFp, " --socket=path  In server mode, serve clients on Unix socket `path'\n");
+    fprintf(ErrFp, " --serve=path  Answer calendar queries on Unix socket `path' (- for stdin)\n");
+    fprintf(ErrFp, " --batch=file  Run the jobs listed in `file' (- for stdin) in one process\n");
+    fprintf(ErrFp, " --prelude=file  With --batch, run `file' once and fork each job from there\n");
+    fprintf(ErrFp, " --queue-state=file  Save queued reminders' state in `file' across restarts\n");
+    fprintf(ErrFp, " --events=yyyy-mm-dd  Write each occurrence up to the date as a JSON line\n");
+    fprintf(ErrFp, " --ical=yyyy-mm-dd  Write occurrences up to the date as iCalendar\n");
+    fprintf(ErrFp, " --compile=table,yyyy-mm-dd  Compile OMITs and occurrences up to the date\n");
+    fprintf(ErrFp, " --threads[=n]  Produce a calendar's months or weeks in n threads\n");
+    fprintf(ErrFp, " --processes[=n]  Produce a calendar's months or weeks in n processes\n");
+    fprintf(ErrFp, " --html[=table]  Write the calendar as an HTML page (or just its tables)\n");
+    fprintf(ErrFp, " --lang=xx  Use language xx (en, de, fr, ...) for dates and substitutions\n");
     exit(EXIT_FAILURE);
 }
 #endif /* L_USAGE_OVERRIDE */
@@ -947,3 +1048,179 @@ AddTrustedUser(char const *username)
     NumTrustedUsers++;
 }
 
+
+/***************************************************************/
+/*                                                             */
+/*  WorkerCount                                                */
+/*                                                             */
+/*  Parse the n of --threads[=n] or --processes[=n]; without   */
+/*  it, use one per processor.  Returns 0 if it is invalid.    */
+/*                                                             */
+/***************************************************************/
+static int
+WorkerCount(char const *arg)
+{
+    char const *s = strchr(arg, '=');
+    int n = 0;
+
+    if (s) {
+	s++;
+	while (isdigit(*s)) {
+	    n = n * 10 + (*s - '0');
+	    if (n > MAX_CAL_WORKERS) n = MAX_CAL_WORKERS;
+	    s++;
+	}
+	if (*s || !n) {
+	    fprintf(ErrFp, "%s: --%.*s requires a positive number\n", ArgV[0],
+		    (int) (strchr(arg, '=') - arg), arg);
+	    return 0;
+	}
+	return n;
+    }
+#ifdef _SC_NPROCESSORS_ONLN
+    n = (int) sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    if (n < 1) n = 1;
+    if (n > MAX_CAL_WORKERS) n = MAX_CAL_WORKERS;
+    return n;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  ProcessLongOption                                          */
+/*                                                             */
+/*  Handle an option of the form --name or --name=value.       */
+/*  arg points just past the leading "--".                     */
+/*                                                             */
+/***************************************************************/
+static void
+ProcessLongOption(char const *arg)
+{
+    /* A batch job can only ask for some kind of output */
+    if (InBatchJob && strncmp(arg, "events=", 7) && strncmp(arg, "ical=", 5) &&
+	strncmp(arg, "html", 4) && strncmp(arg, "lang=", 5)) {
+	RejectBatchOption(arg-2);
+	return;
+    }
+    if (!strncmp(arg, "batch=", 6)) {
+	if (!arg[6]) {
+	    fprintf(ErrFp, "%s: --batch requires a file name\n", ArgV[0]);
+	    return;
+	}
+	BatchFile = arg+6;
+	return;
+    }
+    if (!strncmp(arg, "prelude=", 8)) {
+	if (!arg[8]) {
+	    fprintf(ErrFp, "%s: --prelude requires a file name\n", ArgV[0]);
+	    return;
+	}
+	PreludeFile = arg+8;
+	return;
+    }
+    if (!strncmp(arg, "socket=", 7)) {
+	if (!arg[7]) {
+	    fprintf(ErrFp, "%s: --socket requires a path\n", ArgV[0]);
+	    return;
+	}
+	SocketPath = arg+7;
+	/* Socket service implies server mode */
+	Ctx->DontFork = 1;
+	Ctx->Daemon = -1;
+	return;
+    }
+    if (!strncmp(arg, "serve=", 6)) {
+	if (!arg[6]) {
+	    fprintf(ErrFp, "%s: --serve requires a path\n", ArgV[0]);
+	    return;
+	}
+	ServePath = arg+6;
+	return;
+    }
+    if (!strncmp(arg, "queue-state=", 12)) {
+	if (!arg[12]) {
+	    fprintf(ErrFp, "%s: --queue-state requires a file name\n", ArgV[0]);
+	    return;
+	}
+	QueueStateFile = arg+12;
+	return;
+    }
+    if (!strncmp(arg, "events=", 7)) {
+	char const *s = arg+7;
+	int jul, tim;
+	if (ParseLiteralDate(&s, &jul, &tim) || *s || tim != NO_TIME) {
+	    fprintf(ErrFp, "%s: --events requires a date of the form yyyy-mm-dd\n", ArgV[0]);
+	    return;
+	}
+	Ctx->EventsUntil = jul;
+	return;
+    }
+    if (!strncmp(arg, "compile=", 8)) {
+	char const *s = strrchr(arg+8, ',');
+	size_t len;
+	int jul, tim;
+	if (!s || s == arg+8) {
+	    fprintf(ErrFp, "%s: --compile requires a table file and a date of the form yyyy-mm-dd\n", ArgV[0]);
+	    return;
+	}
+	len = s - (arg+8);
+	s++;
+	if (ParseLiteralDate(&s, &jul, &tim) || *s || tim != NO_TIME) {
+	    fprintf(ErrFp, "%s: --compile requires a table file and a date of the form yyyy-mm-dd\n", ArgV[0]);
+	    return;
+	}
+	free(Ctx->TableFile);
+	Ctx->TableFile = malloc(len+1);
+	if (!Ctx->TableFile) {
+	    fprintf(ErrFp, "%s: %s\n", ArgV[0], ErrMsg[E_NO_MEM]);
+	    exit(1);
+	}
+	memcpy(Ctx->TableFile, arg+8, len);
+	Ctx->TableFile[len] = 0;
+	Ctx->EventsUntil = jul;
+	return;
+    }
+    if (!strncmp(arg, "ical=", 5)) {
+	char const *s = arg+5;
+	int jul, tim;
+	if (ParseLiteralDate(&s, &jul, &tim) || *s || tim != NO_TIME) {
+	    fprintf(ErrFp, "%s: --ical requires a date of the form yyyy-mm-dd\n", ArgV[0]);
+	    return;
+	}
+	Ctx->EventsUntil = jul;
+	Ctx->DoICalendar = 1;
+	return;
+    }
+    if (!strcmp(arg, "html") || !strcmp(arg, "html=table")) {
+	Ctx->HtmlCal = (arg[4] ? HTML_TABLE : HTML_PAGE);
+	/* Collect the specials just as -pp does */
+	Ctx->DoSimpleCalendar = 1;
+	Ctx->PsCal = PSCAL_LEVEL2;
+	return;
+    }
+    if (!strcmp(arg, "threads") || !strncmp(arg, "threads=", 8)) {
+	int n = WorkerCount(arg);
+	if (!n) return;
+#ifndef USE_THREADS
+	fprintf(ErrFp, "%s: --threads is not supported on this system; ignored\n", ArgV[0]);
+#endif
+	Ctx->CalThreads = n;
+	return;
+    }
+    if (!strcmp(arg, "processes") || !strncmp(arg, "processes=", 10)) {
+	Ctx->CalProcesses = WorkerCount(arg);
+	return;
+    }
+    if (!strncmp(arg, "lang=", 5)) {
+	LangTable const *lang = FindLanguage(arg+5);
+	if (!lang) {
+	    fprintf(ErrFp, "%s: Unknown language `%s'\n", ArgV[0], arg+5);
+	    return;
+	}
+	if (SetLanguage(lang)) {
+	    fprintf(ErrFp, "%s: %s\n", ArgV[0], ErrMsg[E_NO_MEM]);
+	}
+	return;
+    }
+    fprintf(ErrFp, "%s: Unknown long option --%s\n", ArgV[0], arg);
+}
@@ -0,0 +1,229 @@
+/***************************************************************/
+/*                                                             */
+/*  LANGS.C                                                    */
+/*                                                             */
+/*  Every language in langs/, compiled into one table each so  */
+/*  that the language can be chosen at run time, with --lang   */
+/*  or SET $Language, rather than when Remind is built.  Each  */
+/*  language gets its own copy of DoSubst, so the L_*_OVER     */
+/*  hooks in its header still work.  The language chosen with  */
+/*  LANG at build time is the default.                         */
+/*                                                             */
+/*  This file is part of REMIND.                               */
+/*  Copyright (C) 1992-2022 by Dianne Skoll                    */
+/*                                                             */
+/***************************************************************/
+
+#include "config.h"
+#include "expr.h"
+#define L_IN_DOSUBST
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+
+#include <stdlib.h>
+
+#include "types.h"
+#include "globals.h"
+#include "err.h"
+#include "protos.h"
+
+/* globals.h has brought in the default language; start afresh */
+#include "langs/clear.h"
+
+/* The overrides use the language's own day and month names */
+#define DayName (Ctx->Lang->DayName)
+#define MonthName (Ctx->Lang->MonthName)
+
+/* The table for the language whose header was included last */
+#define LANG_TABLE(code) { \
+    L_LANGNAME, code, \
+    { L_MONDAY, L_TUESDAY, L_WEDNESDAY, L_THURSDAY, L_FRIDAY, \
+      L_SATURDAY, L_SUNDAY }, \
+    { L_JAN, L_FEB, L_MAR, L_APR, L_MAY, L_JUN, \
+      L_JUL, L_AUG, L_SEP, L_OCT, L_NOV, L_DEC }, \
+    L_TODAY, L_TOMORROW, L_BANNER, L_AM, L_PM, L_AGO, L_FROMNOW, \
+    L_ON, L_NOW, L_AT, L_MINUTE, L_HOUR, L_IS, L_WAS, L_AND, \
+    L_HPLU, L_MPLU, LANG_DOSUBST }
+
+#include "langs/english.h"
+#define LANG_DOSUBST EnglishSubst
+#include "dosubst.h"
+static LangTable const English = LANG_TABLE("en");
+#undef LANG_DOSUBST
+#include "langs/clear.h"
+
+#include "langs/german.h"
+#define LANG_DOSUBST GermanSubst
+#include "dosubst.h"
+static LangTable const German = LANG_TABLE("de");
+#undef LANG_DOSUBST
+#include "langs/clear.h"
+
+#include "langs/dutch.h"
+#define LANG_DOSUBST DutchSubst
+#include "dosubst.h"
+static LangTable const Dutch = LANG_TABLE("nl");
+#undef LANG_DOSUBST
+#include "langs/clear.h"
+
+#include "langs/finnish.h"
+#define LANG_DOSUBST FinnishSubst
+#include "dosubst.h"
+static LangTable const Finnish = LANG_TABLE("fi");
+#undef LANG_DOSUBST
+#include "langs/clear.h"
+
+#include "langs/french.h"
+#define LANG_DOSUBST FrenchSubst
+#include "dosubst.h"
+static LangTable const French = LANG_TABLE("fr");
+#undef LANG_DOSUBST
+#include "langs/clear.h"
+
+#include "langs/norwgian.h"
+#define LANG_DOSUBST NorwegianSubst
+#include "dosubst.h"
+static LangTable const Norwegian = LANG_TABLE("no");
+#undef LANG_DOSUBST
+#include "langs/clear.h"
+
+#include "langs/danish.h"
+#define LANG_DOSUBST DanishSubst
+#include "dosubst.h"
+static LangTable const Danish = LANG_TABLE("da");
+#undef LANG_DOSUBST
+#include "langs/clear.h"
+
+#include "langs/polish.h"
+#define LANG_DOSUBST PolishSubst
+#include "dosubst.h"
+static LangTable const Polish = LANG_TABLE("pl");
+#undef LANG_DOSUBST
+#include "langs/clear.h"
+
+#include "langs/portbr.h"
+#define LANG_DOSUBST BrazPortSubst
+#include "dosubst.h"
+static LangTable const BrazPort = LANG_TABLE("pt");
+#undef LANG_DOSUBST
+#include "langs/clear.h"
+
+#include "langs/italian.h"
+#define LANG_DOSUBST ItalianSubst
+#include "dosubst.h"
+static LangTable const Italian = LANG_TABLE("it");
+#undef LANG_DOSUBST
+#include "langs/clear.h"
+
+#include "langs/romanian.h"
+#define LANG_DOSUBST RomanianSubst
+#include "dosubst.h"
+static LangTable const Romanian = LANG_TABLE("ro");
+#undef LANG_DOSUBST
+#include "langs/clear.h"
+
+#include "langs/spanish.h"
+#define LANG_DOSUBST SpanishSubst
+#include "dosubst.h"
+static LangTable const Spanish = LANG_TABLE("es");
+#undef LANG_DOSUBST
+#include "langs/clear.h"
+
+#include "langs/icelandic.h"
+#define LANG_DOSUBST IcelandicSubst
+#include "dosubst.h"
+static LangTable const Icelandic = LANG_TABLE("is");
+#undef LANG_DOSUBST
+#include "langs/clear.h"
+
+#undef DayName
+#undef MonthName
+
+/* Indexed by the language numbers in lang.h */
+static LangTable const *Languages[] = {
+    &English, &German, &Dutch, &Finnish, &French, &Norwegian, &Danish,
+    &Polish, &BrazPort, &Italian, &Romanian, &Spanish, &Icelandic
+};
+#define NUM_LANGUAGES ((int) (sizeof(Languages) / sizeof(Languages[0])))
+
+/***************************************************************/
+/*                                                             */
+/*  DefaultLanguage                                            */
+/*                                                             */
+/*  The language Remind was built for.                         */
+/*                                                             */
+/***************************************************************/
+LangTable const *DefaultLanguage(void)
+{
+    if (LANG < 0 || LANG >= NUM_LANGUAGES) return &English;
+    return Languages[LANG];
+}
+
+/***************************************************************/
+/*                                                             */
+/*  FindLanguage                                               */
+/*                                                             */
+/*  Find a language by its code ("de") or its name ("German"). */
+/*  Returns NULL if there is no such language.                 */
+/*                                                             */
+/***************************************************************/
+LangTable const *FindLanguage(char const *name)
+{
+    int i;
+
+    for (i=0; i<NUM_LANGUAGES; i++) {
+	if (!StrCmpi(name, Languages[i]->Code) ||
+	    !StrCmpi(name, Languages[i]->Name)) {
+	    return Languages[i];
+	}
+    }
+    return NULL;
+}
+
+static int SetWord(char **word, char const *s)
+{
+    char *t = StrDup(s);
+    if (!t) return E_NO_MEM;
+    free(*word);
+    *word = t;
+    return OK;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  SetLanguage                                                */
+/*                                                             */
+/*  Make lang the current context's language.  The names and   */
+/*  words that can be SET, and the banner, are reset to the    */
+/*  language's.                                                */
+/*                                                             */
+/***************************************************************/
+int SetLanguage(LangTable const *lang)
+{
+    int i, r = OK;
+
+    Ctx->Lang = lang;
+    for (i=0; i<7 && !r; i++) r = SetWord(&Ctx->DynamicDayName[i], lang->DayName[i]);
+    for (i=0; i<12 && !r; i++) r = SetWord(&Ctx->DynamicMonthName[i], lang->MonthName[i]);
+    if (!r) r = SetWord(&Ctx->DynamicToday, lang->Today);
+    if (!r) r = SetWord(&Ctx->DynamicTomorrow, lang->Tomorrow);
+    if (!r) r = SetWord(&Ctx->DynamicAm, lang->Am);
+    if (!r) r = SetWord(&Ctx->DynamicPm, lang->Pm);
+    if (!r) r = SetWord(&Ctx->DynamicAgo, lang->Ago);
+    if (!r) r = SetWord(&Ctx->DynamicFromnow, lang->Fromnow);
+    if (!r) r = SetWord(&Ctx->DynamicOn, lang->On);
+    if (!r) r = SetWord(&Ctx->DynamicNow, lang->Now);
+    if (!r) r = SetWord(&Ctx->DynamicAt, lang->At);
+    if (!r) r = SetWord(&Ctx->DynamicMinute, lang->Minute);
+    if (!r) r = SetWord(&Ctx->DynamicHour, lang->Hour);
+    if (!r) r = SetWord(&Ctx->DynamicIs, lang->Is);
+    if (!r) r = SetWord(&Ctx->DynamicWas, lang->Was);
+    if (!r) r = SetWord(&Ctx->DynamicAnd, lang->And);
+    if (!r) r = SetWord(&Ctx->DynamicHplu, lang->Hplu);
+    if (!r) r = SetWord(&Ctx->DynamicMplu, lang->Mplu);
+    if (r) return r;
+
+    DBufFree(&Ctx->Banner);
+    return DBufPuts(&Ctx->Banner, lang->Banner);
+}
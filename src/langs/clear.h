@@ -0,0 +1,115 @@
+/***************************************************************/
+/*                                                             */
+/*  CLEAR.H                                                    */
+/*                                                             */
+/*  Forget the language defined by the last langs/ header, so  */
+/*  that langs.c can include the next one.  A macro added to   */
+/*  any language file must be added here too.                  */
+/*                                                             */
+/*  This file is part of REMIND.                               */
+/*  Copyright (C) 1992-2022 by Dianne Skoll                    */
+/*                                                             */
+/***************************************************************/
+
+/* Words */
+#undef L_LANGNAME
+#undef L_SUNDAY
+#undef L_MONDAY
+#undef L_TUESDAY
+#undef L_WEDNESDAY
+#undef L_THURSDAY
+#undef L_FRIDAY
+#undef L_SATURDAY
+#undef L_JAN
+#undef L_FEB
+#undef L_MAR
+#undef L_APR
+#undef L_MAY
+#undef L_JUN
+#undef L_JUL
+#undef L_AUG
+#undef L_SEP
+#undef L_OCT
+#undef L_NOV
+#undef L_DEC
+#undef L_TODAY
+#undef L_TOMORROW
+#undef L_BANNER
+#undef L_AM
+#undef L_PM
+#undef L_AGO
+#undef L_FROMNOW
+#undef L_INXDAYS
+#undef L_ON
+#undef L_PLURAL
+#undef L_NOW
+#undef L_AT
+#undef L_MINUTE
+#undef L_HOUR
+#undef L_IS
+#undef L_WAS
+#undef L_AND
+#undef L_HPLU
+#undef L_MPLU
+#undef L_HGEN
+#undef L_MGEN
+#undef L_NPLU
+#undef L_PARTIT
+
+/* Overrides; see dosubst.h */
+#undef L_ORDINAL_OVERRIDE
+#undef L_AMPM_OVERRIDE
+#undef L_HPLU_OVER
+#undef L_MPLU_OVER
+#undef L_A_OVER
+#undef L_B_OVER
+#undef L_C_OVER
+#undef L_D_OVER
+#undef L_E_OVER
+#undef L_F_OVER
+#undef L_G_OVER
+#undef L_H_OVER
+#undef L_I_OVER
+#undef L_J_OVER
+#undef L_K_OVER
+#undef L_L_OVER
+#undef L_M_OVER
+#undef L_N_OVER
+#undef L_O_OVER
+#undef L_P_OVER
+#undef L_Q_OVER
+#undef L_R_OVER
+#undef L_S_OVER
+#undef L_T_OVER
+#undef L_U_OVER
+#undef L_V_OVER
+#undef L_W_OVER
+#undef L_X_OVER
+#undef L_Y_OVER
+#undef L_Z_OVER
+#undef L_0_OVER
+#undef L_1_OVER
+#undef L_2_OVER
+#undef L_3_OVER
+#undef L_4_OVER
+#undef L_5_OVER
+#undef L_6_OVER
+#undef L_7_OVER
+#undef L_8_OVER
+#undef L_9_OVER
+#undef L_BANG_OVER
+#undef L_AT_OVER
+#undef L_HASH_OVER
+#undef L_NOTOMORROW_A
+#undef L_NOTOMORROW_B
+#undef L_NOTOMORROW_C
+#undef L_NOTOMORROW_E
+#undef L_NOTOMORROW_F
+#undef L_NOTOMORROW_G
+#undef L_NOTOMORROW_H
+#undef L_NOTOMORROW_I
+#undef L_NOTOMORROW_J
+#undef L_NOTOMORROW_K
+#undef L_NOTOMORROW_L
+#undef L_NOTOMORROW_U
+#undef L_NOTOMORROW_V
@@ -88,23 +88,23 @@
                                 MonthName[m], y);
 #define L_C_OVER	sprintf(s, "%s", DayName[jul%7]);
 
-#define L_E_OVER	sprintf(s, "%02d%c%02d%c%04d", d, DateSep,\
-                                 m+1, DateSep, y);
+#define L_E_OVER	sprintf(s, "%02d%c%02d%c%04d", d, Ctx->DateSep,\
+                                 m+1, Ctx->DateSep, y);
 
-#define L_F_OVER	sprintf(s, "%02d%c%02d%c%04d", m+1, DateSep, d, DateSep, y);
+#define L_F_OVER	sprintf(s, "%02d%c%02d%c%04d", m+1, Ctx->DateSep, d, Ctx->DateSep, y);
 
 #define L_G_OVER	sprintf(s, "%s, %d %s", DayName[jul%7], d, MonthName[m]);
 
-#define L_H_OVER	sprintf(s, "%02d%c%02d", d, DateSep, m+1);
+#define L_H_OVER	sprintf(s, "%02d%c%02d", d, Ctx->DateSep, m+1);
 
-#define L_I_OVER	sprintf(s, "%02d%c%02d", m+1, DateSep, d);
+#define L_I_OVER	sprintf(s, "%02d%c%02d", m+1, Ctx->DateSep, d);
 
 #define L_J_OVER	sprintf(s, "%s, %d %s %d", DayName[jul%7], d, \
                                 MonthName[m], y);
 
 #define L_K_OVER	sprintf(s, "%s, %d %s", DayName[jul%7], d, \
                                 MonthName[m]);
-#define L_L_OVER	sprintf(s, "%04d%c%02d%c%02d", y, DateSep, m+1, DateSep, d);
+#define L_L_OVER	sprintf(s, "%04d%c%02d%c%02d", y, Ctx->DateSep, m+1, Ctx->DateSep, d);
 
 #define L_U_OVER	sprintf(s, "%s, %d %s %d", DayName[jul%7], d, \
                                 MonthName[m], y);
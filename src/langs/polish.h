@@ -234,7 +234,8 @@ EXTERN char *ErrMsg[] =
     "No files matching *.rem",
     "String too long",
     "Time specified twice",
-    "Cannot specify DURATION without specifying AT"
+    "Cannot specify DURATION without specifying AT",
+    "File ended by EXIT"
 };
 #endif /* MK_GLOBALS */
 
@@ -0,0 +1,479 @@
+/***************************************************************/
+/*                                                             */
+/*  LIBREMIND.C                                                */
+/*                                                             */
+/*  The library interface: load a set of reminder files once   */
+/*  and query it many times.  Each handle has its own          */
+/*  interpreter context; the file cache is shared, so files    */
+/*  are read from disk only once no matter how often they are  */
+/*  queried.                                                   */
+/*                                                             */
+/*  This file is part of REMIND.                               */
+/*  Copyright (C) 1992-2022 by Dianne Skoll                    */
+/*                                                             */
+/***************************************************************/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "types.h"
+#include "protos.h"
+#include "expr.h"
+#include "globals.h"
+#include "err.h"
+#include "libremind.h"
+
+struct rem_handle {
+    RemContext *ctx;
+    FILE *errfp;
+    char *path;		/* The file or directory loaded */
+    int today;		/* The date being evaluated */
+    int ran;		/* Date the file was last run for, or NO_DATE */
+};
+
+/* A growing array of occurrences being collected */
+typedef struct {
+    RemOccurrence *occ;
+    int num;
+    int size;
+} OccList;
+
+/***************************************************************/
+/*                                                             */
+/*  Enter                                                      */
+/*                                                             */
+/*  Make h's context current for the duration of a call.       */
+/*  Returns the context to restore with SwitchContext.         */
+/*                                                             */
+/***************************************************************/
+static RemContext *Enter(RemHandle *h)
+{
+    ErrFp = h->errfp;
+    return SwitchContext(h->ctx);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  SetToday                                                   */
+/*                                                             */
+/*  Set the date being evaluated, as if it had been given on   */
+/*  the command line.                                          */
+/*                                                             */
+/***************************************************************/
+static void SetToday(RemHandle *h, int jul)
+{
+    h->today = jul;
+    h->ran = NO_DATE;
+    Ctx->JulianToday = jul;
+    FromJulian(jul, &Ctx->CurYear, &Ctx->CurMon, &Ctx->CurDay);
+    Ctx->IgnoreOnce = (jul != Ctx->RealToday);
+    if (Ctx->CalculateUTC) {
+	(void) CalcMinsFromUTC(jul, SystemTime(0)/60, &Ctx->MinsFromUTC, NULL);
+    }
+}
+
+/***************************************************************/
+/*                                                             */
+/*  RunFile                                                    */
+/*                                                             */
+/*  Make sure the variables and functions defined by the file  */
+/*  are those it defines on the date being evaluated.          */
+/*                                                             */
+/***************************************************************/
+static int RunFile(RemHandle *h)
+{
+    int r;
+
+    if (!h->path || h->ran == h->today) return OK;
+    r = RunCalendarFile(h->today);
+    Ctx->JulianToday = h->today;
+    if (r) return r;
+    h->ran = h->today;
+    return OK;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  rem_new                                                    */
+/*                                                             */
+/*  Create a handle with nothing loaded, evaluating today's    */
+/*  date.  Returns NULL if out of memory.                      */
+/*                                                             */
+/***************************************************************/
+RemHandle *rem_new(void)
+{
+    RemHandle *h;
+    RemContext *old;
+
+    h = calloc(1, sizeof(RemHandle));
+    if (!h) return NULL;
+    h->errfp = stderr;
+    h->ctx = NewContext();
+    if (!h->ctx) {
+	free(h);
+	return NULL;
+    }
+
+    old = Enter(h);
+    Ctx->RealToday = SystemDate(&Ctx->CurYear, &Ctx->CurMon, &Ctx->CurDay);
+    set_components_from_lat_and_long();
+
+    /* Evaluate as for "remind -pp", keeping files in memory */
+    Ctx->ShouldCache = 1;
+    Ctx->DoSimpleCalendar = 1;
+    Ctx->PsCal = PSCAL_LEVEL2;
+    Ctx->DoPrefixLineNo = 1;
+    Ctx->DontQueue = 1;
+    Ctx->RunDisabled = RUN_CMDLINE;
+    /* EXIT must end only the file, never the program */
+    Ctx->TrapExit = 1;
+    SetToday(h, Ctx->RealToday);
+    SwitchContext(old);
+    return h;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  rem_free                                                   */
+/*                                                             */
+/*  Free a handle and everything its interpreter holds.        */
+/*                                                             */
+/***************************************************************/
+void rem_free(RemHandle *h)
+{
+    if (!h) return;
+    ErrFp = h->errfp;
+    FreeContext(h->ctx);
+    free(h->path);
+    free(h);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  rem_set_error_file                                         */
+/*                                                             */
+/*  Send error messages for h to fp rather than stderr.        */
+/*                                                             */
+/***************************************************************/
+void rem_set_error_file(RemHandle *h, FILE *fp)
+{
+    h->errfp = fp ? fp : stderr;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  rem_strerror                                               */
+/*                                                             */
+/*  Describe an error returned by one of these functions.      */
+/*                                                             */
+/***************************************************************/
+char const *rem_strerror(int err)
+{
+    /* E_EXIT is the last message */
+    if (err < 0 || err > E_EXIT) return "Unknown error";
+    return ErrMsg[err];
+}
+
+/***************************************************************/
+/*                                                             */
+/*  rem_load                                                   */
+/*                                                             */
+/*  Load a reminder file, or a directory of *.rem files, along */
+/*  with everything it INCLUDEs.  It replaces whatever was     */
+/*  loaded before.                                             */
+/*                                                             */
+/***************************************************************/
+int rem_load(RemHandle *h, char const *path)
+{
+    RemContext *old;
+    char *p;
+    int r;
+
+    p = StrDup(path);
+    if (!p) return E_NO_MEM;
+    free(h->path);
+    h->path = p;
+
+    old = Enter(h);
+    Ctx->InitialFile = h->path;
+    h->ran = NO_DATE;
+    r = RunFile(h);
+    SwitchContext(old);
+    return r;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  rem_reload                                                 */
+/*                                                             */
+/*  Forget the cached files and read them from disk again.     */
+/*  The cache is shared, so this affects every handle.         */
+/*                                                             */
+/***************************************************************/
+int rem_reload(RemHandle *h)
+{
+    RemContext *old;
+    int r;
+
+    old = Enter(h);
+    ClearFileCache();
+    h->ran = NO_DATE;
+    r = RunFile(h);
+    SwitchContext(old);
+    return r;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  rem_set_date                                               */
+/*                                                             */
+/*  Set the date being evaluated (today() in expressions.)     */
+/*  Month is 1-12.                                             */
+/*                                                             */
+/***************************************************************/
+int rem_set_date(RemHandle *h, int year, int month, int day)
+{
+    RemContext *old;
+
+    if (!DateOK(year, month-1, day)) return E_BAD_DATE;
+    old = Enter(h);
+    SetToday(h, Julian(year, month-1, day));
+    SwitchContext(old);
+    return OK;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  rem_set_time                                               */
+/*                                                             */
+/*  Set the time of day now() returns, in minutes after        */
+/*  midnight, or -1 to use the system clock.                   */
+/*                                                             */
+/***************************************************************/
+int rem_set_time(RemHandle *h, int minutes)
+{
+    RemContext *old;
+
+    if (minutes < -1 || minutes >= MINUTES_PER_DAY) return E_BAD_TIME;
+    old = Enter(h);
+    Ctx->SysTime = (minutes < 0) ? -1L : (long) minutes * 60L;
+    h->ran = NO_DATE;
+    SwitchContext(old);
+    return OK;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  rem_set_option                                             */
+/*                                                             */
+/*  Set one of the REM_OPT_ options, which correspond to       */
+/*  command-line options of remind.                            */
+/*                                                             */
+/***************************************************************/
+int rem_set_option(RemHandle *h, int option, int value)
+{
+    RemContext *old;
+    int r = OK;
+
+    old = Enter(h);
+    switch(option) {
+    case REM_OPT_RUN:
+	if (value) Ctx->RunDisabled &= ~RUN_CMDLINE;
+	else       Ctx->RunDisabled |= RUN_CMDLINE;
+	break;
+
+    case REM_OPT_TIME_FORMAT:
+	if (value < 0 || value > 2) r = E_DOMAIN_ERR;
+	else Ctx->ScFormat = value;
+	break;
+
+    case REM_OPT_NO_TIMED:
+	Ctx->DontIssueAts = value;
+	break;
+
+    case REM_OPT_ADVANCE:
+	Ctx->DoSimpleCalDelta = value;
+	break;
+
+    case REM_OPT_MAX_SAT_ITER:
+	Ctx->MaxSatIter = (value < 10) ? 10 : value;
+	break;
+
+    default:
+	r = E_DOMAIN_ERR;
+    }
+    h->ran = NO_DATE;
+    SwitchContext(old);
+    return r;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  rem_set_var                                                */
+/*                                                             */
+/*  Set a variable to the value of an expression, as the -i    */
+/*  option does.  The variable is preserved, so the files      */
+/*  see it on every date.  A name starting with $ sets a       */
+/*  system variable.                                           */
+/*                                                             */
+/***************************************************************/
+int rem_set_var(RemHandle *h, char const *name, char const *expr)
+{
+    RemContext *old;
+    Value val;
+    int r;
+
+    if (!*name) return E_MISS_VAR;
+    old = Enter(h);
+    r = EvalExpr(&expr, &val, NULL);
+    if (!r) {
+	if (*name == '$') {
+	    r = SetSysVar(name+1, &val);
+	    DestroyValue(val);
+	} else {
+	    r = SetVar(name, &val);
+	    if (!r) r = PreserveVar(name);
+	}
+    }
+    h->ran = NO_DATE;
+    SwitchContext(old);
+    return r;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  AddOccurrence                                              */
+/*                                                             */
+/*  Append a copy of an occurrence to an OccList.              */
+/*                                                             */
+/***************************************************************/
+static int AddOccurrence(RemOccurrence const *o, void *data)
+{
+    OccList *list = (OccList *) data;
+    RemOccurrence *n;
+
+    if (list->num == list->size) {
+	int size = list->size ? 2*list->size : 16;
+	n = realloc(list->occ, size * sizeof(RemOccurrence));
+	if (!n) return E_NO_MEM;
+	list->occ = n;
+	list->size = size;
+    }
+    n = &list->occ[list->num];
+    *n = *o;
+    n->passthru = StrDup(o->passthru);
+    n->tags = StrDup(o->tags);
+    n->body = StrDup(o->body);
+    n->plain_body = StrDup(o->plain_body);
+    n->raw_body = StrDup(o->raw_body);
+    n->filename = StrDup(o->filename);
+    list->num++;
+    if (!n->passthru || !n->tags || !n->body || !n->plain_body ||
+	!n->raw_body || !n->filename) return E_NO_MEM;
+    return OK;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  rem_occurrences                                            */
+/*                                                             */
+/*  Find the reminders that occur on each of ndays days        */
+/*  starting with the given one.  On success, *occ is an       */
+/*  array of *num occurrences in date order, to be freed with  */
+/*  rem_free_occurrences.                                      */
+/*                                                             */
+/***************************************************************/
+int rem_occurrences(RemHandle *h, int year, int month, int day, int ndays,
+		    RemOccurrence **occ, int *num)
+{
+    RemContext *old;
+    OccList list;
+    int jul, r = OK;
+
+    *occ = NULL;
+    *num = 0;
+    if (!h->path) return E_CANT_OPEN;
+    if (!DateOK(year, month-1, day)) return E_BAD_DATE;
+    if (ndays < 0) return E_2LOW;
+
+    list.occ = NULL;
+    list.num = 0;
+    list.size = 0;
+
+    old = Enter(h);
+    for (jul = Julian(year, month-1, day); ndays--; jul++) {
+	r = CalendarOccurrences(jul, AddOccurrence, &list);
+	if (r) break;
+	h->ran = jul;
+    }
+    Ctx->JulianToday = h->today;
+    SwitchContext(old);
+
+    if (r) {
+	rem_free_occurrences(list.occ, list.num);
+	return r;
+    }
+    *occ = list.occ;
+    *num = list.num;
+    return OK;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  rem_free_occurrences                                       */
+/*                                                             */
+/*  Free an array returned by rem_occurrences.                 */
+/*                                                             */
+/***************************************************************/
+void rem_free_occurrences(RemOccurrence *occ, int num)
+{
+    int i;
+
+    for (i=0; i<num; i++) {
+	free((char *) occ[i].passthru);
+	free((char *) occ[i].tags);
+	free((char *) occ[i].body);
+	free((char *) occ[i].plain_body);
+	free((char *) occ[i].raw_body);
+	free((char *) occ[i].filename);
+    }
+    free(occ);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  rem_eval                                                   */
+/*                                                             */
+/*  Evaluate an expression on the date being evaluated, with   */
+/*  the variables and functions the files define.  On success  */
+/*  *result is the value as a string, to be freed with free(). */
+/*                                                             */
+/***************************************************************/
+int rem_eval(RemHandle *h, char const *expr, char **result)
+{
+    RemContext *old;
+    Value val;
+    int r;
+
+    *result = NULL;
+    old = Enter(h);
+    r = RunFile(h);
+    if (!r) r = EvalExpr(&expr, &val, NULL);
+    if (!r) {
+	while (isspace(*expr)) expr++;
+	if (*expr) r = E_EXTRANEOUS_TOKEN;
+	else r = DoCoerce(STR_TYPE, &val);
+	if (r) {
+	    DestroyValue(val);
+	} else {
+	    /* The string belongs to us now */
+	    *result = val.v.str;
+	}
+    }
+    SwitchContext(old);
+    return r;
+}
@@ -0,0 +1,76 @@
+/***************************************************************/
+/*                                                             */
+/*  LIBREMIND.H                                                */
+/*                                                             */
+/*  The interface to libremind, which lets a program load a    */
+/*  set of reminder files once and then query it as often as   */
+/*  it likes without running remind.  See libremind(3).        */
+/*                                                             */
+/*  This file is part of REMIND.                               */
+/*  Copyright (C) 1992-2022 by Dianne Skoll                    */
+/*                                                             */
+/***************************************************************/
+
+#ifndef LIBREMIND_H
+#define LIBREMIND_H
+
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* A loaded set of reminder files and the interpreter that
+   evaluates them */
+typedef struct rem_handle RemHandle;
+
+/* One occurrence of a reminder, as "remind -pp" would describe it */
+typedef struct rem_occurrence {
+    int year, month, day;	/* Month is 1-12 */
+    int time;			/* Minutes after midnight, or -1 */
+    int duration;		/* Minutes, or -1 */
+    int priority;		/* 0-9999 */
+    char const *passthru;	/* "" for plain reminders, else "COLOR", "SHADE"... */
+    int is_color;		/* If set, r, g and b give the color */
+    int r, g, b;
+    char const *tags;		/* Comma-separated TAGs */
+    char const *body;		/* Substituted text, as in "remind -s" */
+    char const *plain_body;	/* The same, less color and %" markers */
+    char const *raw_body;	/* Text before substitution */
+    char const *filename;	/* Where the reminder came from */
+    int lineno;
+} RemOccurrence;
+
+/* Options for rem_set_option */
+#define REM_OPT_RUN		1 /* Allow RUN and shell(); off by default */
+#define REM_OPT_TIME_FORMAT	2 /* As -b: 0=am/pm, 1=24-hour, 2=none */
+#define REM_OPT_NO_TIMED	3 /* As -a: leave out timed reminders */
+#define REM_OPT_ADVANCE		4 /* As -sa: include advance warnings */
+#define REM_OPT_MAX_SAT_ITER	5 /* As -x */
+
+/* All functions returning int return 0 on success, or an error
+   number that rem_strerror() describes. */
+
+RemHandle *rem_new(void);
+void rem_free(RemHandle *h);
+void rem_set_error_file(RemHandle *h, FILE *fp);
+char const *rem_strerror(int err);
+
+int rem_load(RemHandle *h, char const *path);
+int rem_reload(RemHandle *h);
+
+int rem_set_date(RemHandle *h, int year, int month, int day);
+int rem_set_time(RemHandle *h, int minutes);
+int rem_set_option(RemHandle *h, int option, int value);
+int rem_set_var(RemHandle *h, char const *name, char const *expr);
+
+int rem_occurrences(RemHandle *h, int year, int month, int day, int ndays,
+		    RemOccurrence **occ, int *num);
+void rem_free_occurrences(RemOccurrence *occ, int num);
+int rem_eval(RemHandle *h, char const *expr, char **result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LIBREMIND_H */
@@ -48,6 +48,8 @@
 #include "globals.h"
 #include "err.h"
 
+/* libremind is built from the same sources, less the program itself */
+#ifndef LIBREMIND
 static void DoReminders(void);
 
 /***************************************************************/
@@ -59,8 +61,6 @@ static void DoReminders(void);
 /***************************************************************/
 int main(int argc, char *argv[])
 {
-    int pid;
-
 #ifdef HAVE_SETLOCALE
     setlocale(LC_ALL, "");
 #endif
@@ -72,49 +72,101 @@ int main(int argc, char *argv[])
     ArgC = argc;
     ArgV = (char const **) argv;
 
+    /* Set up the interpreter's context */
+    Ctx = NewContext();
+    if (!Ctx) {
+	fprintf(ErrFp, "%s\n", ErrMsg[E_NO_MEM]);
+	return 1;
+    }
+
     InitRemind(argc, (char const **) argv);
-    DBufInit(&(LastTrigger.tags));
+
+    if (ServePath) {
+	return Serve(ServePath);
+    }
+    if (BatchFile) {
+	return RunBatch(BatchFile, PreludeFile);
+    }
+    if (PreludeFile) {
+	fprintf(ErrFp, "%s: --prelude only applies to --batch\n", ArgV[0]);
+    }
+    return RunRemind();
+}
+
+/***************************************************************/
+/*                                                             */
+/*  RunRemind                                                  */
+/*                                                             */
+/*  Do whatever the command line asked for once InitRemind has */
+/*  parsed it, and return the exit status.                     */
+/*                                                             */
+/***************************************************************/
+int RunRemind(void)
+{
+    int pid;
+
     ClearLastTriggers();
 
-    if (DoCalendar || (DoSimpleCalendar && (!NextMode || PsCal))) {
+    if (Ctx->EventsUntil != NO_DATE) {
+	if (Ctx->EventsUntil < Ctx->JulianToday) {
+	    fprintf(ErrFp, "%s: --%s date is earlier than the start date\n", ArgV[0],
+		    Ctx->TableFile ? "compile" :
+		    Ctx->DoICalendar ? "ical" : "events");
+	    return 1;
+	}
+	if (Ctx->TableFile) {
+	    return CompileTable();
+	}
+	if (Ctx->DoICalendar) {
+	    ProduceICalendar();
+	} else {
+	    ProduceEventStream();
+	}
+	return Ctx->Exited ? Ctx->ExitStatus : 0;
+    }
+
+    if (Ctx->DoCalendar || (Ctx->DoSimpleCalendar && (!Ctx->NextMode || Ctx->PsCal))) {
 	ProduceCalendar();
-	return 0;
+	return Ctx->Exited ? Ctx->ExitStatus : 0;
     }
 
     /* Are we purging old reminders?  Then just run through the loop once! */
-    if (PurgeMode) {
+    if (Ctx->PurgeMode) {
 	DoReminders();
 	return 0;
     }
 
-    /* Not doing a calendar.  Do the regular remind loop */
-    ShouldCache = (Iterations > 1);
+    /* Not doing a calendar.  Do the regular remind loop.  Server
+       mode keeps the files cached for the CALENDAR command, and
+       a batch keeps them for the jobs that follow. */
+    if (Ctx->Iterations > 1 || Ctx->Daemon < 0) Ctx->ShouldCache = 1;
 
-    while (Iterations--) {
+    while (Ctx->Iterations--) {
 	DoReminders();
+	if (Ctx->Exited) return Ctx->ExitStatus;
 
-	if (DebugFlag & DB_DUMP_VARS) {
+	if (Ctx->DebugFlag & DB_DUMP_VARS) {
 	    DumpVarTable();
 	    DumpSysVarByName(NULL);
 	}
 
-	if (!Hush) {
+	if (!Ctx->Hush) {
 	    if (DestroyOmitContexts())
 		Eprint("%s", ErrMsg[E_PUSH_NOPOP]);
-	    if (!Daemon && !NextMode && !NumTriggered && !NumQueued) {
+	    if (!Ctx->Daemon && !Ctx->NextMode && !Ctx->NumTriggered && !Ctx->NumQueued) {
 		printf("%s\n", ErrMsg[E_NOREMINDERS]);
-	    } else if (!Daemon && !NextMode && !NumTriggered) {
-		printf(ErrMsg[M_QUEUED], NumQueued);
+	    } else if (!Ctx->Daemon && !Ctx->NextMode && !Ctx->NumTriggered) {
+		printf(ErrMsg[M_QUEUED], Ctx->NumQueued);
 	    }
 	}
 
 	/* If there are sorted reminders, handle them */
-	if (SortByDate) IssueSortedReminders();
+	if (Ctx->SortByDate) IssueSortedReminders();
 
 	/* If there are any background reminders queued up, handle them */
-	if (NumQueued || Daemon) {
+	if (Ctx->NumQueued || Ctx->Daemon) {
 
-	    if (DontFork) {
+	    if (Ctx->DontFork) {
 		HandleQueuedReminders();
 		return 0;
 	    } else {
@@ -129,20 +181,21 @@ int main(int argc, char *argv[])
 		}
 	    }
 	}
-	if (Iterations) {
+	if (Ctx->Iterations) {
 	    PerIterationInit();
-	    JulianToday++;
+	    Ctx->JulianToday++;
 	}
     }
     return 0;
 }
+#endif /* LIBREMIND */
 
 void PurgeEchoLine(char const *fmt, ...)
 {
     va_list argptr;
     va_start(argptr, fmt);
-    if (PurgeFP != NULL) {
-	(void) vfprintf(PurgeFP, fmt, argptr);
+    if (Ctx->PurgeFP != NULL) {
+	(void) vfprintf(Ctx->PurgeFP, fmt, argptr);
     }
     va_end(argptr);
 
@@ -154,13 +207,15 @@ PerIterationInit(void)
     ClearGlobalOmits();
     DestroyOmitContexts();
     DestroyVars(0);
-    DefaultColorR = -1;
-    DefaultColorG = -1;
-    DefaultColorB = -1;
-    NumTriggered = 0;
+    RestoreBaseVars();
+    Ctx->DefaultColorR = -1;
+    Ctx->DefaultColorG = -1;
+    Ctx->DefaultColorB = -1;
+    Ctx->NumTriggered = 0;
     ClearLastTriggers();
 }
 
+#ifndef LIBREMIND
 /***************************************************************/
 /*                                                             */
 /*  DoReminders                                                */
@@ -176,23 +231,23 @@ static void DoReminders(void)
     Parser p;
     int purge_handled;
 
-    DidMsgReminder = 0;
+    Ctx->DidMsgReminder = 0;
 
-    if (!UseStdin) {
-	FileAccessDate = GetAccessDate(InitialFile);
+    if (!Ctx->UseStdin) {
+	Ctx->FileAccessDate = GetAccessDate(Ctx->InitialFile);
     } else {
-	FileAccessDate = JulianToday;
+	Ctx->FileAccessDate = Ctx->JulianToday;
     }
 
-    if (FileAccessDate < 0) {
-	fprintf(ErrFp, "%s: `%s': %s.\n", ErrMsg[E_CANTACCESS], InitialFile, strerror(errno));
+    if (Ctx->FileAccessDate < 0) {
+	fprintf(ErrFp, "%s: `%s': %s.\n", ErrMsg[E_CANTACCESS], Ctx->InitialFile, strerror(errno));
 	exit(1);
     }
 
-    r=IncludeFile(InitialFile);
+    r=IncludeFile(Ctx->InitialFile);
     if (r) {
 	fprintf(ErrFp, "%s %s: %s\n", ErrMsg[E_ERR_READING],
-		InitialFile, ErrMsg[r]);
+		Ctx->InitialFile, ErrMsg[r]);
 	exit(1);
     }
 
@@ -203,10 +258,10 @@ static void DoReminders(void)
 	    Eprint("%s: %s", ErrMsg[E_ERR_READING], ErrMsg[r]);
 	    exit(1);
 	}
-	s = FindInitialToken(&tok, CurLine);
+	s = FindInitialToken(&tok, Ctx->CurLine);
 
 	/* Should we ignore it? */
-	if (NumIfs &&
+	if (Ctx->NumIfs &&
 	    tok.type != T_If &&
 	    tok.type != T_Else &&
 	    tok.type != T_EndIf &&
@@ -214,9 +269,9 @@ static void DoReminders(void)
 	    ShouldIgnoreLine())
 	{
 	    /*** IGNORE THE LINE ***/
-	    if (PurgeMode) {
-		if (strncmp(CurLine, "#!P", 3)) {
-		    PurgeEchoLine("%s\n", CurLine);
+	    if (Ctx->PurgeMode) {
+		if (strncmp(Ctx->CurLine, "#!P", 3)) {
+		    PurgeEchoLine("%s\n", Ctx->CurLine);
 		}
 	    }
 	}
@@ -228,7 +283,7 @@ static void DoReminders(void)
 
             case T_Empty:
 	    case T_Comment:
-		if (!strncmp(CurLine, "#!P", 3)) {
+		if (!strncmp(Ctx->CurLine, "#!P", 3)) {
 		    purge_handled = 1;
 		}
 		break;
@@ -243,8 +298,8 @@ static void DoReminders(void)
             case T_IncludeR:
 		/* In purge mode, include closes file, so we
 		   need to echo it here! */
-		if (PurgeMode) {
-		    PurgeEchoLine("%s\n", CurLine);
+		if (Ctx->PurgeMode) {
+		    PurgeEchoLine("%s\n", Ctx->CurLine);
 		}
 		r=DoInclude(&p, tok.type);
 		purge_handled = 1;
@@ -252,13 +307,13 @@ static void DoReminders(void)
 	    case T_IncludeCmd:
 		/* In purge mode, include closes file, so we
 		   need to echo it here! */
-		if (PurgeMode) {
-		    PurgeEchoLine("%s\n", CurLine);
+		if (Ctx->PurgeMode) {
+		    PurgeEchoLine("%s\n", Ctx->CurLine);
 		}
 		r=DoIncludeCmd(&p);
 		purge_handled = 1;
 		break;
-	    case T_Exit:    DoExit(&p);      break;
+	    case T_Exit:    r=DoExit(&p);    break;
 	    case T_Flush:   r=DoFlush(&p);   break;
 	    case T_Set:     r=DoSet(&p);     break;
 	    case T_Fset:    r=DoFset(&p);    break;
@@ -282,7 +337,7 @@ static void DoReminders(void)
 	    case T_RemType: if (tok.val == RUN_TYPE) {
 		    r=DoRun(&p);
 		} else {
-		    CreateParser(CurLine, &p);
+		    CreateParser(Ctx->CurLine, &p);
 		    r=DoRem(&p);
 		    purge_handled = 1;
 		}
@@ -293,19 +348,25 @@ static void DoReminders(void)
 	    /* Note:  Since the parser hasn't been used yet, we don't */
 	    /* need to destroy it here. */
 
-	    default: CreateParser(CurLine, &p); purge_handled = 1; r=DoRem(&p); break;
+	    default: CreateParser(Ctx->CurLine, &p); purge_handled = 1; r=DoRem(&p); break;
 
 	    }
-	    if (r && (!Hush || r != E_RUN_DISABLED)) {
+	    if (r == E_EXIT) {
+		/* Nothing more of the file is read */
+		DestroyParser(&p);
+		ClearIncludeStack();
+		return;
+	    }
+	    if (r && (!Ctx->Hush || r != E_RUN_DISABLED)) {
 		Eprint("%s", ErrMsg[r]);
 	    }
-	    if (PurgeMode) {
+	    if (Ctx->PurgeMode) {
 		if (!purge_handled) {
-		    PurgeEchoLine("%s\n", CurLine);
+		    PurgeEchoLine("%s\n", Ctx->CurLine);
 		} else {
 		    if (r) {
 			PurgeEchoLine("#!P! Could not parse next line: %s\n", ErrMsg[r]);
-			PurgeEchoLine("%s\n", CurLine);
+			PurgeEchoLine("%s\n", Ctx->CurLine);
 		    }
 		}
 	    }
@@ -314,6 +375,7 @@ static void DoReminders(void)
 	}
     }
 }
+#endif /* LIBREMIND */
 
 /***************************************************************/
 /*                                                             */
@@ -595,11 +657,11 @@ void Wprint(char const *fmt, ...)
     va_list argptr;
 
 
-    if (FileName) {
-	if (strcmp(FileName, "-"))
-	    (void) fprintf(ErrFp, "%s(%d): ", FileName, LineNo);
+    if (Ctx->FileName) {
+	if (strcmp(Ctx->FileName, "-"))
+	    (void) fprintf(ErrFp, "%s(%d): ", Ctx->FileName, Ctx->LineNo);
 	else
-	    (void) fprintf(ErrFp, "-stdin-(%d): ", LineNo);
+	    (void) fprintf(ErrFp, "-stdin-(%d): ", Ctx->LineNo);
     }
 
     va_start(argptr, fmt);
@@ -618,23 +680,23 @@ void Eprint(char const *fmt, ...)
     va_list argptr;
 
     /* Check if more than one error msg. from this line */
-    if (!FreshLine && !ShowAllErrors) return;
+    if (!Ctx->FreshLine && !Ctx->ShowAllErrors) return;
 
-    if (FreshLine && FileName) {
-	FreshLine = 0;
-	if (strcmp(FileName, "-")) {
-	    (void) fprintf(ErrFp, "%s(%d): ", FileName, LineNo);
+    if (Ctx->FreshLine && Ctx->FileName) {
+	Ctx->FreshLine = 0;
+	if (strcmp(Ctx->FileName, "-")) {
+	    (void) fprintf(ErrFp, "%s(%d): ", Ctx->FileName, Ctx->LineNo);
             if (print_callstack(ErrFp)) {
                 (void) fprintf(ErrFp, ": ");
             }
         } else {
-	    (void) fprintf(ErrFp, "-stdin-(%d): ", LineNo);
+	    (void) fprintf(ErrFp, "-stdin-(%d): ", Ctx->LineNo);
             if (print_callstack(ErrFp)) {
                 (void) fprintf(ErrFp, ": ");
             }
         }
-	if (DebugFlag & DB_PRTLINE) OutputLine(ErrFp);
-    } else if (FileName) {
+	if (Ctx->DebugFlag & DB_PRTLINE) OutputLine(ErrFp);
+    } else if (Ctx->FileName) {
 	fprintf(ErrFp, "       ");
         if (print_callstack(ErrFp)) {
             (void) fprintf(ErrFp, ": ");
@@ -658,7 +720,7 @@ void Eprint(char const *fmt, ...)
 /***************************************************************/
 void OutputLine(FILE *fp)
 {
-    char const *s = CurLine;
+    char const *s = Ctx->CurLine;
     char c = 0;
 
     while (*s) {
@@ -735,14 +797,16 @@ int PushToken(char const *tok, ParsePtr p)
 long SystemTime(int realtime)
 {
     time_t tloc;
-    struct tm *t;
+    struct tm t;
 
-    if (!realtime && (SysTime != -1L)) return SysTime;
+    if (!realtime && (Ctx->SysTime != -1L)) return Ctx->SysTime;
 
     (void) time(&tloc);
-    t = localtime(&tloc);
-    return (long) t->tm_hour * 3600L + (long) t->tm_min * 60L +
-	(long) t->tm_sec;
+    LockTz();
+    localtime_r(&tloc, &t);
+    UnlockTz();
+    return (long) t.tm_hour * 3600L + (long) t.tm_min * 60L +
+	(long) t.tm_sec;
 }
 
 /***************************************************************/
@@ -757,14 +821,16 @@ long SystemTime(int realtime)
 int SystemDate(int *y, int *m, int *d)
 {
     time_t tloc;
-    struct tm *t;
+    struct tm t;
 
     (void) time(&tloc);
-    t = localtime(&tloc);
+    LockTz();
+    localtime_r(&tloc, &t);
+    UnlockTz();
 
-    *d = t->tm_mday;
-    *m = t->tm_mon;
-    *y = t->tm_year + 1900;
+    *d = t.tm_mday;
+    *m = t.tm_mon;
+    *y = t.tm_year + 1900;
 
     return Julian(*y, *m, *d);
 }
@@ -781,7 +847,7 @@ int DoIf(ParsePtr p)
     int r;
     unsigned syndrome;
 
-    if ((size_t) NumIfs >= IF_NEST) return E_NESTED_IF;
+    if ((size_t) Ctx->NumIfs >= IF_NEST) return E_NESTED_IF;
 
     if (ShouldIgnoreLine()) syndrome = IF_TRUE | BEFORE_ELSE;
     else {
@@ -794,16 +860,16 @@ int DoIf(ParsePtr p)
 		syndrome = IF_TRUE | BEFORE_ELSE;
 	    } else {
 		syndrome = IF_FALSE | BEFORE_ELSE;
-		if (PurgeMode) {
+		if (Ctx->PurgeMode) {
 		    PurgeEchoLine("%s\n", "#!P: The next IF evaluated false...");
 		    PurgeEchoLine("%s\n", "#!P: REM statements in IF block not checked for purging.");
 		}
 	    }
     }
 
-    NumIfs++;
-    IfFlags &= ~(IF_MASK << (2*NumIfs - 2));
-    IfFlags |= syndrome << (2 * NumIfs - 2);
+    Ctx->NumIfs++;
+    Ctx->IfFlags &= ~(IF_MASK << (2*Ctx->NumIfs - 2));
+    Ctx->IfFlags |= syndrome << (2 * Ctx->NumIfs - 2);
     if (ShouldIgnoreLine()) return OK;
     return VerifyEoln(p);
 }
@@ -820,14 +886,14 @@ int DoElse(ParsePtr p)
 
     int was_ignoring = ShouldIgnoreLine();
 
-    if (!NumIfs) return E_ELSE_NO_IF;
+    if (!Ctx->NumIfs) return E_ELSE_NO_IF;
 
-    syndrome = IfFlags >> (2 * NumIfs - 2);
+    syndrome = Ctx->IfFlags >> (2 * Ctx->NumIfs - 2);
 
     if ((syndrome & IF_ELSE_MASK) == AFTER_ELSE) return E_ELSE_NO_IF;
 
-    IfFlags |= AFTER_ELSE << (2 * NumIfs - 2);
-    if (PurgeMode && ShouldIgnoreLine() && !was_ignoring) {
+    Ctx->IfFlags |= AFTER_ELSE << (2 * Ctx->NumIfs - 2);
+    if (Ctx->PurgeMode && ShouldIgnoreLine() && !was_ignoring) {
 	PurgeEchoLine("%s\n", "#!P: The previous IF evaluated true.");
 	PurgeEchoLine("%s\n", "#!P: REM statements in ELSE block not checked for purging");
     }
@@ -841,8 +907,8 @@ int DoElse(ParsePtr p)
 /***************************************************************/
 int DoEndif(ParsePtr p)
 {
-    if (!NumIfs) return E_ENDIF_NO_IF;
-    NumIfs--;
+    if (!Ctx->NumIfs) return E_ENDIF_NO_IF;
+    Ctx->NumIfs--;
     return VerifyEoln(p);
 }
 
@@ -862,7 +928,7 @@ int DoIfTrig(ParsePtr p)
     int jul;
 
 
-    if ((size_t) NumIfs >= IF_NEST) return E_NESTED_IF;
+    if ((size_t) Ctx->NumIfs >= IF_NEST) return E_NESTED_IF;
     if (ShouldIgnoreLine()) syndrome = IF_TRUE | BEFORE_ELSE;
     else {
 	if ( (r=ParseRem(p, &trig, &tim, 1)) ) return r;
@@ -870,7 +936,7 @@ int DoIfTrig(ParsePtr p)
 	jul = ComputeTrigger(trig.scanfrom, &trig, &tim, &r, 1);
 	if (r) {
             if (r != E_CANT_TRIG || !trig.maybe_uncomputable) {
-                if (!Hush || r != E_RUN_DISABLED) {
+                if (!Ctx->Hush || r != E_RUN_DISABLED) {
                     Eprint("%s", ErrMsg[r]);
                 }
             }
@@ -883,15 +949,15 @@ int DoIfTrig(ParsePtr p)
 		syndrome = IF_FALSE | BEFORE_ELSE;
 	    }
 	}
-        if (syndrome == (IF_FALSE | BEFORE_ELSE) && PurgeMode) {
+        if (syndrome == (IF_FALSE | BEFORE_ELSE) && Ctx->PurgeMode) {
             PurgeEchoLine("%s\n", "#!P: The next IFTRIG did not trigger.");
             PurgeEchoLine("%s\n", "#!P: REM statements in IFTRIG block not checked for purging.");
         }
 	FreeTrig(&trig);
     }
-    NumIfs++;
-    IfFlags &= ~(IF_MASK << (2*NumIfs - 2));
-    IfFlags |= syndrome << (2 * NumIfs - 2);
+    Ctx->NumIfs++;
+    Ctx->IfFlags &= ~(IF_MASK << (2*Ctx->NumIfs - 2));
+    Ctx->IfFlags |= syndrome << (2 * Ctx->NumIfs - 2);
     return OK;
 }
 
@@ -909,8 +975,8 @@ int ShouldIgnoreLine(void)
 /* Algorithm - go from outer to inner, and if any should be ignored, then
    ignore the whole. */
 
-    for (i=0; i<NumIfs; i++) {
-	syndrome = (IfFlags >> (i*2)) & IF_MASK;
+    for (i=0; i<Ctx->NumIfs; i++) {
+	syndrome = (Ctx->IfFlags >> (i*2)) & IF_MASK;
 	if (syndrome == IF_TRUE+AFTER_ELSE ||
 	    syndrome == IF_FALSE+BEFORE_ELSE) return 1;
     }
@@ -979,38 +1045,38 @@ int DoDebug(ParsePtr p)
 
 	case 'e':
 	case 'E':
-	    if (val) DebugFlag |=  DB_ECHO_LINE;
-	    else     DebugFlag &= ~DB_ECHO_LINE;
+	    if (val) Ctx->DebugFlag |=  DB_ECHO_LINE;
+	    else     Ctx->DebugFlag &= ~DB_ECHO_LINE;
 	    break;
 
 	case 'x':
 	case 'X':
-	    if (val) DebugFlag |=  DB_PRTEXPR;
-	    else     DebugFlag &= ~DB_PRTEXPR;
+	    if (val) Ctx->DebugFlag |=  DB_PRTEXPR;
+	    else     Ctx->DebugFlag &= ~DB_PRTEXPR;
 	    break;
 
 	case 't':
 	case 'T':
-	    if (val) DebugFlag |=  DB_PRTTRIG;
-	    else     DebugFlag &= ~DB_PRTTRIG;
+	    if (val) Ctx->DebugFlag |=  DB_PRTTRIG;
+	    else     Ctx->DebugFlag &= ~DB_PRTTRIG;
 	    break;
 
 	case 'v':
 	case 'V':
-	    if (val) DebugFlag |=  DB_DUMP_VARS;
-	    else     DebugFlag &= ~DB_DUMP_VARS;
+	    if (val) Ctx->DebugFlag |=  DB_DUMP_VARS;
+	    else     Ctx->DebugFlag &= ~DB_DUMP_VARS;
 	    break;
 
 	case 'l':
 	case 'L':
-	    if (val) DebugFlag |=  DB_PRTLINE;
-	    else     DebugFlag &= ~DB_PRTLINE;
+	    if (val) Ctx->DebugFlag |=  DB_PRTLINE;
+	    else     Ctx->DebugFlag &= ~DB_PRTLINE;
 	    break;
 
 	case 'f':
 	case 'F':
-	    if (val) DebugFlag |= DB_TRACE_FILES;
-	    else     DebugFlag &= ~DB_TRACE_FILES;
+	    if (val) Ctx->DebugFlag |= DB_TRACE_FILES;
+	    else     Ctx->DebugFlag &= ~DB_TRACE_FILES;
 	    break;
 	}
     }
@@ -1047,9 +1113,9 @@ int DoBanner(ParsePtr p)
 	    return err;
 	}
     }
-    DBufFree(&Banner);
+    DBufFree(&Ctx->Banner);
     
-    err = DBufPuts(&Banner, DBufValue(&buf));
+    err = DBufPuts(&Ctx->Banner, DBufValue(&buf));
     DBufFree(&buf);
     return err;
 }
@@ -1073,11 +1139,11 @@ int DoRun(ParsePtr p)
 
 /* Only allow RUN ON in top-level script */
     if (! StrCmpi(DBufValue(&buf), "ON")) {
-	if (TopLevel()) RunDisabled &= ~RUN_SCRIPT;
+	if (TopLevel()) Ctx->RunDisabled &= ~RUN_SCRIPT;
     }
 /* But allow RUN OFF anywhere */
     else if (! StrCmpi(DBufValue(&buf), "OFF"))
-	RunDisabled |= RUN_SCRIPT;
+	Ctx->RunDisabled |= RUN_SCRIPT;
     else {
 	DBufFree(&buf);
 	return E_PARSE_ERR;
@@ -1105,19 +1171,26 @@ int DoFlush(ParsePtr p)
 /*                                                             */
 /*  DoExit                                                     */
 /*                                                             */
-/*  Handle the EXIT command.                                   */
+/*  Handle the EXIT command.  If TrapExit is set, only the     */
+/*  file ends: the status is put in ExitStatus and E_EXIT is   */
+/*  returned for the caller to stop reading.                   */
 /*                                                             */
 /***************************************************************/
-void DoExit(ParsePtr p)
+int DoExit(ParsePtr p)
 {
-    int r;
+    int r, status;
     Value v;
 
-    if (PurgeMode) return;
+    if (Ctx->PurgeMode) return OK;
 
     r = EvaluateExpr(p, &v);
-    if (r || v.type != INT_TYPE) exit(99);
-    exit(v.v.val);
+    if (r || v.type != INT_TYPE) status = 99;
+    else status = v.v.val;
+    if (!r) DestroyValue(v);
+    if (!Ctx->TrapExit) exit(status);
+    Ctx->Exited = 1;
+    Ctx->ExitStatus = status;
+    return E_EXIT;
 }
 
 /***************************************************************/
@@ -1136,12 +1209,12 @@ int DoErrMsg(ParsePtr p)
 
     DynamicBuffer buf;
 
-    if (PurgeMode) return OK;
+    if (Ctx->PurgeMode) return OK;
 
     DBufInit(&buf);
     t.typ = MSG_TYPE;
     tt.ttime = SystemTime(0) / 60;
-    if ( (r=DoSubst(p, &buf, &t, &tt, JulianToday, NORMAL_MODE)) ) {
+    if ( (r=DoSubst(p, &buf, &t, &tt, Ctx->JulianToday, NORMAL_MODE)) ) {
 	return r;
     }
     s = DBufValue(&buf);
@@ -1177,7 +1250,7 @@ int CalcMinsFromUTC(int jul, int tim, int *mins, int *isdst)
 /* Convert jul and tim to an Unix tm struct */
     int yr, mon, day;
     int tdiff;
-    struct tm local, utc, *temp;
+    struct tm local, utc;
     time_t loc_t, utc_t;
     int isdst_tmp;
 
@@ -1186,7 +1259,7 @@ int CalcMinsFromUTC(int jul, int tim, int *mins, int *isdst)
 /* If the year is greater than 2037, some Unix machines have problems.
    Fold it back to a "similar" year and trust that the UTC calculations
    are still valid... */
-    if (FoldYear && yr>2037) {
+    if (Ctx->FoldYear && yr>2037) {
 	jul = Julian(yr, 0, 1);
 	yr = FoldArray[IsLeapYear(yr)][jul%7];
     }
@@ -1202,17 +1275,21 @@ int CalcMinsFromUTC(int jul, int tim, int *mins, int *isdst)
 
 
     /* Horrible contortions to get minutes from UTC portably */
+    LockTz();
+    utc_t = -1;
     loc_t = mktime(&local);
-    if (loc_t == -1) return 1;
     isdst_tmp = local.tm_isdst;
-    local.tm_isdst = 0;
-    loc_t = mktime(&local);
-    if (loc_t == -1) return 1;
-    temp = gmtime(&loc_t);
-    utc = *temp;
-    utc.tm_isdst = 0;
-    utc_t = mktime(&utc);
-    if (utc_t == -1) return 1;
+    if (loc_t != -1) {
+	local.tm_isdst = 0;
+	loc_t = mktime(&local);
+    }
+    if (loc_t != -1) {
+	gmtime_r(&loc_t, &utc);
+	utc.tm_isdst = 0;
+	utc_t = mktime(&utc);
+    }
+    UnlockTz();
+    if (loc_t == -1 || utc_t == -1) return 1;
     /* Compute difference between local time and UTC in seconds.
        Be careful, since time_t might be unsigned. */
 
@@ -1291,13 +1368,13 @@ FillParagraphWCAux(wchar_t const *s)
 	}
 	/* Over here, we're at the beginning of a line.  Emit the correct
 	   number of spaces */
-	j = line ? SubsIndent : FirstIndent;
+	j = line ? Ctx->SubsIndent : Ctx->FirstIndent;
 	for (i=0; i<j; i++) {
 	    putchar(' ');
 	}
 
 	/* Calculate the amount of room left on this line */
-	roomleft = FormWidth - j;
+	roomleft = Ctx->FormWidth - j;
 	pendspace = 0;
 
 	/* Emit words until the next one won't fit */
@@ -1329,8 +1406,8 @@ FillParagraphWCAux(wchar_t const *s)
 		}
 		while(t < s) {
                     PutWideChar(*t);
-		    if (strchr(EndSent, *t)) doublespace = 2;
-		    else if (!strchr(EndSentIg, *t)) doublespace = 1;
+		    if (strchr(Ctx->EndSent, *t)) doublespace = 2;
+		    else if (!strchr(Ctx->EndSentIg, *t)) doublespace = 1;
 		    t++;
 		}
 	    } else {
@@ -1415,13 +1492,13 @@ void FillParagraph(char const *s)
 	}
 	/* Over here, we're at the beginning of a line.  Emit the correct
 	   number of spaces */
-	j = line ? SubsIndent : FirstIndent;
+	j = line ? Ctx->SubsIndent : Ctx->FirstIndent;
 	for (i=0; i<j; i++) {
 	    putchar(' ');
 	}
 
 	/* Calculate the amount of room left on this line */
-	roomleft = FormWidth - j;
+	roomleft = Ctx->FormWidth - j;
 	pendspace = 0;
 
 	/* Emit words until the next one won't fit */
@@ -1453,8 +1530,8 @@ void FillParagraph(char const *s)
 		}
 		while(t < s) {
 		    putchar(*t);
-		    if (strchr(EndSent, *t)) doublespace = 2;
-		    else if (!strchr(EndSentIg, *t)) doublespace = 1;
+		    if (strchr(Ctx->EndSent, *t)) doublespace = 2;
+		    else if (!strchr(Ctx->EndSentIg, *t)) doublespace = 1;
 		    t++;
 		}
 	    } else {
@@ -1481,8 +1558,8 @@ void LocalToUTC(int locdate, int loctime, int *utcdate, int *utctime)
     int diff;
     int dummy;
 
-    if (!CalculateUTC || CalcMinsFromUTC(locdate, loctime, &diff, &dummy)) 
-	diff=MinsFromUTC;
+    if (!Ctx->CalculateUTC || CalcMinsFromUTC(locdate, loctime, &diff, &dummy)) 
+	diff=Ctx->MinsFromUTC;
 
     loctime -= diff;
     if (loctime < 0) {
@@ -1509,8 +1586,8 @@ void UTCToLocal(int utcdate, int utctime, int *locdate, int *loctime)
     int dummy;
 
     /* Hack -- not quite right when DST changes.  */
-    if (!CalculateUTC || CalcMinsFromUTC(utcdate, utctime, &diff, &dummy))
-	diff=MinsFromUTC;
+    if (!Ctx->CalculateUTC || CalcMinsFromUTC(utcdate, utctime, &diff, &dummy))
+	diff=Ctx->MinsFromUTC;
 
     utctime += diff;
     if (utctime < 0) {
@@ -1570,32 +1647,32 @@ FreeTrig(Trigger *t)
 void
 ClearLastTriggers(void)
 {
-    LastTrigger.expired = 0;
-    LastTrigger.wd = NO_WD;
-    LastTrigger.d = NO_DAY;
-    LastTrigger.m = NO_MON;
-    LastTrigger.y = NO_YR;
-    LastTrigger.back = NO_BACK;
-    LastTrigger.delta = NO_DELTA;
-    LastTrigger.rep  = NO_REP;
-    LastTrigger.localomit = NO_WD;
-    LastTrigger.skip = NO_SKIP;
-    LastTrigger.until = NO_UNTIL;
-    LastTrigger.typ = NO_TYPE;
-    LastTrigger.once = NO_ONCE;
-    LastTrigger.scanfrom = NO_DATE;
-    LastTrigger.from = NO_DATE;
-    LastTrigger.priority = DefaultPrio;
-    LastTrigger.sched[0] = 0;
-    LastTrigger.warn[0] = 0;
-    LastTrigger.omitfunc[0] = 0;
-    LastTrigger.passthru[0] = 0;
-    DBufFree(&(LastTrigger.tags));
-
-    LastTimeTrig.ttime = NO_TIME;
-    LastTimeTrig.delta = NO_DELTA;
-    LastTimeTrig.rep   = NO_REP;
-    LastTimeTrig.duration = NO_TIME;
+    Ctx->LastTrigger.expired = 0;
+    Ctx->LastTrigger.wd = NO_WD;
+    Ctx->LastTrigger.d = NO_DAY;
+    Ctx->LastTrigger.m = NO_MON;
+    Ctx->LastTrigger.y = NO_YR;
+    Ctx->LastTrigger.back = NO_BACK;
+    Ctx->LastTrigger.delta = NO_DELTA;
+    Ctx->LastTrigger.rep  = NO_REP;
+    Ctx->LastTrigger.localomit = NO_WD;
+    Ctx->LastTrigger.skip = NO_SKIP;
+    Ctx->LastTrigger.until = NO_UNTIL;
+    Ctx->LastTrigger.typ = NO_TYPE;
+    Ctx->LastTrigger.once = NO_ONCE;
+    Ctx->LastTrigger.scanfrom = NO_DATE;
+    Ctx->LastTrigger.from = NO_DATE;
+    Ctx->LastTrigger.priority = Ctx->DefaultPrio;
+    Ctx->LastTrigger.sched[0] = 0;
+    Ctx->LastTrigger.warn[0] = 0;
+    Ctx->LastTrigger.omitfunc[0] = 0;
+    Ctx->LastTrigger.passthru[0] = 0;
+    DBufFree(&(Ctx->LastTrigger.tags));
+
+    Ctx->LastTimeTrig.ttime = NO_TIME;
+    Ctx->LastTimeTrig.delta = NO_DELTA;
+    Ctx->LastTimeTrig.rep   = NO_REP;
+    Ctx->LastTimeTrig.duration = NO_TIME;
 }
 
 void
@@ -1603,24 +1680,24 @@ SaveAllTriggerInfo(Trigger const *t, TimeTrig const *tt, int trigdate, int trigt
 {
     SaveLastTrigger(t);
     SaveLastTimeTrig(tt);
-    LastTriggerDate = trigdate;
-    LastTriggerTime = trigtime;
-    LastTrigValid = valid;
+    Ctx->LastTriggerDate = trigdate;
+    Ctx->LastTriggerTime = trigtime;
+    Ctx->LastTrigValid = valid;
 }
 
 void
 SaveLastTrigger(Trigger const *t)
 {
-    DBufFree(&(LastTrigger.tags));
-    memcpy(&LastTrigger, t, sizeof(LastTrigger));
-    DBufInit(&(LastTrigger.tags));
-    DBufPuts(&(LastTrigger.tags), DBufValue(&(t->tags)));
+    DBufFree(&(Ctx->LastTrigger.tags));
+    memcpy(&Ctx->LastTrigger, t, sizeof(Ctx->LastTrigger));
+    DBufInit(&(Ctx->LastTrigger.tags));
+    DBufPuts(&(Ctx->LastTrigger.tags), DBufValue(&(t->tags)));
 }
 
 void
 SaveLastTimeTrig(TimeTrig const *t)
 {
-    memcpy(&LastTimeTrig, t, sizeof(LastTimeTrig));
+    memcpy(&Ctx->LastTimeTrig, t, sizeof(Ctx->LastTimeTrig));
 }
 
 /* Wrapper to ignore warnings about ignoring return value of system() */
@@ -1640,8 +1717,8 @@ get_day_name(int wkday)
     if (wkday < 0 || wkday > 6) {
         return "INVALID_WKDAY";
     }
-    if (DynamicDayName[wkday]) return DynamicDayName[wkday];
-    return DayName[wkday];
+    if (Ctx->DynamicDayName[wkday]) return Ctx->DynamicDayName[wkday];
+    return Ctx->Lang->DayName[wkday];
 }
 
 char const *
@@ -1650,6 +1727,6 @@ get_month_name(int mon)
     if (mon < 0 || mon > 11) {
         return "INVALID_MON";
     }
-    if (DynamicMonthName[mon]) return DynamicMonthName[mon];
-    return MonthName[mon];
+    if (Ctx->DynamicMonthName[mon]) return Ctx->DynamicMonthName[mon];
+    return Ctx->Lang->MonthName[mon];
 }
@@ -15,6 +15,7 @@
 #include <stdio.h>
 
 #include <stdlib.h>
+#include <string.h>
 #include "types.h"
 #include "protos.h"
 #include "globals.h"
@@ -24,15 +25,6 @@
 static int BexistsIntArray (int array[], int num, int key);
 static void InsertIntoSortedArray (int *array, int num, int key);
 
-/* Arrays for the global omits */
-static int FullOmitArray[MAX_FULL_OMITS];
-static int PartialOmitArray[MAX_PARTIAL_OMITS];
-
-/* WeekdayOmits is declared in global.h */
-
-/* How many of each omit types do we have? */
-static int NumFullOmits, NumPartialOmits;
-
 /* The structure for saving and restoring OMIT contexts */
 typedef struct omitcontext {
     struct omitcontext *next;
@@ -42,23 +34,119 @@ typedef struct omitcontext {
     int weekdaysave;
 } OmitContext;
 
-/* The stack of saved omit contexts */
-static OmitContext *SavedOmitContexts = NULL;
-
 /***************************************************************/
 /*                                                             */
 /*  ClearGlobalOmits                                           */
 /*                                                             */
-/*  Clear all the global OMIT context.                         */
+/*  Clear all the global OMIT context, going back to the base  */
+/*  OMITs if SetBaseOmits has been called.                     */
 /*                                                             */
 /***************************************************************/
 int ClearGlobalOmits(void)
 {
-    NumFullOmits = NumPartialOmits = 0;
-    WeekdayOmits = 0;
+    OmitContext *b = Ctx->BaseOmits;
+    int i;
+
+    if (!b) {
+	Ctx->NumFullOmits = Ctx->NumPartialOmits = 0;
+	Ctx->WeekdayOmits = 0;
+	return OK;
+    }
+    Ctx->NumFullOmits = b->numfull;
+    Ctx->NumPartialOmits = b->numpart;
+    Ctx->WeekdayOmits = b->weekdaysave;
+    for (i=0; i<b->numfull; i++)
+	Ctx->FullOmitArray[i] = b->fullsave[i];
+    for (i=0; i<b->numpart; i++)
+	Ctx->PartialOmitArray[i] = b->partsave[i];
+    return OK;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  SetBaseOmits                                               */
+/*                                                             */
+/*  Make the current global OMITs the ones ClearGlobalOmits    */
+/*  goes back to, so that they survive the clearing done       */
+/*  before each calendar day.                                  */
+/*                                                             */
+/***************************************************************/
+int SetBaseOmits(void)
+{
+    OmitContext *b;
+    int i;
+
+    DestroyBaseOmits();
+    b = NEW(OmitContext);
+    if (!b) return E_NO_MEM;
+    b->numfull = Ctx->NumFullOmits;
+    b->numpart = Ctx->NumPartialOmits;
+    b->weekdaysave = Ctx->WeekdayOmits;
+    b->fullsave = malloc((b->numfull ? b->numfull : 1) * sizeof(int));
+    b->partsave = malloc((b->numpart ? b->numpart : 1) * sizeof(int));
+    b->next = NULL;
+    if (!b->fullsave || !b->partsave) {
+	if (b->fullsave) free(b->fullsave);
+	if (b->partsave) free(b->partsave);
+	free(b);
+	return E_NO_MEM;
+    }
+    for (i=0; i<b->numfull; i++)
+	b->fullsave[i] = Ctx->FullOmitArray[i];
+    for (i=0; i<b->numpart; i++)
+	b->partsave[i] = Ctx->PartialOmitArray[i];
+    Ctx->BaseOmits = b;
+    return OK;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  CopyBaseOmits                                              */
+/*                                                             */
+/*  Give the current context the base OMITs of src, if any.    */
+/*                                                             */
+/***************************************************************/
+int CopyBaseOmits(struct RemContext const *src)
+{
+    OmitContext *b = src->BaseOmits;
+    OmitContext *c;
+
+    if (!b) return OK;
+    c = NEW(OmitContext);
+    if (!c) return E_NO_MEM;
+    *c = *b;
+    c->fullsave = malloc((b->numfull ? b->numfull : 1) * sizeof(int));
+    c->partsave = malloc((b->numpart ? b->numpart : 1) * sizeof(int));
+    if (!c->fullsave || !c->partsave) {
+	if (c->fullsave) free(c->fullsave);
+	if (c->partsave) free(c->partsave);
+	free(c);
+	return E_NO_MEM;
+    }
+    memcpy(c->fullsave, b->fullsave, b->numfull * sizeof(int));
+    memcpy(c->partsave, b->partsave, b->numpart * sizeof(int));
+    Ctx->BaseOmits = c;
     return OK;
 }
 
+/***************************************************************/
+/*                                                             */
+/*  DestroyBaseOmits                                           */
+/*                                                             */
+/*  Forget the base OMITs set by SetBaseOmits.                 */
+/*                                                             */
+/***************************************************************/
+void DestroyBaseOmits(void)
+{
+    OmitContext *b = Ctx->BaseOmits;
+
+    if (!b) return;
+    free(b->fullsave);
+    free(b->partsave);
+    free(b);
+    Ctx->BaseOmits = NULL;
+}
+
 /***************************************************************/
 /*                                                             */
 /*  DoClear                                                    */
@@ -83,7 +171,7 @@ int DoClear(ParsePtr p)
 /***************************************************************/
 int DestroyOmitContexts(void)
 {
-    OmitContext *c = SavedOmitContexts;
+    OmitContext *c = Ctx->SavedOmitContexts;
     OmitContext *d;
     int num = 0;
 
@@ -95,7 +183,7 @@ int DestroyOmitContexts(void)
 	free(c);
 	c = d;
     }
-    SavedOmitContexts = NULL;
+    Ctx->SavedOmitContexts = NULL;
     return num;
 }
 
@@ -115,31 +203,31 @@ int PushOmitContext(ParsePtr p)
     context = NEW(OmitContext);
     if (!context) return E_NO_MEM;
 
-    context->numfull = NumFullOmits;
-    context->numpart = NumPartialOmits;
-    context->weekdaysave = WeekdayOmits;
-    context->fullsave = malloc(NumFullOmits * sizeof(int));
-    if (NumFullOmits && !context->fullsave) {
+    context->numfull = Ctx->NumFullOmits;
+    context->numpart = Ctx->NumPartialOmits;
+    context->weekdaysave = Ctx->WeekdayOmits;
+    context->fullsave = malloc(Ctx->NumFullOmits * sizeof(int));
+    if (Ctx->NumFullOmits && !context->fullsave) {
 	free(context);
 	return E_NO_MEM;
     }
-    context->partsave = malloc(NumPartialOmits * sizeof(int));
-    if (NumPartialOmits && !context->partsave) {
+    context->partsave = malloc(Ctx->NumPartialOmits * sizeof(int));
+    if (Ctx->NumPartialOmits && !context->partsave) {
 	free(context->fullsave);
 	free(context);
 	return E_NO_MEM;
     }
 
 /* Copy the context over */
-    for (i=0; i<NumFullOmits; i++)
-	*(context->fullsave + i) = FullOmitArray[i];
+    for (i=0; i<Ctx->NumFullOmits; i++)
+	*(context->fullsave + i) = Ctx->FullOmitArray[i];
 
-    for (i=0; i<NumPartialOmits; i++)
-	*(context->partsave + i) = PartialOmitArray[i];
+    for (i=0; i<Ctx->NumPartialOmits; i++)
+	*(context->partsave + i) = Ctx->PartialOmitArray[i];
 
 /* Add the context to the stack */
-    context->next = SavedOmitContexts;
-    SavedOmitContexts = context;
+    context->next = Ctx->SavedOmitContexts;
+    Ctx->SavedOmitContexts = context;
     return VerifyEoln(p);
 }
 
@@ -154,22 +242,22 @@ int PopOmitContext(ParsePtr p)
 {
 
     register int i;
-    OmitContext *c = SavedOmitContexts;
+    OmitContext *c = Ctx->SavedOmitContexts;
 
     if (!c) return E_POP_NO_PUSH;
-    NumFullOmits = c->numfull;
-    NumPartialOmits = c->numpart;
-    WeekdayOmits = c->weekdaysave;
+    Ctx->NumFullOmits = c->numfull;
+    Ctx->NumPartialOmits = c->numpart;
+    Ctx->WeekdayOmits = c->weekdaysave;
 
 /* Copy the context over */
-    for (i=0; i<NumFullOmits; i++)
-	FullOmitArray[i] = *(c->fullsave + i);
+    for (i=0; i<Ctx->NumFullOmits; i++)
+	Ctx->FullOmitArray[i] = *(c->fullsave + i);
 
-    for (i=0; i<NumPartialOmits; i++)
-	PartialOmitArray[i] = *(c->partsave + i);
+    for (i=0; i<Ctx->NumPartialOmits; i++)
+	Ctx->PartialOmitArray[i] = *(c->partsave + i);
 
 /* Remove the context from the stack */
-    SavedOmitContexts = c->next;
+    Ctx->SavedOmitContexts = c->next;
 
 /* Free memory used by the saved context */
     if (c->partsave) free(c->partsave);
@@ -220,19 +308,19 @@ int IsOmitted(int jul, int localomit, char const *omitfunc, int *omit)
     }
 
     /* Is it omitted because of global weekday omits? */
-    if (WeekdayOmits & (1 << (jul % 7))) {
+    if (Ctx->WeekdayOmits & (1 << (jul % 7))) {
         *omit = 1;
         return OK;
     }
 
     /* Is it omitted because of fully-specified omits? */
-    if (BexistsIntArray(FullOmitArray, NumFullOmits, jul)) {
+    if (BexistsIntArray(Ctx->FullOmitArray, Ctx->NumFullOmits, jul)) {
 	*omit = 1;
 	return OK;
     }
 
     FromJulian(jul, &y, &m, &d);
-    if (BexistsIntArray(PartialOmitArray, NumPartialOmits, (m << 5) + d)) {
+    if (BexistsIntArray(Ctx->PartialOmitArray, Ctx->NumPartialOmits, (m << 5) + d)) {
 	*omit = 1;
 	return OK;
     }
@@ -387,10 +475,10 @@ int DoOmit(ParsePtr p)
         if (y[0] != NO_YR || m[0] != NO_MON || d[0] != NO_DAY) {
             return E_PARSE_ERR;
         }
-        if ((WeekdayOmits | wd) == 0x7F) {
+        if ((Ctx->WeekdayOmits | wd) == 0x7F) {
             return E_2MANY_LOCALOMIT;
         }
-        WeekdayOmits |= wd;
+        Ctx->WeekdayOmits |= wd;
         if (tok.type == T_Tag || tok.type == T_Duration || tok.type == T_RemType || tok.type == T_Priority) return E_PARSE_AS_REM;
         return OK;
     }
@@ -437,9 +525,9 @@ int DoOmit(ParsePtr p)
         mc = m[0];
         while(1) {
             syndrome = (mc<<5) + dc;
-            if (!BexistsIntArray(PartialOmitArray, NumPartialOmits, syndrome)) {
-                InsertIntoSortedArray(PartialOmitArray, NumPartialOmits, syndrome);
-                NumPartialOmits++;
+            if (!BexistsIntArray(Ctx->PartialOmitArray, Ctx->NumPartialOmits, syndrome)) {
+                InsertIntoSortedArray(Ctx->PartialOmitArray, Ctx->NumPartialOmits, syndrome);
+                Ctx->NumPartialOmits++;
             }
             if (mc == m[1] && dc == d[1]) {
                 break;
@@ -465,10 +553,10 @@ int DoOmit(ParsePtr p)
         }
 
         for (tmp = start; tmp <= end; tmp++) {
-            if (!BexistsIntArray(FullOmitArray, NumFullOmits, tmp)) {
-                if (NumFullOmits >= MAX_FULL_OMITS) return E_2MANY_FULL;
-                InsertIntoSortedArray(FullOmitArray, NumFullOmits, tmp);
-                NumFullOmits++;
+            if (!BexistsIntArray(Ctx->FullOmitArray, Ctx->NumFullOmits, tmp)) {
+                if (Ctx->NumFullOmits >= MAX_FULL_OMITS) return E_2MANY_FULL;
+                InsertIntoSortedArray(Ctx->FullOmitArray, Ctx->NumFullOmits, tmp);
+                Ctx->NumFullOmits++;
             }
         }
     }
@@ -481,11 +569,52 @@ int DoOmit(ParsePtr p)
 int
 AddGlobalOmit(int jul)
 {
-    if (NumFullOmits == MAX_FULL_OMITS) return E_2MANY_FULL;
-    if (!BexistsIntArray(FullOmitArray, NumFullOmits, jul)) {
-        InsertIntoSortedArray(FullOmitArray, NumFullOmits, jul);
-        NumFullOmits++;
+    if (Ctx->NumFullOmits == MAX_FULL_OMITS) return E_2MANY_FULL;
+    if (!BexistsIntArray(Ctx->FullOmitArray, Ctx->NumFullOmits, jul)) {
+        InsertIntoSortedArray(Ctx->FullOmitArray, Ctx->NumFullOmits, jul);
+        Ctx->NumFullOmits++;
+    }
+    return OK;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  MergeOmits                                                 */
+/*                                                             */
+/*  Add sorted arrays of full and partial OMITs, and a mask of */
+/*  weekday OMITs, to the global OMITs, as when a compiled     */
+/*  table is INCLUDEd.                                         */
+/*                                                             */
+/***************************************************************/
+int MergeOmits(int const *full, int nfull, int const *partial, int npartial,
+	       int weekdays)
+{
+    int i;
+
+    /* With no full OMITs yet, the sorted array can be copied */
+    if (!Ctx->NumFullOmits) {
+	if (nfull > MAX_FULL_OMITS) return E_2MANY_FULL;
+	memcpy(Ctx->FullOmitArray, full, nfull * sizeof(int));
+	Ctx->NumFullOmits = nfull;
+    } else {
+	for (i=0; i<nfull; i++) {
+	    if (BexistsIntArray(Ctx->FullOmitArray, Ctx->NumFullOmits, full[i])) {
+		continue;
+	    }
+	    if (Ctx->NumFullOmits >= MAX_FULL_OMITS) return E_2MANY_FULL;
+	    InsertIntoSortedArray(Ctx->FullOmitArray, Ctx->NumFullOmits, full[i]);
+	    Ctx->NumFullOmits++;
+	}
+    }
+    for (i=0; i<npartial; i++) {
+	if (BexistsIntArray(Ctx->PartialOmitArray, Ctx->NumPartialOmits, partial[i])) {
+	    continue;
+	}
+	if (Ctx->NumPartialOmits >= MAX_PARTIAL_OMITS) return E_2MANY_PART;
+	InsertIntoSortedArray(Ctx->PartialOmitArray, Ctx->NumPartialOmits, partial[i]);
+	Ctx->NumPartialOmits++;
     }
+    Ctx->WeekdayOmits |= weekdays;
     return OK;
 }
 
@@ -494,32 +623,32 @@ DumpOmits(void)
 {
     int i;
     int y, m, d;
-    printf("Global Full OMITs (%d of maximum allowed %d):\n", NumFullOmits, MAX_FULL_OMITS);
-    if (!NumFullOmits) {
+    printf("Global Full OMITs (%d of maximum allowed %d):\n", Ctx->NumFullOmits, MAX_FULL_OMITS);
+    if (!Ctx->NumFullOmits) {
 	printf("\tNone.\n");
     } else {
-	for (i=0; i<NumFullOmits; i++) {
-	    FromJulian(FullOmitArray[i], &y, &m, &d);
+	for (i=0; i<Ctx->NumFullOmits; i++) {
+	    FromJulian(Ctx->FullOmitArray[i], &y, &m, &d);
 	    printf("\t%04d%c%02d%c%02d\n",
-		    y, DateSep, m+1, DateSep, d);
+		    y, Ctx->DateSep, m+1, Ctx->DateSep, d);
 	}
     }
-    printf("Global Partial OMITs (%d of maximum allowed %d):\n", NumPartialOmits, MAX_PARTIAL_OMITS);
-    if (!NumPartialOmits) {
+    printf("Global Partial OMITs (%d of maximum allowed %d):\n", Ctx->NumPartialOmits, MAX_PARTIAL_OMITS);
+    if (!Ctx->NumPartialOmits) {
 	printf("\tNone.\n");
     } else {
-	for (i=0; i<NumPartialOmits; i++) {
-	    m = PartialOmitArray[i] >> 5 & 0xf;
-	    d = PartialOmitArray[i] & 0x1f;
-	    printf("\t%02d%c%02d\n", m+1, DateSep, d);
+	for (i=0; i<Ctx->NumPartialOmits; i++) {
+	    m = Ctx->PartialOmitArray[i] >> 5 & 0xf;
+	    d = Ctx->PartialOmitArray[i] & 0x1f;
+	    printf("\t%02d%c%02d\n", m+1, Ctx->DateSep, d);
 	}
     }
     printf("Global Weekday OMITs:\n");
-    if (WeekdayOmits == 0) {
+    if (Ctx->WeekdayOmits == 0) {
         printf("\tNone.\n");
     } else {
         for (i=0; i<7; i++) {
-            if (WeekdayOmits & (1<<i)) {
+            if (Ctx->WeekdayOmits & (1<<i)) {
                 printf("\t%s\n", EnglishDayName[i]);
             }
         }
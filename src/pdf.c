@@ -0,0 +1,554 @@
+/***************************************************************/
+/*                                                             */
+/*  PDF.C                                                      */
+/*                                                             */
+/*  A minimal PDF writer for rem2ps -P.  Pages are written as  */
+/*  soon as they are finished, so a document of thousands of   */
+/*  pages never has more than one of them in memory.  Text     */
+/*  uses the standard PDF fonts, which every viewer has, in    */
+/*  the WinAnsi encoding; their widths are built in so the     */
+/*  calendar can be laid out without reading font files.       */
+/*                                                             */
+/*  This file is part of REMIND.                               */
+/*  Copyright (C) 1992-2022 by Dianne Skoll                    */
+/*                                                             */
+/***************************************************************/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+#if defined(HAVE_LIBZ) && defined(HAVE_ZLIB_H)
+#include <zlib.h>
+#endif
+
+#include "pdf.h"
+
+/* Widths of characters 32 to 126, in thousandths of the font size */
+static short const HelveticaWidths[95] = {
+    278, 278, 355, 556, 556, 889, 667, 191, 333, 333, 389, 584, 278, 333, 278, 278,
+    556, 556, 556, 556, 556, 556, 556, 556, 556, 556, 278, 278, 584, 584, 584, 556,
+    1015, 667, 667, 722, 722, 667, 611, 778, 722, 278, 500, 667, 556, 833, 722, 778,
+    667, 778, 722, 667, 611, 722, 667, 944, 667, 667, 611, 278, 278, 278, 469, 556,
+    333, 556, 556, 500, 556, 556, 278, 556, 556, 222, 222, 500, 222, 833, 556, 556,
+    556, 556, 333, 500, 278, 556, 500, 722, 500, 500, 500, 334, 260, 334, 584
+};
+
+static short const HelveticaBoldWidths[95] = {
+    278, 333, 474, 556, 556, 889, 722, 238, 333, 333, 389, 584, 278, 333, 278, 278,
+    556, 556, 556, 556, 556, 556, 556, 556, 556, 556, 333, 333, 584, 584, 584, 611,
+    975, 722, 722, 722, 722, 667, 611, 778, 722, 278, 556, 722, 611, 833, 722, 778,
+    667, 778, 722, 667, 611, 722, 667, 944, 667, 667, 611, 333, 278, 333, 584, 556,
+    333, 556, 611, 556, 611, 556, 333, 611, 611, 278, 278, 556, 278, 889, 611, 611,
+    611, 611, 389, 556, 333, 611, 556, 778, 556, 556, 500, 389, 280, 389, 584
+};
+
+static short const TimesRomanWidths[95] = {
+    250, 333, 408, 500, 500, 833, 778, 180, 333, 333, 500, 564, 250, 333, 250, 278,
+    500, 500, 500, 500, 500, 500, 500, 500, 500, 500, 278, 278, 564, 564, 564, 444,
+    921, 722, 667, 667, 722, 611, 556, 722, 722, 333, 389, 722, 611, 889, 722, 722,
+    556, 722, 667, 556, 611, 722, 722, 944, 722, 722, 611, 333, 278, 333, 469, 500,
+    333, 444, 500, 444, 500, 444, 333, 500, 500, 278, 278, 500, 278, 778, 500, 500,
+    500, 500, 333, 389, 278, 500, 500, 722, 500, 500, 444, 480, 200, 480, 541
+};
+
+static short const TimesBoldWidths[95] = {
+    250, 333, 555, 500, 500, 1000, 833, 278, 333, 333, 500, 570, 250, 333, 250, 278,
+    500, 500, 500, 500, 500, 500, 500, 500, 500, 500, 333, 333, 570, 570, 570, 500,
+    930, 722, 667, 722, 722, 667, 611, 778, 778, 389, 500, 778, 667, 944, 722, 778,
+    611, 778, 722, 556, 667, 722, 722, 1000, 722, 722, 667, 333, 278, 333, 581, 500,
+    333, 500, 556, 444, 556, 444, 333, 500, 556, 278, 333, 556, 278, 833, 556, 500,
+    556, 556, 444, 389, 333, 556, 500, 722, 500, 500, 444, 394, 220, 394, 520
+};
+
+/* Characters 128 to 255 are measured as the ASCII character of
+   about the same width:  accented letters as their base letters */
+static char const WidthAlias[] =
+    "0 ,0\"W00-WS-W Z "
+    " ,,\"\"*0W-Ws-W zY"
+    " !0000|0-O*0+-O-"
+    "*+---u0.--*0%%%?"
+    "AAAAAAWCEEEEIIII"
+    "DNOOOOO+OUUUUYPb"
+    "aaaaaamceeeeiiii"
+    "onooooo+ouuuuypy";
+
+/* Unicode characters with a place in WinAnsi between 128 and 159 */
+static unsigned short const WinAnsiHigh[32] = {
+    0x20AC, 0, 0x201A, 0x0192, 0x201E, 0x2026, 0x2020, 0x2021,
+    0x02C6, 0x2030, 0x0160, 0x2039, 0x0152, 0, 0x017D, 0,
+    0, 0x2018, 0x2019, 0x201C, 0x201D, 0x2022, 0x2013, 0x2014,
+    0x02DC, 0x2122, 0x0161, 0x203A, 0x0153, 0, 0x017E, 0x0178
+};
+
+typedef struct {
+    char const *name;
+    short const *widths;  /* NULL for a fixed-pitch font */
+} PdfFontInfo;
+
+#define MAX_FONTS 8
+static PdfFontInfo Fonts[MAX_FONTS];
+static int NumFonts = 0;
+
+/* The document being written */
+static FILE *Out;
+static long Offset;
+static long *ObjOffsets;
+static int NumObjs, ObjSize;
+static int *PageObjs;
+static int NumPages, PageSize;
+static double PageWidth, PageHeight;
+
+/* The content of the page being drawn */
+static char *Content;
+static size_t ContentLen, ContentSize;
+
+/* Objects with fixed numbers; each font follows the resources */
+#define OBJ_CATALOG   1
+#define OBJ_PAGES     2
+#define OBJ_RESOURCES 3
+#define OBJ_INFO      4
+#define OBJ_FONT0     5
+
+static void *
+Grow(void *p, size_t n)
+{
+    p = realloc(p, n);
+    if (!p) {
+	fprintf(stderr, "malloc failed - aborting.\n");
+	exit(1);
+    }
+    return p;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  PdfFont - register a font by name and return its number.   */
+/*  A font that isn't one of the standard ones is measured as  */
+/*  Helvetica and left to the viewer to find.                  */
+/*                                                             */
+/***************************************************************/
+int PdfFont(char const *name)
+{
+    int i;
+    short const *widths;
+
+    for (i=0; i<NumFonts; i++) {
+	if (!strcmp(Fonts[i].name, name)) return i;
+    }
+    if (NumFonts == MAX_FONTS) {
+	fprintf(stderr, "Rem2PS: Too many fonts\n");
+	exit(1);
+    }
+    if (!strncmp(name, "Courier", 7)) {
+	widths = NULL;
+    } else if (!strncmp(name, "Times-Bold", 10)) {
+	widths = TimesBoldWidths;
+    } else if (!strncmp(name, "Times", 5)) {
+	widths = TimesRomanWidths;
+    } else if (!strncmp(name, "Helvetica-Bold", 14)) {
+	widths = HelveticaBoldWidths;
+    } else {
+	widths = HelveticaWidths;
+    }
+    Fonts[NumFonts].name = name;
+    Fonts[NumFonts].widths = widths;
+    return NumFonts++;
+}
+
+int PdfFixedPitch(int font)
+{
+    return Fonts[font].widths == NULL;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  PdfStringWidth - the width of len WinAnsi characters in a  */
+/*  font of the given size.                                    */
+/*                                                             */
+/***************************************************************/
+double PdfStringWidth(int font, char const *s, size_t len, double size)
+{
+    short const *widths = Fonts[font].widths;
+    long w = 0;
+    int c;
+
+    if (!widths) return len * 0.6 * size;
+    while (len--) {
+	c = (unsigned char) *s++;
+	if (c >= 128) c = WidthAlias[c-128];
+	if (c < 32 || c > 126) c = ' ';
+	w += widths[c-32];
+    }
+    return w * size / 1000.0;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  PdfDescent - roughly how far below the baseline a string   */
+/*  reaches, as a fraction of the font size.                   */
+/*                                                             */
+/***************************************************************/
+double PdfDescent(char const *s)
+{
+    if (strpbrk(s, "gjpqy")) return 0.22;
+    if (strpbrk(s, ",;")) return 0.15;
+    return 0.0;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  PdfEncode - convert a UTF-8 string to WinAnsi in a newly   */
+/*  allocated string.  Characters WinAnsi lacks become `?';    */
+/*  bytes that aren't UTF-8 are taken to be ISO 8859-1.        */
+/*                                                             */
+/***************************************************************/
+char *PdfEncode(char const *s)
+{
+    unsigned char const *in = (unsigned char const *) s;
+    char *out = Grow(NULL, strlen(s)+1);
+    char *t = out;
+    unsigned long u;
+    int n, i;
+
+    while (*in) {
+	if (*in < 0x80) {
+	    *t++ = *in++;
+	    continue;
+	}
+	if ((*in & 0xE0) == 0xC0) {
+	    u = *in & 0x1F; n = 1;
+	} else if ((*in & 0xF0) == 0xE0) {
+	    u = *in & 0x0F; n = 2;
+	} else if ((*in & 0xF8) == 0xF0) {
+	    u = *in & 0x07; n = 3;
+	} else {
+	    *t++ = *in++;
+	    continue;
+	}
+	for (i=1; i<=n; i++) {
+	    if ((in[i] & 0xC0) != 0x80) break;
+	    u = (u << 6) | (in[i] & 0x3F);
+	}
+	if (i <= n) {
+	    *t++ = *in++;
+	    continue;
+	}
+	in += n+1;
+	if (u >= 0xA0 && u <= 0xFF) {
+	    *t++ = (char) u;
+	    continue;
+	}
+	for (i=0; i<32; i++) {
+	    if (WinAnsiHigh[i] && WinAnsiHigh[i] == u) break;
+	}
+	*t++ = (i < 32) ? (char) (0x80 + i) : '?';
+    }
+    *t = 0;
+    return out;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  Writing the document                                       */
+/*                                                             */
+/***************************************************************/
+static void
+Put(char const *fmt, ...)
+{
+    va_list ap;
+    int n;
+
+    va_start(ap, fmt);
+    n = vfprintf(Out, fmt, ap);
+    va_end(ap);
+    if (n > 0) Offset += n;
+}
+
+static void
+PutData(char const *data, size_t len)
+{
+    fwrite(data, 1, len, Out);
+    Offset += len;
+}
+
+static void
+StartObj(int n)
+{
+    if (n >= ObjSize) {
+	ObjSize = n + 256;
+	ObjOffsets = Grow(ObjOffsets, ObjSize * sizeof(long));
+    }
+    if (n >= NumObjs) NumObjs = n + 1;
+    ObjOffsets[n] = Offset;
+    Put("%d 0 obj\n", n);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  PdfBegin - start a document on out.  The fonts must all    */
+/*  have been registered.                                      */
+/*                                                             */
+/***************************************************************/
+void PdfBegin(FILE *out)
+{
+    int i;
+
+    Out = out;
+    Offset = 0;
+    NumObjs = OBJ_FONT0 + NumFonts;
+    NumPages = 0;
+
+    /* The binary comment tells transfer programs the file isn't text */
+    Put("%%PDF-1.4\n%%\342\343\317\323\n");
+
+    StartObj(OBJ_RESOURCES);
+    Put("<< /Font <<");
+    for (i=0; i<NumFonts; i++) {
+	Put(" /F%d %d 0 R", i, OBJ_FONT0 + i);
+    }
+    Put(" >> >>\nendobj\n");
+
+    for (i=0; i<NumFonts; i++) {
+	StartObj(OBJ_FONT0 + i);
+	Put("<< /Type /Font /Subtype /Type1 /BaseFont /%s", Fonts[i].name);
+	if (strcmp(Fonts[i].name, "Symbol") &&
+	    strcmp(Fonts[i].name, "ZapfDingbats")) {
+	    Put(" /Encoding /WinAnsiEncoding");
+	}
+	Put(" >>\nendobj\n");
+    }
+}
+
+/***************************************************************/
+/*                                                             */
+/*  Drawing on a page                                          */
+/*                                                             */
+/***************************************************************/
+static void
+Append(char const *s, size_t len)
+{
+    if (ContentLen + len + 1 > ContentSize) {
+	ContentSize = (ContentLen + len + 1) * 2;
+	Content = Grow(Content, ContentSize);
+    }
+    memcpy(Content + ContentLen, s, len);
+    ContentLen += len;
+}
+
+/* Numbers are written with two decimals at most, and no
+   trailing zeros */
+static char *
+FormatNum(char *buf, double v)
+{
+    int n = sprintf(buf, "%.2f", v);
+
+    while (buf[n-1] == '0') n--;
+    if (buf[n-1] == '.') n--;
+    buf[n] = 0;
+    if (!strcmp(buf, "-0")) strcpy(buf, "0");
+    return buf;
+}
+
+static void
+AppendNum(double v)
+{
+    char buf[64];
+
+    FormatNum(buf, v);
+    strcat(buf, " ");
+    Append(buf, strlen(buf));
+}
+
+void PdfStartPage(double width, double height)
+{
+    PageWidth = width;
+    PageHeight = height;
+    ContentLen = 0;
+}
+
+void PdfPrintf(char const *fmt, ...)
+{
+    char buf[256];
+    va_list ap;
+    int n;
+
+    va_start(ap, fmt);
+    n = vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    if (n < 0) return;
+    if ((size_t) n >= sizeof(buf)) n = sizeof(buf) - 1;
+    Append(buf, n);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  PdfText - draw len WinAnsi characters with their baseline  */
+/*  starting at (x, y).                                        */
+/*                                                             */
+/***************************************************************/
+void PdfText(int font, double size, double x, double y,
+	     char const *s, size_t len)
+{
+    char buf[8];
+    int c;
+
+    PdfPrintf("BT /F%d ", font);
+    AppendNum(size);
+    Append("Tf ", 3);
+    AppendNum(x);
+    AppendNum(y);
+    Append("Td (", 4);
+    while (len--) {
+	c = (unsigned char) *s++;
+	if (c == '(' || c == ')' || c == '\\') {
+	    buf[0] = '\\';
+	    buf[1] = c;
+	    Append(buf, 2);
+	} else if (c < 32) {
+	    Append(buf, sprintf(buf, "\\%03o", c));
+	} else {
+	    buf[0] = c;
+	    Append(buf, 1);
+	}
+    }
+    Append(") Tj ET\n", 8);
+}
+
+void PdfLine(double x1, double y1, double x2, double y2)
+{
+    AppendNum(x1);
+    AppendNum(y1);
+    Append("m ", 2);
+    AppendNum(x2);
+    AppendNum(y2);
+    Append("l S\n", 4);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  PdfEndPage - write out the page just drawn, compressing    */
+/*  its content if zlib is available.                          */
+/*                                                             */
+/***************************************************************/
+void PdfEndPage(void)
+{
+    int content = NumObjs;
+    int page = NumObjs + 1;
+    char w[64], h[64];
+    char const *data = Content;
+    size_t len = ContentLen;
+    char const *filter = "";
+
+#if defined(HAVE_LIBZ) && defined(HAVE_ZLIB_H)
+    static unsigned char *Packed = NULL;
+    static uLongf PackedSize = 0;
+    uLongf packed;
+
+    if (compressBound(ContentLen) > PackedSize) {
+	PackedSize = compressBound(ContentLen);
+	Packed = Grow(Packed, PackedSize);
+    }
+    packed = PackedSize;
+    if (compress2(Packed, &packed, (Bytef const *) Content, ContentLen,
+		  Z_DEFAULT_COMPRESSION) == Z_OK) {
+	data = (char const *) Packed;
+	len = packed;
+	filter = " /Filter /FlateDecode";
+    }
+#endif
+
+    StartObj(content);
+    Put("<< /Length %lu%s >>\nstream\n", (unsigned long) len, filter);
+    PutData(data, len);
+    Put("\nendstream\nendobj\n");
+
+    StartObj(page);
+    Put("<< /Type /Page /Parent %d 0 R /MediaBox [0 0 %s %s]"
+	" /Resources %d 0 R /Contents %d 0 R >>\nendobj\n",
+	OBJ_PAGES, FormatNum(w, PageWidth), FormatNum(h, PageHeight),
+	OBJ_RESOURCES, content);
+    ContentLen = 0;
+
+    if (NumPages == PageSize) {
+	PageSize = PageSize ? PageSize * 2 : 64;
+	PageObjs = Grow(PageObjs, PageSize * sizeof(int));
+    }
+    PageObjs[NumPages++] = page;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  PdfEnd - write the page tree, the cross-reference table    */
+/*  and the trailer.  Returns 0, or -1 if there was a write    */
+/*  error.                                                     */
+/*                                                             */
+/***************************************************************/
+int PdfEnd(void)
+{
+    long xref;
+    int i;
+
+    StartObj(OBJ_PAGES);
+    Put("<< /Type /Pages /Count %d /Kids [", NumPages);
+    for (i=0; i<NumPages; i++) {
+	Put("%s%d 0 R", (i % 10) ? " " : "\n", PageObjs[i]);
+    }
+    Put("\n] >>\nendobj\n");
+
+    StartObj(OBJ_CATALOG);
+    Put("<< /Type /Catalog /Pages %d 0 R >>\nendobj\n", OBJ_PAGES);
+
+    StartObj(OBJ_INFO);
+    Put("<< /Producer (Rem2PS) /Creator (Remind) >>\nendobj\n");
+
+    xref = Offset;
+    Put("xref\n0 %d\n0000000000 65535 f \n", NumObjs);
+    for (i=1; i<NumObjs; i++) {
+	Put("%010ld 00000 n \n", ObjOffsets[i]);
+    }
+    Put("trailer\n<< /Size %d /Root %d 0 R /Info %d 0 R >>\n",
+	NumObjs, OBJ_CATALOG, OBJ_INFO);
+    Put("startxref\n%ld\n%%%%EOF\n", xref);
+
+    fflush(Out);
+    return ferror(Out) ? -1 : 0;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  PdfCircle - add a circle of radius r centred on (x, y) to  */
+/*  the path:  all of it if half is 0, the left half if it is  */
+/*  1 and the right half if it is 2.  The path is closed but   */
+/*  not painted.                                               */
+/*                                                             */
+/***************************************************************/
+void PdfCircle(double x, double y, double r, int half)
+{
+    /* Control points of the Bezier curve closest to a quarter circle */
+    double k = 0.5523 * r;
+
+    switch(half) {
+    case 1:
+	PdfPrintf("%.2f %.2f m\n", x, y+r);
+	PdfPrintf("%.2f %.2f %.2f %.2f %.2f %.2f c\n", x-k, y+r, x-r, y+k, x-r, y);
+	PdfPrintf("%.2f %.2f %.2f %.2f %.2f %.2f c\n", x-r, y-k, x-k, y-r, x, y-r);
+	break;
+    case 2:
+	PdfPrintf("%.2f %.2f m\n", x, y-r);
+	PdfPrintf("%.2f %.2f %.2f %.2f %.2f %.2f c\n", x+k, y-r, x+r, y-k, x+r, y);
+	PdfPrintf("%.2f %.2f %.2f %.2f %.2f %.2f c\n", x+r, y+k, x+k, y+r, x, y+r);
+	break;
+    default:
+	PdfPrintf("%.2f %.2f m\n", x+r, y);
+	PdfPrintf("%.2f %.2f %.2f %.2f %.2f %.2f c\n", x+r, y+k, x+k, y+r, x, y+r);
+	PdfPrintf("%.2f %.2f %.2f %.2f %.2f %.2f c\n", x-k, y+r, x-r, y+k, x-r, y);
+	PdfPrintf("%.2f %.2f %.2f %.2f %.2f %.2f c\n", x-r, y-k, x-k, y-r, x, y-r);
+	PdfPrintf("%.2f %.2f %.2f %.2f %.2f %.2f c\n", x+k, y-r, x+r, y-k, x+r, y);
+	break;
+    }
+    PdfPrintf("h\n");
+}
@@ -0,0 +1,38 @@
+/***************************************************************/
+/*                                                             */
+/*  PDF.H                                                      */
+/*                                                             */
+/*  Declaration of functions for writing a PDF document one    */
+/*  page at a time, used by rem2ps -P.                         */
+/*                                                             */
+/*  This file is part of REMIND.                               */
+/*  Copyright (C) 1992-2022 by Dianne Skoll                    */
+/*                                                             */
+/***************************************************************/
+
+#ifndef PDF_H
+#define PDF_H
+
+#include <stdio.h>
+
+int PdfFont(char const *name);
+int PdfFixedPitch(int font);
+double PdfStringWidth(int font, char const *s, size_t len, double size);
+double PdfDescent(char const *s);
+char *PdfEncode(char const *s);
+
+void PdfBegin(FILE *out);
+void PdfStartPage(double width, double height);
+void PdfPrintf(char const *fmt, ...)
+#ifdef __GNUC__
+    __attribute__ ((format (printf, 1, 2)))
+#endif
+    ;
+void PdfText(int font, double size, double x, double y,
+	     char const *s, size_t len);
+void PdfLine(double x1, double y1, double x2, double y2);
+void PdfCircle(double x, double y, double r, int half);
+void PdfEndPage(void);
+int PdfEnd(void);
+
+#endif /* PDF_H */
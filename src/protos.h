@@ -24,20 +24,33 @@
 #include "dynbuf.h"
 #include <ctype.h>
 
+/* An interpreter context; see context.h */
+struct RemContext;
+#include <sys/select.h>  /* For fd_set */
+
 int CallUserFunc (char const *name, int nargs, ParsePtr p);
 int DoFset (ParsePtr p);
 int DoFunset (ParsePtr p);
 void ProduceCalendar (void);
+void ProduceJSONCalendar (int y, int m, int n);
+struct rem_occurrence;
+int CalendarOccurrences (int jul, int (*fn)(struct rem_occurrence const *occ, void *data), void *data);
+int RunCalendarFile (int jul);
+void ProduceEventStream (void);
+void ProduceICalendar (void);
 char const *SimpleTime (int tim);
 char const *CalendarTime (int tim, int duration);
 int DoRem (ParsePtr p);
 int DoFlush (ParsePtr p);
-void DoExit (ParsePtr p);
+int DoExit (ParsePtr p);
 int ParseRem (ParsePtr s, Trigger *trig, TimeTrig *tim, int save_in_globals);
 int TriggerReminder (ParsePtr p, Trigger *t, TimeTrig *tim, int jul);
 int ShouldTriggerReminder (Trigger *t, TimeTrig *tim, int jul, int *err);
 int DoSubst (ParsePtr p, DynamicBuffer *dbuf, Trigger *t, TimeTrig *tt, int jul, int mode);
 int DoSubstFromString (char const *source, DynamicBuffer *dbuf, int jul, int tim);
+LangTable const *DefaultLanguage (void);
+LangTable const *FindLanguage (char const *name);
+int SetLanguage (LangTable const *lang);
 int ParseLiteralDate (char const **s, int *jul, int *tim);
 int ParseLiteralTime (char const **s, int *tim);
 int EvalExpr (char const **e, Value *v, ParsePtr p);
@@ -49,10 +62,16 @@ int OpenFile (char const *fname);
 int DoInclude (ParsePtr p, enum TokTypes tok);
 int DoIncludeCmd (ParsePtr p);
 int IncludeFile (char const *fname);
+void ClearFileCache (void);
+int FileCacheStale (void);
+void UncacheFile (char const *fname);
+void ClearIncludeStack (void);
 int GetAccessDate (char const *file);
 int SetAccessDate (char const *fname, int jul);
 int TopLevel (void);
 int CallFunc (BuiltinFunc *f, int nargs);
+void LockTz (void);
+void UnlockTz (void);
 void InitRemind (int argc, char const *argv[]);
 void Usage (void);
 int Julian (int year, int month, int day);
@@ -84,6 +103,9 @@ int DoErrMsg (ParsePtr p);
 int ClearGlobalOmits (void);
 int DoClear (ParsePtr p);
 int DestroyOmitContexts (void);
+int SetBaseOmits (void);
+void DestroyBaseOmits (void);
+int CopyBaseOmits (struct RemContext const *src);
 int PushOmitContext (ParsePtr p);
 int PopOmitContext (ParsePtr p);
 int IsOmitted (int jul, int localomit, char const *omitfunc, int *omit);
@@ -111,7 +133,14 @@ int DoUnset  (Parser *p);
 int DoDump (ParsePtr p);
 void DumpVarTable (void);
 void DestroyVars (int all);
+int InitSysVars (void);
+void DestroySysVars (void);
 int PreserveVar (char const *name);
+int CopyVars (struct RemContext const *src);
+int SetBaseVars (void);
+int CopyBaseVars (struct RemContext const *src);
+int RestoreBaseVars (void);
+void DestroyBaseVars (void);
 int DoPreserve  (Parser *p);
 int DoSatRemind (Trigger *trig, TimeTrig *tt, ParsePtr p);
 int DoMsgCommand (char const *cmd, char const *msg);
@@ -122,7 +151,10 @@ Operator *FindOperator (char const *name, Operator where[], int num);
 BuiltinFunc *FindFunc (char const *name, BuiltinFunc where[], int num);
 int InsertIntoSortBuffer (int jul, int tim, char const *body, int typ, int prio);
 void IssueSortedReminders (void);
+void FreeSortBuffer (void);
 int UserFuncExists (char const *fn);
+void DestroyUserFuncs (void);
+int CopyUserFuncs (struct RemContext const *src);
 void JulToHeb (int jul, int *hy, int *hm, int *hd);
 int HebNameToNum (char const *mname);
 char const *HebMonthName (int m, int y);
@@ -166,7 +198,15 @@ void PrintJSONKeyPairDateTime(char const *name, int dt);
 void PrintJSONKeyPairTime(char const *name, int t);
 void System(char const *cmd);
 int ShellEscape(char const *in, DynamicBuffer *out);
+size_t JSONPlainSpan(char const *s);
 int AddGlobalOmit(int jul);
+int MergeOmits(int const *full, int nfull, int const *partial, int npartial, int weekdays);
+int TableAddReminder(ParsePtr p, Trigger const *trig, TimeTrig const *tim, int jul);
+int CompileTable(void);
+int IsTable(char const *fname, FILE *fp);
+int OpenTable(char const *fname, FILE *fp);
+void ClearTables(char const *fname);
+int TablesStale(void);
 void set_lat_and_long_from_components(void);
 void set_components_from_lat_and_long(void);
 
@@ -178,6 +218,29 @@ void clear_callstack(void);
 int have_callstack(void);
 int print_callstack(FILE *fp);
 void pop_call(void);
+
+int ServerListen(char const *path);
+int ServerActive(void);
+void ServerPrepareExec(void);
+int ServerSetFds(fd_set *readSet, fd_set *writeSet, int maxfd);
+void ServerProcess(fd_set *readSet, fd_set *writeSet,
+		   void (*handler)(int client, char const *line));
+void ServerSend(int client, char const *s);
+void ServerBroadcast(unsigned int event, char const *s);
+int ServerWantsEvent(unsigned int event);
+unsigned int ServerSubscribe(int client, unsigned int events, int on);
+int ServerBeginCapture(void);
+int ServerEndCapture(DynamicBuffer *out);
+int DBufPutJSONString(DynamicBuffer *dbuf, char const *s);
+int Serve(char const *path);
+int RunRemind(void);
+int RunBatch(char const *manifest, char const *prelude);
+void RejectBatchOption(char const *opt);
+void RejectBatchJob(char const *why);
+struct RemContext *NewContext(void);
+struct RemContext *CloneContext(struct RemContext const *src);
+void FreeContext(struct RemContext *ctx);
+struct RemContext *SwitchContext(struct RemContext *ctx);
 #ifdef REM_USE_WCHAR
 #define _XOPEN_SOURCE 600
 #include <wctype.h>
@@ -18,12 +18,14 @@
 
 /* We only want object code generated if we have queued reminders */
 #include <stdio.h>
+#include <errno.h>
 #include <string.h>
 #include <signal.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/select.h>
+#include <sys/wait.h>
 #include <stdlib.h>
 #include <unistd.h>
 
@@ -32,10 +34,17 @@
 #include "err.h"
 #include "protos.h"
 #include "expr.h"
+#include "json.h"
+#include "md5.h"
 
 /* List structure for holding queued reminders */
 typedef struct queuedrem {
     struct queuedrem *next;
+    struct queuedrem *chg_next;   /* List ordered by most recent change */
+    struct queuedrem *chg_prev;
+    int id;                       /* Stable ID reported to clients */
+    long added_gen;               /* Generation in which we were queued */
+    long changed_gen;             /* Generation of last change */
     int typ;
     int RunDisabled;
     int ntrig;
@@ -52,14 +61,66 @@ typedef struct queuedrem {
 static QueuedRem *QueueHead;
 static time_t FileModTime;
 static struct stat StatBuf;
+static int StdinOpen = 1;
+static DynamicBuffer StdinBuf;
+
+/* Queue state read back from QueueStateFile; entries are matched to
+   the new queue by fingerprint, each one at most once */
+#define QUEUE_STATE_HEADER "# Remind queue state 1"
+typedef struct savedrem {
+    struct savedrem *next;
+    char fingerprint[33];
+    int ntrig;
+    int nexttime;
+    int used;
+} SavedRem;
+static SavedRem *SavedState = NULL;
+
+/* Queue generations, so clients can ask for just what changed.
+   Every change to an entry's scheduling bumps QueueGeneration and
+   moves the entry to the front of the change list. */
+#define QUEUE_GENERATION_ENV "REMIND_QUEUE_GENERATION"
+#define STDIN_PENDING_ENV "REMIND_SERVER_STDIN"
+static long QueueGeneration = 0;
+static long QueueBaseGeneration = 0;
+static QueuedRem *ChangedHead = NULL;
+static int NextQueueId = 0;
+
+/* Names of events socket clients may subscribe to */
+static struct {
+    char const *name;
+    unsigned int mask;
+} ServerEvents[] = {
+    { "reminder", SERVER_EV_REMINDER },
+    { "newdate",  SERVER_EV_NEWDATE },
+    { "reread",   SERVER_EV_REREAD },
+    { "queue",    SERVER_EV_QUEUE },
+    { "all",      SERVER_EV_ALL }
+};
+#define NUM_SERVER_EVENTS (sizeof(ServerEvents) / sizeof(ServerEvents[0]))
 
 static void CheckInitialFile (void);
 static int CalculateNextTime (QueuedRem *q);
 static QueuedRem *FindNextReminder (void);
 static int CalculateNextTimeUsingSched (QueuedRem *q);
 static void DaemonWait (struct timeval *sleep_tv);
+static void DaemonStdinLines(void);
+static void DaemonCommand(char const *cmdLine);
 static void reread (void);
 static void PrintQueue(void);
+static int CountQueued(void);
+static void BroadcastQueueChange(void);
+static void MarkChanged(QueuedRem *q);
+static void json_queue_delta(long since, char const *members);
+static void ServerCommand(int client, char const *line);
+static void ServerCalendarCommand(int client, json_value const *req);
+static int CheckCalendarRange(int y, int m, int n);
+static void DaemonCalendarCommand(char const *args);
+static int DaemonCalendar(int y, int m, int n, DynamicBuffer *cal, DynamicBuffer *errs);
+static void LoadQueueState(void);
+static int RestoreQueueEntry(QueuedRem *q);
+static void FreeQueueState(void);
+static void SaveQueueState(void);
 
 /***************************************************************/
 /*                                                             */
@@ -74,11 +135,11 @@ int QueueReminder(ParsePtr p, Trigger *trig,
 {
     QueuedRem *qelem;
 
-    if (DontQueue ||
+    if (Ctx->DontQueue ||
 	tim->ttime == NO_TIME ||
 	trig->typ == CAL_TYPE ||
 	tim->ttime < SystemTime(0) / 60 ||
-	((trig->typ == RUN_TYPE) && RunDisabled)) return OK;
+	((trig->typ == RUN_TYPE) && Ctx->RunDisabled)) return OK;
 
     qelem = NEW(QueuedRem);
     if (!qelem) {
@@ -89,19 +150,24 @@ int QueueReminder(ParsePtr p, Trigger *trig,
 	free(qelem);
 	return E_NO_MEM;
     }
-    NumQueued++;
+    Ctx->NumQueued++;
     qelem->typ = trig->typ;
     strcpy(qelem->passthru, trig->passthru);
     qelem->tt = *tim;
     qelem->t = *trig;
     DBufInit(&(qelem->t.tags));
     qelem->next = QueueHead;
-    qelem->RunDisabled = RunDisabled;
+    qelem->chg_next = NULL;
+    qelem->chg_prev = NULL;
+    qelem->id = ++NextQueueId;
+    qelem->added_gen = 0;
+    qelem->changed_gen = 0;
+    qelem->RunDisabled = Ctx->RunDisabled;
     qelem->ntrig = 0;
     strcpy(qelem->sched, sched);
     DBufInit(&(qelem->tags));
     DBufPuts(&(qelem->tags), DBufValue(&(trig->tags)));
-    if (SynthesizeTags) {
+    if (Ctx->SynthesizeTags) {
 	AppendTag(&(qelem->tags), SynthesizeTag());
     }
     QueueHead = qelem;
@@ -125,12 +191,13 @@ void HandleQueuedReminders(void)
     struct timeval tv;
     struct timeval sleep_tv;
     struct sigaction sa;
+    char const *s;
 
     /* Suppress the BANNER from being issued */
-    DidMsgReminder = 1;
+    Ctx->DidMsgReminder = 1;
 
     /* Turn off sorting -- otherwise, TriggerReminder has no effect! */
-    SortByDate = 0;
+    Ctx->SortByDate = 0;
 
     /* If we are not connected to a tty, then we must close the
      * standard file descriptors. This is to prevent someone
@@ -141,29 +208,75 @@ void HandleQueuedReminders(void)
      * processed correctly are RUN commands, provided they mail
      * the result back or use their own resource (as a window).
      */
-    if (!DontFork && (!isatty(1) || !isatty(2))) {
+    if (!Ctx->DontFork && (!isatty(1) || !isatty(2))) {
 	close(1);
 	close(2);
     }
 
     /* If we're a daemon, get the mod time of initial file */
-    if (Daemon > 0) {
-	if (stat(InitialFile, &StatBuf)) {
+    if (Ctx->Daemon > 0) {
+	if (stat(Ctx->InitialFile, &StatBuf)) {
 	    fprintf(ErrFp, "Cannot stat %s - not running as daemon!\n",
-		    InitialFile);
-	    Daemon = 0;
+		    Ctx->InitialFile);
+	    Ctx->Daemon = 0;
 	} else FileModTime = StatBuf.st_mtime;
     }
 
-    /* Initialize the queue - initialize all the entries time of issue */
+    /* Pick up any commands the previous process had not yet run */
+    DBufInit(&StdinBuf);
+    s = getenv(STDIN_PENDING_ENV);
+    if (s && *s) {
+	DBufPuts(&StdinBuf, s);
+#ifdef HAVE_UNSETENV
+	unsetenv(STDIN_PENDING_ENV);
+#else
+	putenv(STDIN_PENDING_ENV "=");
+#endif
+    }
+
+    /* In server mode, optionally accept clients on a socket too */
+    if (Ctx->Daemon < 0 && SocketPath) {
+	if (ServerListen(SocketPath) != OK) {
+	    fprintf(ErrFp, "Not serving clients on `%s'\n", SocketPath);
+	}
+    }
+
+    /* Carry the generation over a REREAD so that clients' deltas
+       from the previous process are recognized as stale */
+    s = getenv(QUEUE_GENERATION_ENV);
+    if (s && *s) {
+	QueueGeneration = atol(s);
+#ifdef HAVE_UNSETENV
+	unsetenv(QUEUE_GENERATION_ENV);
+#else
+	putenv(QUEUE_GENERATION_ENV "=");
+#endif
+    }
+    QueueBaseGeneration = ++QueueGeneration;
+
+    /* Initialize the queue - initialize all the entries time of issue,
+       carrying over where we were from the state file if possible */
+    if (QueueStateFile) LoadQueueState();
 
     while (q) {
-	q->tt.nexttime = (int) (SystemTime(1)/60 - 1);
-	q->tt.nexttime = CalculateNextTime(q);
+	if (!RestoreQueueEntry(q)) {
+	    q->tt.nexttime = (int) (SystemTime(1)/60 - 1);
+	    q->tt.nexttime = CalculateNextTime(q);
+	}
+	q->added_gen = QueueBaseGeneration;
+	q->changed_gen = QueueBaseGeneration;
+	q->chg_next = ChangedHead;
+	if (ChangedHead) ChangedHead->chg_prev = q;
+	ChangedHead = q;
 	q = q->next;
     }
+    FreeQueueState();
+    SaveQueueState();
+
+    /* Clients that survived a REREAD need to know the queue is new */
+    BroadcastQueueChange();
 
-    if (!DontFork || Daemon) {
+    if (!Ctx->DontFork || Ctx->Daemon) {
         sa.sa_handler = SigIntHandler;
         sa.sa_flags = 0;
         (void) sigaction(SIGINT, &sa, NULL);
@@ -174,14 +287,14 @@ void HandleQueuedReminders(void)
 	q = FindNextReminder();
 
 	/* If no more reminders to issue, we're done unless we're a daemon. */
-	if (!q && !Daemon) break;
+	if (!q && !Ctx->Daemon) break;
 
-	if (Daemon && !q) {
-	    if (Daemon < 0) {
+	if (Ctx->Daemon && !q) {
+	    if (Ctx->Daemon < 0) {
 		/* Sleep until midnight */
 		TimeToSleep = MINUTES_PER_DAY*60 - SystemTime(1);
 	    } else {
-		TimeToSleep = 60*Daemon;
+		TimeToSleep = 60*Ctx->Daemon;
 	    }
 	} else {
 	    TimeToSleep = q->tt.nexttime * 60L - SystemTime(1);
@@ -190,13 +303,13 @@ void HandleQueuedReminders(void)
 	while (TimeToSleep > 0L) {
 	    SleepTime = TimeToSleep;
 
-	    if (Daemon > 0 && SleepTime > (unsigned int) 60*Daemon) {
-                SleepTime = 60*Daemon;
+	    if (Ctx->Daemon > 0 && SleepTime > (unsigned int) 60*Ctx->Daemon) {
+                SleepTime = 60*Ctx->Daemon;
             }
 
 	    /* Wake up once a minute to recalibrate sleep time in
 	       case of laptop hibernation */
-	    if (Daemon < 0) {
+	    if (Ctx->Daemon < 0) {
 		/* Wake up on the next exact minute */
                 gettimeofday(&tv, NULL);
                 sleep_tv.tv_sec = 60 - (tv.tv_sec % 60);
@@ -217,21 +330,21 @@ void HandleQueuedReminders(void)
 
 	    /* If not in daemon mode and day has rolled around,
 	       exit -- not much we can do. */
-	    if (!Daemon) {
+	    if (!Ctx->Daemon) {
 		int y, m, d;
-		if (RealToday != SystemDate(&y, &m, &d)) {
+		if (Ctx->RealToday != SystemDate(&y, &m, &d)) {
 			exit(0);
 		}
 	    }
 
-	    if (Daemon > 0 && SleepTime) CheckInitialFile();
+	    if (Ctx->Daemon > 0 && SleepTime) CheckInitialFile();
 
-	    if (Daemon && !q) {
-		if (Daemon < 0) {
+	    if (Ctx->Daemon && !q) {
+		if (Ctx->Daemon < 0) {
 		    /* Sleep until midnight */
 		    TimeToSleep = MINUTES_PER_DAY*60 - SystemTime(1);
 		} else {
-		    TimeToSleep = 60*Daemon;
+		    TimeToSleep = 60*Ctx->Daemon;
 		}
 	    } else {
 		TimeToSleep = q->tt.nexttime * 60L - SystemTime(1);
@@ -250,8 +363,8 @@ void HandleQueuedReminders(void)
 	    CreateParser(q->text, &p);
 	    trig.typ = q->typ;
 	    strcpy(trig.passthru, q->passthru);
-	    RunDisabled = q->RunDisabled;
-	    if (Daemon < 0) {
+	    Ctx->RunDisabled = q->RunDisabled;
+	    if (Ctx->Daemon < 0) {
 		printf("NOTE reminder %s",
 		       SimpleTime(q->tt.ttime));
 		printf("%s", SimpleTime(SystemTime(1)/60));
@@ -264,9 +377,37 @@ void HandleQueuedReminders(void)
 
 	    /* Set up global variables so some functions like trigdate()
 	       and trigtime() work correctly                             */
-	    SaveAllTriggerInfo(&(q->t), &(q->tt), JulianToday, q->tt.ttime, 1);
-	    (void) TriggerReminder(&p, &trig, &q->tt, JulianToday);
-	    if (Daemon < 0) {
+	    SaveAllTriggerInfo(&(q->t), &(q->tt), Ctx->JulianToday, q->tt.ttime, 1);
+	    if (ServerWantsEvent(SERVER_EV_REMINDER) &&
+		ServerBeginCapture() == OK) {
+		DynamicBuffer body, ev;
+		char tmp[64];
+		DBufInit(&body);
+		DBufInit(&ev);
+		(void) TriggerReminder(&p, &trig, &q->tt, Ctx->JulianToday);
+		(void) ServerEndCapture(&body);
+		fputs(DBufValue(&body), stdout);
+		DBufPuts(&ev, "{\"event\":\"reminder\",");
+		sprintf(tmp, "\"ttime\":\"%02d:%02d\",", q->tt.ttime / 60, q->tt.ttime % 60);
+		DBufPuts(&ev, tmp);
+		sprintf(tmp, "\"now\":\"%02d:%02d\",",
+			(int) (SystemTime(1)/3600), (int) ((SystemTime(1)/60) % 60));
+		DBufPuts(&ev, tmp);
+		if (*DBufValue(&q->tags)) {
+		    DBufPuts(&ev, "\"tags\":\"");
+		    DBufPutJSONString(&ev, DBufValue(&q->tags));
+		    DBufPuts(&ev, "\",");
+		}
+		DBufPuts(&ev, "\"body\":\"");
+		DBufPutJSONString(&ev, DBufValue(&body));
+		DBufPuts(&ev, "\"}\n");
+		ServerBroadcast(SERVER_EV_REMINDER, DBufValue(&ev));
+		DBufFree(&ev);
+		DBufFree(&body);
+	    } else {
+		(void) TriggerReminder(&p, &trig, &q->tt, Ctx->JulianToday);
+	    }
+	    if (Ctx->Daemon < 0) {
 		printf("NOTE endreminder\n");
 	    }
 	    fflush(stdout);
@@ -275,6 +416,11 @@ void HandleQueuedReminders(void)
 
 	/* Calculate the next trigger time */
 	q->tt.nexttime = CalculateNextTime(q);
+	MarkChanged(q);
+	SaveQueueState();
+	if (q->tt.nexttime == NO_TIME) {
+	    BroadcastQueueChange();
+	}
     }
     exit(0);
 }
@@ -362,8 +508,8 @@ void PrintQueue(void)
     while (q) {
 	if (q->tt.nexttime != NO_TIME) {
 	    printf("Trigger: %02d%c%02d  Activate: %02d%c%02d  Rep: %d  Delta: %d  Sched: %s",
-		   q->tt.ttime / 60, TimeSep, q->tt.ttime % 60,
-		   q->tt.nexttime / 60, TimeSep, q->tt.nexttime % 60,
+		   q->tt.ttime / 60, Ctx->TimeSep, q->tt.ttime % 60,
+		   q->tt.nexttime / 60, Ctx->TimeSep, q->tt.nexttime % 60,
 		   q->tt.rep, q->tt.delta, q->sched);
 	    if (*q->sched) printf("(%d)", q->ntrig+1);
 	    printf("%s", NL);
@@ -395,9 +541,9 @@ static void CheckInitialFile(void)
     time_t tim = FileModTime;
     int y, m, d;
 
-    if (stat(InitialFile, &StatBuf) == 0) tim = StatBuf.st_mtime;
+    if (stat(Ctx->InitialFile, &StatBuf) == 0) tim = StatBuf.st_mtime;
     if (tim != FileModTime ||
-	RealToday != SystemDate(&y, &m, &d)) {
+	Ctx->RealToday != SystemDate(&y, &m, &d)) {
 	reread();
     }
 }
@@ -423,7 +569,7 @@ static int CalculateNextTimeUsingSched(QueuedRem *q)
 	return NO_TIME;
     }
 
-    RunDisabled = q->RunDisabled;  /* Don't want weird scheduling functions
+    Ctx->RunDisabled = q->RunDisabled;  /* Don't want weird scheduling functions
 				     to be a security hole!                */
     while(1) {
 	char exprBuf[VAR_NAME_LEN+32];
@@ -453,9 +599,9 @@ static int CalculateNextTimeUsingSched(QueuedRem *q)
 	}
 	if (ThisTime < 0) ThisTime = 0;        /* Can't be less than 00:00 */
 	if (ThisTime > (MINUTES_PER_DAY-1)) ThisTime = (MINUTES_PER_DAY-1);  /* or greater than 11:59 */
-	if (DebugFlag & DB_PRTEXPR) {
+	if (Ctx->DebugFlag & DB_PRTEXPR) {
 	    fprintf(ErrFp, "SCHED: Considering %02d%c%02d\n",
-		    ThisTime / 60, TimeSep, ThisTime % 60);
+		    ThisTime / 60, Ctx->TimeSep, ThisTime % 60);
 	}
 	if (ThisTime > q->tt.nexttime) return ThisTime;
 	if (ThisTime <= LastTime) {
@@ -467,6 +613,57 @@ static int CalculateNextTimeUsingSched(QueuedRem *q)
     }
 }
 
+/* Dump a single queue entry in JSON format */
+static void
+json_queue_entry(QueuedRem const *q)
+{
+    printf("{");
+    PrintJSONKeyPairInt("id", q->id);
+    switch(q->typ) {
+    case NO_TYPE: PrintJSONKeyPairString("type", "NO_TYPE"); break;
+    case MSG_TYPE: PrintJSONKeyPairString("type", "MSG_TYPE"); break;
+    case RUN_TYPE: PrintJSONKeyPairString("type", "RUN_TYPE"); break;
+    case CAL_TYPE: PrintJSONKeyPairString("type", "CAL_TYPE"); break;
+    case SAT_TYPE: PrintJSONKeyPairString("type", "SAT_TYPE"); break;
+    case PS_TYPE: PrintJSONKeyPairString("type", "PS_TYPE"); break;
+    case PSF_TYPE: PrintJSONKeyPairString("type", "PSF_TYPE"); break;
+    case MSF_TYPE: PrintJSONKeyPairString("type", "MSF_TYPE"); break;
+    case PASSTHRU_TYPE: PrintJSONKeyPairString("type", "PASSTHRU_TYPE"); break;
+    default: PrintJSONKeyPairString("type", "?"); break;
+    }
+    PrintJSONKeyPairInt("rundisabled", q->RunDisabled);
+    PrintJSONKeyPairInt("ntrig", q->ntrig);
+    PrintJSONKeyPairTime("ttime", q->tt.ttime);
+    PrintJSONKeyPairTime("nextttime", q->tt.nexttime);
+    PrintJSONKeyPairInt("delta", q->tt.delta);
+    if (q->tt.rep != NO_TIME) {
+	PrintJSONKeyPairInt("rep", q->tt.rep);
+    }
+    if (q->tt.duration != NO_TIME) {
+	PrintJSONKeyPairInt("duration", q->tt.duration);
+    }
+    if (q->passthru[0]) {
+	PrintJSONKeyPairString("passthru", q->passthru);
+    }
+    if (q->sched[0]) {
+	PrintJSONKeyPairString("sched", q->sched);
+    }
+    if (DBufLen(&(q->tags))) {
+	PrintJSONKeyPairString("tags", DBufValue(&(q->tags)));
+    }
+
+    /* Last one is a special case - no trailing comma */
+    printf("\"");
+    PrintJSONString("body");
+    printf("\":\"");
+    if (q->text) {
+	PrintJSONString(q->text);
+    } else {
+	PrintJSONString("");
+    }
+    printf("\"}");
+}
+
 /* Dump the queue in JSON format */
 static void
 json_queue(QueuedRem const *q)
@@ -482,55 +679,83 @@ json_queue(QueuedRem const *q)
 	    printf(",");
 	}
 	done = 1;
-	printf("{");
-	switch(q->typ) {
-	case NO_TYPE: PrintJSONKeyPairString("type", "NO_TYPE"); break;
-	case MSG_TYPE: PrintJSONKeyPairString("type", "MSG_TYPE"); break;
-	case RUN_TYPE: PrintJSONKeyPairString("type", "RUN_TYPE"); break;
-	case CAL_TYPE: PrintJSONKeyPairString("type", "CAL_TYPE"); break;
-	case SAT_TYPE: PrintJSONKeyPairString("type", "SAT_TYPE"); break;
-	case PS_TYPE: PrintJSONKeyPairString("type", "PS_TYPE"); break;
-	case PSF_TYPE: PrintJSONKeyPairString("type", "PSF_TYPE"); break;
-	case MSF_TYPE: PrintJSONKeyPairString("type", "MSF_TYPE"); break;
-	case PASSTHRU_TYPE: PrintJSONKeyPairString("type", "PASSTHRU_TYPE"); break;
-	default: PrintJSONKeyPairString("type", "?"); break;
-	}
-	PrintJSONKeyPairInt("rundisabled", q->RunDisabled);
-	PrintJSONKeyPairInt("ntrig", q->ntrig);
-	PrintJSONKeyPairTime("ttime", q->tt.ttime);
-	PrintJSONKeyPairTime("nextttime", q->tt.nexttime);
-	PrintJSONKeyPairInt("delta", q->tt.delta);
-	if (q->tt.rep != NO_TIME) {
-	    PrintJSONKeyPairInt("rep", q->tt.rep);
-	}
-	if (q->tt.duration != NO_TIME) {
-	    PrintJSONKeyPairInt("duration", q->tt.duration);
-	}
-	if (q->passthru[0]) {
-	    PrintJSONKeyPairString("passthru", q->passthru);
-	}
-	if (q->sched[0]) {
-	    PrintJSONKeyPairString("sched", q->sched);
-	}
-	if (DBufLen(&(q->tags))) {
-	    PrintJSONKeyPairString("tags", DBufValue(&(q->tags)));
-	}
-
-	/* Last one is a special case - no trailing comma */
-	printf("\"");
-	PrintJSONString("body");
-	printf("\":\"");
-	if (q->text) {
-	    PrintJSONString(q->text);
-	} else {
-	    PrintJSONString("");
-	}
-	printf("\"}");
+	json_queue_entry(q);
 	q = q->next;
     }
     printf("]\n");
 }
 
+/***************************************************************/
+/*                                                             */
+/*  json_queue_delta                                           */
+/*                                                             */
+/*  Dump only the entries that were queued, rescheduled or     */
+/*  removed after generation since.  If since predates this    */
+/*  process (or is nonsense) send everything and say so.       */
+/*  members is extra JSON output at the start of the object.   */
+/*                                                             */
+/***************************************************************/
+static void
+json_queue_delta(long since, char const *members)
+{
+    QueuedRem const *q;
+    int done = 0;
+    int full = (since < QueueBaseGeneration || since > QueueGeneration);
+
+    printf("{%s\"generation\":%ld,\"full\":%d,\"changed\":[",
+	   members, QueueGeneration, full);
+    if (full) {
+	for (q = QueueHead; q; q = q->next) {
+	    if (q->tt.nexttime == NO_TIME) continue;
+	    if (done) printf(",");
+	    done = 1;
+	    json_queue_entry(q);
+	}
+	printf("],\"removed\":[]}\n");
+	return;
+    }
+
+    for (q = ChangedHead; q && q->changed_gen > since; q = q->chg_next) {
+	if (q->tt.nexttime == NO_TIME) continue;
+	if (done) printf(",");
+	done = 1;
+	json_queue_entry(q);
+    }
+    printf("],\"removed\":[");
+    done = 0;
+    for (q = ChangedHead; q && q->changed_gen > since; q = q->chg_next) {
+	/* Entries that came and went since then are of no interest */
+	if (q->tt.nexttime != NO_TIME || q->added_gen > since) continue;
+	if (done) printf(",");
+	done = 1;
+	printf("%d", q->id);
+    }
+    printf("]}\n");
+}
+
+/***************************************************************/
+/*                                                             */
+/*  MarkChanged                                                */
+/*                                                             */
+/*  Note that q's scheduling changed in a new generation.      */
+/*                                                             */
+/***************************************************************/
+static void MarkChanged(QueuedRem *q)
+{
+    q->changed_gen = ++QueueGeneration;
+    if (ChangedHead == q) return;
+
+    /* Unlink... */
+    if (q->chg_prev) q->chg_prev->chg_next = q->chg_next;
+    if (q->chg_next) q->chg_next->chg_prev = q->chg_prev;
+
+    /* ... and move to the front */
+    q->chg_prev = NULL;
+    q->chg_next = ChangedHead;
+    if (ChangedHead) ChangedHead->chg_prev = q;
+    ChangedHead = q;
+}
+
 /***************************************************************/
 /*                                                             */
 /*  DaemonWait                                                 */
@@ -540,50 +765,107 @@ json_queue(QueuedRem const *q)
 /***************************************************************/
 static void DaemonWait(struct timeval *sleep_tv)
 {
-    fd_set readSet;
+    fd_set readSet, writeSet;
     int retval;
+    int maxfd = -1;
     int y, m, d;
-    char cmdLine[256];
+    char buf[256];
+    ssize_t n, i;
+
+    /* Commands that arrived along with a REREAD are run at once */
+    if (strchr(DBufValue(&StdinBuf), '\n')) {
+	DaemonStdinLines();
+	return;
+    }
 
     FD_ZERO(&readSet);
-    FD_SET(0, &readSet);
-    retval = select(1, &readSet, NULL, NULL, sleep_tv);
+    FD_ZERO(&writeSet);
+    if (StdinOpen) {
+	FD_SET(0, &readSet);
+	maxfd = 0;
+    }
+    maxfd = ServerSetFds(&readSet, &writeSet, maxfd);
+    retval = select(maxfd+1, &readSet, &writeSet, NULL, sleep_tv);
 
     /* If date has rolled around, restart */
-    if (RealToday != SystemDate(&y, &m, &d)) {
+    if (Ctx->RealToday != SystemDate(&y, &m, &d)) {
 	printf("NOTE newdate\nNOTE reread\n");
 	fflush(stdout);
+	ServerBroadcast(SERVER_EV_NEWDATE, "{\"event\":\"newdate\"}\n");
+	ServerBroadcast(SERVER_EV_REREAD, "{\"event\":\"reread\"}\n");
 	reread();
     }
 
     /* If nothing readable or interrupted system call, return */
     if (retval <= 0) return;
 
+    /* Service socket clients first */
+    ServerProcess(&readSet, &writeSet, ServerCommand);
+
     /* If stdin not readable, return */
-    if (!FD_ISSET(0, &readSet)) return;
+    if (!StdinOpen || !FD_ISSET(0, &readSet)) return;
+
+    /* Read stdin ourselves rather than with fgets, so that several
+       commands arriving at once are not left sitting in a stdio
+       buffer that select() knows nothing about. */
+    n = read(0, buf, sizeof(buf));
+    if (n < 0 && errno == EINTR) return;
 
-    /* If EOF on stdin, exit */
-    if (feof(stdin)) {
+    /* If EOF on stdin, exit -- unless socket clients are
+       still being served, in which case just stop reading stdin */
+    if (n <= 0) {
+	if (ServerActive()) {
+	    StdinOpen = 0;
+	    return;
+	}
 	exit(0);
     }
+    for (i=0; i<n; i++) {
+	DBufPutc(&StdinBuf, buf[i]);
+    }
+    DaemonStdinLines();
+}
 
-    /* Read a line from stdin and interpret it */
-    if (!fgets(cmdLine, sizeof(cmdLine), stdin)) {
-	exit(0);
+/***************************************************************/
+/*                                                             */
+/*  DaemonStdinLines                                           */
+/*                                                             */
+/*  Execute each complete command line buffered from stdin.    */
+/*                                                             */
+/***************************************************************/
+static void DaemonStdinLines(void)
+{
+    char *nl;
+
+    while ((nl = strchr(DBufValue(&StdinBuf), '\n')) != NULL) {
+	DynamicBuffer line, rest;
+	DBufInit(&line);
+	DBufInit(&rest);
+	*nl = 0;
+	DBufPuts(&line, DBufValue(&StdinBuf));
+	DBufPutc(&line, '\n');
+	DBufPuts(&rest, nl+1);
+	DBufFree(&StdinBuf);
+	DBufPuts(&StdinBuf, DBufValue(&rest));
+	DBufFree(&rest);
+	DaemonCommand(DBufValue(&line));
+	DBufFree(&line);
     }
+}
 
+/***************************************************************/
+/*                                                             */
+/*  DaemonCommand                                              */
+/*                                                             */
+/*  Interpret a newline-terminated command read from stdin     */
+/*                                                             */
+/***************************************************************/
+static void DaemonCommand(char const *cmdLine)
+{
     if (!strcmp(cmdLine, "EXIT\n")) {
 	exit(0);
     } else if (!strcmp(cmdLine, "STATUS\n")) {
-	int nqueued = 0;
-	QueuedRem *q = QueueHead;
-	while(q) {
-	    if (q->tt.nexttime != NO_TIME) {
-		nqueued++;
-	    }
-	    q = q->next;
-	}
-	printf("NOTE queued %d\n", nqueued);
+	printf("NOTE queued %d\n", CountQueued());
 	fflush(stdout);
     } else if (!strcmp(cmdLine, "QUEUE\n")) {
 	printf("NOTE queue\n");
@@ -617,9 +899,17 @@ static void DaemonWait(struct timeval *sleep_tv)
 	json_queue(QueueHead);
 	printf("NOTE ENDJSONQUEUE\n");
 	fflush(stdout);
+    } else if (!strncmp(cmdLine, "JSONQUEUE ", 10)) {
+	printf("NOTE JSONQUEUE\n");
+	json_queue_delta(atol(cmdLine+10), "");
+	printf("NOTE ENDJSONQUEUE\n");
+	fflush(stdout);
+    } else if (!strncmp(cmdLine, "CALENDAR ", 9)) {
+	DaemonCalendarCommand(cmdLine+9);
     } else if (!strcmp(cmdLine, "REREAD\n")) {
 	printf("NOTE reread\n");
 	fflush(stdout);
+	ServerBroadcast(SERVER_EV_REREAD, "{\"event\":\"reread\"}\n");
 	reread();
     } else {
 	printf("ERR Invalid daemon command: %s", cmdLine);
@@ -636,6 +926,603 @@ static void DaemonWait(struct timeval *sleep_tv)
 /***************************************************************/
 static void reread(void)
 {
+    static char genbuf[64];
+    static DynamicBuffer pending;
+
+    ServerPrepareExec();
+    sprintf(genbuf, "%s=%ld", QUEUE_GENERATION_ENV, QueueGeneration);
+    putenv(genbuf);
+    if (DBufLen(&StdinBuf)) {
+	DBufInit(&pending);
+	DBufPuts(&pending, STDIN_PENDING_ENV "=");
+	DBufPuts(&pending, DBufValue(&StdinBuf));
+	putenv(DBufValue(&pending));
+    }
     execvp(ArgV[0], (char **) ArgV);
 }
 
+/***************************************************************/
+/*                                                             */
+/*  CountQueued                                                */
+/*                                                             */
+/*  Return the number of reminders still waiting to trigger.   */
+/*                                                             */
+/***************************************************************/
+static int CountQueued(void)
+{
+    int nqueued = 0;
+    QueuedRem *q = QueueHead;
+    while(q) {
+	if (q->tt.nexttime != NO_TIME) {
+	    nqueued++;
+	}
+	q = q->next;
+    }
+    return nqueued;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  BroadcastQueueChange                                       */
+/*                                                             */
+/*  Tell subscribed socket clients that the queue changed.     */
+/*                                                             */
+/***************************************************************/
+static void BroadcastQueueChange(void)
+{
+    char buf[128];
+    if (!ServerWantsEvent(SERVER_EV_QUEUE)) return;
+    sprintf(buf, "{\"event\":\"queue\",\"queued\":%d,\"generation\":%ld}\n",
+	    CountQueued(), QueueGeneration);
+    ServerBroadcast(SERVER_EV_QUEUE, buf);
+}
+
+static json_value const *
+JSONMember(json_value const *obj, char const *name)
+{
+    unsigned int i;
+    if (!obj || obj->type != json_object) return NULL;
+    for (i=0; i<obj->u.object.length; i++) {
+	if (!strcmp(obj->u.object.values[i].name, name)) {
+	    return obj->u.object.values[i].value;
+	}
+    }
+    return NULL;
+}
+
+static void
+ServerError(int client, char const *msg)
+{
+    DynamicBuffer buf;
+    DBufInit(&buf);
+    DBufPuts(&buf, "{\"response\":\"error\",\"error\":\"");
+    DBufPutJSONString(&buf, msg);
+    DBufPuts(&buf, "\"}\n");
+    ServerSend(client, DBufValue(&buf));
+    DBufFree(&buf);
+}
+
+/* Handle "subscribe" and "unsubscribe" requests */
+static void
+ServerSubscribeCommand(int client, json_value const *req, int on)
+{
+    json_value const *events = JSONMember(req, "events");
+    unsigned int mask = 0;
+    unsigned int i, j;
+    int found;
+    DynamicBuffer buf;
+
+    if (!events || events->type != json_array) {
+	ServerError(client, "Expecting an array of events");
+	return;
+    }
+    for (i=0; i<events->u.array.length; i++) {
+	json_value const *e = events->u.array.values[i];
+	if (e->type != json_string) {
+	    ServerError(client, "Event names must be strings");
+	    return;
+	}
+	found = 0;
+	for (j=0; j<NUM_SERVER_EVENTS; j++) {
+	    if (!strcmp(e->u.string.ptr, ServerEvents[j].name)) {
+		mask |= ServerEvents[j].mask;
+		found = 1;
+		break;
+	    }
+	}
+	if (!found) {
+	    ServerError(client, "Unknown event name");
+	    return;
+	}
+    }
+    mask = ServerSubscribe(client, mask, on);
+
+    DBufInit(&buf);
+    DBufPuts(&buf, on ? "{\"response\":\"subscribe\",\"events\":["
+		 : "{\"response\":\"unsubscribe\",\"events\":[");
+    found = 0;
+    for (j=0; j<NUM_SERVER_EVENTS; j++) {
+	if (ServerEvents[j].mask == SERVER_EV_ALL) continue;
+	if (mask & ServerEvents[j].mask) {
+	    if (found) DBufPutc(&buf, ',');
+	    found = 1;
+	    DBufPutc(&buf, '"');
+	    DBufPuts(&buf, ServerEvents[j].name);
+	    DBufPutc(&buf, '"');
+	}
+    }
+    DBufPuts(&buf, "]}\n");
+    ServerSend(client, DBufValue(&buf));
+    DBufFree(&buf);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  ServerCommand                                              */
+/*                                                             */
+/*  Interpret one JSON request from a socket client.           */
+/*                                                             */
+/***************************************************************/
+static void ServerCommand(int client, char const *line)
+{
+    json_value *req;
+    json_value const *cmd;
+    char const *c;
+    char buf[128];
+    DynamicBuffer out;
+
+    req = json_parse(line, strlen(line));
+    if (!req) {
+	ServerError(client, "Malformed JSON request");
+	return;
+    }
+    cmd = JSONMember(req, "command");
+    if (!cmd || cmd->type != json_string) {
+	json_value_free(req);
+	ServerError(client, "Missing \"command\"");
+	return;
+    }
+    c = cmd->u.string.ptr;
+
+    if (!strcmp(c, "status")) {
+	sprintf(buf, "{\"response\":\"status\",\"queued\":%d}\n", CountQueued());
+	ServerSend(client, buf);
+    } else if (!strcmp(c, "queue")) {
+	json_value const *since = JSONMember(req, "since");
+	DBufInit(&out);
+	if (since && since->type == json_integer) {
+	    if (ServerBeginCapture() == OK) {
+		json_queue_delta((long) since->u.integer, "\"response\":\"queue\",");
+		(void) ServerEndCapture(&out);
+	    }
+	} else {
+	    sprintf(buf, "{\"response\":\"queue\",\"generation\":%ld,\"queue\":",
+		    QueueGeneration);
+	    DBufPuts(&out, buf);
+	    if (ServerBeginCapture() == OK) {
+		json_queue(QueueHead);
+		(void) ServerEndCapture(&out);
+	    }
+	    /* json_queue ends with a newline; replace it with the closing brace */
+	    if (DBufLen(&out) && DBufValue(&out)[DBufLen(&out)-1] == '\n') {
+		DBufValue(&out)[--DBufLen(&out)] = 0;
+	    }
+	    DBufPuts(&out, "}\n");
+	}
+	ServerSend(client, DBufValue(&out));
+	DBufFree(&out);
+    } else if (!strcmp(c, "calendar")) {
+	ServerCalendarCommand(client, req);
+    } else if (!strcmp(c, "subscribe")) {
+	ServerSubscribeCommand(client, req, 1);
+    } else if (!strcmp(c, "unsubscribe")) {
+	ServerSubscribeCommand(client, req, 0);
+    } else if (!strcmp(c, "reread")) {
+	json_value_free(req);
+	ServerSend(client, "{\"response\":\"reread\"}\n");
+	printf("NOTE reread\n");
+	fflush(stdout);
+	ServerBroadcast(SERVER_EV_REREAD, "{\"event\":\"reread\"}\n");
+	reread();
+	return;
+    } else if (!strcmp(c, "exit")) {
+	ServerSend(client, "{\"response\":\"exit\"}\n");
+	exit(0);
+    } else {
+	DBufInit(&out);
+	DBufPuts(&out, "Invalid daemon command: ");
+	DBufPuts(&out, c);
+	ServerError(client, DBufValue(&out));
+	DBufFree(&out);
+    }
+    json_value_free(req);
+}
+
+
+/***************************************************************/
+/*                                                             */
+/*  CheckCalendarRange                                         */
+/*                                                             */
+/*  Make sure a calendar of n months starting with month m     */
+/*  (1-12) of year y lies within Remind's range of dates.      */
+/*                                                             */
+/***************************************************************/
+static int CheckCalendarRange(int y, int m, int n)
+{
+    if (y < BASE || y > BASE+YR_RANGE || m < 1 || m > 12 || n < 1) {
+	return E_BAD_DATE;
+    }
+    /* Check n on its own first so the sum below can't overflow */
+    if (n > (YR_RANGE+1)*12) {
+	return E_BAD_DATE;
+    }
+    if ((y-BASE)*12 + m-1 + n > (YR_RANGE+1)*12) {
+	return E_BAD_DATE;
+    }
+    return OK;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  DaemonCalendar                                             */
+/*                                                             */
+/*  Produce a "-ppp" calendar of n months starting with month  */
+/*  m (1-12) of year y from the files we already have cached.  */
+/*  A calendar run resets the variables and OMITs the queued   */
+/*  reminders rely on, so it is done in a child process.  The  */
+/*  calendar goes in cal with its newlines removed so that it  */
+/*  fits on one line; error messages go in errs.               */
+/*                                                             */
+/***************************************************************/
+static int DaemonCalendar(int y, int m, int n, DynamicBuffer *cal, DynamicBuffer *errs)
+{
+    FILE *errfp;
+    pid_t pid;
+    int status = 0;
+    int c;
+    DynamicBuffer raw;
+    char const *t;
+
+    errfp = tmpfile();
+    if (!errfp) return E_IO_ERR;
+    if (ServerBeginCapture() != OK) {
+	fclose(errfp);
+	return E_IO_ERR;
+    }
+    fflush(ErrFp);
+    pid = fork();
+    if (pid == 0) {
+	ErrFp = errfp;
+	ProduceJSONCalendar(y, m-1, n);
+	fflush(stdout);
+	fflush(ErrFp);
+	_exit(0);
+    }
+    if (pid > 0) {
+	while (waitpid(pid, &status, 0) < 0) {
+	    if (errno != EINTR) break;
+	}
+    }
+
+    DBufInit(&raw);
+    (void) ServerEndCapture(&raw);
+    if (pid < 0) {
+	DBufFree(&raw);
+	fclose(errfp);
+	return E_CANTFORK;
+    }
+    for (t = DBufValue(&raw); *t; t++) {
+	if (*t != '\n') DBufPutc(cal, *t);
+    }
+    DBufFree(&raw);
+
+    rewind(errfp);
+    while ((c = getc(errfp)) != EOF) {
+	DBufPutc(errs, (char) c);
+    }
+    fclose(errfp);
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status)) return E_ERR_READING;
+    return OK;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  DaemonCalendarCommand                                      */
+/*                                                             */
+/*  Handle "CALENDAR yyyy mm [n]" read from stdin.  Replies    */
+/*  with the calendar on one line between NOTE CALENDAR and    */
+/*  NOTE ENDCALENDAR, preceded by an ERR line for each error.  */
+/*                                                             */
+/***************************************************************/
+static void DaemonCalendarCommand(char const *args)
+{
+    int y, m, n = 1;
+    int r;
+    DynamicBuffer cal, errs;
+    char *t, *nl;
+
+    if (sscanf(args, "%d %d %d", &y, &m, &n) < 2) {
+	printf("ERR Invalid daemon command: CALENDAR %s", args);
+	fflush(stdout);
+	return;
+    }
+    r = CheckCalendarRange(y, m, n);
+    if (r != OK) {
+	printf("ERR %s\n", ErrMsg[r]);
+	fflush(stdout);
+	return;
+    }
+
+    DBufInit(&cal);
+    DBufInit(&errs);
+    r = DaemonCalendar(y, m, n, &cal, &errs);
+    printf("NOTE CALENDAR\n");
+    for (t = DBufValue(&errs); *t; t = nl+1) {
+	nl = strchr(t, '\n');
+	if (!nl) {
+	    printf("ERR %s\n", t);
+	    break;
+	}
+	printf("ERR %.*s\n", (int) (nl-t), t);
+    }
+    if (r != OK && r != E_ERR_READING) {
+	printf("ERR %s\n", ErrMsg[r]);
+    }
+    printf("%s\n", DBufValue(&cal));
+    printf("NOTE ENDCALENDAR\n");
+    fflush(stdout);
+    DBufFree(&cal);
+    DBufFree(&errs);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  ServerCalendarCommand                                      */
+/*                                                             */
+/*  Handle {"command":"calendar","year":y,"month":m,           */
+/*  "months":n} from a socket client.                          */
+/*                                                             */
+/***************************************************************/
+static void ServerCalendarCommand(int client, json_value const *req)
+{
+    json_value const *v;
+    int y, m, n = 1;
+    int r;
+    DynamicBuffer out, errs;
+
+    v = JSONMember(req, "year");
+    if (!v || v->type != json_integer) {
+	ServerError(client, "Missing \"year\"");
+	return;
+    }
+    y = (int) v->u.integer;
+    v = JSONMember(req, "month");
+    if (!v || v->type != json_integer) {
+	ServerError(client, "Missing \"month\"");
+	return;
+    }
+    m = (int) v->u.integer;
+    v = JSONMember(req, "months");
+    if (v && v->type == json_integer) {
+	/* Don't let a huge count wrap around to a small one */
+	if (v->u.integer < 1 || v->u.integer > (YR_RANGE+1)*12) {
+	    ServerError(client, ErrMsg[E_BAD_DATE]);
+	    return;
+	}
+	n = (int) v->u.integer;
+    }
+    r = CheckCalendarRange(y, m, n);
+    if (r != OK) {
+	ServerError(client, ErrMsg[r]);
+	return;
+    }
+
+    DBufInit(&out);
+    DBufInit(&errs);
+    DBufPuts(&out, "{\"response\":\"calendar\",\"calendar\":");
+    r = DaemonCalendar(y, m, n, &out, &errs);
+    if (r != OK && r != E_ERR_READING) {
+	DBufFree(&out);
+	DBufFree(&errs);
+	ServerError(client, ErrMsg[r]);
+	return;
+    }
+    if (DBufValue(&out)[DBufLen(&out)-1] == ':') {
+	/* The child produced nothing at all */
+	DBufPuts(&out, "null");
+    }
+    if (DBufLen(&errs)) {
+	DBufPuts(&out, ",\"errors\":\"");
+	DBufPutJSONString(&out, DBufValue(&errs));
+	DBufPutc(&out, '"');
+    }
+    DBufPuts(&out, "}\n");
+    ServerSend(client, DBufValue(&out));
+    DBufFree(&out);
+    DBufFree(&errs);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  QueueFingerprint                                           */
+/*                                                             */
+/*  Compute a fingerprint identifying a queued reminder        */
+/*  across restarts:  an MD5 hash of its type, timing and      */
+/*  text.  out must hold 33 characters.                        */
+/*                                                             */
+/***************************************************************/
+static void QueueFingerprint(QueuedRem const *q, char *out)
+{
+    struct MD5Context ctx;
+    unsigned char buf[16];
+    char hdr[128];
+    int i;
+
+    sprintf(hdr, "%d %d %d %d %d %s|", q->typ, q->tt.ttime, q->tt.delta,
+	    q->tt.rep, q->tt.duration, q->sched);
+    MD5Init(&ctx);
+    MD5Update(&ctx, (unsigned char *) hdr, strlen(hdr));
+    MD5Update(&ctx, (unsigned char *) q->text, strlen(q->text));
+    MD5Final(buf, &ctx);
+    for (i=0; i<16; i++) {
+	sprintf(out + 2*i, "%02x", (unsigned int) buf[i]);
+    }
+}
+
+/***************************************************************/
+/*                                                             */
+/*  LoadQueueState                                             */
+/*                                                             */
+/*  Read the state saved by SaveQueueState.  It is used only   */
+/*  if it was written today for the same reminder file.  Lines */
+/*  that are malformed, cut short or out of range are skipped, */
+/*  so their reminders are scheduled afresh.                   */
+/*                                                             */
+/***************************************************************/
+static void LoadQueueState(void)
+{
+    FILE *fp;
+    char line[1024];
+    char today[32];
+    char fingerprint[33];
+    int y, m, d, ntrig, nexttime, n;
+    size_t len;
+    SavedRem *sr;
+
+    fp = fopen(QueueStateFile, "r");
+    if (!fp) return;
+
+    FromJulian(Ctx->RealToday, &y, &m, &d);
+    sprintf(today, "date %04d-%02d-%02d\n", y, m+1, d);
+
+    /* Header, reminder file and date must all match */
+    if (!fgets(line, sizeof(line), fp) ||
+	strcmp(line, QUEUE_STATE_HEADER "\n") ||
+	!fgets(line, sizeof(line), fp) ||
+	strncmp(line, "file ", 5)) {
+	fclose(fp);
+	return;
+    }
+    len = strlen(line);
+    if (len && line[len-1] == '\n') line[--len] = 0;
+    if (strcmp(line+5, Ctx->InitialFile) ||
+	!fgets(line, sizeof(line), fp) ||
+	strcmp(line, today)) {
+	fclose(fp);
+	return;
+    }
+
+    while (fgets(line, sizeof(line), fp)) {
+	n = 0;
+	if (sscanf(line, "%32s %d %d%n", fingerprint, &ntrig, &nexttime, &n) != 3 ||
+	    strcmp(line+n, "\n") ||
+	    strlen(fingerprint) != 32 ||
+	    strspn(fingerprint, "0123456789abcdef") != 32 ||
+	    ntrig < 0 || nexttime < -1 || nexttime >= MINUTES_PER_DAY) {
+	    continue;
+	}
+	sr = NEW(SavedRem);
+	if (!sr) break;
+	strcpy(sr->fingerprint, fingerprint);
+	sr->ntrig = ntrig;
+	sr->nexttime = (nexttime < 0) ? NO_TIME : nexttime;
+	sr->used = 0;
+	sr->next = SavedState;
+	SavedState = sr;
+    }
+    fclose(fp);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  RestoreQueueEntry                                          */
+/*                                                             */
+/*  If the saved state has an entry for q, pick up where it    */
+/*  left off rather than starting afresh, so that reminders    */
+/*  already issued are not issued again.  Returns 1 if q was   */
+/*  restored, 0 if its next time must be calculated.           */
+/*                                                             */
+/***************************************************************/
+static int RestoreQueueEntry(QueuedRem *q)
+{
+    SavedRem *sr;
+    char fingerprint[33];
+    int now;
+
+    if (!SavedState) return 0;
+    QueueFingerprint(q, fingerprint);
+    for (sr = SavedState; sr; sr = sr->next) {
+	if (!sr->used && !strcmp(sr->fingerprint, fingerprint)) break;
+    }
+    if (!sr) return 0;
+
+    sr->used = 1;
+    q->ntrig = sr->ntrig;
+    now = (int) (SystemTime(1)/60);
+    if (sr->nexttime == NO_TIME || sr->nexttime >= now) {
+	q->tt.nexttime = sr->nexttime;
+    } else {
+	/* We were down when it was due; carry on from now */
+	q->tt.nexttime = now - 1;
+	q->tt.nexttime = CalculateNextTime(q);
+    }
+    return 1;
+}
+
+static void FreeQueueState(void)
+{
+    SavedRem *sr;
+    while (SavedState) {
+	sr = SavedState->next;
+	free(SavedState);
+	SavedState = sr;
+    }
+}
+
+/***************************************************************/
+/*                                                             */
+/*  SaveQueueState                                             */
+/*                                                             */
+/*  Write each queued reminder's fingerprint, trigger count    */
+/*  and next trigger time to QueueStateFile.  The file is      */
+/*  written under a temporary name and renamed into place.     */
+/*                                                             */
+/***************************************************************/
+static void SaveQueueState(void)
+{
+    DynamicBuffer tmpname;
+    FILE *fp;
+    QueuedRem *q;
+    char fingerprint[33];
+    int y, m, d;
+
+    if (!QueueStateFile) return;
+
+    DBufInit(&tmpname);
+    DBufPuts(&tmpname, QueueStateFile);
+    DBufPuts(&tmpname, ".tmp");
+    fp = fopen(DBufValue(&tmpname), "w");
+    if (!fp) {
+	fprintf(ErrFp, "Cannot write queue state file `%s': %s\n",
+		DBufValue(&tmpname), strerror(errno));
+	DBufFree(&tmpname);
+	return;
+    }
+
+    FromJulian(Ctx->RealToday, &y, &m, &d);
+    fprintf(fp, "%s\n", QUEUE_STATE_HEADER);
+    fprintf(fp, "file %s\n", Ctx->InitialFile);
+    fprintf(fp, "date %04d-%02d-%02d\n", y, m+1, d);
+    for (q = QueueHead; q; q = q->next) {
+	QueueFingerprint(q, fingerprint);
+	fprintf(fp, "%s %d %d\n", fingerprint, q->ntrig,
+		(q->tt.nexttime == NO_TIME) ? -1 : q->tt.nexttime);
+    }
+    if (fclose(fp) == EOF || rename(DBufValue(&tmpname), QueueStateFile)) {
+	fprintf(ErrFp, "Cannot write queue state file `%s': %s\n",
+		QueueStateFile, strerror(errno));
+	(void) unlink(DBufValue(&tmpname));
+    }
+    DBufFree(&tmpname);
+}
@@ -2,7 +2,7 @@
 /*                                                             */
 /*  REM2PS.C                                                   */
 /*                                                             */
-/*  Print a PostScript calendar.                               */
+/*  Print a PostScript or PDF calendar.                        */
 /*                                                             */
 /*  This file is part of REMIND.                               */
 /*  Copyright (C) 1992-2022 by Dianne Skoll                    */
@@ -11,7 +11,7 @@
 
 #include "version.h"
 #include "config.h"
-#include "dynbuf.h"
+#include "arena.h"
 
 #include <stdio.h>
 #include <string.h>
@@ -21,6 +21,7 @@
 #include <stdlib.h>
 #include "rem2ps.h"
 #include "json.h"
+#include "pdf.h"
 
 #define NEW(type) (malloc(sizeof(type)))
 
@@ -102,6 +103,7 @@ char PortraitMode;
 char DaynumRight;
 char NoSmallCal;
 char UseISO;
+char PdfMode;
 
 char const *HeadFont="Helvetica";
 char const *TitleFont="Helvetica";
@@ -120,6 +122,22 @@ char const *UserProlog = NULL;
 
 int validfile = 0;
 
+/* JSON entries are parsed into an arena that is emptied after each one */
+static Arena JSONArena;
+static json_settings JSONSettings;
+
+/* Input buffer from which lines are handed out in place */
+#define IN_CHUNK 65536
+static char *InBuf = NULL;
+static size_t InSize = 0;
+static size_t InStart = 0;
+static size_t InEnd = 0;
+static int InEOF = 0;
+
+char MonthName[40], YearName[40];
+char PrevMonthName[40], NextMonthName[40];
+int PrevDays, NextDays;
+
 int CurDay;
 int MaxDay;
 int DayNum;
@@ -130,9 +148,29 @@ int LeftMarg, RightMarg, TopMarg, BotMarg;
 int FillPage;
 int Verbose = 0;
 
+/* Input files named on the command line; standard input if none */
+char **InputFiles;
+int NumInputFiles = 0;
+
+/* With -P, the layout the PostScript prologue does when the
+   calendar is printed is done here instead, in points.  These
+   mirror the prologue's variables of the same names. */
+static int TitleF, HeadF, DayF, EntryF, SmallF;
+static double TitleSz, HeadSz, DaySz, EntrySz, LineW;
+static double MinX, MinY, MaxX, MaxY, Border;
+static double XIncr, TopY, YTop, YMin, YLast, MinBoxSize;
+static double YSmallTop, YSmallBot, YSmall1, YSmall2;
+
+/* The ordinary entries of each day in the row being drawn */
+static CalEntry *DayEntries[32];
+
 void Init (int argc, char *argv[]);
 void Usage (char const *s);
 void DoPsCal (void);
+static void DoBinaryInput (void);
+static void StartPsMonth (void);
+static void AddPsEntry (CalEntry *c);
+static void FinishPsMonth (void);
 int DoQueuedPs (void);
 void DoSmallCal (char const *m, int days, int first, int col, int which);
 void WriteProlog (void);
@@ -140,6 +178,9 @@ void WriteCalEntry (void);
 void WriteOneEntry (CalEntry *c);
 void GetSmallLocations (void);
 char const *EatToken(char const *in, char *out, int maxlen);
+static void StartPdfPage (void);
+static void DrawPdfRow (void);
+static void DoSmallPdf (char const *m, int days, int first, int col, int which);
 
 static void
 put_escaped_string(char const *s)
@@ -171,26 +212,153 @@ int StrCmpi(char const *s1, char const *s2)
     }
     return toupper(*s1) - toupper(*s2);
 }
+/***************************************************************/
+/*                                                             */
+/*  CountMonth - note that we have found another month of      */
+/*  calendar data.                                             */
+/*                                                             */
+/***************************************************************/
+static void
+CountMonth(void)
+{
+    if (!validfile) {
+	if (Verbose) {
+	    fprintf(stderr, "Rem2PS: Version %s Copyright 1992-2022 by Dianne Skoll\n\n", VERSION);
+	    fprintf(stderr, "Generating %s calendar\n",
+		    PdfMode ? "PDF" : "PostScript");
+	}
+    }
+    validfile++;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  PassthruToSpecial - map a SPECIAL name to its type         */
+/*                                                             */
+/***************************************************************/
+static int
+PassthruToSpecial(char const *s)
+{
+    if (!StrCmpi(s, "PostScript")) {
+	return SPECIAL_POSTSCRIPT;
+    } else if (!StrCmpi(s, "SHADE")) {
+	return SPECIAL_SHADE;
+    } else if (!StrCmpi(s, "MOON")) {
+	return SPECIAL_MOON;
+    } else if (!StrCmpi(s, "WEEK")) {
+	return SPECIAL_WEEK;
+    } else if (!StrCmpi(s, "PSFile")) {
+	return SPECIAL_PSFILE;
+    } else if (!StrCmpi(s, "COLOUR") ||
+	       !StrCmpi(s, "COLOR")) {
+	return SPECIAL_COLOR;
+    }
+    return SPECIAL_UNKNOWN;
+}
+
+/***************************************************************/
+/*                                                             */
+/*   ReadLine - return the next line of input without its      */
+/*   newline, or NULL at end of file.  Input is read in large  */
+/*   chunks and the line is terminated in place, so it is only */
+/*   valid until the next call.                                */
+/*                                                             */
+/***************************************************************/
+static char *
+ReadLine(size_t *len)
+{
+    char *line, *nl;
+    size_t n;
+
+    while(1) {
+	nl = (InEnd > InStart) ?
+	    memchr(InBuf + InStart, '\n', InEnd - InStart) : NULL;
+	if (nl) break;
+	if (InEOF) {
+	    if (InStart == InEnd) return NULL;
+	    /* Last line has no newline; there is always room for
+	       its terminator */
+	    nl = InBuf + InEnd;
+	    InEnd++;
+	    break;
+	}
+
+	/* Slide the partial line down and make room for another chunk */
+	if (InStart) {
+	    memmove(InBuf, InBuf + InStart, InEnd - InStart);
+	    InEnd -= InStart;
+	    InStart = 0;
+	}
+	if (InSize - InEnd < IN_CHUNK + 1) {
+	    InSize = InEnd + IN_CHUNK + 1;
+	    InBuf = realloc(InBuf, InSize);
+	    if (!InBuf) {
+		fprintf(stderr, "malloc failed - aborting.\n");
+		exit(1);
+	    }
+	}
+	n = fread(InBuf + InEnd, 1, IN_CHUNK, stdin);
+	if (n < IN_CHUNK) InEOF = 1;
+	InEnd += n;
+    }
+
+    line = InBuf + InStart;
+    *nl = 0;
+    *len = nl - line;
+    InStart = nl - InBuf + 1;
+    return line;
+}
+
+/* A missing header line reads as an empty one */
+static char const *
+ReadHeaderLine(void)
+{
+    size_t len;
+    char const *line = ReadLine(&len);
+    return line ? line : "";
+}
+
 /***************************************************************/
 /*                                                             */
 /*   Parse the new-style JSON intermediate format              */
 /*                                                             */
 /***************************************************************/
+static void *
+JSONArenaAlloc(size_t n, int zero, void *data)
+{
+    void *p = ArenaAlloc((Arena *) data, n);
+    if (p && zero) memset(p, 0, n);
+    return p;
+}
+
+static void
+JSONArenaFree(void *p, void *data)
+{
+    /* Everything goes at once when the arena is reset */
+    (void) p;
+    (void) data;
+}
+
 static CalEntry *
-JSONToCalEntry(DynamicBuffer *buf)
+JSONToCalEntry(char const *line, size_t len)
 {
     CalEntry *c;
     json_value *val;
 
-    val = json_parse(DBufValue(buf), DBufLen(buf));
+    if (!JSONSettings.mem_alloc) {
+	ArenaInit(&JSONArena);
+	JSONSettings.mem_alloc = JSONArenaAlloc;
+	JSONSettings.mem_free = JSONArenaFree;
+	JSONSettings.user_data = &JSONArena;
+    }
+    val = json_parse_ex(&JSONSettings, line, len, NULL);
     if (!val) {
-	fprintf(stderr, "Unable to parse JSON line `%s'\n", DBufValue(buf));
+	fprintf(stderr, "Unable to parse JSON line `%s'\n", line);
 	exit(1);
     }
 
     if (val->type != json_object) {
-	fprintf(stderr, "Expecting JSON object; found `%s'\n",
-		DBufValue(buf));
+	fprintf(stderr, "Expecting JSON object; found `%s'\n", line);
 	exit(1);
     }
 
@@ -227,31 +395,15 @@ JSONToCalEntry(DynamicBuffer *buf)
 	    }
 	} else if (!strcmp(nm, "passthru")) {
 	    if (v->type == json_string) {
-		s = v->u.string.ptr;
-		if (!StrCmpi(s, "PostScript")) {
-		    c->special = SPECIAL_POSTSCRIPT;
-		} else if (!StrCmpi(s, "SHADE")) {
-		    c->special = SPECIAL_SHADE;
-		} else if (!StrCmpi(s, "MOON")) {
-		    c->special = SPECIAL_MOON;
-		} else if (!StrCmpi(s, "WEEK")) {
-		    c->special = SPECIAL_WEEK;
-		} else if (!StrCmpi(s, "PSFile")) {
-		    c->special = SPECIAL_PSFILE;
-		} else if (!StrCmpi(s, "COLOUR") ||
-			   !StrCmpi(s, "COLOR")) {
-		    c->special = SPECIAL_COLOR;
-		} else {
-		    c->special = SPECIAL_UNKNOWN;
-		}
+		c->special = PassthruToSpecial(v->u.string.ptr);
 	    }
 	}
     }
 
-    json_value_free(val);
+    ArenaReset(&JSONArena);
 
     if (!got_body || !got_date) {
-	fprintf(stderr, "Could not parse line `%s'\n", DBufValue(buf));
+	fprintf(stderr, "Could not parse line `%s'\n", line);
 	exit(1);
     }
     return c;
@@ -263,7 +415,7 @@ JSONToCalEntry(DynamicBuffer *buf)
 /*                                                             */
 /***************************************************************/
 static CalEntry *
-TextToCalEntry(DynamicBuffer *buf)
+TextToCalEntry(char const *line)
 {
     char const *startOfBody;
     char passthru[PASSTHRU_LEN+1];
@@ -275,10 +427,10 @@ TextToCalEntry(DynamicBuffer *buf)
     }
     c->next = NULL;
     c->special = SPECIAL_NORMAL;
-    c->daynum = (DBufValue(buf)[8] - '0') * 10 + DBufValue(buf)[9] - '0';
+    c->daynum = (line[8] - '0') * 10 + line[9] - '0';
 
     /* Skip the tag, duration and time */
-    startOfBody = DBufValue(buf)+10;
+    startOfBody = line+10;
 
     /* Eat the passthru */
     startOfBody = EatToken(startOfBody, passthru, PASSTHRU_LEN);
@@ -300,70 +452,303 @@ TextToCalEntry(DynamicBuffer *buf)
     strcpy(c->entry, startOfBody);
 
     /* Save the type of SPECIAL */
-    if (!StrCmpi(passthru, "PostScript")) {
-	c->special = SPECIAL_POSTSCRIPT;
-    } else if (!StrCmpi(passthru, "SHADE")) {
-	c->special = SPECIAL_SHADE;
-    } else if (!StrCmpi(passthru, "MOON")) {
-	c->special = SPECIAL_MOON;
-    } else if (!StrCmpi(passthru, "WEEK")) {
-	c->special = SPECIAL_WEEK;
-    } else if (!StrCmpi(passthru, "PSFile")) {
-	c->special = SPECIAL_PSFILE;
-    } else if (!StrCmpi(passthru, "COLOUR") ||
-	       !StrCmpi(passthru, "COLOR")) {
-	c->special = SPECIAL_COLOR;
-    } else if (StrCmpi(passthru, "*")) {
-	c->special = SPECIAL_UNKNOWN;
+    if (StrCmpi(passthru, "*")) {
+	c->special = PassthruToSpecial(passthru);
     }
     return c;
 }
 
 /***************************************************************/
 /*                                                             */
-/*   MAIN PROGRAM                                              */
+/*   Read the binary interchange format (remind -pb).  See     */
+/*   custom.h for the layout.                                  */
 /*                                                             */
 /***************************************************************/
-int main(int argc, char *argv[])
+typedef struct {
+    unsigned char const *pos;
+    unsigned char const *end;
+} BinCursor;
+
+static unsigned char *BinRec = NULL;
+static size_t BinRecSize = 0;
+
+static void
+BinCorrupt(void)
 {
-    /* If stdin is a tty - probably wrong. */
+    fprintf(stderr, "Binary input from REMIND is corrupt!\n");
+    exit(1);
+}
 
-    DynamicBuffer buf;
-    DBufInit(&buf);
-    Init(argc, argv);
+static unsigned long
+BinU32(unsigned char const *p)
+{
+    return ((unsigned long) p[0]) |
+	((unsigned long) p[1] << 8) |
+	((unsigned long) p[2] << 16) |
+	((unsigned long) p[3] << 24);
+}
 
-    if (isatty(0)) {
-	Usage("Input should not come from a terminal");
+/* Read the next record into BinRec; return its type, or EOF at the
+   end of the input */
+static int
+ReadBinRecord(BinCursor *cur)
+{
+    unsigned char hdr[5];
+    size_t n, len;
+
+    n = fread(hdr, 1, sizeof(hdr), stdin);
+    if (n == 0 && feof(stdin)) return EOF;
+    if (n != sizeof(hdr)) BinCorrupt();
+
+    len = BinU32(hdr+1);
+    if (len > BinRecSize) {
+	free(BinRec);
+	BinRec = malloc(len);
+	if (!BinRec) {
+	    fprintf(stderr, "malloc failed - aborting.\n");
+	    exit(1);
+	}
+	BinRecSize = len;
+    }
+    if (len && fread(BinRec, 1, len, stdin) != len) BinCorrupt();
+    cur->pos = BinRec;
+    cur->end = BinRec + len;
+    return hdr[0];
+}
+
+static int
+BinInt(BinCursor *cur)
+{
+    long long v;
+
+    if (cur->end - cur->pos < 4) BinCorrupt();
+    v = BinU32(cur->pos);
+    cur->pos += 4;
+    if (v >= 0x80000000LL) v -= 0x100000000LL;
+    return (int) v;
+}
+
+/* Return a pointer to the next string in the record and set *len
+   to its length.  The string is NOT null-terminated. */
+static char const *
+BinString(BinCursor *cur, size_t *len)
+{
+    char const *s;
+    int n = BinInt(cur);
+
+    if (n < 0 || cur->end - cur->pos < n) BinCorrupt();
+    s = (char const *) cur->pos;
+    cur->pos += n;
+    *len = n;
+    return s;
+}
+
+/* Copy the next string into out, truncating it to max characters */
+static void
+BinStringCopy(BinCursor *cur, char *out, size_t max)
+{
+    size_t len;
+    char const *s = BinString(cur, &len);
+
+    if (len > max) len = max;
+    memcpy(out, s, len);
+    out[len] = 0;
+}
+
+static void
+BinToMonth(BinCursor *cur)
+{
+    int i;
+
+    BinStringCopy(cur, MonthName, sizeof(MonthName)-1);
+    sprintf(YearName, "%d", BinInt(cur));
+    MaxDay = BinInt(cur);
+    FirstWkDay = BinInt(cur);
+    MondayFirst = BinInt(cur);
+    for (i=0; i<7; i++) {
+	BinStringCopy(cur, DayName[i], sizeof(DayName[i])-1);
+    }
+    BinStringCopy(cur, PrevMonthName, sizeof(PrevMonthName)-1);
+    PrevDays = BinInt(cur);
+    BinStringCopy(cur, NextMonthName, sizeof(NextMonthName)-1);
+    NextDays = BinInt(cur);
+
+    if (MaxDay < 1 || MaxDay > 31 || FirstWkDay < 0 || FirstWkDay > 6) {
+	BinCorrupt();
+    }
+}
+
+static CalEntry *
+BinToCalEntry(BinCursor *cur)
+{
+    char passthru[PASSTHRU_LEN+1];
+    char const *body;
+    size_t len;
+
+    CalEntry *c = NEW(CalEntry);
+    if (!c) {
+	fprintf(stderr, "malloc failed - aborting.\n");
+	exit(1);
+    }
+    c->next = NULL;
+    c->daynum = BinInt(cur);
+    if (c->daynum < 1 || c->daynum > MaxDay) BinCorrupt();
+
+    /* Skip the time and duration */
+    (void) BinInt(cur);
+    (void) BinInt(cur);
+
+    BinStringCopy(cur, passthru, PASSTHRU_LEN);
+    if (*passthru) {
+	c->special = PassthruToSpecial(passthru);
+    } else {
+	c->special = SPECIAL_NORMAL;
+    }
+
+    /* Skip the tags */
+    (void) BinString(cur, &len);
+
+    body = BinString(cur, &len);
+    c->entry = malloc(len+1);
+    if (!c->entry) {
+	fprintf(stderr, "malloc failed - aborting.\n");
+	exit(1);
+    }
+    memcpy(c->entry, body, len);
+    c->entry[len] = 0;
+
+    /* The file name and line number that follow aren't needed */
+    return c;
+}
+
+static void
+DoBinaryInput(void)
+{
+    unsigned char hdr[PSBIN_MAGIC_LEN+4];
+    BinCursor cur;
+    int type;
+    int in_month = 0;
+
+    if (fread(hdr, 1, sizeof(hdr), stdin) != sizeof(hdr) ||
+	memcmp(hdr, PSBIN_MAGIC, PSBIN_MAGIC_LEN)) {
+	BinCorrupt();
+    }
+    if (BinU32(hdr+PSBIN_MAGIC_LEN) != PSBIN_VERSION) {
+	fprintf(stderr, "Rem2PS: Binary input is version %lu; I only understand version %d\n",
+		BinU32(hdr+PSBIN_MAGIC_LEN), PSBIN_VERSION);
+	exit(1);
+    }
+
+    while ((type = ReadBinRecord(&cur)) != EOF) {
+	switch(type) {
+	case PSBIN_MONTH:
+	    if (in_month) BinCorrupt();
+	    CountMonth();
+	    BinToMonth(&cur);
+	    StartPsMonth();
+	    in_month = 1;
+	    break;
+
+	case PSBIN_ENTRY:
+	    if (!in_month) BinCorrupt();
+	    AddPsEntry(BinToCalEntry(&cur));
+	    break;
+
+	case PSBIN_END:
+	    if (!in_month) BinCorrupt();
+	    FinishPsMonth();
+	    in_month = 0;
+	    break;
+
+	default:
+	    /* Skip record types added by later versions */
+	    break;
+	}
+    }
+    if (in_month) BinCorrupt();
+}
+
+/***************************************************************/
+/*                                                             */
+/*  DoInput - draw every month in the standard input.          */
+/*                                                             */
+/***************************************************************/
+static void DoInput(void)
+{
+    char const *line;
+    size_t len;
+
+    /* Binary input is recognized by its first byte, which can't
+       start a line of the text formats */
+    int ch = getc(stdin);
+    if (ch != EOF) {
+	ungetc(ch, stdin);
+    }
+    if (ch == (unsigned char) PSBIN_MAGIC[0]) {
+	DoBinaryInput();
     }
 
     int first_line = 1;
     /* Search for a valid input file */
-    while (!feof(stdin)) {
-	DBufGets(&buf, stdin);
-	if (first_line && (!strcmp(DBufValue(&buf), "["))) {
+    while ((line = ReadLine(&len)) != NULL) {
+	if (first_line && (!strcmp(line, "["))) {
 	    fprintf(stderr, "Rem2PS: It appears that you have invoked Remind with the -ppp option.\n        Please use either -p or -pp, but not -ppp.\n");
 	    exit(1);
 	}
 	first_line = 0;
-	if (!strcmp(DBufValue(&buf), PSBEGIN) ||
-	    !strcmp(DBufValue(&buf), PSBEGIN2)) {
-	    if (!validfile) {
-		if (Verbose) {
-		    fprintf(stderr, "Rem2PS: Version %s Copyright 1992-2022 by Dianne Skoll\n\n", VERSION);
-		    fprintf(stderr, "Generating PostScript calendar\n");
-		}
-	    }
-	    validfile++;
+	if (!strcmp(line, PSBEGIN) ||
+	    !strcmp(line, PSBEGIN2)) {
+	    CountMonth();
 	    DoPsCal();
 	}
     }
+}
+
+/***************************************************************/
+/*                                                             */
+/*   MAIN PROGRAM                                              */
+/*                                                             */
+/***************************************************************/
+int main(int argc, char *argv[])
+{
+    int i;
+
+    Init(argc, argv);
+
+    if (!NumInputFiles) {
+	/* If stdin is a tty - probably wrong. */
+	if (isatty(0)) {
+	    Usage("Input should not come from a terminal");
+	}
+	DoInput();
+    }
+
+    /* Each input file's months follow the last file's, so the
+       calendars of many users can go in one document */
+    for (i=0; i<NumInputFiles; i++) {
+	if (!freopen(InputFiles[i], "r", stdin)) {
+	    fprintf(stderr, "Rem2PS: Cannot open `%s'\n", InputFiles[i]);
+	    exit(1);
+	}
+	InStart = InEnd = 0;
+	InEOF = 0;
+	DoInput();
+    }
+
     if (!validfile) {
 	fprintf(stderr, "Rem2PS: Couldn't find any calendar data - are you\n");
 	fprintf(stderr, "        sure you fed me input produced by remind -p ...?\n");
 	exit(1);
     }
-    printf("%%%%Trailer\n");
-    printf("%%%%Pages: %d\n", validfile);
+    if (PdfMode) {
+	if (PdfEnd()) {
+	    fprintf(stderr, "Rem2PS: Error writing PDF output\n");
+	    exit(1);
+	}
+    } else {
+	printf("%%%%Trailer\n");
+	printf("%%%%Pages: %d\n", validfile);
+    }
     if (Verbose) fprintf(stderr, "Rem2PS: Done\n");
     return 0;
 }
@@ -375,33 +760,26 @@ int main(int argc, char *argv[])
 /***************************************************************/
 void DoPsCal(void)
 {
-    char month[40], year[40];
-    char prevm[40], nextm[40];
-    int days, wkday, prevdays, nextdays;
-    int sfirst;
     int i;
-    int firstcol;
-    DynamicBuffer buf;
-    CalEntry *c, *d, *p;
+    char *line;
+    size_t len;
+    CalEntry *c;
     char *s;
 
 /* Read the month and year name, followed by # days in month and 1st day of
    month */
-    DBufInit(&buf);
-    DBufGets(&buf, stdin);
-    sscanf(DBufValue(&buf), "%s %s %d %d %d", month, year, &days, &wkday,
-	   &MondayFirst);
+    sscanf(ReadHeaderLine(), "%39s %39s %d %d %d", MonthName, YearName,
+	   &MaxDay, &FirstWkDay, &MondayFirst);
 
     /* Replace underscores in month name with spaces */
-    s = month;
+    s = MonthName;
     while(*s) {
         if (*s == '_') *s = ' ';
         s++;
     }
 
     /* Get day names */
-    DBufGets(&buf, stdin);
-    sscanf(DBufValue(&buf), "%32s %32s %32s %32s %32s %32s %32s",
+    sscanf(ReadHeaderLine(), "%32s %32s %32s %32s %32s %32s %32s",
 	   DayName[0], DayName[1], DayName[2], DayName[3],
 	   DayName[4], DayName[5], DayName[6]);
 
@@ -414,178 +792,225 @@ void DoPsCal(void)
         }
     }
 
-    /* We write the prolog here because it's only at this point that
-       MondayFirst is set correctly. */
-    if (validfile == 1) {
-	WriteProlog();
-    }
-
-    DBufGets(&buf, stdin);
-    sscanf(DBufValue(&buf), "%s %d", prevm, &prevdays);
-    DBufGets(&buf, stdin);
-    sscanf(DBufValue(&buf), "%s %d", nextm, &nextdays);
+    sscanf(ReadHeaderLine(), "%39s %d", PrevMonthName, &PrevDays);
+    sscanf(ReadHeaderLine(), "%39s %d", NextMonthName, &NextDays);
 
     /* Replace underscores with spaces in names of next/prev month */
-    s = prevm;
+    s = PrevMonthName;
     while(*s) {
         if (*s == '_') *s = ' ';
         s++;
     }
-    s = nextm;
+    s = NextMonthName;
     while(*s) {
         if (*s == '_') *s = ' ';
         s++;
     }
 
-    DBufFree(&buf);
-    MaxDay = days;
-    FirstWkDay = wkday;
+    StartPsMonth();
 
-/* Print a message for the user */
-    if (Verbose) fprintf(stderr, "        %s %s\n", month, year);
+/* Do each entry */
+    while(1) {
+	line = ReadLine(&len);
+	if (!line) {
+	    fprintf(stderr, "Input from REMIND is corrupt!\n");
+	    exit(1);
+	}
 
-    printf("%%%%Page: %c%c%c%c%c %d\n", month[0], month[1], month[2],
-	   year[2], year[3], validfile);
-    printf("%%%%PageBoundingBox: 0 0 %d %d\n", CurPage->xsize, CurPage->ysize);
+	if (!strcmp(line, PSEND) ||
+	    !strcmp(line, PSEND2)) {
+	    break;
+	}
 
-/* Emit PostScript to do the heading */
-    if (!PortraitMode) printf("90 rotate 0 XSIZE neg translate\n");
-    printf("/SAVESTATE save def (%s) (%s) PreCal SAVESTATE restore\n", month, year);
-    printf("(%s %s) doheading\n", month, year);
+	/* Ignore lines beginning with '#' */
+	if (line[0] == '#') {
+	    continue;
+	}
+
+	if (line[0] == '{') {
+	    /* Starts with '{', so assume new-style JSON format */
+	    c = JSONToCalEntry(line, len);
+	} else {
+	    /* Assume it's the old-style rem2ps intermediate format */
+	    c = TextToCalEntry(line);
+	}
+	AddPsEntry(c);
+    }
+
+    FinishPsMonth();
+}
+
+/***************************************************************/
+/*                                                             */
+/*  StartPsMonth - emit the PostScript that starts a month,    */
+/*  once its header has been read.                             */
+/*                                                             */
+/***************************************************************/
+static void StartPsMonth(void)
+{
+    int firstcol, rows;
+
+    /* We write the prolog here because it's only at this point that
+       MondayFirst is set correctly. */
+    if (validfile == 1) {
+	if (PdfMode) PdfBegin(stdout);
+	else         WriteProlog();
+    }
+
+/* Print a message for the user */
+    if (Verbose) fprintf(stderr, "        %s %s\n", MonthName, YearName);
 
 /* Figure out the column of the first day in the calendar */
 
     if (MondayFirst) {
-	firstcol = wkday-1;
+	firstcol = FirstWkDay-1;
 	if (firstcol < 0) firstcol = 6;
     } else {
-	firstcol = wkday;
+	firstcol = FirstWkDay;
     }
 
-/* Calculate the minimum box size */
+/* Figure out how many rows the minimum box size allows for */
     if (!FillPage) {
-	printf("/MinBoxSize ytop MinY sub 7 div def\n");
+	rows = 7;
     } else {
-	if ((days == 31 && firstcol >= 5) || (days == 30 && firstcol == 6))
-	    printf("/MinBoxSize ytop MinY sub 6 div def\n");
-	else if (days == 28 && firstcol == 0 && NoSmallCal)
-	    printf("/MinBoxSize ytop MinY sub 4 div def\n");
+	if ((MaxDay == 31 && firstcol >= 5) || (MaxDay == 30 && firstcol == 6))
+	    rows = 6;
+	else if (MaxDay == 28 && firstcol == 0 && NoSmallCal)
+	    rows = 4;
 	else
-	    printf("/MinBoxSize ytop MinY sub 5 div def\n");
+	    rows = 5;
     }
 
-    printf("/ysmalltop ytop def\n");
-
-/* Do each entry */
-
     CurEntries = NULL;
     CurDay = 1;
-    WkDayNum = wkday;
+    WkDayNum = FirstWkDay;
 
-    while(1) {
-	if (feof(stdin)) {
-	    fprintf(stderr, "Input from REMIND is corrupt!\n");
-	    exit(1);
-	}
+    if (PdfMode) {
+	StartPdfPage();
+	MinBoxSize = (YTop - MinY) / rows;
+	YSmallTop = YTop;
+	return;
+    }
 
-	DBufGets(&buf, stdin);
-	if (!strcmp(DBufValue(&buf), PSEND) ||
-	    !strcmp(DBufValue(&buf), PSEND2)) {
-	    DBufFree(&buf);
-	    break;
-	}
+    printf("%%%%Page: %c%c%c%c%c %d\n", MonthName[0], MonthName[1], MonthName[2],
+	   YearName[2], YearName[3], validfile);
+    printf("%%%%PageBoundingBox: 0 0 %d %d\n", CurPage->xsize, CurPage->ysize);
 
-	/* Ignore lines beginning with '#' */
-	if (DBufValue(&buf)[0] == '#') {
-	    DBufFree(&buf);
-	    continue;
-	}
+/* Emit PostScript to do the heading */
+    if (!PortraitMode) printf("90 rotate 0 XSIZE neg translate\n");
+    printf("/SAVESTATE save def (%s) (%s) PreCal SAVESTATE restore\n", MonthName, YearName);
+    printf("(%s %s) doheading\n", MonthName, YearName);
 
-	if (DBufValue(&buf)[0] == '{') {
-	    /* Starts with '{', so assume new-style JSON format */
-	    c = JSONToCalEntry(&buf);
-	} else {
-	    /* Assume it's the old-style rem2ps intermediate format */
-	    c = TextToCalEntry(&buf);
-	}
+/* Calculate the minimum box size */
+    printf("/MinBoxSize ytop MinY sub %d div def\n", rows);
 
-	/* If it's an unknown special, ignore */
-	if (c->special == SPECIAL_UNKNOWN) {
-	    DBufFree(&buf);
-	    free(c);
-	    c = NULL;
-	    continue;
+    printf("/ysmalltop ytop def\n");
+}
+
+/***************************************************************/
+/*                                                             */
+/*  AddPsEntry - add an entry to the month being drawn.        */
+/*  Entries must arrive in order of day.                       */
+/*                                                             */
+/***************************************************************/
+static void AddPsEntry(CalEntry *c)
+{
+    CalEntry *d, *p;
+
+    /* If it's an unknown special, ignore */
+    if (c->special == SPECIAL_UNKNOWN) {
+	free(c->entry);
+	free(c);
+	return;
+    }
+    if (c->daynum != CurDay) {
+	for(; CurDay<c->daynum; CurDay++) {
+	    WriteCalEntry();
+	    WkDayNum = (WkDayNum + 1) % 7;
 	}
-	if (c->daynum != CurDay) {
-	    for(; CurDay<c->daynum; CurDay++) {
-		WriteCalEntry();
-		WkDayNum = (WkDayNum + 1) % 7;
+    }
+    if (c->special == SPECIAL_POSTSCRIPT ||
+	c->special == SPECIAL_SHADE ||
+	c->special == SPECIAL_MOON ||
+	c->special == SPECIAL_WEEK ||
+	c->special == SPECIAL_PSFILE) {
+	if (!PsEntries[c->daynum]) {
+	    PsEntries[c->daynum] = c;
+	} else {
+	    d = PsEntries[c->daynum];
+	    p = NULL;
+	    /* Slot it into the right place */
+	    while (d->next && (SpecialSortOrder[c->special] <= SpecialSortOrder[d->special])) {
+		p = d;
+		d = d->next;
 	    }
-	}
-	if (c->special == SPECIAL_POSTSCRIPT ||
-	    c->special == SPECIAL_SHADE ||
-	    c->special == SPECIAL_MOON ||
-	    c->special == SPECIAL_WEEK ||
-	    c->special == SPECIAL_PSFILE) {
-	    if (!PsEntries[c->daynum]) {
-		PsEntries[c->daynum] = c;
+	    if (SpecialSortOrder[c->special] <= SpecialSortOrder[d->special]) {
+		c->next = d->next;
+		d->next = c;
 	    } else {
-		d = PsEntries[c->daynum];
-		p = NULL;
-		/* Slot it into the right place */
-		while (d->next && (SpecialSortOrder[c->special] <= SpecialSortOrder[d->special])) {
-		    p = d;
-		    d = d->next;
-		}
-		if (SpecialSortOrder[c->special] <= SpecialSortOrder[d->special]) {
-		    c->next = d->next;
-		    d->next = c;
+		if (p) {
+		    p->next = c;
 		} else {
-		    if (p) {
-			p->next = c;
-		    } else {
-			PsEntries[c->daynum] = c;
-		    }
-		    c->next = d;
+		    PsEntries[c->daynum] = c;
 		}
+		c->next = d;
 	    }
+	}
+    } else {
+	/* Put on linked list */
+	if (!CurEntries) {
+	    CurEntries = c;
 	} else {
-	    /* Put on linked list */
-	    if (!CurEntries) {
-		CurEntries = c;
-	    } else {
-		d = CurEntries;
-		while(d->next) d = d->next;
-		d->next = c;
-	    }
+	    d = CurEntries;
+	    while(d->next) d = d->next;
+	    d->next = c;
 	}
     }
-    for(; CurDay<=days; CurDay++) {
+}
+
+/***************************************************************/
+/*                                                             */
+/*  FinishPsMonth - write out the remaining days and the       */
+/*  small calendars once all entries have been added.          */
+/*                                                             */
+/***************************************************************/
+static void FinishPsMonth(void)
+{
+    int sfirst;
+    int i;
+
+    for(; CurDay<=MaxDay; CurDay++) {
 	WriteCalEntry();
 	WkDayNum = (WkDayNum + 1) % 7;
     }
 
 /* If wkday < 2, set ysmall.  If necessary (only for feb) increase cal size. */
-    printf("/ysmallbot ylast def\n");
+    if (PdfMode) YSmallBot = YLast;
+    else         printf("/ysmallbot ylast def\n");
 
 /* Now draw the vertical lines */
     GetSmallLocations();
     for (i=0; i<=7; i++) {
-	printf("%d xincr mul MinX add ymin %d xincr mul MinX add topy L\n",
-	       i, i);
+	if (PdfMode) {
+	    PdfLine(i*XIncr + MinX, YMin, i*XIncr + MinX, TopY);
+	} else {
+	    printf("%d xincr mul MinX add ymin %d xincr mul MinX add topy L\n",
+		   i, i);
+	}
     }
 
 /* print the small calendars */
     if (!NoSmallCal) {
-	sfirst = wkday - (prevdays % 7);
+	sfirst = FirstWkDay - (PrevDays % 7);
 	if (sfirst < 0) sfirst += 7;
-	DoSmallCal(prevm, prevdays, sfirst, SmallCol1, 1);
-	sfirst = wkday + (days % 7);
+	DoSmallCal(PrevMonthName, PrevDays, sfirst, SmallCol1, 1);
+	sfirst = FirstWkDay + (MaxDay % 7);
 	if (sfirst >6) sfirst -= 7;
-	DoSmallCal(nextm, nextdays, sfirst, SmallCol2, 2);
+	DoSmallCal(NextMonthName, NextDays, sfirst, SmallCol2, 2);
     }
 /* Do it! */
-    printf("showpage\n");
+    if (PdfMode) PdfEndPage();
+    else         printf("showpage\n");
 }
 
 /***************************************************************/
@@ -706,6 +1131,17 @@ void WriteCalEntry(void)
     CalEntry *d;
     int begin, end, i, HadQPS;
 
+/* For PDF, keep the entries until the row is drawn */
+    if (PdfMode) {
+	DayEntries[CurDay] = CurEntries;
+	CurEntries = NULL;
+	if ((!MondayFirst && WkDayNum == 6) ||
+	    (MondayFirst && WkDayNum == 0) || CurDay == MaxDay) {
+	    DrawPdfRow();
+	}
+	return;
+    }
+
 /* Move to appropriate location */
     printf("/CAL%d {\n", CurDay);
     if (!MondayFirst)
@@ -878,7 +1314,13 @@ void Init(int argc, char *argv[])
 	s = argv[i];
 	i++;
 
-	if (*s++ != '-') Usage("Options must begin with `-'");
+	/* Anything after the options is an input file */
+	if (*s != '-') {
+	    InputFiles = argv + i - 1;
+	    NumInputFiles = argc - i + 1;
+	    break;
+	}
+	s++;
 
 	switch(*s++) {
 
@@ -1001,9 +1443,28 @@ void Init(int argc, char *argv[])
 
 	case 'e': FillPage = 1; break;
 
+	case 'P': PdfMode = 1; break;
+
 	default: Usage("Unrecognized option");
 	}
     }
+
+    if (PdfMode) {
+	if (UserProlog) {
+	    fprintf(stderr, "Rem2PS: -p is ignored with -P\n");
+	}
+	TitleF = PdfFont(TitleFont);
+	HeadF = PdfFont(HeadFont);
+	DayF = PdfFont(DayFont);
+	EntryF = PdfFont(EntryFont);
+	SmallF = PdfFont(SmallFont);
+	TitleSz = atof(TitleSize);
+	HeadSz = atof(HeadSize);
+	DaySz = atof(DaySize);
+	EntrySz = atof(EntrySize);
+	Border = atof(BorderSize);
+	LineW = atof(LineWidth);
+    }
 }
 
 /***************************************************************/
@@ -1015,10 +1476,11 @@ void Usage(char const *s)
 {
     if (s) fprintf(stderr, "Rem2PS: %s\n\n", s);
 
-    fprintf(stderr, "Rem2PS: Produce a PostScript calendar from output of Remind.\n\n");
-    fprintf(stderr, "Usage: rem2ps [options]\n\n");
+    fprintf(stderr, "Rem2PS: Produce a PostScript or PDF calendar from output of Remind.\n\n");
+    fprintf(stderr, "Usage: rem2ps [options] [file...]\n\n");
     fprintf(stderr, "Options:\n\n");
     fprintf(stderr, "-v            Print progress messages to standard error\n");
+    fprintf(stderr, "-P            Produce PDF instead of PostScript\n");
     fprintf(stderr, "-p file       Include user-supplied PostScript code in prologue\n");
     fprintf(stderr, "-l            Do calendar in landscape mode\n");
     fprintf(stderr, "-c[n]         Control small calendars: 0=none; 1=bt; 2=tb; 3=sbt\n");
@@ -1051,6 +1513,10 @@ void DoSmallCal(char const *m, int days, int first, int col, int which)
 	first--;
 	if (first < 0) first = 6;
     }
+    if (PdfMode) {
+	DoSmallPdf(m, days, first, col, which);
+	return;
+    }
     /* Figure out the font size */
 
     printf("/SmallFontSize MinBoxSize Border sub Border sub 8 div 2 sub def\n");
@@ -1323,15 +1789,23 @@ void GetSmallLocations(void)
 	case 'b':
 	    /* Adjust Feb. if we want it on the bottom */
 	    if (MaxDay == 28 && colfirst == 0) {
-		printf("/ysmallbot ymin def /ymin ysmallbot MinBoxSize sub def\n");
-		printf("MinX ymin MaxX ymin L\n");
-		printf("/ysmall1 ysmallbot def /ysmall2 ysmallbot def\n");
+		if (PdfMode) {
+		    YSmallBot = YMin;
+		    YMin = YSmallBot - MinBoxSize;
+		    PdfLine(MinX, YMin, MaxX, YMin);
+		    YSmall1 = YSmall2 = YSmallBot;
+		} else {
+		    printf("/ysmallbot ymin def /ymin ysmallbot MinBoxSize sub def\n");
+		    printf("MinX ymin MaxX ymin L\n");
+		    printf("/ysmall1 ysmallbot def /ysmall2 ysmallbot def\n");
+		}
 		SmallCol1 = 5;
 		SmallCol2 = 6;
 		return;
 	    }
 	    if (collast <= 4) {
-		printf("/ysmall1 ysmallbot def /ysmall2 ysmallbot def\n");
+		if (PdfMode) YSmall1 = YSmall2 = YSmallBot;
+		else printf("/ysmall1 ysmallbot def /ysmall2 ysmallbot def\n");
 		SmallCol1 = 5;
 		SmallCol2 = 6;
 		return;
@@ -1340,7 +1814,8 @@ void GetSmallLocations(void)
 
 	case 't':
 	    if (colfirst >= 2) {
-		printf("/ysmall1 ysmalltop def /ysmall2 ysmalltop def\n");
+		if (PdfMode) YSmall1 = YSmall2 = YSmallTop;
+		else printf("/ysmall1 ysmalltop def /ysmall2 ysmalltop def\n");
 		SmallCol1 = 0;
 		SmallCol2 = 1;
 		return;
@@ -1349,7 +1824,12 @@ void GetSmallLocations(void)
 
 	case 's':
 	    if (colfirst >= 1 && collast<=5) {
-		printf("/ysmall1 ysmalltop def /ysmall2 ysmallbot def\n");
+		if (PdfMode) {
+		    YSmall1 = YSmallTop;
+		    YSmall2 = YSmallBot;
+		} else {
+		    printf("/ysmall1 ysmalltop def /ysmall2 ysmallbot def\n");
+		}
 		SmallCol1 = 0;
 		SmallCol2 = 6;
 		return;
@@ -1386,3 +1866,419 @@ char const *EatToken(char const *in, char *out, int maxlen)
     if (out) *out = 0;
     return in;
 }
+
+/***************************************************************/
+/*                                                             */
+/* StartPdfPage                                                */
+/*                                                             */
+/* Start a month's page and draw its heading, as the           */
+/* prologue's doheading does.                                  */
+/*                                                             */
+/***************************************************************/
+static void StartPdfPage(void)
+{
+    double x = CurPage->xsize;
+    double y = CurPage->ysize;
+    double w;
+    char *s;
+    int i, j;
+    char title[sizeof(MonthName) + sizeof(YearName) + 1];
+
+    if (!PortraitMode) {
+	w = x; x = y; y = w;
+    }
+    MinX = LeftMarg;
+    MinY = BotMarg;
+    MaxX = x - RightMarg;
+    MaxY = y - TopMarg;
+
+    PdfStartPage(x, y);
+    PdfPrintf("%g w 2 J\n", LineW);
+
+    /* The title, centred, with a line below its lowest point */
+    sprintf(title, "%s %s", MonthName, YearName);
+    s = PdfEncode(title);
+    w = PdfStringWidth(TitleF, s, strlen(s), TitleSz);
+    y = MaxY - Border - TitleSz;
+    PdfText(TitleF, TitleSz, (MaxX + MinX) / 2 - w / 2, y, s, strlen(s));
+    y -= PdfDescent(s) * TitleSz + Border;
+    free(s);
+    PdfLine(MinX, y, MaxX, y);
+    TopY = y;
+
+    /* The days of the week, each centred in its column */
+    XIncr = (MaxX - MinX) / 7;
+    for (i=0; i<7; i++) {
+	j = MondayFirst ? (i+1) % 7 : i;
+	s = PdfEncode(DayName[j]);
+	w = PdfStringWidth(HeadF, s, strlen(s), HeadSz);
+	PdfText(HeadF, HeadSz, MinX + i*XIncr + XIncr / 2 - w / 2,
+		y - HeadSz - HeadSz / 2, s, strlen(s));
+	free(s);
+    }
+    y -= HeadSz * 2;
+    PdfLine(MinX, y, MaxX, y);
+    YTop = YMin = y;
+}
+
+/***************************************************************/
+/*                                                             */
+/* PdfFillBox                                                  */
+/*                                                             */
+/* Fill a box with the words of an entry, as the prologue's    */
+/* FillBoxWithText does:  words are added to a line until the  */
+/* next one doesn't fit, and a word too wide for a line of its */
+/* own is chopped.  Lines are drawn only if draw is non-zero.  */
+/* Returns the new y.                                          */
+/*                                                             */
+/***************************************************************/
+static double PdfFillBox(CalEntry *c, double xleft, double width,
+			 double yincr, double y, int draw)
+{
+    char const *s = c->entry;
+    char *text, *t, *u;
+    size_t ls, ws, we, n;
+    int i, r, g, b, colored = 0;
+
+    /* Chew up leading spaces */
+    while(isspace((unsigned char) *s)) s++;
+
+    /* Skip three decimal numbers for COLOR special */
+    if (c->special == SPECIAL_COLOR) {
+	for (i=0; i<3; i++) {
+	    while(*s && !isspace((unsigned char) *s)) s++;
+	    while(*s && isspace((unsigned char) *s)) s++;
+	}
+	if (draw && sscanf(c->entry, "%d %d %d", &r, &g, &b) == 3) {
+	    if (r < 0) r = 0;
+	    else if (r > 255) r = 255;
+	    if (g < 0) g = 0;
+	    else if (g > 255) g = 255;
+	    if (b < 0) b = 0;
+	    else if (b > 255) b = 255;
+	    PdfPrintf("q %.3f %.3f %.3f rg\n", r / 255.0, g / 255.0, b / 255.0);
+	    colored = 1;
+	}
+    }
+
+    /* Words are separated by single spaces, so the line being
+       filled is always text[ls] up to the word being added */
+    text = PdfEncode(s);
+    for (t = u = text; *t; t++) {
+	if (!isspace((unsigned char) *t)) {
+	    *u++ = *t;
+	} else if (u > text && u[-1] != ' ') {
+	    *u++ = ' ';
+	}
+    }
+    if (u > text && u[-1] == ' ') u--;
+    *u = 0;
+
+    ls = ws = 0;
+    while (text[ws]) {
+	for (we = ws; text[we] && text[we] != ' '; we++);
+	while (1) {
+	    if (PdfStringWidth(EntryF, text+ls, we-ls, EntrySz) <= width) {
+		/* It fits; the line now includes the word and a space */
+		ws = text[we] ? we+1 : we;
+		break;
+	    }
+	    if (ls < ws) {
+		/* Start a new line with the word */
+		if (draw) PdfText(EntryF, EntrySz, xleft, y, text+ls, ws-ls-1);
+		y += yincr;
+		ls = ws;
+		continue;
+	    }
+	    /* Draw as much of the word as fits on a line of its own */
+	    n = we - ws - 1;
+	    while (n > 1 && PdfStringWidth(EntryF, text+ws, n, EntrySz) > width) n--;
+	    if (!n) n = 1;
+	    if (draw) PdfText(EntryF, EntrySz, xleft, y, text+ws, n);
+	    y += yincr;
+	    ws += n;
+	    ls = ws;
+	    if (ws == we) {
+		if (text[ws]) ls = ++ws;
+		break;
+	    }
+	}
+    }
+    if (ls < ws) {
+	n = text[ws-1] == ' ' ? ws-ls-1 : ws-ls;
+	if (draw) PdfText(EntryF, EntrySz, xleft, y, text+ls, n);
+	y += yincr;
+    }
+    free(text);
+
+    if (colored) PdfPrintf("Q\n");
+    return y;
+}
+
+/***************************************************************/
+/*                                                             */
+/* PdfCalBox                                                   */
+/*                                                             */
+/* Do the day number and entries of one calendar box whose     */
+/* top left corner is (xl, yt), as the prologue's DoCalBox     */
+/* does.  Returns the lowest y reached.                        */
+/*                                                             */
+/***************************************************************/
+static double PdfCalBox(double xl, double yt, int day, int draw)
+{
+    char num[16];
+    int n;
+    double x, y;
+    CalEntry *e;
+
+    if (draw) {
+	n = sprintf(num, "%d", day);
+	if (DaynumRight) {
+	    x = xl + XIncr - Border - PdfStringWidth(DayF, num, n, DaySz);
+	} else {
+	    x = xl + Border;
+	}
+	PdfText(DayF, DaySz, x, yt - Border - DaySz, num, n);
+    }
+
+    y = yt - Border - DaySz - DaySz + 2;
+    for (e = DayEntries[day]; e; e = e->next) {
+	y -= 2;
+	y = PdfFillBox(e, xl + Border, XIncr - Border - Border,
+		       -(EntrySz + 2), y, draw);
+    }
+    return y;
+}
+
+/***************************************************************/
+/*                                                             */
+/* DoQueuedPdf                                                 */
+/*                                                             */
+/* Draw the SHADE, MOON and WEEK specials of the row just laid */
+/* out, whose boxes run from YTop up to YLast.  There is no    */
+/* PostScript interpreter to run PS and PSFILE specials, so    */
+/* they are left out.                                          */
+/*                                                             */
+/***************************************************************/
+static void DoQueuedPdf(void)
+{
+    static int warned = 0;
+    int i, j, wd, begin, num, r, g, b, phase, moonsize, fontsize;
+    double x0, h, a, size, fsize, mx, my;
+    char const *s, *extra;
+    char *text = NULL;
+    CalEntry *e, *n;
+
+    if (!MondayFirst) begin = CurDay - WkDayNum;
+    else		     begin = CurDay - (WkDayNum ? WkDayNum-1 : 6);
+    wd = 0;
+    while (begin < 1) begin++, wd++;
+    h = YLast - YTop;
+    for (i=begin; i<=CurDay; i++, wd++) {
+	x0 = wd*XIncr + MinX;
+	for (e = PsEntries[i]; e; e = n) {
+	    s = e->entry;
+	    while (isspace((unsigned char) *s)) s++;
+	    switch(e->special) {
+	    case SPECIAL_POSTSCRIPT:
+	    case SPECIAL_PSFILE:
+		if (!warned) {
+		    fprintf(stderr, "Rem2PS: PS and PSFILE specials are ignored in PDF output\n");
+		    warned = 1;
+		}
+		break;
+
+	    case SPECIAL_SHADE:
+		num = sscanf(s, "%d %d %d", &r, &g, &b);
+		if (num == 1) {
+		    g = r;
+		    b = r;
+		} else if (num != 3) {
+		    fprintf(stderr, "Rem2PS: Malformed SHADE special\n");
+		    break;
+		}
+		if (r < 0 || r > 255 ||
+		    g < 0 || g > 255 ||
+		    b < 0 || b > 255) {
+		    fprintf(stderr, "Rem2PS: Illegal values for SHADE\n");
+		    break;
+		}
+		a = LineW / 2;
+		PdfPrintf("%.3f %.3f %.3f rg %.2f %.2f %.2f %.2f re f 0 g\n",
+			  r/255.0, g/255.0, b/255.0,
+			  x0 + a, YTop + a, XIncr - a - a, h - a - a);
+		break;
+
+	    case SPECIAL_WEEK:
+		text = PdfEncode(s);
+		PdfText(EntryF, EntrySz / 1.2, x0 + Border, YTop + Border / 2,
+			text, strlen(text));
+		break;
+
+	    case SPECIAL_MOON:
+		num = sscanf(s, "%d %d %d", &phase, &moonsize, &fontsize);
+		/* Skip the phase, moon size and font size */
+		extra = s;
+		for (j=0; j<3; j++) {
+		    while(*extra && !isspace((unsigned char) *extra)) extra++;
+		    while(*extra && isspace((unsigned char) *extra)) extra++;
+		}
+		if (num == 1) {
+		    moonsize = -1;
+		    fontsize = -1;
+		} else if (num == 2) {
+		    fontsize = -1;
+		} else if (num != 3) {
+		    fprintf(stderr, "Rem2PS: Badly formed MOON special\n");
+		    break;
+		}
+		if (phase < 0 || phase > 3) {
+		    fprintf(stderr, "Rem2PS: Illegal MOON phase %d\n",
+			    phase);
+		    break;
+		}
+		size = (moonsize < 0) ? DaySz / 2 : moonsize;
+		fsize = (fontsize < 0) ? EntrySz : fontsize;
+		text = PdfEncode(extra);
+
+		/* Opposite the day number, leaving room for the text */
+		if (DaynumRight) {
+		    mx = x0 + Border + size;
+		} else {
+		    mx = x0 + XIncr - Border - size;
+		    if (*text) {
+			mx -= PdfStringWidth(EntryF, text, strlen(text), fsize)
+			    + Border;
+		    }
+		}
+		my = YTop + h - Border - size;
+		PdfPrintf("q 0 g 0 G\n");
+		PdfCircle(mx, my, size, 0);
+		switch(phase) {
+		case 0:
+		    PdfPrintf("f\n");
+		    break;
+		case 2:
+		    PdfPrintf("S\n");
+		    break;
+		default:
+		    PdfPrintf("S\n");
+		    PdfCircle(mx, my, size, phase == 1 ? 1 : 2);
+		    PdfPrintf("f\n");
+		    break;
+		}
+		if (*text) {
+		    PdfText(EntryF, fsize, mx + size + Border,
+			    my - size, text, strlen(text));
+		}
+		PdfPrintf("Q\n");
+		break;
+	    }
+	    free(text);
+	    text = NULL;
+
+/* Free the entry */
+	    free(e->entry);
+	    n = e->next;
+	    free(e);
+	}
+	PsEntries[i] = NULL;
+    }
+}
+
+/***************************************************************/
+/*                                                             */
+/* DrawPdfRow                                                  */
+/*                                                             */
+/* Draw the row of the calendar that ends with CurDay.  It is  */
+/* laid out first to find how tall it is, so the specials can  */
+/* be drawn under its text.                                    */
+/*                                                             */
+/***************************************************************/
+static void DrawPdfRow(void)
+{
+    int col = MondayFirst ? (WkDayNum ? WkDayNum-1 : 6) : WkDayNum;
+    int begin = CurDay - col;
+    int i;
+    double y;
+    CalEntry *c, *d;
+
+    if (begin < 1) begin = 1;
+    for (i=begin; i<=CurDay; i++) {
+	y = PdfCalBox((col - CurDay + i) * XIncr + MinX, YTop, i, 0);
+	if (y < YMin) YMin = y;
+    }
+    y = YTop - MinBoxSize;
+    if (y < YMin) YMin = y;
+    YLast = YTop;
+    YTop = YMin;
+
+    DoQueuedPdf();
+
+    for (i=begin; i<=CurDay; i++) {
+	PdfCalBox((col - CurDay + i) * XIncr + MinX, YLast, i, 1);
+	for (c = DayEntries[i]; c; c = d) {
+	    d = c->next;
+	    free(c->entry);
+	    free(c);
+	}
+	DayEntries[i] = NULL;
+    }
+
+/* Draw the line at the bottom of the row */
+    PdfLine(MinX, YMin, MaxX, YMin);
+}
+
+/***************************************************************/
+/*                                                             */
+/* DoSmallPdf                                                  */
+/*                                                             */
+/* Draw the small calendar for the previous or next month.     */
+/* first is the column of its first day.                       */
+/*                                                             */
+/***************************************************************/
+static void DoSmallPdf(char const *m, int days, int first, int col, int which)
+{
+    char const *sample = PdfFixedPitch(SmallF) ? "WW " : "WW";
+    double size, sw, tmp, x0, y0;
+    char num[16];
+    char *s;
+    int i, j, n;
+    int row = 2;
+
+    /* Figure out the font size */
+    size = (MinBoxSize - Border - Border) / 8 - 2;
+    sw = PdfStringWidth(SmallF, sample, strlen(sample), 1.0);
+    tmp = (XIncr - Border - Border) / (sw * 7);
+    if (tmp < size) size = tmp;
+    sw *= size;
+
+    /* The upper-left hand corner of the box */
+    x0 = col*XIncr + MinX + Border;
+    y0 = (which == 1 ? YSmall1 : YSmall2) - Border;
+
+    /* Print the month */
+    s = PdfEncode(m);
+    PdfText(SmallF, size,
+	    x0 + (sw * 7 - PdfStringWidth(SmallF, s, strlen(s), size)) / 2,
+	    y0 - size, s, strlen(s));
+    free(s);
+
+    /* Print the days of the week */
+    for (i=0; i<7; i++) {
+	if (MondayFirst) j=(i+1)%7;
+	else             j=i;
+	s = PdfEncode(DayName[j]);
+	PdfText(SmallF, size, x0 + i*sw, y0 - size - size - 2, s, *s ? 1 : 0);
+	free(s);
+    }
+
+    /* Now do the days of the month */
+    for (i=1; i<=days; i++) {
+	n = sprintf(num, "%d", i);
+	PdfText(SmallF, size, x0 + first*sw, y0 - size - (size + 2)*row,
+		num, n);
+	first++;
+	if (first == 7) { first = 0; row++; }
+    }
+}
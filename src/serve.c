@@ -0,0 +1,892 @@
+/***************************************************************/
+/*                                                             */
+/*  SERVE.C                                                    */
+/*                                                             */
+/*  The query server started by --serve=path.  It keeps named  */
+/*  sets of reminder files loaded, each with its own           */
+/*  interpreter, and answers agenda, month, next and eval      */
+/*  requests from clients on a Unix-domain socket.  The        */
+/*  reminders found on each day are cached until one of the    */
+/*  files changes on disk.                                     */
+/*                                                             */
+/*  This file is part of REMIND.                               */
+/*  Copyright (C) 1992-2022 by Dianne Skoll                    */
+/*                                                             */
+/***************************************************************/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/select.h>
+
+#include "types.h"
+#include "protos.h"
+#include "globals.h"
+#include "err.h"
+#include "json.h"
+#include "libremind.h"
+
+/* The server is part of the program, not the library */
+#ifndef LIBREMIND
+
+/* Size of the day cache's hash table, and the number of days it
+   may hold before it is emptied and starts again */
+#define DAY_HASH_SIZE 1021
+#define MAX_CACHED_DAYS 20000
+
+/* The longest range of days a single request may cover */
+#define MAX_SERVE_DAYS 3660
+
+/* A named set of reminder files and the interpreter running it */
+typedef struct file_set {
+    struct file_set *next;
+    char *name;
+    char *path;
+    RemHandle *h;
+    int today;			/* Date set with rem_set_date, or NO_DATE */
+    int time_format;		/* Options currently in effect */
+    int no_timed;
+    int advance;
+    LangTable const *lang;
+} FileSet;
+
+/* The reminders one file set yields on one day, as JSON */
+typedef struct cached_day {
+    struct cached_day *next;
+    char *key;
+    char *entries;		/* Comma-separated JSON objects */
+    char *errors;		/* Error messages produced */
+    size_t *ends;		/* Where each entry ends in entries */
+    int num;			/* Number of entries */
+} CachedDay;
+
+static FileSet *FileSets = NULL;
+static CachedDay *DayCache[DAY_HASH_SIZE];
+static int NumCachedDays = 0;
+static unsigned long CacheHits = 0;
+static unsigned long CacheMisses = 0;
+static FILE *ServeErrFp = NULL;
+static int Exiting = 0;
+
+/***************************************************************/
+/*                                                             */
+/*  JSONMember                                                 */
+/*                                                             */
+/*  Return the member called name of a JSON object, or NULL.   */
+/*                                                             */
+/***************************************************************/
+static json_value const *
+JSONMember(json_value const *obj, char const *name)
+{
+    unsigned int i;
+    if (!obj || obj->type != json_object) return NULL;
+    for (i=0; i<obj->u.object.length; i++) {
+	if (!strcmp(obj->u.object.values[i].name, name)) {
+	    return obj->u.object.values[i].value;
+	}
+    }
+    return NULL;
+}
+
+/* Return an integer or boolean member, or def if it is absent */
+static int
+JSONInt(json_value const *obj, char const *name, int def)
+{
+    json_value const *v = JSONMember(obj, name);
+    if (!v) return def;
+    if (v->type == json_integer) return (int) v->u.integer;
+    if (v->type == json_boolean) return v->u.boolean ? 1 : 0;
+    return def;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  Reply                                                      */
+/*                                                             */
+/*  Send a response to a client; client -1 is standard output, */
+/*  used when requests come from standard input.               */
+/*                                                             */
+/***************************************************************/
+static void Reply(int client, char const *s)
+{
+    if (client < 0) {
+	fputs(s, stdout);
+	fflush(stdout);
+    } else {
+	ServerSend(client, s);
+    }
+}
+
+static void
+ServeError(int client, char const *msg)
+{
+    DynamicBuffer buf;
+    DBufInit(&buf);
+    DBufPuts(&buf, "{\"response\":\"error\",\"error\":\"");
+    DBufPutJSONString(&buf, msg);
+    DBufPuts(&buf, "\"}\n");
+    Reply(client, DBufValue(&buf));
+    DBufFree(&buf);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  BeginErrors / EndErrors                                    */
+/*                                                             */
+/*  Collect the error messages the interpreters produce while  */
+/*  answering a request.                                       */
+/*                                                             */
+/***************************************************************/
+static void BeginErrors(void)
+{
+    fflush(ServeErrFp);
+    rewind(ServeErrFp);
+    (void) ftruncate(fileno(ServeErrFp), 0);
+}
+
+static void EndErrors(DynamicBuffer *errs)
+{
+    int c;
+    fflush(ServeErrFp);
+    rewind(ServeErrFp);
+    while ((c = getc(ServeErrFp)) != EOF) {
+	DBufPutc(errs, (char) c);
+    }
+}
+
+/***************************************************************/
+/*                                                             */
+/*  FlushDayCache                                              */
+/*                                                             */
+/*  Forget the cached days of the file set called name, or of  */
+/*  every file set if name is NULL.                            */
+/*                                                             */
+/***************************************************************/
+static void FlushDayCache(char const *name)
+{
+    CachedDay *d, **prev;
+    size_t l = name ? strlen(name) : 0;
+    int i;
+
+    for (i=0; i<DAY_HASH_SIZE; i++) {
+	prev = &DayCache[i];
+	while ((d = *prev) != NULL) {
+	    if (name && (strncmp(d->key, name, l) || d->key[l] != '\n')) {
+		prev = &d->next;
+		continue;
+	    }
+	    *prev = d->next;
+	    free(d->key);
+	    free(d->entries);
+	    free(d->errors);
+	    free(d->ends);
+	    free(d);
+	    NumCachedDays--;
+	}
+    }
+}
+
+static unsigned int DayHash(char const *key)
+{
+    unsigned int h = 0;
+    while (*key) h = h*31 + (unsigned char) *key++;
+    return h % DAY_HASH_SIZE;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  ForgetFiles                                                */
+/*                                                             */
+/*  Forget the cached files and days so that everything is     */
+/*  read afresh.                                               */
+/*                                                             */
+/***************************************************************/
+static void ForgetFiles(void)
+{
+    FileSet *fs;
+
+    ClearFileCache();
+    FlushDayCache(NULL);
+    for (fs = FileSets; fs; fs = fs->next) {
+	/* Makes the next rem_eval run the new files */
+	fs->today = NO_DATE;
+    }
+}
+
+/* Forget everything if any file we have read has changed */
+static void CheckFiles(void)
+{
+    if (FileCacheStale()) ForgetFiles();
+}
+
+/***************************************************************/
+/*                                                             */
+/*  FindFileSet / LoadFileSet                                  */
+/*                                                             */
+/*  Look up a file set by name; create or replace one.         */
+/*                                                             */
+/***************************************************************/
+static FileSet *FindFileSet(char const *name)
+{
+    FileSet *fs;
+    for (fs = FileSets; fs; fs = fs->next) {
+	if (!strcmp(fs->name, name)) return fs;
+    }
+    return NULL;
+}
+
+/* Set the language of a file set's interpreter */
+static int SetFileSetLanguage(RemHandle *h, LangTable const *lang)
+{
+    char expr[32];
+
+    sprintf(expr, "\"%.20s\"", lang->Code);
+    return rem_set_var(h, "$Language", expr);
+}
+
+static int LoadFileSet(char const *name, char const *path)
+{
+    FileSet *fs = FindFileSet(name);
+    RemHandle *h;
+    char *p;
+    int r;
+
+    h = rem_new();
+    if (!h) return E_NO_MEM;
+    p = StrDup(path);
+    if (!p) {
+	rem_free(h);
+	return E_NO_MEM;
+    }
+    rem_set_error_file(h, ServeErrFp);
+
+    /* The command line supplies the defaults */
+    rem_set_option(h, REM_OPT_TIME_FORMAT, Ctx->ScFormat);
+    rem_set_option(h, REM_OPT_NO_TIMED, Ctx->DontIssueAts);
+    rem_set_option(h, REM_OPT_MAX_SAT_ITER, Ctx->MaxSatIter);
+    SetFileSetLanguage(h, Ctx->Lang);
+    r = rem_load(h, p);
+
+    if (!fs) {
+	fs = NEW(FileSet);
+	if (fs) fs->name = StrDup(name);
+	if (!fs || !fs->name) {
+	    free(fs);
+	    free(p);
+	    rem_free(h);
+	    return E_NO_MEM;
+	}
+	fs->next = FileSets;
+	FileSets = fs;
+    } else {
+	rem_free(fs->h);
+	free(fs->path);
+    }
+    fs->h = h;
+    fs->path = p;
+    fs->today = NO_DATE;
+    fs->time_format = Ctx->ScFormat;
+    fs->no_timed = Ctx->DontIssueAts;
+    fs->advance = 0;
+    fs->lang = Ctx->Lang;
+
+    /* Days cached for the set's old files are no longer valid */
+    FlushDayCache(name);
+    return r;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  RequestFileSet                                             */
+/*                                                             */
+/*  Find the file set a request names ("default" if none) and  */
+/*  apply the request's options to it.  Returns NULL and       */
+/*  sends an error if there is no such set.                    */
+/*                                                             */
+/***************************************************************/
+static FileSet *RequestFileSet(int client, json_value const *req)
+{
+    json_value const *v = JSONMember(req, "set");
+    char const *name = "default";
+    LangTable const *lang = Ctx->Lang;
+    FileSet *fs;
+    int i;
+
+    if (v && v->type == json_string) name = v->u.string.ptr;
+    fs = FindFileSet(name);
+    if (!fs) {
+	ServeError(client, "No such file set");
+	return NULL;
+    }
+    v = JSONMember(req, "lang");
+    if (v) {
+	if (v->type == json_string) lang = FindLanguage(v->u.string.ptr);
+	if (v->type != json_string || !lang) {
+	    ServeError(client, "Unknown language");
+	    return NULL;
+	}
+    }
+
+    /* Options not given take the command line's values.  Changing
+       an option makes the interpreter run the files again, so only
+       do it if it really changes */
+    i = JSONInt(req, "time_format", Ctx->ScFormat);
+    if (i != fs->time_format && rem_set_option(fs->h, REM_OPT_TIME_FORMAT, i) == OK) {
+	fs->time_format = i;
+    }
+    i = JSONInt(req, "no_timed", Ctx->DontIssueAts);
+    if (i != fs->no_timed) {
+	rem_set_option(fs->h, REM_OPT_NO_TIMED, i);
+	fs->no_timed = i;
+    }
+    i = JSONInt(req, "advance", 0);
+    if (i != fs->advance) {
+	rem_set_option(fs->h, REM_OPT_ADVANCE, i);
+	fs->advance = i;
+    }
+    if (lang != fs->lang && SetFileSetLanguage(fs->h, lang) == OK) {
+	fs->lang = lang;
+    }
+    return fs;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  RequestDate                                                */
+/*                                                             */
+/*  Get the "date" of a request as a Julian date in *jul;      */
+/*  today if it has none.  Returns OK or an error code.        */
+/*                                                             */
+/***************************************************************/
+static int RequestDate(json_value const *req, int *jul)
+{
+    json_value const *v = JSONMember(req, "date");
+    char const *s;
+    int y, m, d, tim;
+
+    if (!v) {
+	*jul = SystemDate(&y, &m, &d);
+	return OK;
+    }
+    if (v->type != json_string) return E_BAD_DATE;
+    s = v->u.string.ptr;
+    if (ParseLiteralDate(&s, jul, &tim) || *s || tim != NO_TIME) {
+	return E_BAD_DATE;
+    }
+    return OK;
+}
+
+/* Make sure ndays days starting with jul are all valid dates */
+static int CheckRange(int jul, int ndays)
+{
+    int y, m, d;
+    if (ndays < 1 || ndays > MAX_SERVE_DAYS) return E_DOMAIN_ERR;
+    FromJulian(jul, &y, &m, &d);
+    if (y > BASE+YR_RANGE) return E_BAD_DATE;
+    FromJulian(jul+ndays-1, &y, &m, &d);
+    if (y > BASE+YR_RANGE || jul+ndays-1 < jul) return E_BAD_DATE;
+    return OK;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  PutEntry                                                   */
+/*                                                             */
+/*  Append an occurrence to buf as a JSON object with the      */
+/*  same keys "remind -pp" uses.                               */
+/*                                                             */
+/***************************************************************/
+static void PutEntry(DynamicBuffer *buf, RemOccurrence const *o)
+{
+    char tmp[64];
+
+    sprintf(tmp, "{\"date\":\"%04d-%02d-%02d\",", o->year, o->month, o->day);
+    DBufPuts(buf, tmp);
+    DBufPuts(buf, "\"filename\":\"");
+    DBufPutJSONString(buf, o->filename);
+    sprintf(tmp, "\",\"lineno\":%d,\"passthru\":\"", o->lineno);
+    DBufPuts(buf, tmp);
+    DBufPutJSONString(buf, o->passthru);
+    DBufPuts(buf, "\",\"tags\":\"");
+    DBufPutJSONString(buf, o->tags);
+    DBufPuts(buf, "\",");
+    if (o->duration >= 0) {
+	sprintf(tmp, "\"duration\":%d,", o->duration);
+	DBufPuts(buf, tmp);
+    }
+    if (o->time >= 0) {
+	sprintf(tmp, "\"time\":%d,", o->time);
+	DBufPuts(buf, tmp);
+    }
+    sprintf(tmp, "\"priority\":%d,", o->priority);
+    DBufPuts(buf, tmp);
+    if (o->is_color) {
+	sprintf(tmp, "\"r\":%d,\"g\":%d,\"b\":%d,", o->r, o->g, o->b);
+	DBufPuts(buf, tmp);
+    }
+    if (strcmp(o->raw_body, o->body)) {
+	DBufPuts(buf, "\"rawbody\":\"");
+	DBufPutJSONString(buf, o->raw_body);
+	DBufPuts(buf, "\",");
+    }
+    if (strcmp(o->plain_body, o->body)) {
+	DBufPuts(buf, "\"plain_body\":\"");
+	DBufPutJSONString(buf, o->plain_body);
+	DBufPuts(buf, "\",");
+    }
+    DBufPuts(buf, "\"body\":\"");
+    DBufPutJSONString(buf, o->body);
+    DBufPuts(buf, "\"}");
+}
+
+/***************************************************************/
+/*                                                             */
+/*  GetDay                                                     */
+/*                                                             */
+/*  Return the reminders a file set yields on day jul with its */
+/*  current options, from the cache if possible.  Returns NULL */
+/*  if out of memory.                                          */
+/*                                                             */
+/***************************************************************/
+static CachedDay *GetDay(FileSet *fs, int jul)
+{
+    char tmp[64];
+    DynamicBuffer key, entries, errs;
+    RemOccurrence *occ = NULL;
+    size_t *ends = NULL;
+    CachedDay *d;
+    unsigned int h;
+    int y, m, dd, num = 0, i, r;
+
+    DBufInit(&key);
+    DBufPuts(&key, fs->name);
+    sprintf(tmp, "\n%d %d %d %.20s %d", fs->time_format, fs->no_timed, fs->advance,
+	    fs->lang->Code, jul);
+    DBufPuts(&key, tmp);
+    h = DayHash(DBufValue(&key));
+    for (d = DayCache[h]; d; d = d->next) {
+	if (!strcmp(d->key, DBufValue(&key))) {
+	    DBufFree(&key);
+	    CacheHits++;
+	    return d;
+	}
+    }
+    CacheMisses++;
+
+    FromJulian(jul, &y, &m, &dd);
+    DBufInit(&entries);
+    DBufInit(&errs);
+    BeginErrors();
+    r = rem_occurrences(fs->h, y, m+1, dd, 1, &occ, &num);
+    EndErrors(&errs);
+    if (r) {
+	if (!DBufLen(&errs)) {
+	    DBufPuts(&errs, rem_strerror(r));
+	    DBufPutc(&errs, '\n');
+	}
+	num = 0;
+    } else if (num) {
+	ends = malloc(num * sizeof(size_t));
+	for (i=0; ends && i<num; i++) {
+	    if (i) DBufPutc(&entries, ',');
+	    PutEntry(&entries, &occ[i]);
+	    ends[i] = DBufLen(&entries);
+	}
+	rem_free_occurrences(occ, num);
+    }
+
+    if (NumCachedDays >= MAX_CACHED_DAYS) FlushDayCache(NULL);
+    d = NEW(CachedDay);
+    if (d) {
+	d->key = StrDup(DBufValue(&key));
+	d->entries = StrDup(DBufValue(&entries));
+	d->errors = StrDup(DBufValue(&errs));
+	d->ends = ends;
+	d->num = num;
+	if (!d->key || !d->entries || !d->errors || (num && !ends)) {
+	    free(d->key);
+	    free(d->entries);
+	    free(d->errors);
+	    free(d);
+	    d = NULL;
+	} else {
+	    d->next = DayCache[h];
+	    DayCache[h] = d;
+	    NumCachedDays++;
+	}
+    }
+    if (!d) free(ends);
+    DBufFree(&key);
+    DBufFree(&entries);
+    DBufFree(&errs);
+    return d;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  SendDays                                                   */
+/*                                                             */
+/*  Send a response whose "entries" are the reminders on the   */
+/*  days from jul on.  At most ndays days are looked at; if    */
+/*  count is positive, stop after that many entries.  head     */
+/*  holds the members that start the response.                 */
+/*                                                             */
+/***************************************************************/
+static void SendDays(int client, FileSet *fs, char const *head,
+		     int jul, int ndays, int count)
+{
+    DynamicBuffer out, errs;
+    CachedDay *d;
+    int n = 0, i;
+
+    DBufInit(&out);
+    DBufInit(&errs);
+    DBufPuts(&out, head);
+    DBufPuts(&out, "\"entries\":[");
+    for (i=0; i<ndays; i++) {
+	if (count > 0 && n >= count) break;
+	d = GetDay(fs, jul+i);
+	if (!d) {
+	    DBufFree(&out);
+	    DBufFree(&errs);
+	    ServeError(client, ErrMsg[E_NO_MEM]);
+	    return;
+	}
+	DBufPuts(&errs, d->errors);
+	if (!d->num) continue;
+	if (count <= 0 || n + d->num <= count) {
+	    if (n) DBufPutc(&out, ',');
+	    DBufPuts(&out, d->entries);
+	    n += d->num;
+	    continue;
+	}
+	/* Take only as many of this day's entries as we need */
+	if (n) DBufPutc(&out, ',');
+	DBufPutsN(&out, d->entries, d->ends[count-n-1]);
+	n = count;
+    }
+    DBufPuts(&out, "]");
+    if (DBufLen(&errs)) {
+	DBufPuts(&out, ",\"errors\":\"");
+	DBufPutJSONString(&out, DBufValue(&errs));
+	DBufPutc(&out, '"');
+    }
+    DBufPuts(&out, "}\n");
+    Reply(client, DBufValue(&out));
+    DBufFree(&out);
+    DBufFree(&errs);
+}
+
+
+/***************************************************************/
+/*                                                             */
+/*  The requests                                               */
+/*                                                             */
+/*  Each takes the client and the parsed request and sends     */
+/*  exactly one response line.                                 */
+/*                                                             */
+/***************************************************************/
+
+/* {"command":"load","set":name,"file":path} */
+static void LoadCommand(int client, json_value const *req)
+{
+    json_value const *set = JSONMember(req, "set");
+    json_value const *file = JSONMember(req, "file");
+    DynamicBuffer out, errs;
+    int r;
+
+    if (!set || set->type != json_string || !*set->u.string.ptr) {
+	ServeError(client, "Missing \"set\"");
+	return;
+    }
+    if (!file || file->type != json_string || !*file->u.string.ptr) {
+	ServeError(client, "Missing \"file\"");
+	return;
+    }
+    DBufInit(&errs);
+    BeginErrors();
+    r = LoadFileSet(set->u.string.ptr, file->u.string.ptr);
+    EndErrors(&errs);
+    if (r && !DBufLen(&errs)) {
+	DBufPuts(&errs, rem_strerror(r));
+	DBufPutc(&errs, '\n');
+    }
+    DBufInit(&out);
+    DBufPuts(&out, "{\"response\":\"load\",\"set\":\"");
+    DBufPutJSONString(&out, set->u.string.ptr);
+    DBufPutc(&out, '"');
+    if (DBufLen(&errs)) {
+	DBufPuts(&out, ",\"errors\":\"");
+	DBufPutJSONString(&out, DBufValue(&errs));
+	DBufPutc(&out, '"');
+    }
+    DBufPuts(&out, "}\n");
+    Reply(client, DBufValue(&out));
+    DBufFree(&out);
+    DBufFree(&errs);
+}
+
+/* {"command":"agenda","date":"yyyy-mm-dd","days":n} */
+static void AgendaCommand(int client, json_value const *req)
+{
+    FileSet *fs;
+    char head[128];
+    int jul, ndays, y, m, d, r;
+
+    r = RequestDate(req, &jul);
+    ndays = JSONInt(req, "days", 1);
+    if (!r) r = CheckRange(jul, ndays);
+    if (r) {
+	ServeError(client, ErrMsg[r]);
+	return;
+    }
+    fs = RequestFileSet(client, req);
+    if (!fs) return;
+    FromJulian(jul, &y, &m, &d);
+    sprintf(head, "{\"response\":\"agenda\",\"date\":\"%04d-%02d-%02d\",\"days\":%d,",
+	    y, m+1, d, ndays);
+    SendDays(client, fs, head, jul, ndays, 0);
+}
+
+/* {"command":"month","year":y,"month":m} */
+static void MonthCommand(int client, json_value const *req)
+{
+    FileSet *fs;
+    char head[128];
+    int y, m;
+
+    y = JSONInt(req, "year", -1);
+    m = JSONInt(req, "month", -1);
+    if (!DateOK(y, m-1, 1)) {
+	ServeError(client, ErrMsg[E_BAD_DATE]);
+	return;
+    }
+    fs = RequestFileSet(client, req);
+    if (!fs) return;
+    sprintf(head, "{\"response\":\"month\",\"year\":%d,\"month\":%d,", y, m);
+    SendDays(client, fs, head, Julian(y, m-1, 1), DaysInMonth(m-1, y), 0);
+}
+
+/* {"command":"next","date":"yyyy-mm-dd","count":n,"within":days} */
+static void NextCommand(int client, json_value const *req)
+{
+    FileSet *fs;
+    char head[128];
+    int jul, count, within, y, m, d, r;
+
+    r = RequestDate(req, &jul);
+    count = JSONInt(req, "count", 1);
+    within = JSONInt(req, "within", 366);
+    if (!r && count < 1) r = E_2LOW;
+    if (!r) {
+	/* Don't look past the end of time */
+	FromJulian(jul, &y, &m, &d);
+	if (y == BASE+YR_RANGE) {
+	    if (within > Julian(y, 11, 31) - jul + 1) {
+		within = Julian(y, 11, 31) - jul + 1;
+	    }
+	} else if (y < BASE+YR_RANGE && within > MAX_SERVE_DAYS) {
+	    within = MAX_SERVE_DAYS;
+	}
+	r = CheckRange(jul, within);
+    }
+    if (r) {
+	ServeError(client, ErrMsg[r]);
+	return;
+    }
+    fs = RequestFileSet(client, req);
+    if (!fs) return;
+    FromJulian(jul, &y, &m, &d);
+    sprintf(head, "{\"response\":\"next\",\"date\":\"%04d-%02d-%02d\",",
+	    y, m+1, d);
+    SendDays(client, fs, head, jul, within, count);
+}
+
+/* {"command":"eval","expr":expr,"date":"yyyy-mm-dd"} */
+static void EvalCommand(int client, json_value const *req)
+{
+    json_value const *expr = JSONMember(req, "expr");
+    FileSet *fs;
+    DynamicBuffer out, errs;
+    char *result = NULL;
+    int jul, y, m, d, r;
+
+    if (!expr || expr->type != json_string) {
+	ServeError(client, "Missing \"expr\"");
+	return;
+    }
+    r = RequestDate(req, &jul);
+    if (r) {
+	ServeError(client, ErrMsg[r]);
+	return;
+    }
+    fs = RequestFileSet(client, req);
+    if (!fs) return;
+
+    DBufInit(&errs);
+    BeginErrors();
+    /* The files are run again only if the date changes */
+    if (jul != fs->today) {
+	FromJulian(jul, &y, &m, &d);
+	rem_set_date(fs->h, y, m+1, d);
+	fs->today = jul;
+    }
+    r = rem_eval(fs->h, expr->u.string.ptr, &result);
+    EndErrors(&errs);
+
+    DBufInit(&out);
+    if (r) {
+	DBufPuts(&out, "{\"response\":\"error\",\"error\":\"");
+	DBufPutJSONString(&out, rem_strerror(r));
+    } else {
+	DBufPuts(&out, "{\"response\":\"eval\",\"value\":\"");
+	DBufPutJSONString(&out, result);
+	free(result);
+    }
+    DBufPutc(&out, '"');
+    if (DBufLen(&errs)) {
+	DBufPuts(&out, ",\"errors\":\"");
+	DBufPutJSONString(&out, DBufValue(&errs));
+	DBufPutc(&out, '"');
+    }
+    DBufPuts(&out, "}\n");
+    Reply(client, DBufValue(&out));
+    DBufFree(&out);
+    DBufFree(&errs);
+}
+
+/* {"command":"stats"} */
+static void StatsCommand(int client)
+{
+    FileSet *fs;
+    char buf[256];
+    int n = 0;
+
+    for (fs = FileSets; fs; fs = fs->next) n++;
+    sprintf(buf, "{\"response\":\"stats\",\"sets\":%d,\"cached_days\":%d,"
+	    "\"hits\":%lu,\"misses\":%lu}\n",
+	    n, NumCachedDays, CacheHits, CacheMisses);
+    Reply(client, buf);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  ServeCommand                                               */
+/*                                                             */
+/*  Interpret one JSON request.                                */
+/*                                                             */
+/***************************************************************/
+static void ServeCommand(int client, char const *line)
+{
+    json_value *req;
+    json_value const *cmd;
+    char const *c;
+    DynamicBuffer out;
+
+    req = json_parse(line, strlen(line));
+    if (!req) {
+	ServeError(client, "Malformed JSON request");
+	return;
+    }
+    cmd = JSONMember(req, "command");
+    if (!cmd || cmd->type != json_string) {
+	json_value_free(req);
+	ServeError(client, "Missing \"command\"");
+	return;
+    }
+    c = cmd->u.string.ptr;
+
+    /* Notice edits before answering anything */
+    CheckFiles();
+
+    if (!strcmp(c, "agenda")) {
+	AgendaCommand(client, req);
+    } else if (!strcmp(c, "month")) {
+	MonthCommand(client, req);
+    } else if (!strcmp(c, "next")) {
+	NextCommand(client, req);
+    } else if (!strcmp(c, "eval")) {
+	EvalCommand(client, req);
+    } else if (!strcmp(c, "load")) {
+	LoadCommand(client, req);
+    } else if (!strcmp(c, "reload")) {
+	ForgetFiles();
+	Reply(client, "{\"response\":\"reload\"}\n");
+    } else if (!strcmp(c, "stats")) {
+	StatsCommand(client);
+    } else if (!strcmp(c, "exit")) {
+	Reply(client, "{\"response\":\"exit\"}\n");
+	Exiting = 1;
+    } else {
+	DBufInit(&out);
+	DBufPuts(&out, "Invalid command: ");
+	DBufPuts(&out, c);
+	ServeError(client, DBufValue(&out));
+	DBufFree(&out);
+    }
+    json_value_free(req);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  Serve                                                      */
+/*                                                             */
+/*  Run the query server on the socket at path, or on standard */
+/*  input and output if path is "-".  The file named on the    */
+/*  command line is the file set called "default".  Returns    */
+/*  the program's exit status.                                 */
+/*                                                             */
+/***************************************************************/
+int Serve(char const *path)
+{
+    FILE *errfp = ErrFp;
+    DynamicBuffer errs, line;
+    fd_set readSet, writeSet;
+    int maxfd, r;
+
+    ServeErrFp = tmpfile();
+    if (!ServeErrFp) {
+	fprintf(errfp, "%s: Cannot create temporary file: %s\n", ArgV[0],
+		strerror(errno));
+	return 1;
+    }
+
+    DBufInit(&errs);
+    BeginErrors();
+    r = LoadFileSet("default", Ctx->InitialFile);
+    EndErrors(&errs);
+    fputs(DBufValue(&errs), errfp);
+    DBufFree(&errs);
+    if (r) {
+	fprintf(errfp, "%s: %s\n", Ctx->InitialFile, rem_strerror(r));
+    }
+
+    if (!strcmp(path, "-")) {
+	DBufInit(&line);
+	while (!Exiting && DBufGets(&line, stdin) == OK) {
+	    if (*DBufValue(&line)) ServeCommand(-1, DBufValue(&line));
+	    else if (feof(stdin)) break;
+	}
+	DBufFree(&line);
+	return 0;
+    }
+
+    if (ServerListen(path) != OK) return 1;
+    while (!Exiting) {
+	FD_ZERO(&readSet);
+	FD_ZERO(&writeSet);
+	maxfd = ServerSetFds(&readSet, &writeSet, -1);
+	if (select(maxfd+1, &readSet, &writeSet, NULL, NULL) <= 0) continue;
+	ServerProcess(&readSet, &writeSet, ServeCommand);
+    }
+    (void) unlink(path);
+    return 0;
+}
+
+#endif /* LIBREMIND */
@@ -0,0 +1,641 @@
+/***************************************************************/
+/*                                                             */
+/*  SERVER.C                                                   */
+/*                                                             */
+/*  Unix-domain socket support so that server mode (-z0) can   */
+/*  talk to several clients at once.                           */
+/*                                                             */
+/*  This file is part of REMIND.                               */
+/*  Copyright (C) 1992-2022 by Dianne Skoll                    */
+/*                                                             */
+/***************************************************************/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "types.h"
+#include "globals.h"
+#include "err.h"
+#include "protos.h"
+
+/* Name of environment variable used to hand our sockets over to
+   the new process image when we re-exec ourselves */
+#define SERVER_FDS_ENV "REMIND_SERVER_FDS"
+
+/* Refuse to buffer absurdly-long request lines */
+#define MAX_REQUEST_LEN 65536
+
+/* Drop a client that leaves this much of our output unread */
+#define MAX_PENDING_OUTPUT (1024*1024)
+
+typedef struct {
+    int fd;                /* -1 if the slot is unused */
+    unsigned int events;   /* Mask of SERVER_EV_* subscriptions */
+    DynamicBuffer inbuf;   /* Partial request line */
+    DynamicBuffer outbuf;  /* Output the client has yet to take */
+    size_t outpos;         /* How much of outbuf has been sent */
+} ServerClient;
+
+static ServerClient Clients[MAX_SERVER_CLIENTS];
+static int ListenFd = -1;
+static int ClientsInitialized = 0;
+
+static FILE *CaptureFp = NULL;
+static int SavedStdout = -1;
+
+static void InitClients(void)
+{
+    int i;
+    if (ClientsInitialized) return;
+    for (i=0; i<MAX_SERVER_CLIENTS; i++) {
+	Clients[i].fd = -1;
+	Clients[i].events = 0;
+	DBufInit(&(Clients[i].inbuf));
+	DBufInit(&(Clients[i].outbuf));
+	Clients[i].outpos = 0;
+    }
+    ClientsInitialized = 1;
+}
+
+/* Our sockets are closed across exec, except when we re-exec
+   ourselves (see ServerPrepareExec), and never block */
+static void SetCloseOnExec(int fd, int on)
+{
+    int flags = fcntl(fd, F_GETFD);
+    if (flags < 0) return;
+    if (on) flags |= FD_CLOEXEC;
+    else flags &= ~FD_CLOEXEC;
+    (void) fcntl(fd, F_SETFD, flags);
+}
+
+static void SetNonBlocking(int fd)
+{
+    int flags = fcntl(fd, F_GETFL);
+    if (flags >= 0) (void) fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+static int AddClient(int fd, unsigned int events)
+{
+    int i;
+    InitClients();
+    for (i=0; i<MAX_SERVER_CLIENTS; i++) {
+	if (Clients[i].fd == -1) {
+	    SetCloseOnExec(fd, 1);
+	    SetNonBlocking(fd);
+	    Clients[i].fd = fd;
+	    Clients[i].events = events;
+	    DBufInit(&(Clients[i].inbuf));
+	    DBufInit(&(Clients[i].outbuf));
+	    Clients[i].outpos = 0;
+	    return i;
+	}
+    }
+    return -1;
+}
+
+static void DropClient(int client)
+{
+    if (Clients[client].fd == -1) return;
+    close(Clients[client].fd);
+    Clients[client].fd = -1;
+    Clients[client].events = 0;
+    DBufFree(&(Clients[client].inbuf));
+    DBufFree(&(Clients[client].outbuf));
+    Clients[client].outpos = 0;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  FlushClient                                                */
+/*                                                             */
+/*  Write as much of a client's pending output as its socket   */
+/*  will take without blocking.  Drops the client on error.    */
+/*                                                             */
+/***************************************************************/
+static void FlushClient(int client)
+{
+    ServerClient *c = &Clients[client];
+    ssize_t n;
+
+    while (c->fd != -1 && c->outpos < DBufLen(&c->outbuf)) {
+	n = write(c->fd, DBufValue(&c->outbuf) + c->outpos,
+		  DBufLen(&c->outbuf) - c->outpos);
+	if (n < 0) {
+	    if (errno == EINTR) continue;
+	    if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+	    DropClient(client);
+	    return;
+	}
+	c->outpos += n;
+    }
+    if (c->fd == -1) return;
+    if (c->outpos == DBufLen(&c->outbuf)) {
+	DBufFree(&c->outbuf);
+	DBufInit(&c->outbuf);
+	c->outpos = 0;
+    } else if (c->outpos > DBufLen(&c->outbuf) / 2) {
+	/* Don't let a client that reads slowly but steadily make
+	   the buffer grow without bound */
+	c->outbuf.len -= c->outpos;
+	memmove(c->outbuf.buffer, c->outbuf.buffer + c->outpos, c->outbuf.len);
+	c->outbuf.buffer[c->outbuf.len] = 0;
+	c->outpos = 0;
+    }
+}
+
+/***************************************************************/
+/*                                                             */
+/*  IsOurSocket                                                */
+/*                                                             */
+/*  Return 1 if fd is a Unix-domain stream socket, listening   */
+/*  on path if path is non-NULL and connected otherwise.  An   */
+/*  fd named in the environment must pass this before we       */
+/*  adopt it.                                                  */
+/*                                                             */
+/***************************************************************/
+static int IsOurSocket(int fd, char const *path)
+{
+    struct stat sb;
+    struct sockaddr_un addr;
+    socklen_t len;
+    int val;
+
+    if (fd < 0 || fstat(fd, &sb) < 0 || !S_ISSOCK(sb.st_mode)) return 0;
+
+    len = sizeof(val);
+    if (getsockopt(fd, SOL_SOCKET, SO_TYPE, &val, &len) < 0 ||
+	val != SOCK_STREAM) return 0;
+
+    memset(&addr, 0, sizeof(addr));
+    len = sizeof(addr);
+    if (getsockname(fd, (struct sockaddr *) &addr, &len) < 0 ||
+	addr.sun_family != AF_UNIX) return 0;
+
+#ifdef SO_ACCEPTCONN
+    len = sizeof(val);
+    if (getsockopt(fd, SOL_SOCKET, SO_ACCEPTCONN, &val, &len) < 0) return 0;
+    if (!val != !path) return 0;
+#endif
+    if (path && strncmp(addr.sun_path, path, sizeof(addr.sun_path))) {
+	return 0;
+    }
+    return 1;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  AdoptSockets                                               */
+/*                                                             */
+/*  Take over the sockets listed in fds, which has the form    */
+/*  "listenfd fd:events fd:events...".  Returns OK, or         */
+/*  E_CANT_OPEN if the listening socket isn't ours.  Clients   */
+/*  that aren't sockets are left alone.                        */
+/*                                                             */
+/***************************************************************/
+static int AdoptSockets(char const *fds, char const *path)
+{
+    char const *s = fds;
+    char *end;
+    int fd;
+    unsigned int events;
+
+    fd = (int) strtol(s, &end, 10);
+    if (end == s || !IsOurSocket(fd, path)) {
+	fprintf(ErrFp, "Ignoring %s: %d is not the socket `%s'\n",
+		SERVER_FDS_ENV, fd, path);
+	return E_CANT_OPEN;
+    }
+    ListenFd = fd;
+    SetCloseOnExec(ListenFd, 1);
+    SetNonBlocking(ListenFd);
+    s = end;
+    while (*s == ' ') {
+	s++;
+	fd = (int) strtol(s, &end, 10);
+	if (end == s || *end != ':') break;
+	events = (unsigned int) strtoul(end+1, &end, 10);
+	s = end;
+	if (!IsOurSocket(fd, NULL)) continue;
+	if (AddClient(fd, events) < 0) close(fd);
+    }
+    return OK;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  ServerListen                                               */
+/*                                                             */
+/*  Create the listening socket at path.  If we were re-exec'd */
+/*  by a REREAD, pick up the existing sockets instead.         */
+/*  Returns OK or an error code.                               */
+/*                                                             */
+/***************************************************************/
+int ServerListen(char const *path)
+{
+    struct sockaddr_un addr;
+    char const *s;
+    char *fds;
+    int fd;
+    int r;
+    mode_t old_umask;
+
+    InitClients();
+
+    /* Ignore SIGPIPE; a vanished client shows up as EPIPE instead */
+    signal(SIGPIPE, SIG_IGN);
+
+    /* Inherited from a previous incarnation of ourselves? */
+    s = getenv(SERVER_FDS_ENV);
+    if (s && *s) {
+	/* Copy it first: nothing we run later should see it */
+	fds = StrDup(s);
+#ifdef HAVE_UNSETENV
+	unsetenv(SERVER_FDS_ENV);
+#else
+	putenv(SERVER_FDS_ENV "=");
+#endif
+	if (!fds) return E_NO_MEM;
+	r = AdoptSockets(fds, path);
+	free(fds);
+	if (r == OK) return OK;
+    }
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+	fprintf(ErrFp, "Socket path `%s' is too long\n", path);
+	return E_CANT_OPEN;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+	fprintf(ErrFp, "Cannot create socket: %s\n", strerror(errno));
+	return E_CANT_OPEN;
+    }
+
+    /* Don't clobber the socket of a live server */
+    if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) == 0) {
+	fprintf(ErrFp, "Socket `%s' is in use by another server\n", path);
+	close(fd);
+	return E_CANT_OPEN;
+    }
+    close(fd);
+    (void) unlink(path);
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+	fprintf(ErrFp, "Cannot create socket: %s\n", strerror(errno));
+	return E_CANT_OPEN;
+    }
+
+    /* Only the owner may talk to us */
+    old_umask = umask(077);
+    if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+	umask(old_umask);
+	fprintf(ErrFp, "Cannot bind `%s': %s\n", path, strerror(errno));
+	close(fd);
+	return E_CANT_OPEN;
+    }
+    umask(old_umask);
+    if (listen(fd, 16) < 0) {
+	fprintf(ErrFp, "Cannot listen on `%s': %s\n", path, strerror(errno));
+	close(fd);
+	return E_CANT_OPEN;
+    }
+    SetCloseOnExec(fd, 1);
+    SetNonBlocking(fd);
+    ListenFd = fd;
+    return OK;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  ServerActive                                               */
+/*                                                             */
+/*  Return non-zero if we are listening on a socket.           */
+/*                                                             */
+/***************************************************************/
+int ServerActive(void)
+{
+    return ListenFd >= 0;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  ServerPrepareExec                                          */
+/*                                                             */
+/*  Record our sockets in the environment so the process we    */
+/*  are about to exec can keep serving the same clients.  A    */
+/*  client still holding unsent output is dropped, since the   */
+/*  new process can't finish sending it.                       */
+/*                                                             */
+/***************************************************************/
+void ServerPrepareExec(void)
+{
+    static DynamicBuffer env;
+    char tmp[64];
+    int i;
+
+    if (ListenFd < 0) return;
+    DBufInit(&env);
+    sprintf(tmp, "%s=%d", SERVER_FDS_ENV, ListenFd);
+    DBufPuts(&env, tmp);
+    SetCloseOnExec(ListenFd, 0);
+    for (i=0; i<MAX_SERVER_CLIENTS; i++) {
+	if (Clients[i].fd == -1) continue;
+	FlushClient(i);
+	if (Clients[i].fd != -1 && DBufLen(&(Clients[i].outbuf))) {
+	    DropClient(i);
+	}
+	if (Clients[i].fd != -1) {
+	    SetCloseOnExec(Clients[i].fd, 0);
+	    sprintf(tmp, " %d:%u", Clients[i].fd, Clients[i].events);
+	    DBufPuts(&env, tmp);
+	}
+    }
+    putenv(DBufValue(&env));
+}
+
+/***************************************************************/
+/*                                                             */
+/*  ServerSetFds                                               */
+/*                                                             */
+/*  Add the listening socket and all clients to readSet, and   */
+/*  clients with output still to send to writeSet.  Returns    */
+/*  the new maximum fd.                                        */
+/*                                                             */
+/***************************************************************/
+int ServerSetFds(fd_set *readSet, fd_set *writeSet, int maxfd)
+{
+    int i;
+    if (ListenFd < 0) return maxfd;
+
+    FD_SET(ListenFd, readSet);
+    if (ListenFd > maxfd) maxfd = ListenFd;
+    for (i=0; i<MAX_SERVER_CLIENTS; i++) {
+	if (Clients[i].fd != -1) {
+	    FD_SET(Clients[i].fd, readSet);
+	    if (DBufLen(&(Clients[i].outbuf))) {
+		FD_SET(Clients[i].fd, writeSet);
+	    }
+	    if (Clients[i].fd > maxfd) maxfd = Clients[i].fd;
+	}
+    }
+    return maxfd;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  ServerProcess                                              */
+/*                                                             */
+/*  Send pending output to writable clients, accept new        */
+/*  clients and hand each complete request line from a         */
+/*  readable client to handler.                                */
+/*                                                             */
+/***************************************************************/
+void ServerProcess(fd_set *readSet, fd_set *writeSet,
+		   void (*handler)(int client, char const *line))
+{
+    char buf[4096];
+    int i, fd;
+    ssize_t n;
+    ssize_t j;
+    char *line, *nl;
+
+    if (ListenFd < 0) return;
+
+    for (i=0; i<MAX_SERVER_CLIENTS; i++) {
+	if (Clients[i].fd != -1 && FD_ISSET(Clients[i].fd, writeSet)) {
+	    FlushClient(i);
+	}
+    }
+
+    if (FD_ISSET(ListenFd, readSet)) {
+	fd = accept(ListenFd, NULL, NULL);
+	if (fd >= 0) {
+	    if (AddClient(fd, 0) < 0) {
+		static char const toomany[] =
+		    "{\"response\":\"error\",\"error\":\"Too many clients\"}\n";
+		(void) write(fd, toomany, sizeof(toomany)-1);
+		close(fd);
+	    }
+	}
+    }
+
+    for (i=0; i<MAX_SERVER_CLIENTS; i++) {
+	if (Clients[i].fd == -1 || !FD_ISSET(Clients[i].fd, readSet)) continue;
+	n = read(Clients[i].fd, buf, sizeof(buf));
+	if (n < 0 && (errno == EINTR || errno == EAGAIN)) continue;
+	if (n <= 0) {
+	    DropClient(i);
+	    continue;
+	}
+	for (j=0; j<n; j++) {
+	    if (DBufPutc(&(Clients[i].inbuf), buf[j]) != OK) break;
+	}
+	if (DBufLen(&(Clients[i].inbuf)) > MAX_REQUEST_LEN) {
+	    DropClient(i);
+	    continue;
+	}
+
+	/* Dispatch each complete line.  The handler may drop the
+	   client, so re-check fd every time around */
+	while (Clients[i].fd != -1 &&
+	       (nl = strchr(DBufValue(&(Clients[i].inbuf)), '\n')) != NULL) {
+	    DynamicBuffer rest;
+	    *nl = 0;
+	    line = StrDup(DBufValue(&(Clients[i].inbuf)));
+	    DBufInit(&rest);
+	    DBufPuts(&rest, nl+1);
+	    DBufFree(&(Clients[i].inbuf));
+	    DBufInit(&(Clients[i].inbuf));
+	    DBufPuts(&(Clients[i].inbuf), DBufValue(&rest));
+	    DBufFree(&rest);
+	    if (!line) break;
+	    if (*line) handler(i, line);
+	    free(line);
+	}
+    }
+}
+
+/***************************************************************/
+/*                                                             */
+/*  ServerSend                                                 */
+/*                                                             */
+/*  Send a string to a client.  Whatever its socket won't take */
+/*  now is queued and sent as the client reads; a client that  */
+/*  lets too much pile up, or gives an error, is dropped.      */
+/*                                                             */
+/***************************************************************/
+void ServerSend(int client, char const *s)
+{
+    ServerClient *c;
+
+    if (client < 0 || client >= MAX_SERVER_CLIENTS) return;
+    c = &Clients[client];
+    if (c->fd == -1) return;
+    if (DBufLen(&c->outbuf) - c->outpos + strlen(s) > MAX_PENDING_OUTPUT ||
+	DBufPuts(&c->outbuf, s) != OK) {
+	DropClient(client);
+	return;
+    }
+    FlushClient(client);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  ServerBroadcast                                            */
+/*                                                             */
+/*  Send a string to all clients subscribed to event.          */
+/*                                                             */
+/***************************************************************/
+void ServerBroadcast(unsigned int event, char const *s)
+{
+    int i;
+    for (i=0; i<MAX_SERVER_CLIENTS; i++) {
+	if (Clients[i].fd != -1 && (Clients[i].events & event)) {
+	    ServerSend(i, s);
+	}
+    }
+}
+
+/***************************************************************/
+/*                                                             */
+/*  ServerWantsEvent                                           */
+/*                                                             */
+/*  Return non-zero if any client is subscribed to event.      */
+/*                                                             */
+/***************************************************************/
+int ServerWantsEvent(unsigned int event)
+{
+    int i;
+    if (ListenFd < 0) return 0;
+    for (i=0; i<MAX_SERVER_CLIENTS; i++) {
+	if (Clients[i].fd != -1 && (Clients[i].events & event)) {
+	    return 1;
+	}
+    }
+    return 0;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  ServerSubscribe                                            */
+/*                                                             */
+/*  Add (on != 0) or remove events from a client's             */
+/*  subscriptions.  Returns the resulting mask.                */
+/*                                                             */
+/***************************************************************/
+unsigned int ServerSubscribe(int client, unsigned int events, int on)
+{
+    if (client < 0 || client >= MAX_SERVER_CLIENTS) return 0;
+    if (on) {
+	Clients[client].events |= events;
+    } else {
+	Clients[client].events &= ~events;
+    }
+    return Clients[client].events;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  ServerBeginCapture / ServerEndCapture                      */
+/*                                                             */
+/*  Divert everything written to stdout into a buffer, so      */
+/*  that output from the usual printf-based code can be        */
+/*  framed and sent to clients.  Captures do not nest.         */
+/*                                                             */
+/***************************************************************/
+int ServerBeginCapture(void)
+{
+    if (CaptureFp) return E_SWERR;
+    fflush(stdout);
+    CaptureFp = tmpfile();
+    if (!CaptureFp) return E_IO_ERR;
+    SavedStdout = dup(STDOUT_FILENO);
+    if (SavedStdout < 0) {
+	fclose(CaptureFp);
+	CaptureFp = NULL;
+	return E_IO_ERR;
+    }
+    dup2(fileno(CaptureFp), STDOUT_FILENO);
+    return OK;
+}
+
+int ServerEndCapture(DynamicBuffer *out)
+{
+    int r = OK;
+    if (!CaptureFp) return E_SWERR;
+    fflush(stdout);
+    dup2(SavedStdout, STDOUT_FILENO);
+    close(SavedStdout);
+    SavedStdout = -1;
+    rewind(CaptureFp);
+    if (out) {
+	int c;
+	while ((c = getc(CaptureFp)) != EOF) {
+	    if (DBufPutc(out, (char) c) != OK) {
+		r = E_NO_MEM;
+		break;
+	    }
+	}
+    }
+    fclose(CaptureFp);
+    CaptureFp = NULL;
+    return r;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  DBufPutJSONString                                          */
+/*                                                             */
+/*  Append s to dbuf, escaped for use inside a JSON string.    */
+/*                                                             */
+/***************************************************************/
+int DBufPutJSONString(DynamicBuffer *dbuf, char const *s)
+{
+    char tmp[8];
+    size_t n;
+    int r = OK;
+    while (*s && r == OK) {
+	/* Copy a run of characters that need no escaping in one go */
+	n = JSONPlainSpan(s);
+	if (n) {
+	    r = DBufPutsN(dbuf, s, n);
+	    s += n;
+	    if (!*s || r != OK) break;
+	}
+	switch(*s) {
+	case '\b': r = DBufPuts(dbuf, "\\b"); break;
+	case '\f': r = DBufPuts(dbuf, "\\f"); break;
+	case '\n': r = DBufPuts(dbuf, "\\n"); break;
+	case '\r': r = DBufPuts(dbuf, "\\r"); break;
+	case '\t': r = DBufPuts(dbuf, "\\t"); break;
+	case '"':  r = DBufPuts(dbuf, "\\\""); break;
+	case '\\': r = DBufPuts(dbuf, "\\\\"); break;
+	default:
+	    if ((unsigned char) *s < 0x20) {
+		sprintf(tmp, "\\u%04x", (unsigned int) (unsigned char) *s);
+		r = DBufPuts(dbuf, tmp);
+	    } else {
+		r = DBufPutc(dbuf, *s);
+	    }
+	}
+	s++;
+    }
+    return r;
+}
@@ -20,10 +20,10 @@
 #include "expr.h"
 #include "globals.h"
 #include "err.h"
+#include "arena.h"
 
 /* The structure of a sorted entry */
 typedef struct sortrem {
-    struct sortrem *next;
     char const *text;
     int trigdate;
     int trigtime;
@@ -31,92 +31,122 @@ typedef struct sortrem {
     int priority;
 } Sortrem;
 
-/* The sorted reminder queue */
-static Sortrem *SortedQueue = (Sortrem *) NULL;
-
-static Sortrem *MakeSortRem (int jul, int tim, char const *body, int typ, int prio);
+static void SortRems (Sortrem *rems, int n);
 static void IssueSortBanner (int jul);
 
 /***************************************************************/
 /*                                                             */
-/*  MakeSortRem                                                */
+/*  InsertIntoSortBuffer                                       */
 /*                                                             */
-/*  Create a new Sortrem entry - return NULL on failure.       */
+/*  Insert a reminder into the sort buffer                     */
 /*                                                             */
 /***************************************************************/
-static Sortrem *MakeSortRem(int jul, int tim, char const *body, int typ, int prio)
+int InsertIntoSortBuffer(int jul, int tim, char const *body, int typ, int prio)
 {
-    Sortrem *new = NEW(Sortrem);
-    if (!new) return NULL;
+    Sortrem *new;
+    char const *text = NULL;
+
+    if (Ctx->NumSortRems == Ctx->SortBufSize) {
+	int size = Ctx->SortBufSize ? 2*Ctx->SortBufSize : 64;
+	new = realloc(Ctx->SortBuf, size * sizeof(Sortrem));
+	if (new) {
+	    Ctx->SortBuf = new;
+	    Ctx->SortBufSize = size;
+	}
+    }
+    if (Ctx->NumSortRems < Ctx->SortBufSize) {
+	text = ArenaStrDup(&Ctx->SortArena, body);
+    }
 
-    new->text = StrDup(body);
-    if (!new->text) {
-	free(new);
-	return NULL;
+    if (!text) {
+	Eprint("%s", ErrMsg[E_NO_MEM]);
+	IssueSortedReminders();
+	Ctx->SortByDate = 0;
+	Ctx->SortByTime = 0;
+	Ctx->SortByPrio = 0;
+	Ctx->UntimedBeforeTimed = 0;
+	return E_NO_MEM;
     }
-  
+
+    new = &Ctx->SortBuf[Ctx->NumSortRems++];
+    new->text = text;
     new->trigdate = jul;
     new->trigtime = tim;
     new->typ = typ;
     new->priority = prio;
-    new->next = NULL;
-    return new;
+    return OK;
 }
 
 /***************************************************************/
 /*                                                             */
-/*  InsertIntoSortBuffer                                       */
+/*  ShouldComeBefore                                           */
 /*                                                             */
-/*  Insert a reminder into the sort buffer                     */
+/*  Return true if b must be issued before a, which is earlier */
+/*  in the sort buffer.  Ties keep their original order.       */
 /*                                                             */
 /***************************************************************/
-int InsertIntoSortBuffer(int jul, int tim, char const *body, int typ, int prio)
+static int ShouldComeBefore(Sortrem const *b, Sortrem const *a)
 {
-    Sortrem *new = MakeSortRem(jul, tim, body, typ, prio);
-    Sortrem *cur = SortedQueue, *prev = NULL;
-    int ShouldGoAfter;
+    return CompareRems(a->trigdate, a->trigtime, a->priority,
+		       b->trigdate, b->trigtime, b->priority,
+		       Ctx->SortByDate, Ctx->SortByTime, Ctx->SortByPrio, Ctx->UntimedBeforeTimed) < 0;
+}
 
-    if (!new) {
-	Eprint("%s", ErrMsg[E_NO_MEM]);
-	IssueSortedReminders();
-	SortByDate = 0;
-	SortByTime = 0;
-	SortByPrio = 0;
-	UntimedBeforeTimed = 0;
-	return E_NO_MEM;
-    }
+/***************************************************************/
+/*                                                             */
+/*  SortRems                                                   */
+/*                                                             */
+/*  Stable bottom-up merge sort of the sort buffer.  If there  */
+/*  is no memory for the merge, fall back on insertion sort.   */
+/*                                                             */
+/***************************************************************/
+static void SortRems(Sortrem *rems, int n)
+{
+    Sortrem *tmp, *from, *to, *t;
+    int width, lo, mid, hi, i, j, k;
+
+    if (n < 2) return;
 
-    /* Find the correct place in the sorted list */
-    if (!SortedQueue) {
-	SortedQueue = new;
-	return OK;
+    tmp = malloc(n * sizeof(Sortrem));
+    if (!tmp) {
+	Sortrem r;
+	for (i=1; i<n; i++) {
+	    r = rems[i];
+	    for (j=i; j>0 && ShouldComeBefore(&r, &rems[j-1]); j--) {
+		rems[j] = rems[j-1];
+	    }
+	    rems[j] = r;
+	}
+	return;
     }
-    while (cur) {
-	ShouldGoAfter = CompareRems(new->trigdate, new->trigtime, new->priority,
-				    cur->trigdate, cur->trigtime, cur->priority,
-				    SortByDate, SortByTime, SortByPrio, UntimedBeforeTimed);
-
-	if (ShouldGoAfter <= 0) {
-	    prev = cur;
-	    cur = cur->next;
-	} else {
-	    if (prev) {
-		prev->next = new;
-		new->next = cur;
-	    } else {
-		SortedQueue = new;
-		new->next = cur;
+
+    from = rems;
+    to = tmp;
+    for (width=1; width<n; width *= 2) {
+	for (lo=0; lo<n; lo += 2*width) {
+	    mid = lo + width;
+	    if (mid > n) mid = n;
+	    hi = mid + width;
+	    if (hi > n) hi = n;
+	    i = lo; j = mid; k = lo;
+	    while (i < mid && j < hi) {
+		if (ShouldComeBefore(&from[j], &from[i])) {
+		    to[k++] = from[j++];
+		} else {
+		    to[k++] = from[i++];
+		}
 	    }
-	    return OK;
+	    while (i < mid) to[k++] = from[i++];
+	    while (j < hi)  to[k++] = from[j++];
 	}
-      
+	t = from; from = to; to = t;
     }
-    prev->next = new;
-    new->next = cur;  /* For safety - actually redundant */
-    return OK;
+    if (from != rems) {
+	memcpy(rems, from, n * sizeof(Sortrem));
+    }
+    free(tmp);
 }
 
-   
 /***************************************************************/
 /*                                                             */
 /*  IssueSortedReminders                                       */
@@ -126,16 +156,18 @@ int InsertIntoSortBuffer(int jul, int tim, char const *body, int typ, int prio)
 /***************************************************************/
 void IssueSortedReminders(void)
 {
-    Sortrem *cur = SortedQueue;
-    Sortrem *next;
+    Sortrem *cur;
     int olddate = NO_DATE;
+    int i;
 
-    while (cur) {
-	next = cur->next;
+    SortRems(Ctx->SortBuf, Ctx->NumSortRems);
+
+    for (i=0; i<Ctx->NumSortRems; i++) {
+	cur = &Ctx->SortBuf[i];
 	switch(cur->typ) {
 	case MSG_TYPE:
-	    if (MsgCommand) {
-		DoMsgCommand(MsgCommand, cur->text);
+	    if (Ctx->MsgCommand) {
+		DoMsgCommand(Ctx->MsgCommand, cur->text);
             } else {
 		if (cur->trigdate != olddate) {
 		    IssueSortBanner(cur->trigdate);
@@ -153,13 +185,27 @@ void IssueSortedReminders(void)
 	    System(cur->text);
 	    break;
 	}
-
-	free((char *) cur->text);
-	free(cur);
-	cur = next;
     }
-    SortedQueue = NULL;
+    Ctx->NumSortRems = 0;
+    ArenaFree(&Ctx->SortArena);
 }
+
+/***************************************************************/
+/*                                                             */
+/*  FreeSortBuffer                                             */
+/*                                                             */
+/*  Discard any unissued reminders and free the sort buffer.   */
+/*                                                             */
+/***************************************************************/
+void FreeSortBuffer(void)
+{
+    free(Ctx->SortBuf);
+    Ctx->SortBuf = NULL;
+    Ctx->SortBufSize = 0;
+    Ctx->NumSortRems = 0;
+    ArenaFree(&Ctx->SortArena);
+}
+
 /***************************************************************/
 /*                                                             */
 /*  IssueSortBanner                                            */
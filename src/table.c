@@ -0,0 +1,808 @@
+/***************************************************************/
+/*                                                             */
+/*  TABLE.C                                                    */
+/*                                                             */
+/*  Compiled tables (--compile=table,date):  a file such as a  */
+/*  holiday file is run once for each day of a range, and the  */
+/*  OMITs it sets and what each of its REM commands triggers   */
+/*  on each day are written to a binary table.  INCLUDEing the */
+/*  table merges its OMITs and reads, for each REM command,    */
+/*  the occurrence it triggered on today's date, written with  */
+/*  a literal date, so none of the file's triggers or          */
+/*  expressions have to be computed again.                     */
+/*                                                             */
+/*  The layout of a table is described in custom.h.            */
+/*                                                             */
+/*  This file is part of REMIND.                               */
+/*  Copyright (C) 1992-2022 by Dianne Skoll                    */
+/*                                                             */
+/***************************************************************/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "types.h"
+#include "protos.h"
+#include "globals.h"
+#include "err.h"
+#include "expr.h"
+
+#define TABLE_HASH_SIZE 251
+
+/* What a REM command triggers from day "from" until the next run
+   starts:  a REM command with a literal date, or "" for nothing */
+typedef struct {
+    int from;
+    char const *text;
+} TableRun;
+
+/* One REM command of the original file */
+typedef struct table_line {
+    struct table_line *next;
+    char const *filename;
+    int lineno;
+    int day;			/* Last day it triggered, when compiling */
+    int num;
+    int size;
+    TableRun *runs;
+} TableLine;
+
+/* A table that has been read */
+typedef struct omit_table {
+    struct omit_table *next;
+    char *filename;
+    time_t mtime;
+    off_t size;
+    int ownedByMe;
+    int first, last;
+    int weekdays;
+    int npartial, nfull, nlines;
+    int *partial;
+    int *full;
+    TableLine *lines;
+    char *data;
+} OmitTable;
+
+/* The tables read so far.  They are only touched with the file
+   cache locked, so they need no lock of their own. */
+static OmitTable *Tables;
+
+/* The table being compiled */
+static TableLine *CompHash[TABLE_HASH_SIZE];
+static TableLine **CompLines;
+static int NumCompLines, CompLinesSize;
+static int CompFull[MAX_FULL_OMITS], NumCompFull;
+static int CompPartial[MAX_PARTIAL_OMITS], NumCompPartial;
+static int CompWeekdays;
+
+/***************************************************************/
+/*                                                             */
+/*  AddToSet                                                   */
+/*                                                             */
+/*  Add key to the sorted array set of *num elements unless    */
+/*  it's there already.                                        */
+/*                                                             */
+/***************************************************************/
+static int AddToSet(int *set, int *num, int max, int key)
+{
+    int lo = 0, hi = *num, mid;
+
+    while (lo < hi) {
+	mid = (lo + hi) / 2;
+	if (set[mid] < key) lo = mid + 1;
+	else hi = mid;
+    }
+    if (lo < *num && set[lo] == key) return OK;
+    if (*num >= max) return E_2MANY_FULL;
+    memmove(set+lo+1, set+lo, (*num - lo) * sizeof(int));
+    set[lo] = key;
+    (*num)++;
+    return OK;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  FindCompLine                                               */
+/*                                                             */
+/*  Find the record for line lineno of file fname, creating    */
+/*  it the first time the line triggers.                       */
+/*                                                             */
+/***************************************************************/
+static TableLine *FindCompLine(char const *fname, int lineno)
+{
+    TableLine *l, **lines;
+    int h = lineno % TABLE_HASH_SIZE;
+
+    if (!fname) fname = "";
+    for (l = CompHash[h]; l; l = l->next) {
+	if (l->lineno == lineno && !strcmp(l->filename, fname)) return l;
+    }
+
+    if (NumCompLines == CompLinesSize) {
+	lines = realloc(CompLines, (CompLinesSize ? 2*CompLinesSize : 64) *
+			sizeof(TableLine *));
+	if (!lines) return NULL;
+	CompLines = lines;
+	CompLinesSize = CompLinesSize ? 2*CompLinesSize : 64;
+    }
+    l = calloc(1, sizeof(TableLine));
+    if (!l) return NULL;
+    l->filename = StrDup(fname);
+    if (!l->filename) {
+	free(l);
+	return NULL;
+    }
+    l->lineno = lineno;
+    l->day = NO_DATE;
+    l->next = CompHash[h];
+    CompHash[h] = l;
+    CompLines[NumCompLines++] = l;
+    return l;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  TypeName                                                   */
+/*                                                             */
+/*  The keyword for a reminder type.                           */
+/*                                                             */
+/***************************************************************/
+static char const *TypeName(int typ)
+{
+    switch(typ) {
+    case RUN_TYPE:      return "RUN";
+    case CAL_TYPE:      return "CAL";
+    case PS_TYPE:       return "PS";
+    case PSF_TYPE:      return "PSFILE";
+    case MSF_TYPE:      return "MSF";
+    case PASSTHRU_TYPE: return "SPECIAL";
+    default:            return "MSG";
+    }
+}
+
+/***************************************************************/
+/*                                                             */
+/*  RebuildReminder                                            */
+/*                                                             */
+/*  Write a REM command for the occurrence of trig on jul to   */
+/*  out, with the rest of p as its body.  An occurrence with a */
+/*  DURATION is written as it started, however far into it    */
+/*  jul is, so ComputeTrigger finds it just as it did here.    */
+/*  Expressions in the body have been evaluated by the time we */
+/*  see it, so a [ in a result is written as ["["] to keep it  */
+/*  from being evaluated again.                                */
+/*                                                             */
+/***************************************************************/
+static int RebuildReminder(ParsePtr p, Trigger const *trig,
+			   TimeTrig const *tim, int jul, DynamicBuffer *out)
+{
+    char buf[64];
+    char const *s;
+    int ttime = tim->ttime, duration = tim->duration;
+    int y, m, d, i, c, err;
+
+    if (trig->eventstart != NO_TIME) {
+	jul = trig->eventstart / MINUTES_PER_DAY;
+	ttime = trig->eventstart % MINUTES_PER_DAY;
+	if (trig->eventduration != NO_TIME) duration = trig->eventduration;
+    }
+    FromJulian(jul, &y, &m, &d);
+    sprintf(buf, "REM %04d-%02d-%02d", y, m+1, d);
+    if (DBufPuts(out, buf) != OK) return E_NO_MEM;
+    if (ttime != NO_TIME) {
+	sprintf(buf, " AT %02d:%02d", ttime / 60, ttime % 60);
+	if (DBufPuts(out, buf) != OK) return E_NO_MEM;
+	if (tim->delta) {
+	    sprintf(buf, " +%d", tim->delta);
+	    if (DBufPuts(out, buf) != OK) return E_NO_MEM;
+	}
+	if (tim->rep != NO_REP) {
+	    sprintf(buf, " *%d", tim->rep);
+	    if (DBufPuts(out, buf) != OK) return E_NO_MEM;
+	}
+    }
+    if (duration != NO_TIME) {
+	sprintf(buf, " DURATION %d:%02d", duration / 60, duration % 60);
+	if (DBufPuts(out, buf) != OK) return E_NO_MEM;
+    }
+    if (trig->priority != Ctx->DefaultPrio) {
+	sprintf(buf, " PRIORITY %d", trig->priority);
+	if (DBufPuts(out, buf) != OK) return E_NO_MEM;
+    }
+    if (trig->once && DBufPuts(out, " ONCE") != OK) return E_NO_MEM;
+
+    /* Tags are kept separated by commas */
+    s = DBufValue(&trig->tags);
+    while (*s) {
+	if (DBufPuts(out, " TAG ") != OK) return E_NO_MEM;
+	while (*s && *s != ',') {
+	    if (DBufPutc(out, *s++) != OK) return E_NO_MEM;
+	}
+	if (*s) s++;
+    }
+
+    /* The local OMIT only matters now for counting the delta */
+    if (trig->localomit) {
+	if (DBufPuts(out, " OMIT") != OK) return E_NO_MEM;
+	for (i=0; i<7; i++) {
+	    if (trig->localomit & (1 << i)) {
+		if (DBufPutc(out, ' ') != OK ||
+		    DBufPuts(out, EnglishDayName[i]) != OK) return E_NO_MEM;
+	    }
+	}
+    }
+    if (trig->delta != NO_DELTA) {
+	if (trig->delta < 0) sprintf(buf, " ++%d", -trig->delta);
+	else sprintf(buf, " +%d", trig->delta);
+	if (DBufPuts(out, buf) != OK) return E_NO_MEM;
+    }
+
+    if (DBufPutc(out, ' ') != OK ||
+	DBufPuts(out, TypeName(trig->typ)) != OK) return E_NO_MEM;
+    if (trig->typ == PASSTHRU_TYPE) {
+	if (DBufPutc(out, ' ') != OK ||
+	    DBufPuts(out, trig->passthru) != OK) return E_NO_MEM;
+    }
+
+    /* The space after the type was consumed with it */
+    if (DBufPutc(out, ' ') != OK) return E_NO_MEM;
+
+    while(1) {
+	c = ParseChar(p, &err, 0);
+	if (err) return err;
+	if (!c) break;
+	if (c == BEG_OF_EXPR && p->isnested) {
+	    if (DBufPuts(out, "[\"[\"]") != OK) return E_NO_MEM;
+	} else if (DBufPutc(out, c) != OK) {
+	    return E_NO_MEM;
+	}
+    }
+    return OK;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  AddRun                                                     */
+/*                                                             */
+/*  Record that l triggers text (which we now own) from today, */
+/*  unless that's what it triggered already.                   */
+/*                                                             */
+/***************************************************************/
+static int AddRun(TableLine *l, char *text)
+{
+    TableRun *r;
+
+    if (l->num && !strcmp(l->runs[l->num-1].text, text)) {
+	free(text);
+	return OK;
+    }
+    if (l->num == l->size) {
+	r = realloc(l->runs, (l->size ? 2*l->size : 8) * sizeof(TableRun));
+	if (!r) {
+	    free(text);
+	    return E_NO_MEM;
+	}
+	l->runs = r;
+	l->size = l->size ? 2*l->size : 8;
+    }
+    l->runs[l->num].from = Ctx->JulianToday;
+    l->runs[l->num].text = text;
+    l->num++;
+    return OK;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  TableAddReminder                                           */
+/*                                                             */
+/*  Called by the calendar code for each REM command that      */
+/*  triggers on jul while a table is being compiled.  The rest */
+/*  of p is its body.                                          */
+/*                                                             */
+/***************************************************************/
+int TableAddReminder(ParsePtr p, Trigger const *trig, TimeTrig const *tim,
+		     int jul)
+{
+    TableLine *l;
+    DynamicBuffer buf;
+    char *text;
+    int r;
+
+    if (trig->expired || jul < 0) return OK;
+    l = FindCompLine(Ctx->FileName, Ctx->LineNo);
+    if (!l) return E_NO_MEM;
+
+    /* A file INCLUDEd twice only counts the first time */
+    if (l->day == Ctx->JulianToday) return OK;
+    l->day = Ctx->JulianToday;
+
+    DBufInit(&buf);
+    r = RebuildReminder(p, trig, tim, jul, &buf);
+    text = r ? NULL : StrDup(DBufValue(&buf));
+    DBufFree(&buf);
+    if (r) return r;
+    if (!text) return E_NO_MEM;
+    return AddRun(l, text);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  EndDay                                                     */
+/*                                                             */
+/*  Note the lines that triggered nothing today, and add the   */
+/*  OMITs in force at the end of the day to the table.         */
+/*                                                             */
+/***************************************************************/
+static int EndDay(void)
+{
+    TableLine *l;
+    char *none;
+    int i, r;
+
+    for (i=0; i<NumCompLines; i++) {
+	l = CompLines[i];
+	if (l->day == Ctx->JulianToday) continue;
+	none = StrDup("");
+	if (!none) return E_NO_MEM;
+	r = AddRun(l, none);
+	if (r) return r;
+    }
+
+    for (i=0; i<Ctx->NumFullOmits; i++) {
+	r = AddToSet(CompFull, &NumCompFull, MAX_FULL_OMITS,
+		     Ctx->FullOmitArray[i]);
+	if (r) return r;
+    }
+    for (i=0; i<Ctx->NumPartialOmits; i++) {
+	r = AddToSet(CompPartial, &NumCompPartial, MAX_PARTIAL_OMITS,
+		     Ctx->PartialOmitArray[i]);
+	if (r) return E_2MANY_PART;
+    }
+    CompWeekdays |= Ctx->WeekdayOmits;
+    return OK;
+}
+
+static void PutInt(FILE *fp, int n)
+{
+    unsigned long u = (unsigned long) n;
+
+    putc(u & 0xFF, fp);
+    putc((u >> 8) & 0xFF, fp);
+    putc((u >> 16) & 0xFF, fp);
+    putc((u >> 24) & 0xFF, fp);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  WriteTable                                                 */
+/*                                                             */
+/*  Write the compiled table for first through last to fname.  */
+/*  Returns 0 or errno.                                        */
+/*                                                             */
+/***************************************************************/
+static int WriteTable(char const *fname, int first, int last)
+{
+    FILE *fp;
+    TableLine *l;
+    size_t len;
+    int i, j;
+
+    fp = fopen(fname, "wb");
+    if (!fp) return errno;
+
+    fwrite(TABLE_MAGIC, 1, TABLE_MAGIC_LEN, fp);
+    PutInt(fp, TABLE_VERSION);
+    PutInt(fp, BASE);
+    PutInt(fp, first);
+    PutInt(fp, last);
+    PutInt(fp, CompWeekdays);
+    PutInt(fp, NumCompPartial);
+    for (i=0; i<NumCompPartial; i++) PutInt(fp, CompPartial[i]);
+    PutInt(fp, NumCompFull);
+    for (i=0; i<NumCompFull; i++) PutInt(fp, CompFull[i]);
+
+    /* Lines that never triggered in the range were never recorded */
+    PutInt(fp, NumCompLines);
+    for (i=0; i<NumCompLines; i++) {
+	l = CompLines[i];
+	PutInt(fp, l->lineno);
+	PutInt(fp, l->num);
+	for (j=0; j<l->num; j++) {
+	    len = strlen(l->runs[j].text);
+	    PutInt(fp, l->runs[j].from);
+	    PutInt(fp, (int) len);
+	    fwrite(l->runs[j].text, 1, len+1, fp);
+	}
+    }
+
+    if (ferror(fp)) {
+	fclose(fp);
+	return EIO;
+    }
+    if (fclose(fp)) return errno;
+    return 0;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  FreeCompiled                                               */
+/*                                                             */
+/*  Forget the table being compiled.                           */
+/*                                                             */
+/***************************************************************/
+static void FreeCompiled(void)
+{
+    TableLine *l;
+    int i, j;
+
+    for (i=0; i<NumCompLines; i++) {
+	l = CompLines[i];
+	for (j=0; j<l->num; j++) free((char *) l->runs[j].text);
+	free(l->runs);
+	free((char *) l->filename);
+	free(l);
+    }
+    free(CompLines);
+    CompLines = NULL;
+    NumCompLines = CompLinesSize = 0;
+    memset(CompHash, 0, sizeof(CompHash));
+    NumCompFull = NumCompPartial = 0;
+    CompWeekdays = 0;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  CompileTable                                               */
+/*                                                             */
+/*  Run the initial file for each day from JulianToday through */
+/*  EventsUntil and write what it does to TableFile.  Returns  */
+/*  the exit status.                                           */
+/*                                                             */
+/***************************************************************/
+int CompileTable(void)
+{
+    int first = Ctx->JulianToday;
+    int jul, r = OK;
+
+    Ctx->ShouldCache = 1;
+    for (jul = first; jul <= Ctx->EventsUntil; jul++) {
+	/* Errors reading the file have been reported already */
+	if (RunCalendarFile(jul)) {
+	    FreeCompiled();
+	    return 1;
+	}
+	r = EndDay();
+	if (r) break;
+    }
+    ClearIncludeStack();
+    if (r) {
+	fprintf(ErrFp, "%s: %s\n", Ctx->TableFile, ErrMsg[r]);
+	FreeCompiled();
+	return 1;
+    }
+    r = WriteTable(Ctx->TableFile, first, Ctx->EventsUntil);
+    FreeCompiled();
+    if (r) {
+	fprintf(ErrFp, "%s: Cannot write `%s': %s\n", ArgV[0], Ctx->TableFile,
+		strerror(r));
+	return 1;
+    }
+    return 0;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  GetInt                                                     */
+/*                                                             */
+/*  Read an integer from a table being loaded.  Returns 0, or  */
+/*  -1 if the table ends first.                                */
+/*                                                             */
+/***************************************************************/
+static int GetInt(unsigned char const **s, unsigned char const *end, int *n)
+{
+    unsigned char const *t = *s;
+
+    if (end - t < 4) return -1;
+    *n = (int) ((unsigned long) t[0] |
+		((unsigned long) t[1] << 8) |
+		((unsigned long) t[2] << 16) |
+		((unsigned long) t[3] << 24));
+    *s = t+4;
+    return 0;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  GetInts                                                    */
+/*                                                             */
+/*  Read a count and that many integers into a new array.      */
+/*                                                             */
+/***************************************************************/
+static int GetInts(unsigned char const **s, unsigned char const *end,
+		   int max, int *num, int **array)
+{
+    int i;
+
+    if (GetInt(s, end, num) || *num < 0 || *num > max) return -1;
+    *array = malloc((*num ? *num : 1) * sizeof(int));
+    if (!*array) return -1;
+    for (i=0; i<*num; i++) {
+	if (GetInt(s, end, &(*array)[i])) return -1;
+	if (i && (*array)[i] <= (*array)[i-1]) return -1;
+    }
+    return 0;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  FreeTable                                                  */
+/*                                                             */
+/***************************************************************/
+static void FreeTable(OmitTable *t)
+{
+    int i;
+
+    if (t->lines) {
+	for (i=0; i<t->nlines; i++) free(t->lines[i].runs);
+	free(t->lines);
+    }
+    free(t->partial);
+    free(t->full);
+    free(t->data);
+    free(t->filename);
+    free(t);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  ParseTable                                                 */
+/*                                                             */
+/*  Check and index the contents of a table read into t->data. */
+/*  Returns 0, or -1 if it isn't a table we can read.          */
+/*                                                             */
+/***************************************************************/
+static int ParseTable(OmitTable *t)
+{
+    unsigned char const *s = (unsigned char const *) t->data;
+    unsigned char const *end = s + t->size;
+    TableLine *l;
+    TableRun *run;
+    int i, j, n, len;
+
+    if (end - s < TABLE_MAGIC_LEN || memcmp(s, TABLE_MAGIC, TABLE_MAGIC_LEN)) {
+	return -1;
+    }
+    s += TABLE_MAGIC_LEN;
+    if (GetInt(&s, end, &n) || n != TABLE_VERSION) return -1;
+    if (GetInt(&s, end, &n) || n != BASE) return -1;
+    if (GetInt(&s, end, &t->first) ||
+	GetInt(&s, end, &t->last) ||
+	GetInt(&s, end, &t->weekdays)) return -1;
+    if (GetInts(&s, end, MAX_PARTIAL_OMITS, &t->npartial, &t->partial) ||
+	GetInts(&s, end, MAX_FULL_OMITS, &t->nfull, &t->full)) return -1;
+
+    if (GetInt(&s, end, &t->nlines) || t->nlines < 0 ||
+	t->nlines > (end - s) / 8) return -1;
+    t->lines = calloc(t->nlines ? t->nlines : 1, sizeof(TableLine));
+    if (!t->lines) return -1;
+    for (i=0; i<t->nlines; i++) {
+	l = &t->lines[i];
+	if (GetInt(&s, end, &l->lineno) ||
+	    GetInt(&s, end, &l->num) || l->num < 0 ||
+	    l->num > (end - s) / 9) return -1;
+	l->runs = malloc((l->num ? l->num : 1) * sizeof(TableRun));
+	if (!l->runs) return -1;
+	for (j=0; j<l->num; j++) {
+	    run = &l->runs[j];
+	    if (GetInt(&s, end, &run->from) ||
+		GetInt(&s, end, &len) || len < 0 ||
+		len >= end - s || s[len]) return -1;
+	    if (j && run->from <= l->runs[j-1].from) return -1;
+	    run->text = (char const *) s;
+	    s += len + 1;
+	}
+    }
+    return 0;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  LoadTable                                                  */
+/*                                                             */
+/*  Read the table open on fp into memory.                     */
+/*                                                             */
+/***************************************************************/
+static int LoadTable(char const *fname, FILE *fp, OmitTable **out)
+{
+    struct stat statbuf;
+    OmitTable *t;
+
+    if (fstat(fileno(fp), &statbuf)) return E_CANT_OPEN;
+    t = calloc(1, sizeof(OmitTable));
+    if (!t) return E_NO_MEM;
+    t->mtime = statbuf.st_mtime;
+    t->size = statbuf.st_size;
+    t->filename = StrDup(fname);
+    t->data = malloc(t->size ? t->size : 1);
+    if (!t->filename || !t->data) {
+	FreeTable(t);
+	return E_NO_MEM;
+    }
+    if (fread(t->data, 1, t->size, fp) != (size_t) t->size) {
+	FreeTable(t);
+	return E_IO_ERR;
+    }
+    if (ParseTable(t)) {
+	fprintf(ErrFp, "%s: Not a table this version of Remind can read\n", fname);
+	FreeTable(t);
+	return E_CANT_OPEN;
+    }
+    *out = t;
+    return OK;
+}
+
+static OmitTable *FindTable(char const *fname)
+{
+    OmitTable *t;
+
+    for (t = Tables; t; t = t->next) {
+	if (!strcmp(t->filename, fname)) return t;
+    }
+    return NULL;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  IsTable                                                    */
+/*                                                             */
+/*  Return 1 if fname has been read as a table or, if fp isn't */
+/*  NULL, the file open on fp starts like one.  fp is left at  */
+/*  the start of the file.                                     */
+/*                                                             */
+/***************************************************************/
+int IsTable(char const *fname, FILE *fp)
+{
+    char magic[TABLE_MAGIC_LEN];
+    size_t n;
+
+    if (FindTable(fname)) return 1;
+    if (!fp) return 0;
+    n = fread(magic, 1, TABLE_MAGIC_LEN, fp);
+    rewind(fp);
+    return n == TABLE_MAGIC_LEN && !memcmp(magic, TABLE_MAGIC, TABLE_MAGIC_LEN);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  StartTable                                                 */
+/*                                                             */
+/*  Merge the table's OMITs and point CLine at what each of    */
+/*  its REM commands triggered on today's date.  Outside the   */
+/*  range compiled, the table has nothing.                     */
+/*                                                             */
+/***************************************************************/
+static int StartTable(OmitTable const *t)
+{
+    CachedLine *c, *prev = NULL;
+    TableLine const *l;
+    int today = Ctx->JulianToday;
+    int i, lo, hi, mid, n = 0, r;
+
+    if (Ctx->PurgeMode || today < t->first || today > t->last) return OK;
+
+    r = MergeOmits(t->full, t->nfull, t->partial, t->npartial, t->weekdays);
+    if (r) return r;
+
+    if (Ctx->TableLinesSize < t->nlines) {
+	c = realloc(Ctx->TableLines, t->nlines * sizeof(CachedLine));
+	if (!c) return E_NO_MEM;
+	Ctx->TableLines = c;
+	Ctx->TableLinesSize = t->nlines;
+    }
+
+    for (i=0; i<t->nlines; i++) {
+	l = &t->lines[i];
+	/* Find the last run starting no later than today */
+	lo = 0;
+	hi = l->num;
+	while (lo < hi) {
+	    mid = (lo + hi) / 2;
+	    if (l->runs[mid].from <= today) lo = mid + 1;
+	    else hi = mid;
+	}
+	if (!lo || !*l->runs[lo-1].text) continue;
+
+	c = &Ctx->TableLines[n++];
+	c->text = l->runs[lo-1].text;
+	c->LineNo = l->lineno;
+	c->next = NULL;
+	if (prev) prev->next = c;
+	else Ctx->CLine = c;
+	prev = c;
+    }
+    return OK;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  OpenTable                                                  */
+/*                                                             */
+/*  Start reading the table fname, reading it from fp first if */
+/*  it hasn't been read yet.  The caller closes fp.            */
+/*                                                             */
+/***************************************************************/
+int OpenTable(char const *fname, FILE *fp)
+{
+    OmitTable *t = FindTable(fname);
+    int r;
+
+    if (t) {
+	if (Ctx->DebugFlag & DB_TRACE_FILES) {
+	    fprintf(ErrFp, "Reading `%s': Found in cache\n", fname);
+	}
+	if (t->ownedByMe) Ctx->RunDisabled &= ~RUN_NOTOWNER;
+	else Ctx->RunDisabled |= RUN_NOTOWNER;
+    } else {
+	if (!fp) return E_CANT_OPEN;
+	r = LoadTable(fname, fp, &t);
+	if (r) return r;
+	t->ownedByMe = !(Ctx->RunDisabled & RUN_NOTOWNER);
+	t->next = Tables;
+	Tables = t;
+    }
+
+    Ctx->CLine = NULL;
+    STRSET(Ctx->FileName, fname);
+    Ctx->LineNo = 0;
+    if (!Ctx->FileName) return E_NO_MEM;
+    return StartTable(t);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  ClearTables                                                */
+/*                                                             */
+/*  Forget every table read, or only fname if it isn't NULL.   */
+/*                                                             */
+/***************************************************************/
+void ClearTables(char const *fname)
+{
+    OmitTable **tp = &Tables, *t;
+
+    while (*tp) {
+	t = *tp;
+	if (!fname || !strcmp(t->filename, fname)) {
+	    *tp = t->next;
+	    FreeTable(t);
+	} else {
+	    tp = &t->next;
+	}
+    }
+}
+
+/***************************************************************/
+/*                                                             */
+/*  TablesStale                                                */
+/*                                                             */
+/*  Return 1 if any table read has changed on disk since.      */
+/*                                                             */
+/***************************************************************/
+int TablesStale(void)
+{
+    OmitTable *t;
+    struct stat statbuf;
+
+    for (t = Tables; t; t = t->next) {
+	if (stat(t->filename, &statbuf) ||
+	    statbuf.st_mtime != t->mtime || statbuf.st_size != t->size) {
+	    return 1;
+	}
+    }
+    return 0;
+}
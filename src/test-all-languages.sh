@@ -1,6 +1,7 @@
 #!/bin/sh
-# Make sure Remind compiles with all supported languages; show
-# tstlang.rem output for each language.
+# Make sure Remind compiles with each supported language as its
+# default; show tstlang.rem output for each language, chosen at
+# run time with --lang.
 
 ALL=`grep ^#define lang.h | grep -v '#define LANG' | awk '{print $2}'`
 
@@ -18,6 +19,10 @@ done
 make clean
 make -j`nproc` all || exit 1
 
+for i in en de nl fi fr no da pl pt it ro es is ; do
+    ./remind -q -r --lang=$i ../tests/tstlang.rem >> $OUTPUT_RUNTIME 2>&1
+done
+
 ALL=`ls ../include/lang/*.rem`
 for i in $ALL; do
     ./remind -q -r "-ii=\"$i\"" ../tests/tstlang.rem >> $OUTPUT_RUNTIME 2>&1
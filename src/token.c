@@ -264,7 +264,7 @@ void FindNumericToken(char const *s, Token *t)
 	    return;
 	}
 	/* If we hit a colon or a period, we've probably got a time hr:min */
-	if (*s == ':' || *s == '.' || *s == TimeSep) {
+	if (*s == ':' || *s == '.' || *s == Ctx->TimeSep) {
 	    s++;
 	    hour = t->val;
 	    PARSENUM(min, s);
@@ -316,7 +316,7 @@ static int GetNextTriggerDate(Trigger *trig, int start, int *err, int *nextstart
    until we're at the start of a block of holidays */
     if (trig->skip == AFTER_SKIP) {
 	int iter = 0;
-	while (iter++ <= MaxSatIter) {
+	while (iter++ <= Ctx->MaxSatIter) {
 	    *err = IsOmitted(start-1, trig->localomit, trig->omitfunc, &omit);
 	    if (*err) return -2;
 	    if (!omit) {
@@ -324,7 +324,7 @@ static int GetNextTriggerDate(Trigger *trig, int start, int *err, int *nextstart
 	    }
 	    start--;
 	}
-	if (iter > MaxSatIter) {
+	if (iter > Ctx->MaxSatIter) {
 	    /* omitfunc must have returned "true" too often */
 	    *err = E_CANT_TRIG;
 	    return -2;
@@ -348,7 +348,7 @@ static int GetNextTriggerDate(Trigger *trig, int start, int *err, int *nextstart
 	}
 	else {
 	    int iter = 0;
-	    int max = MaxSatIter;
+	    int max = Ctx->MaxSatIter;
 	    if (max < mod*2) {
 		max = mod*2;
 	    }
@@ -380,7 +380,7 @@ static int GetNextTriggerDate(Trigger *trig, int start, int *err, int *nextstart
 /* If it's a "BEFORE"-type skip, back up */
     if (trig->skip == BEFORE_SKIP) {
 	int iter = 0;
-	while(iter++ <= MaxSatIter) {
+	while(iter++ <= Ctx->MaxSatIter) {
 	    *err = IsOmitted(simple, trig->localomit, trig->omitfunc, &omit);
 	    if (*err) return -2;
 	    if (!omit) {
@@ -388,7 +388,7 @@ static int GetNextTriggerDate(Trigger *trig, int start, int *err, int *nextstart
 	    }
 	    simple--;
 	}
-	if (iter > MaxSatIter) {
+	if (iter > Ctx->MaxSatIter) {
 	    *err = E_CANT_TRIG;
 	    return -2;
 	}
@@ -397,7 +397,7 @@ static int GetNextTriggerDate(Trigger *trig, int start, int *err, int *nextstart
 /* If it's an "AFTER"-type skip, jump ahead */
     if (trig->skip == AFTER_SKIP) {
 	int iter = 0;
-	while (iter++ <= MaxSatIter) {
+	while (iter++ <= Ctx->MaxSatIter) {
 	    *err = IsOmitted(simple, trig->localomit, trig->omitfunc, &omit);
 	    if (*err) return -2;
 	    if (!omit) {
@@ -405,7 +405,7 @@ static int GetNextTriggerDate(Trigger *trig, int start, int *err, int *nextstart
 	    }
 	    simple++;
 	}
-	if (iter > MaxSatIter) {
+	if (iter > Ctx->MaxSatIter) {
 	    *err = E_CANT_TRIG;
 	    return -2;
 	}
@@ -438,10 +438,10 @@ AdjustTriggerForDuration(int today, int r, Trigger *trig, TimeTrig *tim, int sav
 
 	/* Change trigger date to today */
 	r = today;
-	if (DebugFlag & DB_PRTTRIG) {
+	if (Ctx->DebugFlag & DB_PRTTRIG) {
 	    FromJulian(r, &y, &m, &d);
 	    fprintf(ErrFp, "%s(%d): Trig(adj) = %s, %d %s, %d",
-		    FileName, LineNo,
+		    Ctx->FileName, Ctx->LineNo,
 		    get_day_name(r % 7),
 		    d,
 		    get_month_name(m),
@@ -523,14 +523,14 @@ int ComputeTriggerNoAdjustDuration(int today, Trigger *trig, TimeTrig *tim,
 
     trig->expired = 0;
     if (save_in_globals) {
-	LastTrigValid = 0;
+	Ctx->LastTrigValid = 0;
     }
 
     /* Assume everything works */
     *err = OK;
 
     /* But check for obvious problems... */
-    if ((WeekdayOmits | trig->localomit) == 0x7F) {
+    if ((Ctx->WeekdayOmits | trig->localomit) == 0x7F) {
 	*err = E_2MANY_LOCALOMIT;
 	return -1;
     }
@@ -567,9 +567,9 @@ int ComputeTriggerNoAdjustDuration(int today, Trigger *trig, TimeTrig *tim,
 	if (*err) return -1;
 	if (result == -1) {
 	    trig->expired = 1;
-	    if (DebugFlag & DB_PRTTRIG) {
+	    if (Ctx->DebugFlag & DB_PRTTRIG) {
 		fprintf(ErrFp, "%s(%d): %s\n",
-			FileName, LineNo, ErrMsg[E_EXPIRED]);
+			Ctx->FileName, Ctx->LineNo, ErrMsg[E_EXPIRED]);
 	    }
 	    return -1;
 	}
@@ -586,13 +586,13 @@ int ComputeTriggerNoAdjustDuration(int today, Trigger *trig, TimeTrig *tim,
 	if (result+duration_days >= today &&
 	    (trig->skip != SKIP_SKIP || !omit)) {
 	    if (save_in_globals) {
-		LastTriggerDate = result;  /* Save in global var */
-		LastTrigValid = 1;
+		Ctx->LastTriggerDate = result;  /* Save in global var */
+		Ctx->LastTrigValid = 1;
 	    }
-	    if (DebugFlag & DB_PRTTRIG) {
+	    if (Ctx->DebugFlag & DB_PRTTRIG) {
 		FromJulian(result, &y, &m, &d);
 		fprintf(ErrFp, "%s(%d): Trig = %s, %d %s, %d",
-			FileName, LineNo,
+			Ctx->FileName, Ctx->LineNo,
 			get_day_name(result % 7),
 			d,
 			get_month_name(m),
@@ -617,14 +617,14 @@ int ComputeTriggerNoAdjustDuration(int today, Trigger *trig, TimeTrig *tim,
 	    trig->skip == NO_SKIP &&
 	    trig->rep == NO_REP) {
 	    trig->expired = 1;
-	    if (DebugFlag & DB_PRTTRIG) {
+	    if (Ctx->DebugFlag & DB_PRTTRIG) {
 		fprintf(ErrFp, "%s(%d): %s\n",
-			FileName, LineNo, ErrMsg[E_EXPIRED]);
+			Ctx->FileName, Ctx->LineNo, ErrMsg[E_EXPIRED]);
 	    }
 	    if (result != -1) {
 		if (save_in_globals) {
-		    LastTriggerDate = result;
-		    LastTrigValid = 1;
+		    Ctx->LastTriggerDate = result;
+		    Ctx->LastTrigValid = 1;
 		}
 	    }
 	    return -1;
@@ -641,14 +641,14 @@ int ComputeTriggerNoAdjustDuration(int today, Trigger *trig, TimeTrig *tim,
 	if (nextstart <= start) {
 	    if (result != -1) {
 		if (save_in_globals) {
-		    LastTriggerDate = result;
-		    LastTrigValid = 1;
+		    Ctx->LastTriggerDate = result;
+		    Ctx->LastTrigValid = 1;
 		}
 	    }
 	    trig->expired = 1;
-	    if (DebugFlag & DB_PRTTRIG) {
+	    if (Ctx->DebugFlag & DB_PRTTRIG) {
 		fprintf(ErrFp, "%s(%d): %s\n",
-			FileName, LineNo, ErrMsg[E_EXPIRED]);
+			Ctx->FileName, Ctx->LineNo, ErrMsg[E_EXPIRED]);
 	    }
 	    return -1;
 	}
@@ -52,6 +52,31 @@ typedef struct var {
     Value v;
 } Var;
 
+/* Define the structures needed by the file caching system */
+typedef struct cache {
+    struct cache *next;
+    char const *text;
+    int LineNo;
+} CachedLine;
+
+/* A linked list of filenames if we INCLUDE /some/directory/  */
+typedef struct fname_chain {
+    struct fname_chain *next;
+    char const *filename;
+} FilenameChain;
+
+/* Define the structures needed by the INCLUDE file system */
+typedef struct include_struct {
+    char const *filename;
+    FilenameChain *chain;
+    int LineNo;
+    unsigned int IfFlags;
+    int NumIfs;
+    long offset;
+    CachedLine *CLine;
+    int ownedByMe;
+} IncludeStruct;
+
 /* A trigger */
 typedef struct {
     int expired;
@@ -208,6 +233,21 @@ typedef struct {
 
 #define QUOTE_MARKER 1 /* Unlikely character to appear in reminder */
 
+/* A language compiled into Remind, made from one of the langs/ files;
+   see langs.c */
+typedef struct {
+    char const *Name;		/* L_LANGNAME */
+    char const *Code;		/* Its two-letter code, as in include/lang */
+    char const *DayName[7];	/* Monday first */
+    char const *MonthName[12];
+    char const *Today, *Tomorrow, *Banner, *Am, *Pm, *Ago, *Fromnow;
+    char const *On, *Now, *At, *Minute, *Hour, *Is, *Was, *And;
+    char const *Hplu, *Mplu;
+    /* DoSubst compiled with the language's L_*_OVER hooks */
+    int (*DoSubst)(ParsePtr p, DynamicBuffer *dbuf, Trigger *t,
+		   TimeTrig *tt, int jul, int mode);
+} LangTable;
+
 /* Flags for disabling run */
 #define RUN_CMDLINE  1
 #define RUN_SCRIPT   2
@@ -238,6 +278,17 @@ typedef struct {
 /* Pure JSON */
 #define PSCAL_LEVEL3  3
 
+/* HTML calendar: a complete page, or just the tables */
+#define HTML_PAGE     1
+#define HTML_TABLE    2
+
 #define TERMINAL_BACKGROUND_UNKNOWN -1
 #define TERMINAL_BACKGROUND_DARK    0
 #define TERMINAL_BACKGROUND_LIGHT   1
+
+/* Events that server-mode socket clients can subscribe to */
+#define SERVER_EV_REMINDER 1
+#define SERVER_EV_NEWDATE  2
+#define SERVER_EV_REREAD   4
+#define SERVER_EV_QUEUE    8
+#define SERVER_EV_ALL      (SERVER_EV_REMINDER | SERVER_EV_NEWDATE | SERVER_EV_REREAD | SERVER_EV_QUEUE)
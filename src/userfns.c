@@ -22,8 +22,6 @@
 #include "err.h"
 #include "expr.h"
 
-#define FUNC_HASH_SIZE 32   /* Size of User-defined function hash table */
-
 /* Define the data structure used to hold a user-defined function */
 typedef struct udf_struct {
     struct udf_struct *next;
@@ -36,17 +34,10 @@ typedef struct udf_struct {
     int lineno;
 } UserFunc;
 
-/* The hash table */
-static UserFunc *FuncHash[FUNC_HASH_SIZE];
-
 /* Access to built-in functions */
 extern int NumFuncs;
 extern BuiltinFunc Func[];
 
-/* We need access to the expression evaluation stack */
-extern Value ValStack[];
-extern int ValStackPtr;
-
 static void DestroyUserFunc (UserFunc *f);
 static void FUnset (char const *name);
 static void FSet (UserFunc *f);
@@ -123,14 +114,14 @@ int DoFset(ParsePtr p)
 	DBufFree(&buf);
 	return E_NO_MEM;
     }
-    func->filename = StrDup(FileName);
+    func->filename = StrDup(Ctx->FileName);
     if (!func->filename) {
         return E_NO_MEM;
     }
-    func->lineno = LineNo;
+    func->lineno = Ctx->LineNo;
     StrnCpy(func->name, DBufValue(&buf), VAR_NAME_LEN);
     DBufFree(&buf);
-    if (!Hush) {
+    if (!Ctx->Hush) {
 	if (FindFunc(func->name, Func, NumFuncs)) {
 	    Eprint("%s: `%s'", ErrMsg[E_REDEF_FUNC], func->name);
 	}
@@ -208,6 +199,55 @@ int DoFset(ParsePtr p)
     return OK;
 }
 
+/***************************************************************/
+/*                                                             */
+/*  CopyUserFuncs                                              */
+/*                                                             */
+/*  Give the current context a copy of every user-defined      */
+/*  function in src, which must have none of its own.          */
+/*                                                             */
+/***************************************************************/
+int CopyUserFuncs(struct RemContext const *src)
+{
+    UserFunc *f, *g, **tail;
+    Var *v, *w, **vtail;
+    int h;
+
+    for (h=0; h<FUNC_HASH_SIZE; h++) {
+	tail = &Ctx->FuncHash[h];
+	for (f = src->FuncHash[h]; f; f = f->next) {
+	    g = NEW(UserFunc);
+	    if (!g) return E_NO_MEM;
+	    *g = *f;
+	    g->next = NULL;
+	    g->IsActive = 0;
+	    g->locals = NULL;
+	    g->text = StrDup(f->text);
+	    g->filename = StrDup(f->filename);
+	    if (!g->text || !g->filename) {
+		DestroyUserFunc(g);
+		return E_NO_MEM;
+	    }
+	    vtail = &g->locals;
+	    for (v = f->locals; v; v = v->next) {
+		w = NEW(Var);
+		if (!w) {
+		    DestroyUserFunc(g);
+		    return E_NO_MEM;
+		}
+		*w = *v;
+		w->next = NULL;
+		w->v.type = ERR_TYPE;
+		*vtail = w;
+		vtail = &w->next;
+	    }
+	    *tail = g;
+	    tail = &g->next;
+	}
+    }
+    return OK;
+}
+
 /***************************************************************/
 /*                                                             */
 /*  DestroyUserFunc                                            */
@@ -253,7 +293,7 @@ static void FUnset(char const *name)
 
     h = HashVal(name) % FUNC_HASH_SIZE;
 
-    cur = FuncHash[h];
+    cur = Ctx->FuncHash[h];
     prev = NULL;
     while(cur) {
 	if (! StrinCmp(name, cur->name, VAR_NAME_LEN)) break;
@@ -261,7 +301,7 @@ static void FUnset(char const *name)
 	cur = cur->next;
     }
     if (!cur) return;
-    if (prev) prev->next = cur->next; else FuncHash[h] = cur->next;
+    if (prev) prev->next = cur->next; else Ctx->FuncHash[h] = cur->next;
     DestroyUserFunc(cur);
 }
 
@@ -275,8 +315,8 @@ static void FUnset(char const *name)
 static void FSet(UserFunc *f)
 {
     int h = HashVal(f->name) % FUNC_HASH_SIZE;
-    f->next = FuncHash[h];
-    FuncHash[h] = f;
+    f->next = Ctx->FuncHash[h];
+    Ctx->FuncHash[h] = f;
 }
 
 /***************************************************************/
@@ -294,24 +334,24 @@ int CallUserFunc(char const *name, int nargs, ParsePtr p)
     char const *s;
 
     /* Search for the function */
-    f = FuncHash[h];
+    f = Ctx->FuncHash[h];
     while (f && StrinCmp(name, f->name, VAR_NAME_LEN)) f = f->next;
     if (!f) {
 	Eprint("%s: `%s'", ErrMsg[E_UNDEF_FUNC], name);
 	return E_UNDEF_FUNC;
     }
     /* Debugging stuff */
-    if (DebugFlag & DB_PRTEXPR) {
+    if (Ctx->DebugFlag & DB_PRTEXPR) {
 	fprintf(ErrFp, "%s %s(", ErrMsg[E_ENTER_FUN], f->name);
 	for (i=0; i<nargs; i++) {
-	    PrintValue(&ValStack[ValStackPtr - nargs + i], ErrFp);
+	    PrintValue(&Ctx->ValStack[Ctx->ValStackPtr - nargs + i], ErrFp);
 	    if (i<nargs-1) fprintf(ErrFp, ", ");
 	}
 	fprintf(ErrFp, ")\n");
     }
     /* Detect illegal recursive call */
     if (f->IsActive) {
-	if (DebugFlag &DB_PRTEXPR) {
+	if (Ctx->DebugFlag &DB_PRTEXPR) {
 	    fprintf(ErrFp, "%s %s() => ", ErrMsg[E_LEAVE_FUN], name);
 	    fprintf(ErrFp, "%s\n", ErrMsg[E_RECURSIVE]);
 	}
@@ -320,7 +360,7 @@ int CallUserFunc(char const *name, int nargs, ParsePtr p)
 
     /* Check number of args */
     if (nargs != f->nargs) {
-	if (DebugFlag &DB_PRTEXPR) {
+	if (Ctx->DebugFlag &DB_PRTEXPR) {
 	    fprintf(ErrFp, "%s %s() => ", ErrMsg[E_LEAVE_FUN], name);
 	    fprintf(ErrFp, "%s\n",
 		    ErrMsg[(nargs < f->nargs) ? E_2FEW_ARGS : E_2MANY_ARGS]);
@@ -330,7 +370,7 @@ int CallUserFunc(char const *name, int nargs, ParsePtr p)
     /* Found the function - set up a local variable frame */
     h = SetUpLocalVars(f);
     if (h) {
-	if (DebugFlag &DB_PRTEXPR) {
+	if (Ctx->DebugFlag &DB_PRTEXPR) {
 	    fprintf(ErrFp, "%s %s() => ", ErrMsg[E_LEAVE_FUN], name);
 	    fprintf(ErrFp, "%s\n", ErrMsg[h]);
 	}
@@ -351,11 +391,11 @@ int CallUserFunc(char const *name, int nargs, ParsePtr p)
     }
     f->IsActive = 0;
     DestroyLocalVals(f);
-    if (DebugFlag &DB_PRTEXPR) {
+    if (Ctx->DebugFlag &DB_PRTEXPR) {
 	fprintf(ErrFp, "%s %s() => ", ErrMsg[E_LEAVE_FUN], name);
 	if (h) fprintf(ErrFp, "%s\n", ErrMsg[h]);
 	else {
-	    PrintValue(&ValStack[ValStackPtr-1], ErrFp);
+	    PrintValue(&Ctx->ValStack[Ctx->ValStackPtr-1], ErrFp);
 	    fprintf(ErrFp, "\n");
 	}
     }
@@ -413,9 +453,32 @@ int UserFuncExists(char const *fn)
     UserFunc *f;
     int h = HashVal(fn) % FUNC_HASH_SIZE;
 
-    f = FuncHash[h];
+    f = Ctx->FuncHash[h];
     while (f && StrinCmp(fn, f->name, VAR_NAME_LEN)) f = f->next;
     if (!f) return -1;
     else return f->nargs;
 }
 
+
+/***************************************************************/
+/*                                                             */
+/*  DestroyUserFuncs                                           */
+/*                                                             */
+/*  Delete every user-defined function.                        */
+/*                                                             */
+/***************************************************************/
+void DestroyUserFuncs(void)
+{
+    UserFunc *f, *next;
+    int h;
+
+    for (h=0; h<FUNC_HASH_SIZE; h++) {
+	f = Ctx->FuncHash[h];
+	while (f) {
+	    next = f->next;
+	    DestroyUserFunc(f);
+	    f = next;
+	}
+	Ctx->FuncHash[h] = NULL;
+    }
+}
@@ -20,6 +20,12 @@ static char const DontEscapeMe[] =
 #include <ctype.h>
 
 #include <stdlib.h>
+
+#if defined(__SSE2__) && defined(__GNUC__)
+#include <emmintrin.h>
+#define JSON_SPAN_SSE2 1
+#endif
+
 #include "types.h"
 #include "globals.h"
 #include "protos.h"
@@ -170,6 +176,59 @@ ShellEscape(char const *in, DynamicBuffer *out)
     return OK;
 }
 
+/***************************************************************/
+/*                                                             */
+/*  JSONPlainSpan                                              */
+/*                                                             */
+/*  Return the number of characters at the start of s that can */
+/*  go into a JSON string as-is: anything except '"', '\\'     */
+/*  and control characters, including the terminating NUL.    */
+/*  Reminder bodies are mostly plain text, so the JSON writers */
+/*  use this to copy them in bulk.                             */
+/*                                                             */
+/***************************************************************/
+size_t
+JSONPlainSpan(char const *s)
+{
+    unsigned char const *t = (unsigned char const *) s;
+
+#ifdef JSON_SPAN_SSE2
+    __m128i quote = _mm_set1_epi8('"');
+    __m128i backslash = _mm_set1_epi8('\\');
+    __m128i ctrl = _mm_set1_epi8(0x1F);
+    __m128i v;
+    int mask;
+
+    /* Go a byte at a time up to a 16-byte boundary.  Aligned loads
+       never cross into the next page, so it's safe to read past the
+       terminating NUL after that. */
+    while (((size_t) t) & 15) {
+	if (*t < 0x20 || *t == '"' || *t == '\\') {
+	    return t - (unsigned char const *) s;
+	}
+	t++;
+    }
+    while (1) {
+	v = _mm_load_si128((__m128i const *) t);
+	mask = _mm_movemask_epi8(
+	    _mm_or_si128(
+		_mm_or_si128(_mm_cmpeq_epi8(v, quote),
+			     _mm_cmpeq_epi8(v, backslash)),
+		/* max(v, 0x1F) == 0x1F exactly when v <= 0x1F */
+		_mm_cmpeq_epi8(_mm_max_epu8(v, ctrl), ctrl)));
+	if (mask) {
+	    return (t - (unsigned char const *) s) + __builtin_ctz(mask);
+	}
+	t += 16;
+    }
+#else
+    while (*t >= 0x20 && *t != '"' && *t != '\\') {
+	t++;
+    }
+    return t - (unsigned char const *) s;
+#endif
+}
+
 /* Call-stack for printing errors from user-defined functions */
 typedef struct cs_s {
     struct cs_s *next;
@@ -178,8 +237,6 @@ typedef struct cs_s {
     int lineno;
 } cs;
 
-static cs *callstack = NULL;
-
 static void
 destroy_cs(cs *entry)
 {
@@ -204,28 +261,28 @@ push_call(char const *filename, char const *func, int lineno)
         destroy_cs(entry);
         return E_NO_MEM;
     }
-    entry->next = callstack;
-    callstack = entry;
+    entry->next = Ctx->callstack;
+    Ctx->callstack = entry;
     return OK;
 }
 
 void
 clear_callstack(void)
 {
-    cs *entry = callstack;
+    cs *entry = Ctx->callstack;
     cs *next;
     while(entry) {
         next = entry->next;
         destroy_cs(entry);
         entry = next;
     }
-    callstack = NULL;
+    Ctx->callstack = NULL;
 }
 
 int
 have_callstack(void)
 {
-    if (callstack) return 1;
+    if (Ctx->callstack) return 1;
     return 0;
 }
 
@@ -242,17 +299,17 @@ print_callstack_aux(FILE *fp, cs *entry)
 int
 print_callstack(FILE *fp)
 {
-    print_callstack_aux(fp, callstack);
-    if (callstack) return 1;
+    print_callstack_aux(fp, Ctx->callstack);
+    if (Ctx->callstack) return 1;
     return 0;
 }
 
 void
 pop_call(void)
 {
-    cs *entry = callstack;
+    cs *entry = Ctx->callstack;
     if (entry) {
-        callstack = entry->next;
+        Ctx->callstack = entry->next;
         destroy_cs(entry);
     }
 }
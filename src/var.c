@@ -17,6 +17,7 @@
 #include <ctype.h>
 
 #include <stdlib.h>
+#include <stddef.h>
 #include <limits.h>
 #include <errno.h>
 #include <locale.h>
@@ -27,17 +28,10 @@
 #include "err.h"
 #define UPPER(c) (islower(c) ? toupper(c) : c)
 
-/* The variable hash table */
-#define VAR_HASH_SIZE 64
 #define VARIABLE ErrMsg[E_VAR]
 #define VALUE    ErrMsg[E_VAL]
 #define UNDEF	 ErrMsg[E_UNDEF]
 
-static int IntMin = INT_MIN;
-static int IntMax = INT_MAX;
-
-static Var *VHashTbl[VAR_HASH_SIZE];
-
 typedef int (*SysVarFunc)(int, Value *);
 
 static double
@@ -72,7 +66,7 @@ strtod_in_c_locale(char const *str, char **endptr)
 
 static void deprecated_var(char const *var, char const *instead)
 {
-    if (DebugFlag & DB_PRTLINE) {
+    if (Ctx->DebugFlag & DB_PRTLINE) {
         Wprint("%s is deprecated; use %s instead", var, instead);
     }
 }
@@ -94,32 +88,32 @@ static int latlong_component_func(int do_set, Value *val, int *var, int min, int
 }
 static int latdeg_func(int do_set, Value *val)
 {
-    return latlong_component_func(do_set, val, &LatDeg, -90, 90, "$LatDeg", "$Latitude");
+    return latlong_component_func(do_set, val, &Ctx->LatDeg, -90, 90, "$LatDeg", "$Latitude");
 }
 
 static int latmin_func(int do_set, Value *val)
 {
-    return latlong_component_func(do_set, val, &LatMin, -59, 59, "$LatMin", "$Latitude");
+    return latlong_component_func(do_set, val, &Ctx->LatMin, -59, 59, "$LatMin", "$Latitude");
 }
 
 static int latsec_func(int do_set, Value *val)
 {
-    return latlong_component_func(do_set, val, &LatSec, -59, 59, "$LatSec", "$Latitude");
+    return latlong_component_func(do_set, val, &Ctx->LatSec, -59, 59, "$LatSec", "$Latitude");
 }
 
 static int longdeg_func(int do_set, Value *val)
 {
-    return latlong_component_func(do_set, val, &LongDeg, -180, 180, "$LongDeg", "$Longitude");
+    return latlong_component_func(do_set, val, &Ctx->LongDeg, -180, 180, "$LongDeg", "$Longitude");
 }
 
 static int longmin_func(int do_set, Value *val)
 {
-    return latlong_component_func(do_set, val, &LongMin, -59, 59, "$LongMin", "$Longitude");
+    return latlong_component_func(do_set, val, &Ctx->LongMin, -59, 59, "$LongMin", "$Longitude");
 }
 
 static int longsec_func(int do_set, Value *val)
 {
-    return latlong_component_func(do_set, val, &LongSec, -59, 59, "$LongSec", "$Longitude");
+    return latlong_component_func(do_set, val, &Ctx->LongSec, -59, 59, "$LongSec", "$Longitude");
 }
 
 static int latitude_longitude_func(int do_set, Value *val, double *var, double min, double max) {
@@ -158,24 +152,56 @@ static int latitude_longitude_func(int do_set, Value *val, double *var, double m
 
 static int longitude_func(int do_set, Value *val)
 {
-    return latitude_longitude_func(do_set, val, &Longitude, -180.0, 180.0);
+    return latitude_longitude_func(do_set, val, &Ctx->Longitude, -180.0, 180.0);
 }
 
 static int latitude_func(int do_set, Value *val)
 {
-    return latitude_longitude_func(do_set, val, &Latitude, -90.0, 90.0);
+    return latitude_longitude_func(do_set, val, &Ctx->Latitude, -90.0, 90.0);
+}
+
+
+static int language_func(int do_set, Value *val)
+{
+    LangTable const *lang;
+
+    if (!do_set) {
+	val->v.str = StrDup(Ctx->Lang->Code);
+	if (!val->v.str) return E_NO_MEM;
+	val->type = STR_TYPE;
+	return OK;
+    }
+    if (val->type != STR_TYPE) return E_BAD_TYPE;
+    lang = FindLanguage(val->v.str);
+    if (!lang) return E_DOMAIN_ERR;
+    return SetLanguage(lang);
+}
+
+static int int_min_func(int do_set, Value *val)
+{
+    UNUSED(do_set);
+    val->type = INT_TYPE;
+    val->v.val = INT_MIN;
+    return OK;
 }
 
+static int int_max_func(int do_set, Value *val)
+{
+    UNUSED(do_set);
+    val->type = INT_TYPE;
+    val->v.val = INT_MAX;
+    return OK;
+}
 
 static int trig_date_func(int do_set, Value *val)
 {
     UNUSED(do_set);
-    if (!LastTrigValid) {
+    if (!Ctx->LastTrigValid) {
         val->type = INT_TYPE;
 	val->v.val = 0;
     } else {
         val->type = DATE_TYPE;
-	val->v.val = LastTriggerDate;
+	val->v.val = Ctx->LastTriggerDate;
     }
     return OK;
 }
@@ -184,12 +210,12 @@ static int trig_day_func(int do_set, Value *val)
     int y, m, d;
     UNUSED(do_set);
     val->type = INT_TYPE;
-    if (!LastTrigValid) {
+    if (!Ctx->LastTrigValid) {
 	val->v.val = -1;
 	return OK;
     }
 
-    FromJulian(LastTriggerDate, &y, &m, &d);
+    FromJulian(Ctx->LastTriggerDate, &y, &m, &d);
     val->v.val = d;
     return OK;
 }
@@ -199,12 +225,12 @@ static int trig_mon_func(int do_set, Value *val)
     int y, m, d;
     UNUSED(do_set);
     val->type = INT_TYPE;
-    if (!LastTrigValid) {
+    if (!Ctx->LastTrigValid) {
 	val->v.val = -1;
 	return OK;
     }
 
-    FromJulian(LastTriggerDate, &y, &m, &d);
+    FromJulian(Ctx->LastTriggerDate, &y, &m, &d);
     val->v.val = m+1;
     return OK;
 }
@@ -214,12 +240,12 @@ static int trig_year_func(int do_set, Value *val)
     int y, m, d;
     UNUSED(do_set);
     val->type = INT_TYPE;
-    if (!LastTrigValid) {
+    if (!Ctx->LastTrigValid) {
 	val->v.val = -1;
 	return OK;
     }
 
-    FromJulian(LastTriggerDate, &y, &m, &d);
+    FromJulian(Ctx->LastTriggerDate, &y, &m, &d);
     val->v.val = y;
     return OK;
 }
@@ -228,12 +254,12 @@ static int trig_wday_func(int do_set, Value *val)
 {
     val->type = INT_TYPE;
     UNUSED(do_set);
-    if (!LastTrigValid) {
+    if (!Ctx->LastTrigValid) {
 	val->v.val = -1;
 	return OK;
     }
 
-    val->v.val = (LastTriggerDate + 1) % 7;
+    val->v.val = (Ctx->LastTriggerDate + 1) % 7;
     return OK;
 }
 
@@ -241,7 +267,7 @@ static int today_date_func(int do_set, Value *val)
 {
     UNUSED(do_set);
     val->type = DATE_TYPE;
-    val->v.val = JulianToday;
+    val->v.val = Ctx->JulianToday;
     return OK;
 }
 static int today_day_func(int do_set, Value *val)
@@ -249,7 +275,7 @@ static int today_day_func(int do_set, Value *val)
     int y, m, d;
     UNUSED(do_set);
     val->type = INT_TYPE;
-    FromJulian(JulianToday, &y, &m, &d);
+    FromJulian(Ctx->JulianToday, &y, &m, &d);
     val->v.val = d;
     return OK;
 }
@@ -259,7 +285,7 @@ static int today_mon_func(int do_set, Value *val)
     int y, m, d;
     UNUSED(do_set);
     val->type = INT_TYPE;
-    FromJulian(JulianToday, &y, &m, &d);
+    FromJulian(Ctx->JulianToday, &y, &m, &d);
     val->v.val = m+1;
     return OK;
 }
@@ -269,7 +295,7 @@ static int today_year_func(int do_set, Value *val)
     int y, m, d;
     UNUSED(do_set);
     val->type = INT_TYPE;
-    FromJulian(JulianToday, &y, &m, &d);
+    FromJulian(Ctx->JulianToday, &y, &m, &d);
     val->v.val = y;
     return OK;
 }
@@ -278,7 +304,7 @@ static int today_wday_func(int do_set, Value *val)
 {
     UNUSED(do_set);
     val->type = INT_TYPE;
-    val->v.val = (JulianToday + 1) % 7;
+    val->v.val = (Ctx->JulianToday + 1) % 7;
     return OK;
 }
 
@@ -287,7 +313,7 @@ static int datetime_sep_func(int do_set, Value *val)
     if (!do_set) {
 	val->v.str = malloc(2);
 	if (!val->v.str) return E_NO_MEM;
-	val->v.str[0] = DateTimeSep;
+	val->v.str[0] = Ctx->DateTimeSep;
 	val->v.str[1] = 0;
 	val->type = STR_TYPE;
 	return OK;
@@ -297,7 +323,7 @@ static int datetime_sep_func(int do_set, Value *val)
 	strcmp(val->v.str, "@")) {
 	return E_BAD_TYPE;
     }
-    DateTimeSep = val->v.str[0];
+    Ctx->DateTimeSep = val->v.str[0];
     return OK;
 }
 
@@ -309,9 +335,9 @@ static int default_color_func(int do_set, Value *val)
         val->v.str = malloc(12);
         if (!val->v.str) return E_NO_MEM;
         snprintf(val->v.str, 12, "%d %d %d",
-                 DefaultColorR,
-                 DefaultColorG,
-                 DefaultColorB
+                 Ctx->DefaultColorR,
+                 Ctx->DefaultColorG,
+                 Ctx->DefaultColorB
             );
         val->type = STR_TYPE;
         return OK;
@@ -322,9 +348,9 @@ static int default_color_func(int do_set, Value *val)
     }
     /* They either all have to be -1, or all between 0 and 255 */
     if (col_r == -1 && col_g == -1 && col_b == -1) {
-	DefaultColorR = -1;
-	DefaultColorG = -1;
-	DefaultColorB = -1;
+	Ctx->DefaultColorR = -1;
+	Ctx->DefaultColorG = -1;
+	Ctx->DefaultColorB = -1;
 	return OK;
     }
     if (col_r < 0) return E_2LOW;
@@ -334,9 +360,9 @@ static int default_color_func(int do_set, Value *val)
     if (col_b < 0) return E_2LOW;
     if (col_b > 255) return E_2HIGH;
 
-    DefaultColorR = col_r;
-    DefaultColorG = col_g;
-    DefaultColorB = col_b;
+    Ctx->DefaultColorR = col_r;
+    Ctx->DefaultColorG = col_g;
+    Ctx->DefaultColorB = col_b;
     return OK;
 }
 
@@ -345,7 +371,7 @@ static int date_sep_func(int do_set, Value *val)
     if (!do_set) {
 	val->v.str = malloc(2);
 	if (!val->v.str) return E_NO_MEM;
-	val->v.str[0] = DateSep;
+	val->v.str[0] = Ctx->DateSep;
 	val->v.str[1] = 0;
 	val->type = STR_TYPE;
 	return OK;
@@ -355,7 +381,7 @@ static int date_sep_func(int do_set, Value *val)
 	strcmp(val->v.str, "-")) {
 	return E_BAD_TYPE;
     }
-    DateSep = val->v.str[0];
+    Ctx->DateSep = val->v.str[0];
     return OK;
 }
 
@@ -364,7 +390,7 @@ static int time_sep_func(int do_set, Value *val)
     if (!do_set) {
 	val->v.str = malloc(2);
 	if (!val->v.str) return E_NO_MEM;
-	val->v.str[0] = TimeSep;
+	val->v.str[0] = Ctx->TimeSep;
 	val->v.str[1] = 0;
 	val->type = STR_TYPE;
 	return OK;
@@ -374,7 +400,7 @@ static int time_sep_func(int do_set, Value *val)
 	strcmp(val->v.str, ".")) {
 	return E_BAD_TYPE;
     }
-    TimeSep = val->v.str[0];
+    Ctx->TimeSep = val->v.str[0];
     return OK;
 }
 
@@ -413,7 +439,7 @@ Var *FindVar(char const *str, int create)
     register Var *prev;
 
     h = HashVal(str) % VAR_HASH_SIZE;
-    v = VHashTbl[h];
+    v = Ctx->VHashTbl[h];
     prev = NULL;
 
     while(v) {
@@ -432,7 +458,7 @@ Var *FindVar(char const *str, int create)
     v->preserve = 0;
     StrnCpy(v->name, str, VAR_NAME_LEN);
 
-    if (prev) prev->next = v; else VHashTbl[h] = v;
+    if (prev) prev->next = v; else Ctx->VHashTbl[h] = v;
     return v;
 }
 
@@ -450,7 +476,7 @@ int DeleteVar(char const *str)
     register Var *prev;
 
     h = HashVal(str) % VAR_HASH_SIZE;
-    v = VHashTbl[h];
+    v = Ctx->VHashTbl[h];
     prev = NULL;
 
     while(v) {
@@ -460,7 +486,7 @@ int DeleteVar(char const *str)
     }
     if (!v) return E_NOSUCH_VAR;
     DestroyValue(v->v);
-    if (prev) prev->next = v->next; else VHashTbl[h] = v->next;
+    if (prev) prev->next = v->next; else Ctx->VHashTbl[h] = v->next;
     free(v);
     return OK;
 }
@@ -596,7 +622,7 @@ int DoDump(ParsePtr p)
     Var *v;
     DynamicBuffer buf;
 
-    if (PurgeMode) return OK;
+    if (Ctx->PurgeMode) return OK;
 
     DBufInit(&buf);
     r = ParseToken(p, &buf);
@@ -649,7 +675,7 @@ void DumpVarTable(void)
     fprintf(ErrFp, "%s  %s\n\n", VARIABLE, VALUE);
 
     for (i=0; i<VAR_HASH_SIZE; i++) {
-	v = VHashTbl[i];
+	v = Ctx->VHashTbl[i];
 	while(v) {
 	    fprintf(ErrFp, "%s  ", v->name);
 	    PrintValue(&(v->v), ErrFp);
@@ -673,8 +699,8 @@ void DestroyVars(int all)
     Var *v, *next, *prev;
 
     for (i=0; i<VAR_HASH_SIZE; i++) {
-	v = VHashTbl[i];
-	VHashTbl[i] = NULL;
+	v = Ctx->VHashTbl[i];
+	Ctx->VHashTbl[i] = NULL;
 	prev = NULL;
 	while(v) {
 	    if (all || !v->preserve) {
@@ -683,7 +709,7 @@ void DestroyVars(int all)
 		free(v);
 	    } else {
 		if (prev) prev->next = v;
-		else VHashTbl[i] = v;
+		else Ctx->VHashTbl[i] = v;
 		prev = v;
 		next = v->next;
 		v->next = NULL;
@@ -710,6 +736,144 @@ int PreserveVar(char const *name)
     return OK;
 }
 
+/***************************************************************/
+/*                                                             */
+/*  CopyVars                                                   */
+/*                                                             */
+/*  Give the current context a copy of every variable in src,  */
+/*  which must have none of its own.                           */
+/*                                                             */
+/***************************************************************/
+int CopyVars(struct RemContext const *src)
+{
+    int i, r;
+    Var *v, *w, **tail;
+
+    for (i=0; i<VAR_HASH_SIZE; i++) {
+	tail = &Ctx->VHashTbl[i];
+	for (v = src->VHashTbl[i]; v; v = v->next) {
+	    w = NEW(Var);
+	    if (!w) return E_NO_MEM;
+	    *w = *v;
+	    w->next = NULL;
+	    r = CopyValue(&w->v, &v->v);
+	    if (r) {
+		free(w);
+		return r;
+	    }
+	    *tail = w;
+	    tail = &w->next;
+	}
+    }
+    return OK;
+}
+
+/* Add a copy of v to the front of the base variables */
+static int AddBaseVar(Var const *v)
+{
+    Var *w = NEW(Var);
+    int r;
+
+    if (!w) return E_NO_MEM;
+    *w = *v;
+    r = CopyValue(&w->v, &v->v);
+    if (r) {
+	free(w);
+	return r;
+    }
+    w->next = Ctx->BaseVars;
+    Ctx->BaseVars = w;
+    return OK;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  SetBaseVars                                                */
+/*                                                             */
+/*  Take a copy of every variable that exists now, for         */
+/*  RestoreBaseVars to put back before each calendar day.      */
+/*  Unlike preserving them, this throws away whatever changes  */
+/*  the day before made.                                       */
+/*                                                             */
+/***************************************************************/
+int SetBaseVars(void)
+{
+    int i, r;
+    Var *v;
+
+    DestroyBaseVars();
+    for (i=0; i<VAR_HASH_SIZE; i++) {
+	for (v = Ctx->VHashTbl[i]; v; v = v->next) {
+	    r = AddBaseVar(v);
+	    if (r) return r;
+	}
+    }
+    return OK;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  CopyBaseVars                                               */
+/*                                                             */
+/*  Give the current context a copy of src's base variables.   */
+/*                                                             */
+/***************************************************************/
+int CopyBaseVars(struct RemContext const *src)
+{
+    Var const *v;
+    int r;
+
+    for (v = src->BaseVars; v; v = v->next) {
+	r = AddBaseVar(v);
+	if (r) return r;
+    }
+    return OK;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  RestoreBaseVars                                            */
+/*                                                             */
+/*  Give each base variable the value it had when SetBaseVars  */
+/*  was called, unless a preserved variable (from -i, say) has */
+/*  taken its name.                                            */
+/*                                                             */
+/***************************************************************/
+int RestoreBaseVars(void)
+{
+    Var const *b;
+    Var *v;
+
+    for (b = Ctx->BaseVars; b; b = b->next) {
+	v = FindVar(b->name, 0);
+	if (v && v->preserve) continue;
+	if (!v) v = FindVar(b->name, 1);
+	if (!v) return E_NO_MEM;
+	DestroyValue(v->v);
+	if (CopyValue(&v->v, &b->v)) return E_NO_MEM;
+    }
+    return OK;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  DestroyBaseVars                                            */
+/*                                                             */
+/*  Forget the base variables set by SetBaseVars.              */
+/*                                                             */
+/***************************************************************/
+void DestroyBaseVars(void)
+{
+    Var *v, *next;
+
+    for (v = Ctx->BaseVars; v; v = next) {
+	next = v->next;
+	DestroyValue(v->v);
+	free(v);
+    }
+    Ctx->BaseVars = NULL;
+}
+
 /***************************************************************/
 /*                                                             */
 /*  DoPreserve - preserve a bunch of variables.                */
@@ -760,121 +924,124 @@ typedef struct {
     char const *name;
     char modifiable;
     int type;
-    void *value;
+    size_t offset;      /* Of the value in RemContext */
+    SysVarFunc func;    /* For SPECIAL_TYPE */
     int min;
     int max;
 } SysVar;
 
-/* If the type of a sys variable is STR_TYPE, then min is redefined
-   to be a flag indicating whether or not the value has been malloc'd. */
-#define been_malloced min
+#define CTX_OFF(var) offsetof(RemContext, var)
+
+/* The value of an INT_TYPE or STR_TYPE variable in the current context */
+#define SysVarValue(v) ((void *) (((char *) Ctx) + (v)->offset))
 
 /* Flag for no min/max constraint */
 #define ANY -31415926
 
 /* All of the system variables sorted alphabetically */
 static SysVar SysVarArr[] = {
-    /*  name          mod  type              value          min/mal   max */
-    {"AddBlankLines",  1,  INT_TYPE,     &AddBlankLines,       0,      1 },
-    {"Ago",            1,  STR_TYPE,     &DynamicAgo,          0,      0 },
-    {"Am",             1,  STR_TYPE,     &DynamicAm,           0,      0 },
-    {"And",            1,  STR_TYPE,     &DynamicAnd,          0,      0 },
-    {"April",          1,  STR_TYPE,     &DynamicMonthName[3], 0,      0 },
-    {"At",             1,  STR_TYPE,     &DynamicAt,           0,      0 },
-    {"August",         1,  STR_TYPE,     &DynamicMonthName[7], 0,      0 },
-    {"CalcUTC",        1,  INT_TYPE,     &CalculateUTC,        0,      1 },
-    {"CalMode",        0,  INT_TYPE,     &DoCalendar,          0,      0 },
-    {"Daemon",         0,  INT_TYPE,     &Daemon,              0,      0 },
-    {"DateSep",        1,  SPECIAL_TYPE, date_sep_func,        0,      0 },
-    {"DateTimeSep",    1,  SPECIAL_TYPE, datetime_sep_func,    0,      0 },
-    {"December",       1,  STR_TYPE,     &DynamicMonthName[11],0,      0 },
-    {"DefaultColor",   1,  SPECIAL_TYPE, default_color_func,   0,      0 },
-    {"DefaultPrio",    1,  INT_TYPE,     &DefaultPrio,         0,      9999 },
-    {"DefaultTDelta",  1,  INT_TYPE,     &DefaultTDelta,       0,      1440 },
-    {"DeltaOffset",    0,  INT_TYPE,     &DeltaOffset,         0,      0 },
-    {"DontFork",       0,  INT_TYPE,     &DontFork,            0,      0 },
-    {"DontQueue",      0,  INT_TYPE,     &DontQueue,           0,      0 },
-    {"DontTrigAts",    0,  INT_TYPE,     &DontIssueAts,        0,      0 },
-    {"EndSent",        1,  STR_TYPE,     &EndSent,             0,      0 },
-    {"EndSentIg",      1,  STR_TYPE,     &EndSentIg,           0,      0 },
-    {"February",       1,  STR_TYPE,     &DynamicMonthName[1], 0,      0 },
-    {"FirstIndent",    1,  INT_TYPE,     &FirstIndent,         0,      132 },
-    {"FoldYear",       1,  INT_TYPE,     &FoldYear,            0,      1 },
-    {"FormWidth",      1,  INT_TYPE,     &FormWidth,           20,     500 },
-    {"Friday",         1,  STR_TYPE,     &DynamicDayName[4],   0,      0 },
-    {"Fromnow",        1,  STR_TYPE,     &DynamicFromnow,      0,      0 },
-    {"Hour",           1,  STR_TYPE,     &DynamicHour,         0,      0 },
-    {"Hplu",           1,  STR_TYPE,     &DynamicHplu,         0,      0 },
-    {"HushMode",       0,  INT_TYPE,     &Hush,                0,      0 },
-    {"IgnoreOnce",     0,  INT_TYPE,     &IgnoreOnce,          0,      0 },
-    {"InfDelta",       0,  INT_TYPE,     &InfiniteDelta,       0,      0 },
-    {"IntMax",         0,  INT_TYPE,     &IntMax,              0,      0 },
-    {"IntMin",         0,  INT_TYPE,     &IntMin,              0,      0 },
-    {"Is",             1,  STR_TYPE,     &DynamicIs,           0,      0 },
-    {"January",        1,  STR_TYPE,     &DynamicMonthName[0], 0,      0 },
-    {"July",           1,  STR_TYPE,     &DynamicMonthName[6], 0,      0 },
-    {"June",           1,  STR_TYPE,     &DynamicMonthName[5], 0,      0 },
-    {"LatDeg",         1,  SPECIAL_TYPE, latdeg_func,          0,      0 },
-    {"Latitude",       1,  SPECIAL_TYPE, latitude_func,        0,      0 },
-    {"LatMin",         1,  SPECIAL_TYPE, latmin_func,          0,      0 },
-    {"LatSec",         1,  SPECIAL_TYPE, latsec_func,          0,      0 },
-    {"Location",       1,  STR_TYPE,     &Location,            0,      0 },
-    {"LongDeg",        1,  SPECIAL_TYPE, longdeg_func,         0,      0 },
-    {"Longitude",      1,  SPECIAL_TYPE, longitude_func,       0,      0 },
-    {"LongMin",        1,  SPECIAL_TYPE, longmin_func,         0,      0 },
-    {"LongSec",        1,  SPECIAL_TYPE, longsec_func,         0,      0 },
-    {"March",          1,  STR_TYPE,     &DynamicMonthName[2], 0,      0 },
-    {"MaxSatIter",     1,  INT_TYPE,     &MaxSatIter,          10,     ANY },
-    {"MaxStringLen",   1,  INT_TYPE,     &MaxStringLen,        -1,     ANY },
-    {"May",            1,  STR_TYPE,     &DynamicMonthName[4], 0,      0 },
-    {"MinsFromUTC",    1,  INT_TYPE,     &MinsFromUTC,         -780,   780 },
-    {"Minute",         1,  STR_TYPE,     &DynamicMinute,       0,      0 },
-    {"Monday",         1,  STR_TYPE,     &DynamicDayName[0],   0,      0 },
-    {"Mplu",           1,  STR_TYPE,     &DynamicMplu,         0,      0 },
-    {"NextMode",       0,  INT_TYPE,     &NextMode,            0,      0 },
-    {"November",       1,  STR_TYPE,     &DynamicMonthName[10],0,      0 },
-    {"Now",            1,  STR_TYPE,     &DynamicNow,          0,      0 },
-    {"NumQueued",      0,  INT_TYPE,     &NumQueued,           0,      0 },
-    {"NumTrig",        0,  INT_TYPE,     &NumTriggered,        0,      0 },
-    {"October",        1,  STR_TYPE,     &DynamicMonthName[9], 0,      0 },
-    {"On",             1,  STR_TYPE,     &DynamicOn,           0,      0 },
-    {"Pm",             1,  STR_TYPE,     &DynamicPm,           0,      0 },
-    {"PrefixLineNo",   0,  INT_TYPE,     &DoPrefixLineNo,      0,      0 },
-    {"PSCal",          0,  INT_TYPE,     &PsCal,               0,      0 },
-    {"RunOff",         0,  INT_TYPE,     &RunDisabled,         0,      0 },
-    {"Saturday",       1,  STR_TYPE,     &DynamicDayName[5],   0,      0 },
-    {"September",      1,  STR_TYPE,     &DynamicMonthName[8], 0,      0 },
-    {"SimpleCal",      0,  INT_TYPE,     &DoSimpleCalendar,    0,      0 },
-    {"SortByDate",     0,  INT_TYPE,     &SortByDate,          0,      0 },
-    {"SortByPrio",     0,  INT_TYPE,     &SortByPrio,          0,      0 },
-    {"SortByTime",     0,  INT_TYPE,     &SortByTime,          0,      0 },
-    {"SubsIndent",     1,  INT_TYPE,     &SubsIndent,          0,      132 },
-    {"Sunday",         1,  STR_TYPE,     &DynamicDayName[6],   0,      0 },
-    {"SuppressLRM",    1,  INT_TYPE,     &SuppressLRM,         0,      1 },
-    {"SysInclude",     0,  STR_TYPE,     &SysDir,              0,      0 },
-    {"T",              0,  SPECIAL_TYPE, trig_date_func,       0,      0 },
-    {"Td",             0,  SPECIAL_TYPE, trig_day_func,        0,      0 },
-    {"TerminalBackground", 0, INT_TYPE,  &TerminalBackground,  0,      0 },
-    {"Thursday",       1,  STR_TYPE,     &DynamicDayName[3],   0,      0 },
-    {"TimeSep",        1,  SPECIAL_TYPE, time_sep_func,        0,      0 },
-    {"Tm",             0,  SPECIAL_TYPE, trig_mon_func,        0,      0 },
-    {"Today",          1,  STR_TYPE,     &DynamicToday,        0,      0 },
-    {"Tomorrow",       1,  STR_TYPE,     &DynamicTomorrow,     0,      0 },
-    {"Tuesday",        1,  STR_TYPE,     &DynamicDayName[1],   0,      0 },
-    {"Tw",             0,  SPECIAL_TYPE, trig_wday_func,       0,      0 },
-    {"Ty",             0,  SPECIAL_TYPE, trig_year_func,       0,      0 },
-    {"U",              0,  SPECIAL_TYPE, today_date_func,      0,      0 },
-    {"Ud",             0,  SPECIAL_TYPE, today_day_func,       0,      0 },
-    {"Um",             0,  SPECIAL_TYPE, today_mon_func,       0,      0 },
-    {"UntimedFirst",   0,  INT_TYPE,     &UntimedBeforeTimed,  0,      0 },
-    {"Use256Colors",   0,  INT_TYPE,     &Use256Colors,        0,      0 },
-    {"UseBGVTColors",  0,  INT_TYPE,     &UseBGVTColors,        0,      0 },
-    {"UseTrueColors",  0,  INT_TYPE,     &UseTrueColors,       0,      0 },
-    {"UseVTColors",    0,  INT_TYPE,     &UseVTColors,         0,      0 },
-    {"Uw",             0,  SPECIAL_TYPE, today_wday_func,      0,      0 },
-    {"Uy",             0,  SPECIAL_TYPE, today_year_func,      0,      0 },
-    {"Was",            1,  STR_TYPE,     &DynamicWas,          0,      0 },
-    {"Wednesday",      1,  STR_TYPE,     &DynamicDayName[2],   0,      0 }
+    /*  name              mod  type          offset                          func                  min    max */
+    {"AddBlankLines",      1, INT_TYPE,     CTX_OFF(AddBlankLines),         NULL,                    0,     1 },
+    {"Ago",                1, STR_TYPE,     CTX_OFF(DynamicAgo),            NULL,                    0,     0 },
+    {"Am",                 1, STR_TYPE,     CTX_OFF(DynamicAm),             NULL,                    0,     0 },
+    {"And",                1, STR_TYPE,     CTX_OFF(DynamicAnd),            NULL,                    0,     0 },
+    {"April",              1, STR_TYPE,     CTX_OFF(DynamicMonthName[3]),   NULL,                    0,     0 },
+    {"At",                 1, STR_TYPE,     CTX_OFF(DynamicAt),             NULL,                    0,     0 },
+    {"August",             1, STR_TYPE,     CTX_OFF(DynamicMonthName[7]),   NULL,                    0,     0 },
+    {"CalcUTC",            1, INT_TYPE,     CTX_OFF(CalculateUTC),          NULL,                    0,     1 },
+    {"CalMode",            0, INT_TYPE,     CTX_OFF(DoCalendar),            NULL,                    0,     0 },
+    {"Daemon",             0, INT_TYPE,     CTX_OFF(Daemon),                NULL,                    0,     0 },
+    {"DateSep",            1, SPECIAL_TYPE, 0,                              date_sep_func,           0,     0 },
+    {"DateTimeSep",        1, SPECIAL_TYPE, 0,                              datetime_sep_func,       0,     0 },
+    {"December",           1, STR_TYPE,     CTX_OFF(DynamicMonthName[11]),  NULL,                    0,     0 },
+    {"DefaultColor",       1, SPECIAL_TYPE, 0,                              default_color_func,      0,     0 },
+    {"DefaultPrio",        1, INT_TYPE,     CTX_OFF(DefaultPrio),           NULL,                    0,  9999 },
+    {"DefaultTDelta",      1, INT_TYPE,     CTX_OFF(DefaultTDelta),         NULL,                    0,  1440 },
+    {"DeltaOffset",        0, INT_TYPE,     CTX_OFF(DeltaOffset),           NULL,                    0,     0 },
+    {"DontFork",           0, INT_TYPE,     CTX_OFF(DontFork),              NULL,                    0,     0 },
+    {"DontQueue",          0, INT_TYPE,     CTX_OFF(DontQueue),             NULL,                    0,     0 },
+    {"DontTrigAts",        0, INT_TYPE,     CTX_OFF(DontIssueAts),          NULL,                    0,     0 },
+    {"EndSent",            1, STR_TYPE,     CTX_OFF(EndSent),               NULL,                    0,     0 },
+    {"EndSentIg",          1, STR_TYPE,     CTX_OFF(EndSentIg),             NULL,                    0,     0 },
+    {"February",           1, STR_TYPE,     CTX_OFF(DynamicMonthName[1]),   NULL,                    0,     0 },
+    {"FirstIndent",        1, INT_TYPE,     CTX_OFF(FirstIndent),           NULL,                    0,   132 },
+    {"FoldYear",           1, INT_TYPE,     CTX_OFF(FoldYear),              NULL,                    0,     1 },
+    {"FormWidth",          1, INT_TYPE,     CTX_OFF(FormWidth),             NULL,                   20,   500 },
+    {"Friday",             1, STR_TYPE,     CTX_OFF(DynamicDayName[4]),     NULL,                    0,     0 },
+    {"Fromnow",            1, STR_TYPE,     CTX_OFF(DynamicFromnow),        NULL,                    0,     0 },
+    {"Hour",               1, STR_TYPE,     CTX_OFF(DynamicHour),           NULL,                    0,     0 },
+    {"Hplu",               1, STR_TYPE,     CTX_OFF(DynamicHplu),           NULL,                    0,     0 },
+    {"HushMode",           0, INT_TYPE,     CTX_OFF(Hush),                  NULL,                    0,     0 },
+    {"IgnoreOnce",         0, INT_TYPE,     CTX_OFF(IgnoreOnce),            NULL,                    0,     0 },
+    {"InfDelta",           0, INT_TYPE,     CTX_OFF(InfiniteDelta),         NULL,                    0,     0 },
+    {"IntMax",             0, SPECIAL_TYPE, 0,                              int_max_func,            0,     0 },
+    {"IntMin",             0, SPECIAL_TYPE, 0,                              int_min_func,            0,     0 },
+    {"Is",                 1, STR_TYPE,     CTX_OFF(DynamicIs),             NULL,                    0,     0 },
+    {"January",            1, STR_TYPE,     CTX_OFF(DynamicMonthName[0]),   NULL,                    0,     0 },
+    {"July",               1, STR_TYPE,     CTX_OFF(DynamicMonthName[6]),   NULL,                    0,     0 },
+    {"June",               1, STR_TYPE,     CTX_OFF(DynamicMonthName[5]),   NULL,                    0,     0 },
+    {"Language",           1, SPECIAL_TYPE, 0,                              language_func,           0,     0 },
+    {"LatDeg",             1, SPECIAL_TYPE, 0,                              latdeg_func,             0,     0 },
+    {"Latitude",           1, SPECIAL_TYPE, 0,                              latitude_func,           0,     0 },
+    {"LatMin",             1, SPECIAL_TYPE, 0,                              latmin_func,             0,     0 },
+    {"LatSec",             1, SPECIAL_TYPE, 0,                              latsec_func,             0,     0 },
+    {"Location",           1, STR_TYPE,     CTX_OFF(Location),              NULL,                    0,     0 },
+    {"LongDeg",            1, SPECIAL_TYPE, 0,                              longdeg_func,            0,     0 },
+    {"Longitude",          1, SPECIAL_TYPE, 0,                              longitude_func,          0,     0 },
+    {"LongMin",            1, SPECIAL_TYPE, 0,                              longmin_func,            0,     0 },
+    {"LongSec",            1, SPECIAL_TYPE, 0,                              longsec_func,            0,     0 },
+    {"March",              1, STR_TYPE,     CTX_OFF(DynamicMonthName[2]),   NULL,                    0,     0 },
+    {"MaxSatIter",         1, INT_TYPE,     CTX_OFF(MaxSatIter),            NULL,                   10,   ANY },
+    {"MaxStringLen",       1, INT_TYPE,     CTX_OFF(MaxStringLen),          NULL,                   -1,   ANY },
+    {"May",                1, STR_TYPE,     CTX_OFF(DynamicMonthName[4]),   NULL,                    0,     0 },
+    {"MinsFromUTC",        1, INT_TYPE,     CTX_OFF(MinsFromUTC),           NULL,                 -780,   780 },
+    {"Minute",             1, STR_TYPE,     CTX_OFF(DynamicMinute),         NULL,                    0,     0 },
+    {"Monday",             1, STR_TYPE,     CTX_OFF(DynamicDayName[0]),     NULL,                    0,     0 },
+    {"Mplu",               1, STR_TYPE,     CTX_OFF(DynamicMplu),           NULL,                    0,     0 },
+    {"NextMode",           0, INT_TYPE,     CTX_OFF(NextMode),              NULL,                    0,     0 },
+    {"November",           1, STR_TYPE,     CTX_OFF(DynamicMonthName[10]),  NULL,                    0,     0 },
+    {"Now",                1, STR_TYPE,     CTX_OFF(DynamicNow),            NULL,                    0,     0 },
+    {"NumQueued",          0, INT_TYPE,     CTX_OFF(NumQueued),             NULL,                    0,     0 },
+    {"NumTrig",            0, INT_TYPE,     CTX_OFF(NumTriggered),          NULL,                    0,     0 },
+    {"October",            1, STR_TYPE,     CTX_OFF(DynamicMonthName[9]),   NULL,                    0,     0 },
+    {"On",                 1, STR_TYPE,     CTX_OFF(DynamicOn),             NULL,                    0,     0 },
+    {"Pm",                 1, STR_TYPE,     CTX_OFF(DynamicPm),             NULL,                    0,     0 },
+    {"PrefixLineNo",       0, INT_TYPE,     CTX_OFF(DoPrefixLineNo),        NULL,                    0,     0 },
+    {"PSCal",              0, INT_TYPE,     CTX_OFF(PsCal),                 NULL,                    0,     0 },
+    {"RunOff",             0, INT_TYPE,     CTX_OFF(RunDisabled),           NULL,                    0,     0 },
+    {"Saturday",           1, STR_TYPE,     CTX_OFF(DynamicDayName[5]),     NULL,                    0,     0 },
+    {"September",          1, STR_TYPE,     CTX_OFF(DynamicMonthName[8]),   NULL,                    0,     0 },
+    {"SimpleCal",          0, INT_TYPE,     CTX_OFF(DoSimpleCalendar),      NULL,                    0,     0 },
+    {"SortByDate",         0, INT_TYPE,     CTX_OFF(SortByDate),            NULL,                    0,     0 },
+    {"SortByPrio",         0, INT_TYPE,     CTX_OFF(SortByPrio),            NULL,                    0,     0 },
+    {"SortByTime",         0, INT_TYPE,     CTX_OFF(SortByTime),            NULL,                    0,     0 },
+    {"SubsIndent",         1, INT_TYPE,     CTX_OFF(SubsIndent),            NULL,                    0,   132 },
+    {"Sunday",             1, STR_TYPE,     CTX_OFF(DynamicDayName[6]),     NULL,                    0,     0 },
+    {"SuppressLRM",        1, INT_TYPE,     CTX_OFF(SuppressLRM),           NULL,                    0,     1 },
+    {"SysInclude",         0, STR_TYPE,     CTX_OFF(SysDir),                NULL,                    0,     0 },
+    {"T",                  0, SPECIAL_TYPE, 0,                              trig_date_func,          0,     0 },
+    {"Td",                 0, SPECIAL_TYPE, 0,                              trig_day_func,           0,     0 },
+    {"TerminalBackground", 0, INT_TYPE,     CTX_OFF(TerminalBackground),    NULL,                    0,     0 },
+    {"Thursday",           1, STR_TYPE,     CTX_OFF(DynamicDayName[3]),     NULL,                    0,     0 },
+    {"TimeSep",            1, SPECIAL_TYPE, 0,                              time_sep_func,           0,     0 },
+    {"Tm",                 0, SPECIAL_TYPE, 0,                              trig_mon_func,           0,     0 },
+    {"Today",              1, STR_TYPE,     CTX_OFF(DynamicToday),          NULL,                    0,     0 },
+    {"Tomorrow",           1, STR_TYPE,     CTX_OFF(DynamicTomorrow),       NULL,                    0,     0 },
+    {"Tuesday",            1, STR_TYPE,     CTX_OFF(DynamicDayName[1]),     NULL,                    0,     0 },
+    {"Tw",                 0, SPECIAL_TYPE, 0,                              trig_wday_func,          0,     0 },
+    {"Ty",                 0, SPECIAL_TYPE, 0,                              trig_year_func,          0,     0 },
+    {"U",                  0, SPECIAL_TYPE, 0,                              today_date_func,         0,     0 },
+    {"Ud",                 0, SPECIAL_TYPE, 0,                              today_day_func,          0,     0 },
+    {"Um",                 0, SPECIAL_TYPE, 0,                              today_mon_func,          0,     0 },
+    {"UntimedFirst",       0, INT_TYPE,     CTX_OFF(UntimedBeforeTimed),    NULL,                    0,     0 },
+    {"Use256Colors",       0, INT_TYPE,     CTX_OFF(Use256Colors),          NULL,                    0,     0 },
+    {"UseBGVTColors",      0, INT_TYPE,     CTX_OFF(UseBGVTColors),         NULL,                    0,     0 },
+    {"UseTrueColors",      0, INT_TYPE,     CTX_OFF(UseTrueColors),         NULL,                    0,     0 },
+    {"UseVTColors",        0, INT_TYPE,     CTX_OFF(UseVTColors),           NULL,                    0,     0 },
+    {"Uw",                 0, SPECIAL_TYPE, 0,                              today_wday_func,         0,     0 },
+    {"Uy",                 0, SPECIAL_TYPE, 0,                              today_year_func,         0,     0 },
+    {"Was",                1, STR_TYPE,     CTX_OFF(DynamicWas),            NULL,                    0,     0 },
+    {"Wednesday",          1, STR_TYPE,     CTX_OFF(DynamicDayName[2]),     NULL,                    0,     0 }
 };
 
 #define NUMSYSVARS ( sizeof(SysVarArr) / sizeof(SysVar) )
@@ -900,28 +1067,28 @@ int SetSysVar(char const *name, Value *value)
     }
 
     if (v->type == SPECIAL_TYPE) {
-	SysVarFunc f = (SysVarFunc) v->value;
-	r = f(1, value);
+	r = v->func(1, value);
         DestroyValue(*value);
         return r;
     }
 
     if (v->type == STR_TYPE) {
+	char **str = (char **) SysVarValue(v);
+
         /* If it's already the same, don't bother doing anything */
-        if (!strcmp(value->v.str, (char const *) v->value)) {
+        if (*str && !strcmp(value->v.str, *str)) {
             DestroyValue(*value);
             return OK;
         }
 
-        /* If it's a string variable, special measures must be taken */
-	if (v->been_malloced) free(*((char **)(v->value)));
-	v->been_malloced = 1;
-	*((char **) v->value) = value->v.str;
+        /* The context owns a copy of each string; see InitSysVars */
+	free(*str);
+	*str = value->v.str;
 	value->type = ERR_TYPE;  /* So that it's not accidentally freed */
     } else {
 	if (v->max != ANY && value->v.val > v->max) return E_2HIGH;
 	if (v->min != ANY && value->v.val < v->min) return E_2LOW;
-	*((int *)v->value) = value->v.val;
+	*((int *) SysVarValue(v)) = value->v.val;
     }
     return OK;
 }
@@ -940,29 +1107,85 @@ int GetSysVar(char const *name, Value *val)
     val->type = ERR_TYPE;
     if (!v) return E_NOSUCH_VAR;
     if (v->type == SPECIAL_TYPE) {
-	SysVarFunc f = (SysVarFunc) v->value;
-	return f(0, val);
+	return v->func(0, val);
     } else if (v->type == STR_TYPE) {
-        if (! * (char **) v->value) {
+        if (! * (char **) SysVarValue(v)) {
             val->v.str = StrDup("");
         } else {
-            val->v.str = StrDup(*((char **) v->value));
+            val->v.str = StrDup(*((char **) SysVarValue(v)));
         }
 	if (!val->v.str) return E_NO_MEM;
     } else {
-	val->v.val = *((int *) v->value);
+	val->v.val = *((int *) SysVarValue(v));
     }
     val->type = v->type;
 
     /* In "verbose" mode, print attempts to test $RunOff */
-    if (DebugFlag & DB_PRTLINE) {
-	if (v->value == (void *) &RunDisabled) {
+    if (Ctx->DebugFlag & DB_PRTLINE) {
+	if (v->offset == CTX_OFF(RunDisabled)) {
 	    Wprint("(Security note: $RunOff variable tested.)");
 	}
     }
     return OK;
 }
 
+/***************************************************************/
+/*                                                             */
+/*  InitSysVars                                                */
+/*                                                             */
+/*  Give the current context its own copy of each string       */
+/*  system variable that can be SET, so that setting one can   */
+/*  always free the old value.  If out of memory, the copies   */
+/*  made so far are freed and every such variable is left      */
+/*  NULL, so the context owns none of them and can be freed    */
+/*  with FreeContext.                                          */
+/*                                                             */
+/***************************************************************/
+int InitSysVars(void)
+{
+    size_t i, j;
+    char **str;
+
+    for (i=0; i<NUMSYSVARS; i++) {
+	if (SysVarArr[i].type != STR_TYPE || !SysVarArr[i].modifiable) continue;
+	str = (char **) SysVarValue(&SysVarArr[i]);
+	if (*str) {
+	    *str = StrDup(*str);
+	    if (!*str) break;
+	}
+    }
+    if (i == NUMSYSVARS) return OK;
+
+    for (j=0; j<NUMSYSVARS; j++) {
+	if (SysVarArr[j].type != STR_TYPE || !SysVarArr[j].modifiable) continue;
+	str = (char **) SysVarValue(&SysVarArr[j]);
+	/* Those from i on were never copied and aren't ours */
+	if (j < i) free(*str);
+	*str = NULL;
+    }
+    return E_NO_MEM;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  DestroySysVars                                             */
+/*                                                             */
+/*  Free the strings allocated by InitSysVars and SET.         */
+/*                                                             */
+/***************************************************************/
+void DestroySysVars(void)
+{
+    size_t i;
+    char **str;
+
+    for (i=0; i<NUMSYSVARS; i++) {
+	if (SysVarArr[i].type != STR_TYPE || !SysVarArr[i].modifiable) continue;
+	str = (char **) SysVarValue(&SysVarArr[i]);
+	free(*str);
+	*str = NULL;
+    }
+}
+
 /***************************************************************/
 /*                                                             */
 /* FindSysVar                                                  */
@@ -1033,25 +1256,24 @@ static void DumpSysVar(char const *name, const SysVar *v)
     fprintf(ErrFp, "%16s  ", buffer);
     if (v) {
 	if (v->type == SPECIAL_TYPE) {
-	    SysVarFunc f = (SysVarFunc) v->value;
-	    f(0, &vtmp);
+	    v->func(0, &vtmp);
 	    PrintValue(&vtmp, ErrFp);
 	    putc('\n', ErrFp);
 	    DestroyValue(vtmp);
 	} else if (v->type == STR_TYPE) {
             vtmp.type = STR_TYPE;
-            vtmp.v.str = * ((char **)v->value);
+            vtmp.v.str = * ((char **) SysVarValue(v));
             PrintValue(&vtmp, ErrFp);
 	    putc('\n', ErrFp);
 	} else if (v->type == DATE_TYPE) {
 	    vtmp.type = DATE_TYPE;
-	    vtmp.v.val = * (int *) v->value;
+	    vtmp.v.val = * (int *) SysVarValue(v);
 	    PrintValue(&vtmp, ErrFp);
 	    putc('\n', ErrFp);
 	} else {
-	    if (!v->modifiable) fprintf(ErrFp, "%d\n", *((int *)v->value));
+	    if (!v->modifiable) fprintf(ErrFp, "%d\n", *((int *) SysVarValue(v)));
 	    else {
-		fprintf(ErrFp, "%-10d  ", *((int *)v->value));
+		fprintf(ErrFp, "%-10d  ", *((int *) SysVarValue(v)));
 		if (v->min == ANY) fprintf(ErrFp, "(-Inf, ");
 		else                         fprintf(ErrFp, "[%d, ", v->min);
 		if (v->max == ANY) fprintf(ErrFp, "Inf)\n");
@@ -1066,8 +1288,8 @@ static void DumpSysVar(char const *name, const SysVar *v)
 void
 set_lat_and_long_from_components(void)
 {
-    Latitude = (double) LatDeg + ((double) LatMin) / 60.0 + ((double) LatSec) / 3600.0;
-    Longitude = - ( (double) LongDeg + ((double) LongMin) / 60.0 + ((double) LongSec) / 3600.0);
+    Ctx->Latitude = (double) Ctx->LatDeg + ((double) Ctx->LatMin) / 60.0 + ((double) Ctx->LatSec) / 3600.0;
+    Ctx->Longitude = - ( (double) Ctx->LongDeg + ((double) Ctx->LongMin) / 60.0 + ((double) Ctx->LongSec) / 3600.0);
 }
 
 void
@@ -1075,35 +1297,35 @@ set_components_from_lat_and_long(void)
 {
     double x;
 
-    x = (Latitude < 0.0 ? -Latitude : Latitude);
-    LatDeg = (int) x;
-    x -= (double) LatDeg;
+    x = (Ctx->Latitude < 0.0 ? -Ctx->Latitude : Ctx->Latitude);
+    Ctx->LatDeg = (int) x;
+    x -= (double) Ctx->LatDeg;
     x *= 60;
-    LatMin = (int) x;
-    x -= (double) LatMin;
+    Ctx->LatMin = (int) x;
+    x -= (double) Ctx->LatMin;
     x *= 60;
-    LatSec = (int) x;
-    if (Latitude < 0.0) {
-        LatDeg = -LatDeg;
-        LatMin = -LatMin;
-        LatSec = -LatSec;
+    Ctx->LatSec = (int) x;
+    if (Ctx->Latitude < 0.0) {
+        Ctx->LatDeg = -Ctx->LatDeg;
+        Ctx->LatMin = -Ctx->LatMin;
+        Ctx->LatSec = -Ctx->LatSec;
     }
 
-    x = (Longitude < 0.0 ? -Longitude : Longitude);
-    LongDeg = (int) x;
-    x -= (double) LongDeg;
+    x = (Ctx->Longitude < 0.0 ? -Ctx->Longitude : Ctx->Longitude);
+    Ctx->LongDeg = (int) x;
+    x -= (double) Ctx->LongDeg;
     x *= 60;
-    LongMin = (int) x;
-    x -= (double) LongMin;
+    Ctx->LongMin = (int) x;
+    x -= (double) Ctx->LongMin;
     x *= 60;
-    LongSec = (int) x;
+    Ctx->LongSec = (int) x;
 
     /* Use STANDARD sign for $Longitude even if $LongDeg, $LongMin and
      * $LongSec are messed up */
-    if (Longitude > 0.0) {
-        LongDeg = -LongDeg;
-        LongMin = -LongMin;
-        LongSec = -LongSec;
+    if (Ctx->Longitude > 0.0) {
+        Ctx->LongDeg = -Ctx->LongDeg;
+        Ctx->LongMin = -Ctx->LongMin;
+        Ctx->LongSec = -Ctx->LongSec;
     }
 }
 
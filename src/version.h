@@ -0,0 +1 @@
+#define VERSION "04.02.00"
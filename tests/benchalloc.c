@@ -0,0 +1,64 @@
+/***************************************************************/
+/*                                                             */
+/*  BENCHALLOC.C                                               */
+/*                                                             */
+/*  A library to be put in LD_PRELOAD that counts the calls to */
+/*  malloc, calloc, realloc and free and the bytes asked for,  */
+/*  and writes the counts to the file named by                 */
+/*  BENCH_ALLOC_OUT when the program exits.  It calls glibc's  */
+/*  own allocator underneath, so it works only with glibc.     */
+/*                                                             */
+/*  This file is part of REMIND.                               */
+/*  Copyright (C) 1992-2022 by Dianne Skoll                    */
+/*                                                             */
+/***************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+static unsigned long Mallocs, Reallocs, Frees, Bytes;
+
+void *malloc(size_t size)
+{
+    __sync_fetch_and_add(&Mallocs, 1);
+    __sync_fetch_and_add(&Bytes, size);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size)
+{
+    __sync_fetch_and_add(&Mallocs, 1);
+    __sync_fetch_and_add(&Bytes, n * size);
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    __sync_fetch_and_add(&Reallocs, 1);
+    __sync_fetch_and_add(&Bytes, size);
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr)
+{
+    if (ptr) __sync_fetch_and_add(&Frees, 1);
+    __libc_free(ptr);
+}
+
+__attribute__ ((destructor))
+static void WriteCounts(void)
+{
+    char const *out = getenv("BENCH_ALLOC_OUT");
+    FILE *fp;
+
+    if (!out) return;
+    fp = fopen(out, "w");
+    if (!fp) return;
+    fprintf(fp, "%lu %lu %lu %lu\n", Mallocs, Reallocs, Frees, Bytes);
+    fclose(fp);
+}
@@ -0,0 +1,190 @@
+/***************************************************************/
+/*                                                             */
+/*  BENCHRUN.C                                                 */
+/*                                                             */
+/*  Time a command for the benchmarks.  Usage:                 */
+/*      benchrun name runs [-i file] -- command [arg...]       */
+/*                                                             */
+/*  Runs the command the given number of times with its        */
+/*  output thrown away and its input from file (or /dev/null), */
+/*  and prints one JSON line giving the fastest and median     */
+/*  wall-clock time and the largest resident set.  If          */
+/*  BENCH_ALLOC_LIB names the allocation-counting library, one */
+/*  more run is made with it preloaded to count calls to       */
+/*  malloc and friends.                                        */
+/*                                                             */
+/*  This file is part of REMIND.                               */
+/*  Copyright (C) 1992-2022 by Dianne Skoll                    */
+/*                                                             */
+/***************************************************************/
+
+#define _GNU_SOURCE 1
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+static char const *Input = "/dev/null";
+static char **Command;
+
+static void Usage(void)
+{
+    fprintf(stderr, "Usage: benchrun name runs [-i file] -- command [arg...]\n");
+    exit(1);
+}
+
+/* Print s as a JSON string */
+static void PutJson(char const *s)
+{
+    putchar('"');
+    for (; *s; s++) {
+	if (*s == '"' || *s == '\\') {
+	    printf("\\%c", *s);
+	} else if ((unsigned char) *s < 0x20) {
+	    printf("\\u%04x", (unsigned) *s);
+	} else {
+	    putchar(*s);
+	}
+    }
+    putchar('"');
+}
+
+static double Now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  RunOnce                                                    */
+/*                                                             */
+/*  Run the command once.  Stores the elapsed milliseconds in  */
+/*  *ms and the peak resident set in kilobytes in *rss, and    */
+/*  returns the exit status, or -1 if the command could not    */
+/*  be run or was killed.  If preload is non-NULL, it is put   */
+/*  in LD_PRELOAD and the counts written to out.               */
+/*                                                             */
+/***************************************************************/
+static int RunOnce(double *ms, long *rss, char const *preload, char const *out)
+{
+    struct rusage ru;
+    double start;
+    pid_t pid;
+    int status, fd;
+
+    start = Now();
+    pid = fork();
+    if (pid < 0) {
+	perror("fork");
+	return -1;
+    }
+    if (pid == 0) {
+	fd = open(Input, O_RDONLY);
+	if (fd < 0 || dup2(fd, 0) < 0) _exit(127);
+	fd = open("/dev/null", O_WRONLY);
+	if (fd < 0 || dup2(fd, 1) < 0 || dup2(fd, 2) < 0) _exit(127);
+	if (preload) {
+	    setenv("LD_PRELOAD", preload, 1);
+	    setenv("BENCH_ALLOC_OUT", out, 1);
+	}
+	execvp(Command[0], Command);
+	_exit(127);
+    }
+    if (wait4(pid, &status, 0, &ru) < 0) {
+	perror("wait4");
+	return -1;
+    }
+    *ms = Now() - start;
+    *rss = ru.ru_maxrss;
+    if (!WIFEXITED(status)) return -1;
+    return WEXITSTATUS(status);
+}
+
+static int CompareDoubles(void const *a, void const *b)
+{
+    double x = *(double const *) a, y = *(double const *) b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char *argv[])
+{
+    char const *name, *lib;
+    double *times;
+    long rss, maxrss = 0;
+    long mallocs = -1, reallocs = -1, frees = -1, bytes = -1;
+    int runs, i, r, status = 0;
+
+    if (argc < 5) Usage();
+    name = argv[1];
+    runs = atoi(argv[2]);
+    if (runs < 1) Usage();
+    argv += 3;
+    if (!strcmp(*argv, "-i")) {
+	if (!argv[1]) Usage();
+	Input = argv[1];
+	argv += 2;
+    }
+    if (!*argv || strcmp(*argv, "--") || !argv[1]) Usage();
+    Command = argv + 1;
+
+    times = malloc(runs * sizeof(double));
+    if (!times) {
+	perror("malloc");
+	return 1;
+    }
+    for (i = 0; i < runs; i++) {
+	r = RunOnce(&times[i], &rss, NULL, NULL);
+	if (r) status = r;
+	if (rss > maxrss) maxrss = rss;
+    }
+    qsort(times, runs, sizeof(double), CompareDoubles);
+
+    lib = getenv("BENCH_ALLOC_LIB");
+    if (lib && *lib && access(lib, R_OK) == 0) {
+	char out[] = "/tmp/benchallocXXXXXX";
+	double ms;
+	FILE *fp;
+	int fd = mkstemp(out);
+	if (fd >= 0) {
+	    close(fd);
+	    RunOnce(&ms, &rss, lib, out);
+	    fp = fopen(out, "r");
+	    if (fp) {
+		if (fscanf(fp, "%ld %ld %ld %ld",
+			   &mallocs, &reallocs, &frees, &bytes) != 4) {
+		    mallocs = reallocs = frees = bytes = -1;
+		}
+		fclose(fp);
+	    }
+	    unlink(out);
+	}
+    }
+
+    printf("{\"name\":");
+    PutJson(name);
+    printf(",\"args\":[");
+    for (i = 1; Command[i]; i++) {
+	if (i > 1) putchar(',');
+	PutJson(Command[i]);
+    }
+    printf("],\"runs\":%d,\"wall_ms_min\":%.2f,\"wall_ms_median\":%.2f,"
+	   "\"max_rss_kb\":%ld", runs, times[0], times[runs / 2], maxrss);
+    if (mallocs >= 0) {
+	printf(",\"mallocs\":%ld,\"reallocs\":%ld,\"frees\":%ld,\"bytes\":%ld",
+	       mallocs, reallocs, frees, bytes);
+    } else {
+	printf(",\"mallocs\":null,\"reallocs\":null,\"frees\":null,\"bytes\":null");
+    }
+    printf(",\"status\":%d}\n", status);
+    free(times);
+    return 0;
+}
@@ -0,0 +1,123 @@
+/***************************************************************/
+/*                                                             */
+/*  LIBTEST.C                                                  */
+/*                                                             */
+/*  Exercise libremind for the acceptance test.  Usage:        */
+/*      libtest file.rem exit.rem                              */
+/*                                                             */
+/*  This file is part of REMIND.                               */
+/*  Copyright (C) 1992-2022 by Dianne Skoll                    */
+/*                                                             */
+/***************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libremind.h"
+
+static void PrintOccurrences(RemHandle *h, int y, int m, int d, int n)
+{
+    RemOccurrence *occ;
+    int num, i, r;
+
+    r = rem_occurrences(h, y, m, d, n, &occ, &num);
+    if (r) {
+	printf("rem_occurrences: %s\n", rem_strerror(r));
+	return;
+    }
+    for (i=0; i<num; i++) {
+	printf("%04d-%02d-%02d time=%d dur=%d prio=%d passthru=%s tags=%s",
+	       occ[i].year, occ[i].month, occ[i].day, occ[i].time,
+	       occ[i].duration, occ[i].priority, occ[i].passthru, occ[i].tags);
+	if (occ[i].is_color) {
+	    printf(" rgb=%d,%d,%d", occ[i].r, occ[i].g, occ[i].b);
+	}
+	printf(" line=%d\n    body=|%s| plain=|%s|\n", occ[i].lineno,
+	       occ[i].body, occ[i].plain_body);
+    }
+    rem_free_occurrences(occ, num);
+}
+
+static void PrintEval(RemHandle *h, char const *expr)
+{
+    char *result;
+    int r = rem_eval(h, expr, &result);
+
+    if (r) {
+	printf("%s => error: %s\n", expr, rem_strerror(r));
+    } else {
+	printf("%s => %s\n", expr, result);
+	free(result);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    RemHandle *h, *h2, *h3;
+    int r;
+
+    if (argc != 3) {
+	fprintf(stderr, "Usage: libtest file.rem exit.rem\n");
+	return 1;
+    }
+
+    h = rem_new();
+    h2 = rem_new();
+    if (!h || !h2) {
+	fprintf(stderr, "rem_new failed\n");
+	return 1;
+    }
+    rem_set_error_file(h, stdout);
+    rem_set_error_file(h2, stdout);
+
+    r = rem_load(h, "nonexistent.rem");
+    printf("rem_load(nonexistent.rem): %s\n", rem_strerror(r));
+
+    rem_set_date(h, 2024, 2, 1);
+    rem_set_var(h, "Who", "\"world\"");
+    r = rem_load(h, argv[1]);
+    printf("rem_load: %s\n", rem_strerror(r));
+    PrintOccurrences(h, 2024, 2, 1, 7);
+
+    /* A second handle has its own variables and options */
+    rem_set_date(h2, 2024, 2, 5);
+    rem_set_var(h2, "Who", "\"there\"");
+    rem_set_option(h2, REM_OPT_TIME_FORMAT, 1);
+    rem_set_option(h2, REM_OPT_ADVANCE, 1);
+    rem_load(h2, argv[1]);
+    PrintOccurrences(h2, 2024, 2, 5, 1);
+
+    PrintEval(h, "today()");
+    PrintEval(h, "greeting()");
+    PrintEval(h, "Counter * 2");
+    PrintEval(h2, "greeting()");
+    PrintEval(h, "1 +");
+    PrintEval(h, "1 2");
+
+    /* Options apply to later queries */
+    rem_set_option(h, REM_OPT_NO_TIMED, 1);
+    PrintOccurrences(h, 2024, 2, 5, 1);
+    r = rem_set_date(h, 2024, 2, 30);
+    printf("rem_set_date(2024-02-30): %s\n", rem_strerror(r));
+    r = rem_set_option(h, 99, 1);
+    printf("rem_set_option(99): %s\n", rem_strerror(r));
+
+    /* EXIT ends the file, not this program */
+    h3 = rem_new();
+    if (!h3) {
+	fprintf(stderr, "rem_new failed\n");
+	return 1;
+    }
+    rem_set_error_file(h3, stdout);
+    rem_set_date(h3, 2024, 2, 5);
+    r = rem_load(h3, argv[2]);
+    printf("rem_load(exit.rem): %s\n", rem_strerror(r));
+    PrintOccurrences(h3, 2024, 2, 5, 1);
+    PrintOccurrences(h3, 2024, 2, 6, 1);
+    printf("Still running after EXIT\n");
+
+    rem_free(h);
+    rem_free(h2);
+    rem_free(h3);
+    return 0;
+}
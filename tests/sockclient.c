@@ -0,0 +1,126 @@
+/***************************************************************/
+/*                                                             */
+/*  SOCKCLIENT.C                                               */
+/*                                                             */
+/*  Talk to a Remind server socket for the acceptance test.    */
+/*  Usage:                                                     */
+/*      sockclient path < script                               */
+/*                                                             */
+/*  Each line of the script is one of:                         */
+/*      send line    - send line to the server                 */
+/*      wait text    - print lines from the server up to and   */
+/*                     including one containing text           */
+/*                                                             */
+/*  Gives up with exit status 1 if a wait takes more than a    */
+/*  couple of minutes or the server goes away.                 */
+/*                                                             */
+/*  This file is part of REMIND.                               */
+/*  Copyright (C) 1992-2022 by Dianne Skoll                    */
+/*                                                             */
+/***************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define WAIT_SECONDS 150
+
+static char InBuf[65536];
+static size_t InLen = 0;
+
+/* Read one line from the server into line, without its newline.
+   Returns 0 on success, -1 on EOF, error or time-out. */
+static int ReadLine(int fd, char *line, size_t size, time_t deadline)
+{
+    char *nl;
+    size_t n;
+    ssize_t got;
+    fd_set readSet;
+    struct timeval tv;
+
+    while (1) {
+	nl = memchr(InBuf, '\n', InLen);
+	if (nl) {
+	    n = nl - InBuf;
+	    if (n >= size) n = size-1;
+	    memcpy(line, InBuf, n);
+	    line[n] = 0;
+	    InLen -= (nl + 1 - InBuf);
+	    memmove(InBuf, nl+1, InLen);
+	    return 0;
+	}
+	if (InLen == sizeof(InBuf) || time(NULL) >= deadline) return -1;
+	FD_ZERO(&readSet);
+	FD_SET(fd, &readSet);
+	tv.tv_sec = 1;
+	tv.tv_usec = 0;
+	if (select(fd+1, &readSet, NULL, NULL, &tv) < 0) {
+	    if (errno == EINTR) continue;
+	    return -1;
+	}
+	if (!FD_ISSET(fd, &readSet)) continue;
+	got = read(fd, InBuf+InLen, sizeof(InBuf) - InLen);
+	if (got <= 0) return -1;
+	InLen += got;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    struct sockaddr_un addr;
+    char cmd[4096];
+    char line[65536];
+    size_t len;
+    int fd;
+
+    if (argc != 2 || strlen(argv[1]) >= sizeof(addr.sun_path)) {
+	fprintf(stderr, "Usage: sockclient path < script\n");
+	return 1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, argv[1]);
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+	fprintf(stderr, "sockclient: cannot connect to %s: %s\n",
+		argv[1], strerror(errno));
+	return 1;
+    }
+
+    while (fgets(cmd, sizeof(cmd), stdin)) {
+	len = strlen(cmd);
+	if (len && cmd[len-1] == '\n') cmd[--len] = 0;
+	if (!strncmp(cmd, "send ", 5)) {
+	    cmd[len++] = '\n';
+	    if (write(fd, cmd+5, len-5) != (ssize_t) (len-5)) {
+		fprintf(stderr, "sockclient: write failed: %s\n",
+			strerror(errno));
+		return 1;
+	    }
+	} else if (!strncmp(cmd, "wait ", 5)) {
+	    time_t deadline = time(NULL) + WAIT_SECONDS;
+	    do {
+		if (ReadLine(fd, line, sizeof(line), deadline) < 0) {
+		    printf("sockclient: gave up waiting for %s\n", cmd+5);
+		    return 1;
+		}
+		printf("%s\n", line);
+	    } while (!strstr(line, cmd+5));
+	} else if (*cmd) {
+	    fprintf(stderr, "sockclient: bad script line: %s\n", cmd);
+	    return 1;
+	}
+	fflush(stdout);
+    }
+    close(fd);
+    return 0;
+}